@@ -6,15 +6,155 @@
 #include <args/args.hxx>
 
 #include "common/NavMesh.h"
+#include "common/ZoneManifest.h"
 
 #include <filesystem>
 #include <fmt/format.h>
+#include <fmt/ranges.h>
 
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
+#include <algorithm>
+#include <ppl.h>
+#include <set>
+#include <windows.h>
+
 namespace fs = std::filesystem;
 
+// Paths the mesh generator builds with, from its ini file next to this executable.
+struct BuildPaths
+{
+	std::string eqPath;
+	std::string outputPath;
+	bool useMaxExtents = true;
+};
+
+static fs::path GetModuleDirectory()
+{
+	CHAR fullPath[MAX_PATH] = { 0 };
+	GetModuleFileNameA(nullptr, fullPath, MAX_PATH);
+
+	return fs::path(fullPath).parent_path();
+}
+
+static BuildPaths LoadBuildPaths()
+{
+	const std::string iniFile = (GetModuleDirectory() / "config" / "MeshGenerator.ini").string();
+
+	CHAR buffer[MAX_PATH] = { 0 };
+	BuildPaths paths;
+
+	GetPrivateProfileStringA("General", "EverQuest Path", "", buffer, MAX_PATH, iniFile.c_str());
+	paths.eqPath = buffer;
+
+	GetPrivateProfileStringA("General", "Output Path", "", buffer, MAX_PATH, iniFile.c_str());
+	if (buffer[0])
+		paths.outputPath = std::string(buffer) + "\\resources\\MQ2Nav";
+
+	GetPrivateProfileStringA("General", "ZoneMaxExtents", "true", buffer, MAX_PATH, iniFile.c_str());
+	paths.useMaxExtents = !_stricmp(buffer, "true");
+
+	return paths;
+}
+
+struct ZoneRebuild
+{
+	std::string zoneShortName;
+	std::vector<std::string> reasons;
+};
+
+static ZoneBuildInputs CollectInputs(const BuildPaths& paths, const std::string& zoneShortName, bool& hasNavMesh)
+{
+	ZoneBuildInputs inputs;
+	inputs.HashSources(paths.eqPath, paths.outputPath, zoneShortName);
+
+	NavMesh navMesh(paths.outputPath, zoneShortName);
+	hasNavMesh = navMesh.LoadNavMeshFile() == NavMesh::LoadResult::Success;
+	if (hasNavMesh)
+		inputs.HashSettings(navMesh, paths.useMaxExtents);
+
+	return inputs;
+}
+
+// Zones in the manifest and zones with a navmesh, if none are named.
+static std::vector<std::string> GetLibraryZones(const BuildPaths& paths, const ZoneManifest& manifest)
+{
+	std::set<std::string> zones;
+	for (const auto& [zoneShortName, inputs] : manifest.GetZones())
+		zones.insert(zoneShortName);
+
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(paths.outputPath, ec))
+	{
+		if (entry.is_regular_file(ec) && entry.path().extension() == ".navmesh")
+			zones.insert(entry.path().stem().string());
+	}
+
+	return { zones.begin(), zones.end() };
+}
+
+// The zones whose inputs differ from their last build, in the order given. Zones
+// are hashed in parallel, the archives of a zone library add up to gigabytes.
+static std::vector<ZoneRebuild> PlanRebuilds(const BuildPaths& paths, const ZoneManifest& manifest,
+	const std::vector<std::string>& zones)
+{
+	std::vector<ZoneRebuild> plan(zones.size());
+
+	concurrency::parallel_for(size_t(0), zones.size(), [&](size_t i)
+		{
+			ZoneRebuild& rebuild = plan[i];
+			rebuild.zoneShortName = zones[i];
+
+			bool hasNavMesh = false;
+			ZoneBuildInputs inputs = CollectInputs(paths, zones[i], hasNavMesh);
+
+			if (inputs.sources.empty())
+			{
+				// Not a zone of this client, nothing to build it from.
+				SPDLOG_WARN("No sources for {} in {}", zones[i], paths.eqPath);
+				return;
+			}
+
+			const ZoneBuildInputs* built = manifest.Find(zones[i]);
+			if (!hasNavMesh)
+				rebuild.reasons.push_back("no navmesh");
+			else if (!built)
+				rebuild.reasons.push_back("not in the manifest");
+			else
+				rebuild.reasons = inputs.Compare(*built);
+		});
+
+	plan.erase(std::remove_if(plan.begin(), plan.end(),
+		[](const ZoneRebuild& rebuild) { return rebuild.reasons.empty(); }), plan.end());
+
+	return plan;
+}
+
+static int RunMeshGenerator(const std::string& arguments)
+{
+	const std::string exePath = (GetModuleDirectory() / "MeshGenerator.exe").string();
+	std::string commandLine = fmt::format("\"{}\" {}", exePath, arguments);
+
+	STARTUPINFOA startupInfo = { sizeof(startupInfo) };
+	PROCESS_INFORMATION process = {};
+	if (!CreateProcessA(exePath.c_str(), commandLine.data(), nullptr, nullptr, FALSE,
+		0, nullptr, nullptr, &startupInfo, &process))
+	{
+		SPDLOG_ERROR("Failed to start {}: error {}", exePath, GetLastError());
+		return -1;
+	}
+
+	WaitForSingleObject(process.hProcess, INFINITE);
+
+	DWORD exitCode = 0;
+	GetExitCodeProcess(process.hProcess, &exitCode);
+	CloseHandle(process.hProcess);
+	CloseHandle(process.hThread);
+
+	return static_cast<int>(exitCode);
+}
+
 int main(int argc, char** argv)
 {
 	args::ArgumentParser parser("MeshTool", "For help about a command, run MeshTool <command> -h");
@@ -24,6 +164,15 @@ int main(int argc, char** argv)
 		args::Positional<std::string> inputMesh(convert, "input", "Input navmesh file to load", args::Options::Required);
 		args::Positional<std::string> outputMesh(convert, "output", "Output navmesh file to save");
 		args::ValueFlag<int> meshVersion(convert, "version", "Navmesh version to save (defaults to latest)", { "version" }, (int)NavMeshHeaderVersion::Latest);
+	args::Command plan(commands, "plan", "List the zones whose sources, settings or tool version changed since they were built");
+		args::PositionalList<std::string> planZones(plan, "zones", "Zones to check (defaults to every zone in the manifest or with a navmesh)");
+		args::ValueFlag<std::string> planEqPath(plan, "path", "Client directory to compare against (defaults to the mesh generator's)", { "eq" });
+	args::Command rebuild(commands, "rebuild", "Build the zones that plan lists, in parallel");
+		args::PositionalList<std::string> rebuildZones(rebuild, "zones", "Zones to check (defaults to every zone in the manifest or with a navmesh)");
+		args::ValueFlag<int> rebuildWorkers(rebuild, "count", "Number of build processes", { "workers" }, 4);
+		args::ValueFlag<int> rebuildShards(rebuild, "count", "Number of shards to split each zone into", { "shards" }, 4);
+	args::Command record(commands, "record", "Record the current inputs of zones as built, without building them");
+		args::PositionalList<std::string> recordZones(record, "zones", "Zones to record (defaults to every zone with a navmesh)");
 
 	args::Group arguments("arguments");
 	args::GlobalOptions globals(parser, arguments);
@@ -119,6 +268,78 @@ int main(int argc, char** argv)
 			fmt::print("Failed!\n");
 		}
 	}
+	else if (plan || rebuild || record)
+	{
+		BuildPaths paths = LoadBuildPaths();
+		if (planEqPath)
+			paths.eqPath = planEqPath.Get();
+
+		if (paths.eqPath.empty() || paths.outputPath.empty())
+		{
+			SPDLOG_ERROR("Set the EverQuest and output paths in the mesh generator first");
+			return 1;
+		}
+
+		ZoneManifest manifest(paths.outputPath);
+		if (!manifest.Load())
+			return 1;
+
+		std::vector<std::string> zones = plan ? planZones.Get() : rebuild ? rebuildZones.Get() : recordZones.Get();
+		if (zones.empty())
+			zones = GetLibraryZones(paths, manifest);
+
+		if (record)
+		{
+			// Adopts meshes built before there was a manifest, or by hand.
+			int recorded = 0;
+			for (const std::string& zone : zones)
+			{
+				bool hasNavMesh = false;
+				ZoneBuildInputs inputs = CollectInputs(paths, zone, hasNavMesh);
+				if (!hasNavMesh)
+				{
+					SPDLOG_WARN("Skipping {}, it has no navmesh", zone);
+					continue;
+				}
+
+				manifest.Record(zone, inputs);
+				++recorded;
+			}
+
+			fmt::print("Recorded {} zones in {}\n", recorded, manifest.GetFilename());
+			return manifest.Save() ? 0 : 1;
+		}
+
+		std::vector<ZoneRebuild> rebuilds = PlanRebuilds(paths, manifest, zones);
+
+		for (const ZoneRebuild& zoneRebuild : rebuilds)
+		{
+			fmt::print("{}: {}\n", zoneRebuild.zoneShortName, fmt::join(zoneRebuild.reasons, ", "));
+		}
+		fmt::print("{} of {} zones need to be rebuilt\n", rebuilds.size(), zones.size());
+
+		if (rebuild && !rebuilds.empty())
+		{
+			std::vector<std::string> rebuildNames;
+			for (const ZoneRebuild& zoneRebuild : rebuilds)
+				rebuildNames.push_back(zoneRebuild.zoneShortName);
+
+			// The mesh generator records each zone in the manifest as it is built.
+			const int failedZones = RunMeshGenerator(fmt::format("--build {} --workers {} --shards {}",
+				fmt::join(rebuildNames, ","), rebuildWorkers.Get(), rebuildShards.Get()));
+
+			if (failedZones < 0)
+				return 1;
+
+			if (failedZones != 0)
+			{
+				SPDLOG_ERROR("{} zones failed to build, see the mesh generator's coordinator log", failedZones);
+				return 1;
+			}
+
+			fmt::print("Rebuilt {} zones\n", rebuilds.size());
+		}
+	}
 	else
 	{
 		std::cout << parser;
@@ -5,6 +5,7 @@
 #include "NavMesh.h"
 
 #include "common/JsonProto.h"
+#include "common/NavMeshFileWriter.h"
 #include "common/Utilities.h"
 #include "common/proto/NavMeshFile.pb.h"
 #include "mq/base/Enum.h"
@@ -107,9 +108,53 @@ void NavMesh::SetNavMesh(const std::shared_ptr<dtNavMesh>& navMesh, bool reset)
 
 	m_navMesh = navMesh;
 	m_navMeshQuery.reset();
+	m_profileMeshes.clear();
 	m_lastLoadResult = LoadResult::None;
 }
 
+void NavMesh::SetProfileNavMeshes(const std::vector<std::shared_ptr<dtNavMesh>>& navMeshes)
+{
+	m_profileMeshes.clear();
+
+	for (const auto& navMesh : navMeshes)
+	{
+		m_profileMeshes.push_back({ navMesh, nullptr });
+	}
+}
+
+std::shared_ptr<dtNavMesh> NavMesh::GetNavMesh(int profile) const
+{
+	if (profile == 0)
+		return m_navMesh;
+
+	if (profile < 0 || profile > static_cast<int>(m_profileMeshes.size()))
+		return nullptr;
+
+	return m_profileMeshes[profile - 1].navMesh;
+}
+
+int NavMesh::GetProfileCount() const
+{
+	if (!m_navMesh)
+		return 0;
+
+	return 1 + static_cast<int>(m_profileMeshes.size());
+}
+
+int NavMesh::FindProfile(std::string_view name) const
+{
+	if (name.empty())
+		return m_navMesh ? 0 : -1;
+
+	for (size_t i = 0; i < m_config.extraProfiles.size() && i < m_profileMeshes.size(); ++i)
+	{
+		if (m_config.extraProfiles[i].name == name)
+			return static_cast<int>(i) + 1;
+	}
+
+	return -1;
+}
+
 void NavMesh::ResetSavedData(PersistedDataFields fields)
 {
 	if (+(fields & PersistedDataFields::BuildSettings))
@@ -122,6 +167,7 @@ void NavMesh::ResetSavedData(PersistedDataFields fields)
 	{
 		m_navMesh.reset();
 		m_navMeshQuery.reset();
+		m_profileMeshes.clear();
 	}
 
 	if (+(fields & PersistedDataFields::AreaTypes))
@@ -141,38 +187,44 @@ void NavMesh::ResetSavedData(PersistedDataFields fields)
 		m_connections.clear();
 		m_connectionsById.clear();
 		m_nextConnectionId = 1;
+		++m_connectionsVersion;
 	}
 }
 
 void NavMesh::ResetNavMesh()
 {
 	SetNavMesh(nullptr, true);
+	m_profileMeshes.clear();
 
 	OnNavMeshChanged();
 }
 
-std::shared_ptr<dtNavMeshQuery> NavMesh::GetNavMeshQuery()
+std::shared_ptr<dtNavMeshQuery> NavMesh::GetNavMeshQuery(int profile)
 {
-	if (!m_navMeshQuery)
+	std::shared_ptr<dtNavMesh> navMesh = GetNavMesh(profile);
+	if (!navMesh)
+		return nullptr;
+
+	std::shared_ptr<dtNavMeshQuery>& navMeshQuery = profile == 0
+		? m_navMeshQuery : m_profileMeshes[profile - 1].navMeshQuery;
+
+	if (!navMeshQuery)
 	{
-		if (m_navMesh)
-		{
-			auto query = std::shared_ptr<dtNavMeshQuery>(dtAllocNavMeshQuery(),
-				[](dtNavMeshQuery* ptr) { dtFreeNavMeshQuery(ptr); });
+		auto query = std::shared_ptr<dtNavMeshQuery>(dtAllocNavMeshQuery(),
+			[](dtNavMeshQuery* ptr) { dtFreeNavMeshQuery(ptr); });
 
-			dtStatus status = query->init(m_navMesh.get(), NAVMESH_QUERY_MAX_NODES);
-			if (dtStatusFailed(status))
-			{
-				SPDLOG_ERROR("GetNavMeshQuery: Could not init detour nav mesh query");
-			}
-			else
-			{
-				m_navMeshQuery = query;
-			}
+		dtStatus status = query->init(navMesh.get(), NAVMESH_QUERY_MAX_NODES);
+		if (dtStatusFailed(status))
+		{
+			SPDLOG_ERROR("GetNavMeshQuery: Could not init detour nav mesh query");
+		}
+		else
+		{
+			navMeshQuery = query;
 		}
 	}
 
-	return m_navMeshQuery;
+	return navMeshQuery;
 }
 
 void NavMesh::SetNavMeshBounds(const glm::vec3& min, const glm::vec3& max)
@@ -273,6 +325,15 @@ static void ToProto(nav::BuildSettings& out_proto, const NavMeshConfig& config)
 	out_proto.set_detail_sample_dist(config.detailSampleDist);
 	out_proto.set_detail_sample_max_error(config.detailSampleMaxError);
 	out_proto.set_partition_type(static_cast<int>(config.partitionType));
+
+	for (const AgentProfile& profile : config.extraProfiles)
+	{
+		nav::AgentProfile* proto_profile = out_proto.add_extra_profiles();
+		proto_profile->set_name(profile.name);
+		proto_profile->set_agent_height(profile.agentHeight);
+		proto_profile->set_agent_radius(profile.agentRadius);
+		proto_profile->set_agent_max_climb(profile.agentMaxClimb);
+	}
 }
 
 static void FromProto(const nav::BuildSettings& proto, NavMeshConfig& config)
@@ -295,6 +356,16 @@ static void FromProto(const nav::BuildSettings& proto, NavMeshConfig& config)
 	config.detailSampleDist = proto.detail_sample_dist();
 	config.detailSampleMaxError = proto.detail_sample_max_error();
 	config.partitionType = static_cast<PartitionType>(proto.partition_type());
+
+	config.extraProfiles.clear();
+	for (const nav::AgentProfile& proto_profile : proto.extra_profiles())
+	{
+		AgentProfile& profile = config.extraProfiles.emplace_back();
+		profile.name = proto_profile.name();
+		profile.agentHeight = proto_profile.agent_height();
+		profile.agentRadius = proto_profile.agent_radius();
+		profile.agentMaxClimb = proto_profile.agent_max_climb();
+	}
 }
 
 static void ToProto(nav::ConvexVolume& out_proto, const ConvexVolume& volume)
@@ -375,63 +446,86 @@ static void FromProto(const nav::PolyAreaType& in_proto, PolyAreaType& area)
 	area.valid = true;
 }
 
-void NavMesh::LoadFromProto(const nav::NavMeshFile& proto, PersistedDataFields fields)
+// Copy tile data into a buffer owned by the navmesh and add it.
+static bool AddTileData(dtNavMesh* navMesh, dtTileRef ref, const uint8_t* tileData, size_t length)
 {
-	if (+(fields & PersistedDataFields::MeshTiles))
+	// allocate buffer for the data
+	uint8_t* data = (uint8_t*)dtAlloc((int)length, DT_ALLOC_PERM);
+	memcpy(data, tileData, length);
+
+	dtMeshHeader* tileheader = (dtMeshHeader*)data;
+
+	dtStatus status = navMesh->addTile(data, (int)length, DT_TILE_FREE_DATA, ref, nullptr);
+	if (status != DT_SUCCESS)
 	{
-		// read the tileset
-		const nav::NavMeshTileSet& tileset = proto.tile_set();
+		SPDLOG_WARN("Failed to read tile: {}, {} ({}) = {}",
+			tileheader->x, tileheader->y, tileheader->layer, status);
 
-		if (tileset.compatibility_version() == NAVMESH_TILE_COMPAT_VERSION)
-		{
-			dtNavMeshParams params;
-			FromProto(params, tileset.mesh_params());
+		dtFree(data);
+		return false;
+	}
 
-			std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(),
-				[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+	return true;
+}
 
-			// would prefer to have proper origin, but this can fix it up too.
-			params.orig[0] = proto.build_settings().bounds_min().x();
-			params.orig[1] = proto.build_settings().bounds_min().y();
-			params.orig[2] = proto.build_settings().bounds_min().z();
+// Create a navmesh from a tile set, with the tiles it holds.
+static std::shared_ptr<dtNavMesh> CreateNavMesh(const nav::NavMeshTileSet& tileset, const nav::NavMeshFile& proto)
+{
+	if (tileset.compatibility_version() != NAVMESH_TILE_COMPAT_VERSION)
+	{
+		SPDLOG_ERROR("loadMesh: navmesh has incompatible structure, will continue loading without tiles.");
+		return nullptr;
+	}
 
-			dtStatus status = navMesh->init(&params);
-			if (status == DT_SUCCESS)
-			{
-				// read the mesh tiles and add them to the navmesh one by one.
-				for (const nav::NavMeshTile& tile : tileset.tiles())
-				{
-					dtTileRef ref = tile.tile_ref();
-					const std::string& tiledata = tile.tile_data();
+	dtNavMeshParams params;
+	FromProto(params, tileset.mesh_params());
 
-					if (ref == 0 || tiledata.length() == 0)
-						continue;
+	std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(),
+		[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
 
-					// allocate buffer for the data
-					uint8_t* data = (uint8_t*)dtAlloc((int)tiledata.length(), DT_ALLOC_PERM);
-					memcpy(data, &tiledata[0], tiledata.length());
+	// would prefer to have proper origin, but this can fix it up too.
+	params.orig[0] = proto.build_settings().bounds_min().x();
+	params.orig[1] = proto.build_settings().bounds_min().y();
+	params.orig[2] = proto.build_settings().bounds_min().z();
 
-					dtMeshHeader* tileheader = (dtMeshHeader*)data;
+	dtStatus status = navMesh->init(&params);
+	if (status != DT_SUCCESS)
+	{
+		SPDLOG_ERROR("loadMesh: failed to initialize navmesh, will continue loading without tiles.");
+		return nullptr;
+	}
 
-					dtStatus status = navMesh->addTile(data, (int)tiledata.length(), DT_TILE_FREE_DATA, ref, nullptr);
-					if (status != DT_SUCCESS)
-					{
-						SPDLOG_WARN("Failed to read tile: {}, {} ({}) = {}",
-							tileheader->x, tileheader->y, tileheader->layer, status);
-					}
-				}
+	// read the mesh tiles and add them to the navmesh one by one.
+	for (const nav::NavMeshTile& tile : tileset.tiles())
+	{
+		dtTileRef ref = tile.tile_ref();
+		const std::string& tiledata = tile.tile_data();
 
-				m_navMesh = std::move(navMesh);
-			}
-			else
+		if (ref == 0 || tiledata.length() == 0)
+			continue;
+
+		AddTileData(navMesh.get(), ref, reinterpret_cast<const uint8_t*>(&tiledata[0]), tiledata.length());
+	}
+
+	return navMesh;
+}
+
+void NavMesh::LoadFromProto(const nav::NavMeshFile& proto, PersistedDataFields fields)
+{
+	if (+(fields & PersistedDataFields::MeshTiles))
+	{
+		// read the tileset
+		if (std::shared_ptr<dtNavMesh> navMesh = CreateNavMesh(proto.tile_set(), proto))
+		{
+			m_navMesh = std::move(navMesh);
+
+			// and those of the extra agent profiles. A profile that fails to load
+			// keeps its place, so that the following ones keep their index.
+			for (const nav::NavMeshTileSet& tileset : proto.profile_tile_sets())
 			{
-				SPDLOG_ERROR("loadMesh: failed to initialize navmesh, will continue loading without tiles.");
+				m_profileMeshes.push_back({ CreateNavMesh(tileset, proto), nullptr });
 			}
 		}
-		else
-		{
-			SPDLOG_ERROR("loadMesh: navmesh has incompatible structure, will continue loading without tiles.");
-		}
 	}
 
 	if (+(fields & PersistedDataFields::BuildSettings))
@@ -489,6 +583,7 @@ void NavMesh::LoadFromProto(const nav::NavMeshFile& proto, PersistedDataFields f
 				[](const auto& l, const auto& r) { return l->id < r->id; });
 
 		m_nextConnectionId = (result != std::end(m_connections) ? (*result)->id : 0) + 1;
+		++m_connectionsVersion;
 	}
 }
 
@@ -509,6 +604,18 @@ void NavMesh::SaveToProto(nav::NavMeshFile& proto, PersistedDataFields fields)
 		tileset->set_compatibility_version(NAVMESH_TILE_COMPAT_VERSION);
 		ToProto(*tileset->mutable_mesh_params(), m_navMesh->getParams());
 		ToProto(*tileset->mutable_tiles(), m_navMesh.get());
+
+		for (const ProfileMesh& profileMesh : m_profileMeshes)
+		{
+			nav::NavMeshTileSet* profileTileset = proto.add_profile_tile_sets();
+			profileTileset->set_compatibility_version(NAVMESH_TILE_COMPAT_VERSION);
+
+			if (profileMesh.navMesh)
+			{
+				ToProto(*profileTileset->mutable_mesh_params(), profileMesh.navMesh->getParams());
+				ToProto(*profileTileset->mutable_tiles(), profileMesh.navMesh.get());
+			}
+		}
 	}
 
 	if (+(fields & PersistedDataFields::ConvexVolumes))
@@ -650,7 +757,31 @@ NavMesh::LoadResult NavMesh::LoadMesh(const char* filename)
 		return LoadResult::VersionMismatch;
 	}
 
-	data_ptr += headerSize; data_size -= headerSize;
+	// Version 6 keeps the tiles out of the proto, they are read from the tile index
+	// once the rest is loaded. Version 7 adds the agent profile to the index.
+	const MeshFileHeaderV6* fileHeaderV6 = nullptr;
+	const size_t indexEntrySize = headerVersion >= (uint16_t)NavMeshHeaderVersion::Version7
+		? sizeof(NavMeshTileIndexEntryV7) : sizeof(NavMeshTileIndexEntry);
+	if (headerVersion >= (uint16_t)NavMeshHeaderVersion::Version6)
+	{
+		fileHeaderV6 = (const MeshFileHeaderV6*)data_ptr;
+
+		if (filesize < sizeof(MeshFileHeaderV6)
+			|| headerSize < sizeof(MeshFileHeaderV6)
+			|| fileHeaderV6->metadataOffset + fileHeaderV6->metadataSize > filesize
+			|| fileHeaderV6->tileIndexOffset + fileHeaderV6->tileCount * indexEntrySize > filesize)
+		{
+			SPDLOG_ERROR("loadMesh: mesh file is not a valid mesh file");
+			return LoadResult::Corrupt;
+		}
+
+		data_ptr = buffer.get() + fileHeaderV6->metadataOffset;
+		data_size = fileHeaderV6->metadataSize;
+	}
+	else
+	{
+		data_ptr += headerSize; data_size -= headerSize;
+	}
 
 	bool compressed = +(fileHeader->flags & NavMeshFileFlags::COMPRESSED) != 0;
 	nav::NavMeshFile file_proto;
@@ -666,7 +797,8 @@ NavMesh::LoadResult NavMesh::LoadMesh(const char* filename)
 				return LoadResult::Corrupt;
 			}
 
-			buffer.reset();
+			if (!fileHeaderV6)
+				buffer.reset();
 
 			if (!file_proto.ParseFromArray(&data[0], (int)data.size()))
 			{
@@ -703,6 +835,54 @@ NavMesh::LoadResult NavMesh::LoadMesh(const char* filename)
 	ResetSavedData(PersistedDataFields::All);
 	LoadFromProto(file_proto, PersistedDataFields::All);
 
+	if (fileHeaderV6 && m_navMesh)
+	{
+		const char* index = buffer.get() + fileHeaderV6->tileIndexOffset;
+
+		try
+		{
+			std::vector<uint8_t> tileData;
+
+			for (uint32_t i = 0; i < fileHeaderV6->tileCount; ++i)
+			{
+				const NavMeshTileIndexEntry& entry = *(const NavMeshTileIndexEntry*)(index + i * indexEntrySize);
+				if (entry.offset + entry.size > filesize || entry.size == 0)
+				{
+					SPDLOG_WARN("loadMesh: skipping tile {} with invalid location", i);
+					continue;
+				}
+
+				int profile = 0;
+				if (indexEntrySize >= sizeof(NavMeshTileIndexEntryV7))
+					profile = static_cast<int>(((const NavMeshTileIndexEntryV7*)&entry)->profile);
+
+				dtNavMesh* navMesh = GetNavMesh(profile).get();
+				if (!navMesh)
+					continue;
+
+				char* tilePtr = buffer.get() + entry.offset;
+				if (compressed)
+				{
+					if (!DecompressMemory(tilePtr, entry.size, tileData, entry.uncompressedSize))
+					{
+						SPDLOG_WARN("loadMesh: failed to decompress tile {}", i);
+						continue;
+					}
+
+					AddTileData(navMesh, entry.tileRef, tileData.data(), tileData.size());
+				}
+				else
+				{
+					AddTileData(navMesh, entry.tileRef, (const uint8_t*)tilePtr, entry.size);
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			return LoadResult::OutOfMemory;
+		}
+	}
+
 	return LoadResult::Success;
 }
 
@@ -827,12 +1007,77 @@ bool NavMesh::SaveMeshV5(const char* filename)
 	return true;
 }
 
+bool NavMesh::SaveMeshIndexed(const char* filename, NavMeshHeaderVersion version)
+{
+	if (!m_navMesh)
+	{
+		return false;
+	}
+
+	// todo: Configuration
+	bool compress = true;
+
+	NavMeshFileWriter writer;
+	if (!writer.Open(filename, compress, version))
+		return false;
+
+	// Version 6 only holds the main profile.
+	const int profileCount = version >= NavMeshHeaderVersion::Version7 ? GetProfileCount() : 1;
+
+	for (int profile = 0; profile < profileCount; ++profile)
+	{
+		const dtNavMesh* navMesh = GetNavMesh(profile).get();
+		if (!navMesh)
+			continue;
+
+		for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (!tile || !tile->header || !tile->dataSize) continue;
+
+			if (!writer.AddTile(navMesh->getTileRef(tile), tile->data, tile->dataSize, profile))
+				return false;
+		}
+	}
+
+	return FinishNavMeshFile(writer, *m_navMesh->getParams(), profileCount);
+}
+
+bool NavMesh::FinishNavMeshFile(NavMeshFileWriter& writer, const dtNavMeshParams& params, int profileCount)
+{
+	nav::NavMeshFile file_proto;
+	file_proto.set_zone_short_name(m_zoneName);
+
+	SaveToProto(file_proto, PersistedDataFields::BuildSettings | PersistedDataFields::ConvexVolumes
+		| PersistedDataFields::AreaTypes | PersistedDataFields::Connections);
+
+	// the tile sets only carry the mesh parameters, the tiles are already in the file.
+	// All profiles share the same tiling.
+	if (writer.GetVersion() < NavMeshHeaderVersion::Version7)
+		profileCount = 1;
+
+	for (int profile = 0; profile < profileCount; ++profile)
+	{
+		nav::NavMeshTileSet* tileset = profile == 0 ? file_proto.mutable_tile_set() : file_proto.add_profile_tile_sets();
+		tileset->set_compatibility_version(NAVMESH_TILE_COMPAT_VERSION);
+		ToProto(*tileset->mutable_mesh_params(), &params);
+	}
+
+	if (!writer.Finish(file_proto))
+		return false;
+
+	m_version = writer.GetVersion();
+	return true;
+}
+
 bool NavMesh::SaveMesh(const char* filename, NavMeshHeaderVersion version /*= NavMeshHeaderVersion::Latest*/)
 {
 	if (version == NavMeshHeaderVersion::Version4)
 		return SaveMeshV4(filename);
 	if (version == NavMeshHeaderVersion::Version5)
 		return SaveMeshV5(filename);
+	if (version == NavMeshHeaderVersion::Version6 || version == NavMeshHeaderVersion::Version7)
+		return SaveMeshIndexed(filename, version);
 
 	return false;
 }
@@ -956,8 +1201,7 @@ OffMeshConnection* NavMesh::AddConnection(std::unique_ptr<OffMeshConnection> con
 	OffMeshConnection* conn = connection.get();
 	m_connections.push_back(std::move(connection));
 	m_connectionsById.emplace(conn->id, conn);
-
-	// todo: update buffer if one exists?
+	++m_connectionsVersion;
 
 	return conn;
 }
@@ -979,9 +1223,16 @@ void NavMesh::DeleteConnectionById(uint32_t id)
 	{
 		m_connectionsById.erase((*iter)->id);
 		m_connections.erase(iter);
+		++m_connectionsVersion;
 	}
+}
 
-	// todo: update buffer if one exists?
+void NavMesh::MarkConnectionModified(uint32_t id)
+{
+	if (m_connectionsById.count(id))
+	{
+		++m_connectionsVersion;
+	}
 }
 
 std::vector<dtTileRef> NavMesh::GetTilesIntersectingConnection(uint32_t connectionId)
@@ -997,11 +1248,25 @@ std::vector<dtTileRef> NavMesh::GetTilesIntersectingConnection(uint32_t connecti
 	return refs;
 }
 
-std::shared_ptr<OffMeshConnectionBuffer> NavMesh::CreateOffMeshConnectionBuffer() const
+std::shared_ptr<OffMeshConnectionBuffer> NavMesh::GetOffMeshConnectionBuffer(float tileWorldSize, float agentRadius) const
 {
-	// crude and simple. Could be optimized in the future to not regenerate
-	// every time we need it. At least this is thread-safe...
-	return std::make_shared<OffMeshConnectionBuffer>(this, m_connections);
+	std::unique_lock<std::mutex> lock(m_connectionBufferMutex);
+
+	// The buffer is reused until the connections change, or until a setting that
+	// affects the buffer (tile layout, agent radius) changes.
+	const uint32_t version = m_connectionsVersion;
+	if (m_connectionBuffer
+		&& m_connectionBuffer->version == version
+		&& m_connectionBuffer->origin == m_boundsMin
+		&& m_connectionBuffer->tileWorldSize == tileWorldSize
+		&& m_connectionBuffer->agentRadius == agentRadius)
+	{
+		return m_connectionBuffer;
+	}
+
+	m_connectionBuffer = std::make_shared<OffMeshConnectionBuffer>(this, m_connections, version,
+		tileWorldSize, agentRadius);
+	return m_connectionBuffer;
 }
 
 //----------------------------------------------------------------------------
@@ -1009,6 +1274,7 @@ std::shared_ptr<OffMeshConnectionBuffer> NavMesh::CreateOffMeshConnectionBuffer(
 void NavMesh::InitializeAreas()
 {
 	m_polyAreaList.clear();
+	++m_connectionsVersion;
 
 	// initialize the array
 	for (uint8_t i = 0; i < m_polyAreas.size(); i++)
@@ -1081,6 +1347,9 @@ void NavMesh::UpdateArea(const PolyAreaType& areaType)
 
 		std::sort(m_polyAreaList.begin(), m_polyAreaList.end(),
 			[](const PolyAreaType* typeA, const PolyAreaType* typeB) { return typeA->id < typeB->id; });
+
+		// connection flags are derived from their area
+		++m_connectionsVersion;
 	}
 }
 
@@ -1104,6 +1373,8 @@ void NavMesh::RemoveUserDefinedArea(uint8_t areaId)
 
 	std::sort(m_polyAreaList.begin(), m_polyAreaList.end(),
 		[](const PolyAreaType* typeA, const PolyAreaType* typeB) { return typeA->id < typeB->id; });
+
+	++m_connectionsVersion;
 }
 
 uint8_t NavMesh::GetFirstUnusedUserDefinedArea() const
@@ -1161,6 +1432,21 @@ bool NavMesh::ExportJson(const std::string& filename, PersistedDataFields fields
 	return false;
 }
 
+uint64_t NavMesh::GetBuildSettingsHash()
+{
+	nav::NavMeshFile proto;
+	SaveToProto(proto, PersistedDataFields::BuildSettings | PersistedDataFields::ConvexVolumes
+		| PersistedDataFields::AreaTypes | PersistedDataFields::Connections);
+
+	// The file has no map fields, so the same settings always serialize the same way.
+	std::string data;
+	proto.SerializeToString(&data);
+
+	ContentHash hash;
+	hash.Update(data);
+	return hash.Get();
+}
+
 bool NavMesh::ImportJson(const std::string& filename, PersistedDataFields fields)
 {
 	if (m_zoneName.empty())
@@ -1248,35 +1534,59 @@ float NavMesh::GetClosestHeight(const glm::vec3& pos)
 
 OffMeshConnectionBuffer::OffMeshConnectionBuffer(
 	const NavMesh* navMesh,
-	const std::vector<std::unique_ptr<OffMeshConnection>>& connections)
+	const std::vector<std::unique_ptr<OffMeshConnection>>& connections,
+	uint32_t version_, float tileWorldSize_, float agentRadius_)
+	: version(version_)
+	, origin(navMesh->GetNavMeshBoundsMin())
+	, tileWorldSize(tileWorldSize_)
+	, agentRadius(agentRadius_)
 {
 	// when we have multiple types of connections in the future, this will
 	// need to change to only count the number of basic connections.
 
-	if (!connections.empty())
+	if (tileWorldSize <= 0.0f)
+		return;
+
+	for (const auto& conn : connections)
 	{
-		offMeshConVerts.reserve(connections.size());
-		offMeshConRads.reserve(connections.size());
-		offMeshConDirs.reserve(connections.size());
-		offMeshConAreas.reserve(connections.size());
-		offMeshConFlags.reserve(connections.size());
-		offMeshConId.reserve(connections.size());
+		// Detour only keeps a connection in the tile that contains its start point. We
+		// also add it to the neighbours so that a point on a tile edge is never missed.
+		const int tx = static_cast<int>(floorf((conn->start.x - origin.x) / tileWorldSize));
+		const int ty = static_cast<int>(floorf((conn->start.z - origin.z) / tileWorldSize));
 
-		for (const auto& conn : connections)
+		for (int y = ty - 1; y <= ty + 1; ++y)
 		{
-			offMeshConVerts.emplace_back(conn->start, conn->end);
-			offMeshConRads.emplace_back(navMesh->GetNavMeshConfig().agentRadius);
-			offMeshConDirs.emplace_back(conn->bidirectional ? (uint8_t)DT_OFFMESH_CON_BIDIR : 0);
-			offMeshConAreas.emplace_back(conn->areaType);
-			offMeshConFlags.emplace_back(navMesh->GetPolyArea(conn->areaType).flags);
-			offMeshConId.emplace_back(conn->id);
+			for (int x = tx - 1; x <= tx + 1; ++x)
+			{
+				Connections& tile = m_tiles[TileKey(x, y)];
+
+				tile.offMeshConVerts.emplace_back(conn->start, conn->end);
+				tile.offMeshConRads.emplace_back(agentRadius);
+				tile.offMeshConDirs.emplace_back(conn->bidirectional ? (uint8_t)DT_OFFMESH_CON_BIDIR : 0);
+				tile.offMeshConAreas.emplace_back(conn->areaType);
+				tile.offMeshConFlags.emplace_back(navMesh->GetPolyArea(conn->areaType).flags);
+				tile.offMeshConId.emplace_back(conn->id);
+				++tile.offMeshConCount;
+			}
 		}
 	}
+}
 
-	offMeshConCount = connections.size();
+const OffMeshConnectionBuffer::Connections& OffMeshConnectionBuffer::GetConnectionsForTile(int tx, int ty) const
+{
+	auto iter = m_tiles.find(TileKey(tx, ty));
+	if (iter != m_tiles.end())
+		return iter->second;
+
+	return m_empty;
+}
+
+void OffMeshConnectionBuffer::UpdateNavMeshCreateParams(dtNavMeshCreateParams& params, int tx, int ty) const
+{
+	GetConnectionsForTile(tx, ty).UpdateNavMeshCreateParams(params);
 }
 
-void OffMeshConnectionBuffer::UpdateNavMeshCreateParams(dtNavMeshCreateParams& params)
+void OffMeshConnectionBuffer::Connections::UpdateNavMeshCreateParams(dtNavMeshCreateParams& params) const
 {
 	if (offMeshConCount > 0)
 	{
@@ -12,14 +12,19 @@
 #include "DetourNavMesh.h"
 
 #include <array>
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 class dtNavMesh;
 class dtNavMeshQuery;
 class dtQueryFilter;
 class Context;
+class NavMeshFileWriter;
 struct OffMeshConnectionBuffer;
 
 namespace nav {
@@ -69,15 +74,30 @@ public:
 	// get the current nav mesh
 	std::shared_ptr<dtNavMesh> GetNavMesh() const { return m_navMesh; }
 
+	// get the nav mesh of an agent profile. Profile 0 is the main mesh, extra
+	// profiles follow in the order of NavMeshConfig::extraProfiles.
+	std::shared_ptr<dtNavMesh> GetNavMesh(int profile) const;
+
+	// number of agent profiles with a mesh, including the main one.
+	int GetProfileCount() const;
+
+	// find an agent profile by name. The main profile is found by an empty name.
+	// Returns -1 if there is no mesh for it.
+	int FindProfile(std::string_view name) const;
+
 	// set the navmesh. This is primarily used for building a new mesh and should be
 	// hidden away in the future to avoid the wierd usage requirements...
+	// This drops the meshes of the extra agent profiles.
 	void SetNavMesh(const std::shared_ptr<dtNavMesh>& navMesh, bool reset = true);
 
+	// set the meshes of the extra agent profiles, built alongside the main mesh.
+	void SetProfileNavMeshes(const std::vector<std::shared_ptr<dtNavMesh>>& navMeshes);
+
 	// unload all existing data and clean up all state
 	void ResetNavMesh();
 
-	// get the nav mesh query object
-	std::shared_ptr<dtNavMeshQuery> GetNavMeshQuery();
+	// get the nav mesh query object of an agent profile
+	std::shared_ptr<dtNavMeshQuery> GetNavMeshQuery(int profile = 0);
 
 	// build area costs for filter
 	void FillFilterAreaCosts(dtQueryFilter& filter);
@@ -89,6 +109,10 @@ public:
 	bool ExportJson(const std::string& filename, PersistedDataFields fields);
 	bool ImportJson(const std::string& filename, PersistedDataFields fields);
 
+	// hash of everything besides geometry that a build of this mesh depends on:
+	// build settings, bounds, convex volumes, areas and connections.
+	uint64_t GetBuildSettingsHash();
+
 	//----------------------------------------------------------------------------
 	// navmesh queries
 
@@ -122,6 +146,13 @@ public:
 	bool SaveNavMeshFile(const std::string& filename,
 		NavMeshHeaderVersion version = NavMeshHeaderVersion::Latest);
 
+	// finish a file whose tiles were written directly to the writer, without going
+	// through the loaded mesh, by adding everything else. params describes the
+	// mesh the tiles were built for, profileCount the number of agent profiles
+	// they were built for.
+	bool FinishNavMeshFile(NavMeshFileWriter& writer, const dtNavMeshParams& params,
+		int profileCount = 1);
+
 	void SetNavMeshBounds(const glm::vec3& min, const glm::vec3& max);
 	void GetNavMeshBounds(glm::vec3& min, glm::vec3& max);
 
@@ -192,9 +223,20 @@ public:
 	OffMeshConnection* GetConnectionById(uint32_t id);
 	void DeleteConnectionById(uint32_t id);
 
+	// Call after modifying a connection in place, so that the connection buffer
+	// is regenerated.
+	void MarkConnectionModified(uint32_t id);
+
 	std::vector<dtTileRef> GetTilesIntersectingConnection(uint32_t connectionId);
 
-	std::shared_ptr<OffMeshConnectionBuffer> CreateOffMeshConnectionBuffer() const;
+	// Incremented every time the connections (or the area flags they use) change.
+	uint32_t GetConnectionsVersion() const { return m_connectionsVersion; }
+
+	// Returns the connection buffer for the current set of connections, bucketed by
+	// tiles of the given size. Pass the settings the tiles are built with, which may
+	// differ from the saved config while settings are being edited. The buffer is
+	// immutable and is shared until the connections or these settings change.
+	std::shared_ptr<OffMeshConnectionBuffer> GetOffMeshConnectionBuffer(float tileWorldSize, float agentRadius) const;
 
 	//------------------------------------------------------------------------
 	// events
@@ -206,6 +248,7 @@ private:
 
 	bool SaveMeshV4(const char* filename);
 	bool SaveMeshV5(const char* filename);
+	bool SaveMeshIndexed(const char* filename, NavMeshHeaderVersion version);
 
 	bool SaveMesh(const char* filename, NavMeshHeaderVersion version = NavMeshHeaderVersion::Latest);
 
@@ -228,6 +271,14 @@ private:
 
 	std::shared_ptr<dtNavMesh> m_navMesh;
 	std::shared_ptr<dtNavMeshQuery> m_navMeshQuery;
+
+	// meshes of the extra agent profiles, profile 1 and up.
+	struct ProfileMesh
+	{
+		std::shared_ptr<dtNavMesh> navMesh;
+		std::shared_ptr<dtNavMeshQuery> navMeshQuery;
+	};
+	std::vector<ProfileMesh> m_profileMeshes;
 	glm::vec3 m_boundsMin = { 0, 0, 0 };
 	glm::vec3 m_boundsMax = { 0, 0, 0 };
 	NavMeshConfig m_config;
@@ -242,6 +293,12 @@ private:
 	std::unordered_map<uint32_t, OffMeshConnection*> m_connectionsById;
 	uint32_t m_nextConnectionId = 1;
 
+	// Bumped on the main thread, read by builds on other threads.
+	std::atomic<uint32_t> m_connectionsVersion = 0;
+
+	mutable std::mutex m_connectionBufferMutex;
+	mutable std::shared_ptr<OffMeshConnectionBuffer> m_connectionBuffer;
+
 	// area types
 	std::vector<const PolyAreaType*> m_polyAreaList;
 	std::array<PolyAreaType, (int)PolyArea::Last + 1> m_polyAreas;
@@ -251,22 +308,49 @@ private:
 
 struct dtNavMeshCreateParams;
 
-// buffer used to store raw data used for tile creation
+// buffer used to store raw data used for tile creation. Connections are bucketed
+// by the tile their start point falls in, and are also added to the neighbouring
+// tiles, so that each tile is only given the connections that can belong to it.
+// The buffer is immutable once created.
 struct OffMeshConnectionBuffer
 {
 	OffMeshConnectionBuffer(
 		const NavMesh* navMesh,
-		const std::vector<std::unique_ptr<OffMeshConnection>>& connections);
+		const std::vector<std::unique_ptr<OffMeshConnection>>& connections,
+		uint32_t version, float tileWorldSize, float agentRadius);
+
+	struct Connections
+	{
+		std::vector<std::pair<glm::vec3, glm::vec3>> offMeshConVerts;
+		std::vector<float> offMeshConRads;
+		std::vector<uint8_t> offMeshConDirs;
+		std::vector<uint8_t> offMeshConAreas;
+		std::vector<uint16_t> offMeshConFlags;
+		std::vector<uint32_t> offMeshConId;
+		size_t offMeshConCount = 0;
+
+		void UpdateNavMeshCreateParams(dtNavMeshCreateParams& params) const;
+	};
+
+	// Connections that may belong to the given tile, in their original order.
+	const Connections& GetConnectionsForTile(int tx, int ty) const;
 
-	std::vector<std::pair<glm::vec3, glm::vec3>> offMeshConVerts;
-	std::vector<float> offMeshConRads;
-	std::vector<uint8_t> offMeshConDirs;
-	std::vector<uint8_t> offMeshConAreas;
-	std::vector<uint16_t> offMeshConFlags;
-	std::vector<uint32_t> offMeshConId;
-	size_t offMeshConCount = 0;
+	void UpdateNavMeshCreateParams(dtNavMeshCreateParams& params, int tx, int ty) const;
+
+	// the state this buffer was generated from
+	uint32_t version = 0;
+	glm::vec3 origin = { 0, 0, 0 };
+	float tileWorldSize = 0.0f;
+	float agentRadius = 0.0f;
+
+private:
+	static uint64_t TileKey(int tx, int ty)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(tx)) << 32) | static_cast<uint32_t>(ty);
+	}
 
-	void UpdateNavMeshCreateParams(dtNavMeshCreateParams& params);
+	std::unordered_map<uint64_t, Connections> m_tiles;
+	Connections m_empty;
 };
 
 //============================================================================
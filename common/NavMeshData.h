@@ -67,6 +67,16 @@ enum struct PartitionType : uint32_t
 	LAYERS = 2,
 };
 
+// Agent settings of an additional mesh, built from the same geometry and
+// remaining settings as the main mesh for agents of another size.
+struct AgentProfile
+{
+	std::string name;
+	float agentHeight = 6.0f;
+	float agentRadius = 2.0f;
+	float agentMaxClimb = 4.0f;
+};
+
 struct NavMeshConfig
 {
 	uint8_t configVersion = 1;
@@ -86,6 +96,10 @@ struct NavMeshConfig
 	float detailSampleDist = 6.0f;
 	float detailSampleMaxError = 1.0f;
 	PartitionType partitionType = PartitionType::WATERSHED;
+
+	// Each profile is built into its own mesh alongside the main one. Profile 0 is
+	// the main agent above, these are profiles 1 and up.
+	std::vector<AgentProfile> extraProfiles;
 };
 
 //----------------------------------------------------------------------------
@@ -100,8 +114,10 @@ const int NAVMESH_FILE_MAGIC = 'MSET';
 enum struct NavMeshHeaderVersion : uint16_t {
 	Version4 = 4,                // base version
 	Version5 = 5,                // version 5 introduced headerSize and uncompressedSize
+	Version6 = 6,                // version 6 compresses each tile separately and indexes them
+	Version7 = 7,                // version 7 adds the agent profile of each tile to the tile index
 
-	Latest = Version5,
+	Latest = Version7,
 };
 
 enum struct NavMeshFileFlags : uint16_t {
@@ -122,6 +138,32 @@ struct MeshFileHeaderV5 : MeshFileHeader
 	uint32_t headerSize;
 };
 
+// From version 6 on the proto holds everything but the tiles, and uncompressedSize is
+// its size. Each tile is stored (and compressed) on its own, and located through
+// the tile index at the end of the file. See NavMeshFileWriter.
+struct MeshFileHeaderV6 : MeshFileHeaderV5
+{
+	uint32_t tileCount;
+	uint32_t reserved;
+	uint64_t metadataOffset;
+	uint64_t metadataSize;
+	uint64_t tileIndexOffset;
+};
+
+struct NavMeshTileIndexEntry
+{
+	uint64_t tileRef;
+	uint64_t offset;
+	uint32_t size;
+	uint32_t uncompressedSize;
+};
+
+struct NavMeshTileIndexEntryV7 : NavMeshTileIndexEntry
+{
+	uint32_t profile;
+	uint32_t reserved;
+};
+
 // compatibility version of the navmesh data
 const int NAVMESH_TILE_COMPAT_VERSION = 1;
 
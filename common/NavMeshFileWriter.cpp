@@ -0,0 +1,381 @@
+//
+// NavMeshFileWriter.cpp
+//
+
+#include "common/NavMeshFileWriter.h"
+#include "common/Utilities.h"
+#include "common/proto/NavMeshFile.pb.h"
+
+#include "spdlog/spdlog.h"
+
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+//============================================================================
+
+NavMeshFileWriter::NavMeshFileWriter(size_t maxQueuedTiles)
+	: m_maxQueuedTiles(std::max<size_t>(maxQueuedTiles, 1))
+{
+}
+
+NavMeshFileWriter::~NavMeshFileWriter()
+{
+	Abort();
+}
+
+bool NavMeshFileWriter::Open(const std::string& filename, bool compress, NavMeshHeaderVersion version)
+{
+	Abort();
+
+	if (version != NavMeshHeaderVersion::Version6 && version != NavMeshHeaderVersion::Version7)
+	{
+		SPDLOG_ERROR("NavMeshFileWriter: cannot write version {} files", static_cast<int>(version));
+		return false;
+	}
+
+	m_filename = filename;
+	m_tempFilename = filename + ".tmp";
+	m_compress = compress;
+	m_version = version;
+
+	m_file.open(m_tempFilename, std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+	{
+		SPDLOG_ERROR("NavMeshFileWriter: failed to open {} for writing", m_tempFilename);
+		return false;
+	}
+
+	// Reserve space for the header, it is written last.
+	MeshFileHeaderV6 header = {};
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	m_offset = sizeof(header);
+	m_index.clear();
+	m_queue.clear();
+	m_stopping = false;
+	m_failed = false;
+	m_open = true;
+
+	m_writerThread = std::thread([this]() { WriterThread(); });
+	return true;
+}
+
+bool NavMeshFileWriter::AddTile(uint64_t tileRef, const uint8_t* data, size_t dataSize, uint32_t profile)
+{
+	if (!m_open || !data || dataSize == 0)
+		return false;
+
+	// Version 6 only holds the main profile.
+	if (profile != 0 && m_version < NavMeshHeaderVersion::Version7)
+		return false;
+
+	QueuedTile tile;
+	tile.tileRef = tileRef;
+	tile.profile = profile;
+	tile.uncompressedSize = static_cast<uint32_t>(dataSize);
+
+	if (m_compress)
+	{
+		if (!CompressMemory(const_cast<uint8_t*>(data), dataSize, tile.data))
+		{
+			SPDLOG_ERROR("NavMeshFileWriter: failed to compress tile");
+			return false;
+		}
+	}
+	else
+	{
+		tile.data.assign(data, data + dataSize);
+	}
+
+	return QueueTile(std::move(tile));
+}
+
+bool NavMeshFileWriter::QueueTile(QueuedTile tile)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queueChanged.wait(lock, [this]() { return m_queue.size() < m_maxQueuedTiles || m_failed || m_stopping; });
+
+	if (m_failed || m_stopping)
+		return false;
+
+	m_queue.push_back(std::move(tile));
+	m_queueChanged.notify_all();
+	return true;
+}
+
+void NavMeshFileWriter::WriterThread()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_queueChanged.wait(lock, [this]() { return !m_queue.empty() || m_stopping; });
+		if (m_queue.empty())
+			break;
+
+		QueuedTile tile = std::move(m_queue.front());
+		m_queue.pop_front();
+		m_queueChanged.notify_all();
+
+		if (m_failed)
+			continue;
+
+		lock.unlock();
+
+		m_file.write(reinterpret_cast<const char*>(tile.data.data()), tile.data.size());
+		const bool ok = m_file.good();
+
+		lock.lock();
+
+		if (!ok)
+		{
+			SPDLOG_ERROR("NavMeshFileWriter: failed to write tile to {}", m_tempFilename);
+			m_failed = true;
+			m_queueChanged.notify_all();
+			continue;
+		}
+
+		NavMeshTileIndexEntryV7& entry = m_index.emplace_back();
+		entry.tileRef = tile.tileRef;
+		entry.offset = m_offset;
+		entry.size = static_cast<uint32_t>(tile.data.size());
+		entry.uncompressedSize = tile.uncompressedSize;
+		entry.profile = tile.profile;
+		entry.reserved = 0;
+
+		m_offset += tile.data.size();
+	}
+}
+
+void NavMeshFileWriter::StopWriterThread()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopping = true;
+		m_queueChanged.notify_all();
+	}
+
+	if (m_writerThread.joinable())
+		m_writerThread.join();
+}
+
+bool NavMeshFileWriter::Finish(const nav::NavMeshFile& metadata)
+{
+	if (!m_open)
+		return false;
+
+	std::string buffer;
+	metadata.SerializeToString(&buffer);
+
+	std::vector<uint8_t> compressed;
+	if (m_compress && !buffer.empty())
+	{
+		if (!CompressMemory(&buffer[0], buffer.length(), compressed))
+		{
+			SPDLOG_ERROR("NavMeshFileWriter: failed to compress navmesh data");
+			Abort();
+			return false;
+		}
+	}
+	else
+	{
+		compressed.assign(buffer.begin(), buffer.end());
+	}
+
+	return FinishRaw(compressed, static_cast<uint32_t>(buffer.length()));
+}
+
+bool NavMeshFileWriter::FinishRaw(const std::vector<uint8_t>& metadata, uint32_t uncompressedSize)
+{
+	if (!m_open)
+		return false;
+
+	// Drains the queue before returning.
+	StopWriterThread();
+
+	if (m_failed)
+	{
+		Abort();
+		return false;
+	}
+
+	MeshFileHeaderV6 header = {};
+	header.magic = NAVMESH_FILE_MAGIC;
+	header.version = (uint16_t)m_version;
+	header.flags = NavMeshFileFlags{};
+	if (m_compress) header.flags |= NavMeshFileFlags::COMPRESSED;
+	header.headerSize = sizeof(MeshFileHeaderV6);
+	header.uncompressedSize = uncompressedSize;
+	header.tileCount = static_cast<uint32_t>(m_index.size());
+	header.metadataOffset = m_offset;
+	header.metadataSize = metadata.size();
+	header.tileIndexOffset = m_offset + metadata.size();
+
+	m_file.write(reinterpret_cast<const char*>(metadata.data()), metadata.size());
+
+	if (m_version >= NavMeshHeaderVersion::Version7)
+	{
+		m_file.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(NavMeshTileIndexEntryV7));
+	}
+	else
+	{
+		for (const NavMeshTileIndexEntryV7& entry : m_index)
+			m_file.write(reinterpret_cast<const char*>(&entry), sizeof(NavMeshTileIndexEntry));
+	}
+
+	m_file.seekp(0);
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if (!m_file.good())
+	{
+		SPDLOG_ERROR("NavMeshFileWriter: failed to write {}", m_tempFilename);
+		Abort();
+		return false;
+	}
+
+	Close();
+
+	std::error_code ec;
+	fs::rename(m_tempFilename, m_filename, ec);
+	if (ec)
+	{
+		SPDLOG_ERROR("NavMeshFileWriter: failed to replace {}: {}", m_filename, ec.message());
+		fs::remove(m_tempFilename, ec);
+		return false;
+	}
+
+	return true;
+}
+
+void NavMeshFileWriter::Abort()
+{
+	if (!m_open)
+		return;
+
+	StopWriterThread();
+	Close();
+
+	std::error_code ec;
+	fs::remove(m_tempFilename, ec);
+}
+
+void NavMeshFileWriter::Close()
+{
+	m_file.close();
+	m_queue.clear();
+	m_open = false;
+}
+
+int NavMeshFileWriter::GetTileCount() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return static_cast<int>(m_index.size() + m_queue.size());
+}
+
+//----------------------------------------------------------------------------
+
+// Read the header and tile index of a version 6 or later file. Version 6 tiles
+// all belong to the main profile.
+static bool ReadFileIndex(std::ifstream& file, const std::string& filename,
+	MeshFileHeaderV6& header, std::vector<NavMeshTileIndexEntryV7>& index)
+{
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good()
+		|| header.magic != NAVMESH_FILE_MAGIC
+		|| header.version < (uint16_t)NavMeshHeaderVersion::Version6
+		|| header.headerSize < sizeof(MeshFileHeaderV6))
+	{
+		SPDLOG_ERROR("NavMeshFileWriter: {} is not a tile indexed navmesh file", filename);
+		return false;
+	}
+
+	index.resize(header.tileCount);
+	file.seekg(header.tileIndexOffset);
+
+	if (header.version >= (uint16_t)NavMeshHeaderVersion::Version7)
+	{
+		file.read(reinterpret_cast<char*>(index.data()), index.size() * sizeof(NavMeshTileIndexEntryV7));
+	}
+	else
+	{
+		for (NavMeshTileIndexEntryV7& entry : index)
+		{
+			entry = {};
+			file.read(reinterpret_cast<char*>(&entry), sizeof(NavMeshTileIndexEntry));
+		}
+	}
+
+	if (!file.good())
+	{
+		SPDLOG_ERROR("NavMeshFileWriter: failed to read the tile index of {}", filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool NavMeshFileWriter::Merge(const std::vector<std::string>& inputs, const std::string& output)
+{
+	if (inputs.empty())
+		return false;
+
+	NavMeshFileWriter writer;
+	std::vector<uint8_t> metadata;
+	uint32_t metadataSize = 0;
+
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		std::ifstream file(inputs[i], std::ios::binary);
+		if (!file.is_open())
+		{
+			SPDLOG_ERROR("NavMeshFileWriter: failed to open {}", inputs[i]);
+			return false;
+		}
+
+		MeshFileHeaderV6 header;
+		std::vector<NavMeshTileIndexEntryV7> index;
+		if (!ReadFileIndex(file, inputs[i], header, index))
+			return false;
+
+		const bool compressed = +(header.flags & NavMeshFileFlags::COMPRESSED) != 0;
+
+		if (i == 0)
+		{
+			if (!writer.Open(output, compressed))
+				return false;
+
+			metadata.resize(header.metadataSize);
+			metadataSize = header.uncompressedSize;
+
+			file.seekg(header.metadataOffset);
+			file.read(reinterpret_cast<char*>(metadata.data()), metadata.size());
+		}
+		else if (compressed != writer.m_compress)
+		{
+			SPDLOG_ERROR("NavMeshFileWriter: {} is not compressed like {}", inputs[i], inputs[0]);
+			return false;
+		}
+
+		for (const NavMeshTileIndexEntryV7& entry : index)
+		{
+			QueuedTile tile;
+			tile.tileRef = entry.tileRef;
+			tile.profile = entry.profile;
+			tile.uncompressedSize = entry.uncompressedSize;
+			tile.data.resize(entry.size);
+
+			file.seekg(entry.offset);
+			file.read(reinterpret_cast<char*>(tile.data.data()), tile.data.size());
+
+			if (!file.good() || !writer.QueueTile(std::move(tile)))
+			{
+				SPDLOG_ERROR("NavMeshFileWriter: failed to copy tiles from {}", inputs[i]);
+				return false;
+			}
+		}
+	}
+
+	return writer.FinishRaw(metadata, metadataSize);
+}
@@ -0,0 +1,110 @@
+//
+// NavMeshFileWriter.h
+//
+
+#pragma once
+
+#include "common/NavMeshData.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nav {
+	class NavMeshFile;
+}
+
+// Writes a version 6 or 7 navmesh file one tile at a time, so that a mesh can be
+// saved while it is being built without ever holding all of its tiles, or a
+// serialized copy of them, in memory.
+//
+// Tiles are compressed on the thread that adds them and handed to a writer
+// thread through a queue of at most maxQueuedTiles tiles. AddTile blocks while
+// the queue is full. Everything is written to a temporary file that replaces
+// the destination when Finish succeeds, so an aborted or failed save leaves the
+// existing file alone.
+//
+// File layout:
+//   MeshFileHeaderV6
+//   tile data, in the order the tiles were added
+//   NavMeshFile proto with everything except the tiles
+//   NavMeshTileIndexEntryV7 (NavMeshTileIndexEntry in version 6) for every tile
+
+class NavMeshFileWriter
+{
+public:
+	explicit NavMeshFileWriter(size_t maxQueuedTiles = 16);
+	~NavMeshFileWriter();
+
+	NavMeshFileWriter(const NavMeshFileWriter&) = delete;
+	NavMeshFileWriter& operator=(const NavMeshFileWriter&) = delete;
+
+	// version may be Version6, which cannot hold extra agent profiles, or Version7.
+	bool Open(const std::string& filename, bool compress = true,
+		NavMeshHeaderVersion version = NavMeshHeaderVersion::Latest);
+
+	// Add a tile of the mesh of an agent profile. Thread safe. tileRef may be 0,
+	// the tile then gets a new reference when the file is loaded.
+	bool AddTile(uint64_t tileRef, const uint8_t* data, size_t dataSize, uint32_t profile = 0);
+
+	// Write the rest of the navmesh and move the file into place. The tile set in
+	// metadata is expected to have no tiles.
+	bool Finish(const nav::NavMeshFile& metadata);
+
+	// Stop writing and delete the temporary file.
+	void Abort();
+
+	// Combine version 6 or later navmesh files holding different tiles of the same
+	// mesh into one. Everything but the tiles is taken from the first file. Tiles
+	// are copied without being decompressed.
+	static bool Merge(const std::vector<std::string>& inputs, const std::string& output);
+
+	bool IsOpen() const { return m_open; }
+	const std::string& GetFileName() const { return m_filename; }
+	NavMeshHeaderVersion GetVersion() const { return m_version; }
+
+	int GetTileCount() const;
+
+private:
+	struct QueuedTile
+	{
+		uint64_t tileRef = 0;
+		uint32_t profile = 0;
+		uint32_t uncompressedSize = 0;
+		std::vector<uint8_t> data;
+	};
+
+	// Queue a tile that is already compressed the way this file expects.
+	bool QueueTile(QueuedTile tile);
+
+	bool FinishRaw(const std::vector<uint8_t>& metadata, uint32_t uncompressedSize);
+
+	void WriterThread();
+	void StopWriterThread();
+	void Close();
+
+	const size_t m_maxQueuedTiles;
+
+	std::string m_filename;
+	std::string m_tempFilename;
+	std::ofstream m_file;
+	bool m_compress = true;
+	bool m_open = false;
+	NavMeshHeaderVersion m_version = NavMeshHeaderVersion::Latest;
+
+	std::thread m_writerThread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_queueChanged;
+	std::deque<QueuedTile> m_queue;
+	bool m_stopping = false;
+	bool m_failed = false;
+
+	// Tiles written so far and where the next one goes.
+	std::vector<NavMeshTileIndexEntryV7> m_index;
+	uint64_t m_offset = 0;
+};
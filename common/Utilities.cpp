@@ -125,6 +125,42 @@ bool DecompressMemory(void* in_data, size_t in_data_size, std::vector<uint8_t>&
 
 //----------------------------------------------------------------------------
 
+bool HashFileContents(const std::string& filename, ContentHash& hash)
+{
+	FILE* file = nullptr;
+	if (fopen_s(&file, filename.c_str(), "rb") != 0 || file == nullptr)
+	{
+		hash.Update(uint64_t{ 0 });
+		return false;
+	}
+
+	const size_t BUFSIZE = 256 * 1024;
+	std::unique_ptr<uint8_t[]> buffer = std::make_unique<uint8_t[]>(BUFSIZE);
+
+	uint64_t totalSize = 0;
+	size_t read;
+	while ((read = fread(buffer.get(), 1, BUFSIZE, file)) > 0)
+	{
+		hash.Update(buffer.get(), read);
+		totalSize += read;
+	}
+
+	fclose(file);
+
+	// include length so that an empty file differs from a missing one.
+	hash.Update(totalSize + 1);
+	return true;
+}
+
+std::string FormatHash(uint64_t hash)
+{
+	char buffer[17];
+	sprintf_s(buffer, "%016llx", static_cast<unsigned long long>(hash));
+	return buffer;
+}
+
+//----------------------------------------------------------------------------
+
 EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
 inline HINSTANCE GetComponentInstance()
@@ -11,7 +11,9 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 
 //----------------------------------------------------------------------------
@@ -90,6 +92,60 @@ bool DecompressMemory(void* in_data, size_t in_data_size, std::vector<uint8_t>&
 	size_t decompressedSize = 0);
 
 
+//----------------------------------------------------------------------------
+// content hashing
+
+// 64-bit FNV-1a hash, used to fingerprint build inputs for the various caches.
+// Not cryptographic, only needs to be stable across runs and machines.
+class ContentHash
+{
+public:
+	static constexpr uint64_t OffsetBasis = 14695981039346656037ull;
+	static constexpr uint64_t Prime = 1099511628211ull;
+
+	ContentHash() = default;
+	explicit ContentHash(uint64_t seed) : m_hash(seed) {}
+
+	void Update(const void* data, size_t length)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < length; ++i)
+		{
+			m_hash ^= bytes[i];
+			m_hash *= Prime;
+		}
+	}
+
+	template <typename T>
+	void Update(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types may be hashed directly");
+		Update(&value, sizeof(T));
+	}
+
+	void Update(std::string_view str)
+	{
+		Update(str.size());
+		Update(str.data(), str.size());
+	}
+
+	void Update(const std::string& str) { Update(std::string_view{ str }); }
+	void Update(const char* str) { Update(std::string_view{ str }); }
+
+	uint64_t Get() const { return m_hash; }
+
+private:
+	uint64_t m_hash = OffsetBasis;
+};
+
+// Hashes the contents of a file. A missing file hashes its absence, so that
+// adding or removing an optional input is still detected. Returns true if the
+// file existed.
+bool HashFileContents(const std::string& filename, ContentHash& hash);
+
+// Formats a hash as a fixed width hex string, suitable for use in file names.
+std::string FormatHash(uint64_t hash);
+
 //----------------------------------------------------------------------------
 
 class scope_guard
@@ -13,14 +13,151 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iterator>
 #include <filesystem>
+#include <map>
+#include <thread>
 
 namespace fs = std::filesystem;
 
-typedef std::shared_ptr<EQEmu::EQG::Geometry> ModelPtr;
-typedef std::shared_ptr<EQEmu::S3D::Geometry> OldModelPtr;
+// Run fn(index) for every index in [0, count) on a pool of worker threads.
+template <typename Fn>
+static void ParallelFor(size_t count, const Fn& fn)
+{
+	const size_t workerCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), count);
+	std::atomic<size_t> next = 0;
+
+	auto work = [&]()
+	{
+		for (size_t index = next++; index < count; index = next++)
+			fn(index);
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < workerCount; ++i)
+		workers.emplace_back(work);
+
+	work();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+bool AssetModels::Load(const std::string& eqPath, const std::vector<std::string>& filenames, bool parallel)
+{
+	if (!parallel)
+		return LoadSerial(eqPath, filenames);
+
+	std::vector<EQEmu::PFS::Archive> archives(filenames.size());
+	std::vector<char> opened(filenames.size(), 0);
+
+	ParallelFor(filenames.size(), [&](size_t i)
+		{
+			opened[i] = archives[i].Open(fmt::format("{}\\{}", eqPath, filenames[i]));
+		});
+
+	// Gather every model first, in the order they would be loaded in.
+	struct ModelJob
+	{
+		size_t archive;
+		std::string name;
+		ModelPtr model;
+	};
+	std::vector<ModelJob> jobs;
+
+	for (size_t i = 0; i < archives.size(); ++i)
+	{
+		std::vector<std::string> models;
+		if (!opened[i] || !archives[i].GetFilenames("mod", models))
+			continue;
+
+		for (std::string& modelName : models)
+			jobs.push_back(ModelJob{ i, std::move(modelName), nullptr });
+	}
+
+	ParallelFor(jobs.size(), [&](size_t i)
+		{
+			ModelJob& job = jobs[i];
+
+			EQEmu::EQGModelLoader model_loader;
+			model_loader.Load(archives[job.archive], job.name, job.model);
+			if (job.model)
+				job.model->SetName(job.name);
+		});
+
+	// Merge in load order. A stable sort keeps duplicates in that order, and the
+	// last of each is the one to keep.
+	std::vector<std::pair<std::string, ModelPtr>> models;
+	models.reserve(m_models.size() + jobs.size());
+	models.insert(models.end(), m_models.begin(), m_models.end());
+
+	for (ModelJob& job : jobs)
+	{
+		if (job.model)
+			models.emplace_back(std::move(job.name), std::move(job.model));
+	}
+
+	std::stable_sort(models.begin(), models.end(),
+		[](const auto& a, const auto& b) { return a.first < b.first; });
+
+	m_models.clear();
+	for (size_t i = 0; i < models.size(); ++i)
+	{
+		if (i + 1 < models.size() && models[i + 1].first == models[i].first)
+			continue;
+
+		m_models.push_back(std::move(models[i]));
+	}
+
+	return !m_models.empty();
+}
+
+bool AssetModels::LoadSerial(const std::string& eqPath, const std::vector<std::string>& filenames)
+{
+	std::map<std::string, ModelPtr> modelsByFile(m_models.begin(), m_models.end());
+
+	for (const std::string& name : filenames)
+	{
+		EQEmu::PFS::Archive archive;
+		if (!archive.Open(fmt::format("{}\\{}", eqPath, name)))
+			continue;
+
+		std::vector<std::string> models;
+		if (!archive.GetFilenames("mod", models))
+			continue;
+
+		for (const std::string& modelName : models)
+		{
+			EQEmu::EQGModelLoader model_loader;
+			ModelPtr model;
+
+			model_loader.Load(archive, modelName, model);
+			if (model)
+			{
+				model->SetName(modelName);
+				modelsByFile[modelName] = model;
+			}
+		}
+	}
+
+	m_models.assign(modelsByFile.begin(), modelsByFile.end());
+	return !m_models.empty();
+}
+
+ModelPtr AssetModels::Find(const std::string& name) const
+{
+	auto iter = std::lower_bound(m_models.begin(), m_models.end(), name,
+		[](const auto& entry, const std::string& name) { return entry.first < name; });
+
+	if (iter != m_models.end() && iter->first == name)
+		return iter->second;
+
+	return nullptr;
+}
+
+//----------------------------------------------------------------------------
 
 class ZoneDataLoader
 {
@@ -70,33 +207,8 @@ public:
 					std::istream_iterator<std::string>(),
 					std::back_inserter(filenames));
 
-				for (auto& name : filenames)
-				{
-					std::string asset_file = fmt::format("{}\\{}", m_zd->GetEQPath(), name);
-					EQEmu::PFS::Archive archive;
-
-					if (!archive.Open(asset_file))
-						continue;
-
-					std::vector<std::string> models;
-
-					if (archive.GetFilenames("mod", models))
-					{
-						for (auto& modelName : models)
-						{
-							EQEmu::EQGModelLoader model_loader;
-							ModelPtr model;
-
-							model_loader.Load(archive, modelName, model);
-							if (model)
-							{
-								model->SetName(modelName);
-								m_modelsByFile[modelName] = model;
-								loadedSomething = true;
-							}
-						}
-					}
-				}
+				if (m_modelsByFile.Load(m_zd->GetEQPath(), filenames))
+					loadedSomething = true;
 			}
 		}
 
@@ -106,10 +218,9 @@ public:
 	ModelPtr GetModel(const std::string& modelName)
 	{
 		std::string name = mq::to_lower_copy(modelName) + ".mod";
-		auto fileIter = m_modelsByFile.find(name);
-		if (fileIter != m_modelsByFile.end())
+		if (ModelPtr model = m_modelsByFile.Find(name))
 		{
-			return fileIter->second;
+			return model;
 		}
 
 		auto iter = m_models.find(modelName);
@@ -160,7 +271,7 @@ private:
 	EQEmu::PFS::Archive m_archive;
 
 	std::map<std::string, ModelPtr> m_models;
-	std::map<std::string, ModelPtr> m_modelsByFile;
+	AssetModels m_modelsByFile;
 };
 
 //----------------------------------------------------------------------------
@@ -239,33 +350,8 @@ public:
 					filenames.push_back("poknowledge_obj3.eqg");
 				}
 
-				for (auto& name : filenames)
-				{
-					std::string asset_file = fmt::format("{}\\{}", m_zd->GetEQPath(), name);
-					EQEmu::PFS::Archive archive;
-
-					if (!archive.Open(asset_file))
-						continue;
-
-					std::vector<std::string> models;
-
-					if (archive.GetFilenames("mod", models))
-					{
-						for (auto& modelName : models)
-						{
-							EQEmu::EQGModelLoader model_loader;
-							ModelPtr model;
-
-							model_loader.Load(archive, modelName, model);
-							if (model)
-							{
-								model->SetName(modelName);
-								m_eqgModels[modelName] = model;
-								loadedSomething = true;
-							}
-						}
-					}
-				}
+				if (m_eqgModels.Load(m_zd->GetEQPath(), filenames))
+					loadedSomething = true;
 			}
 		}
 
@@ -287,11 +373,7 @@ public:
 	{
 		std::string eqgName = mq::to_lower_copy(modelName) + ".mod";
 
-		auto iter = m_eqgModels.find(eqgName);
-		if (iter != m_eqgModels.end())
-			return iter->second;
-
-		return nullptr;
+		return m_eqgModels.Find(eqgName);
 	}
 
 	virtual std::shared_ptr<ModelInfo> GetModelInfo(const std::string& modelName) override
@@ -343,7 +425,7 @@ private:
 	ZoneData* m_zd;
 
 	std::map<std::string, OldModelPtr> m_s3dModels;
-	std::map<std::string, ModelPtr> m_eqgModels;
+	AssetModels m_eqgModels;
 };
 
 //----------------------------------------------------------------------------
@@ -387,3 +469,39 @@ bool ZoneData::IsLoaded()
 {
 	return m_loader != nullptr;
 }
+
+std::vector<std::string> ZoneData::GetSourceFiles(const std::string& eqPath, const std::string& zoneName)
+{
+	std::string base_filename = fmt::format("{}\\{}", eqPath, zoneName);
+
+	std::vector<std::string> files = {
+		base_filename + ".eqg",
+		base_filename + ".zon",
+		base_filename + ".s3d",
+		base_filename + "_obj.s3d",
+		base_filename + "_obj2.s3d",
+		base_filename + "_assets.txt",
+	};
+
+	// archives listed in the assets file contribute door and object models
+	std::ifstream assets(base_filename + "_assets.txt");
+	if (assets.is_open())
+	{
+		std::vector<std::string> filenames;
+		std::copy(std::istream_iterator<std::string>(assets),
+			std::istream_iterator<std::string>(),
+			std::back_inserter(filenames));
+
+		if (zoneName == "poknowledge")
+		{
+			filenames.push_back("poknowledge_obj3.eqg");
+		}
+
+		for (auto& name : filenames)
+		{
+			files.push_back(fmt::format("{}\\{}", eqPath, name));
+		}
+	}
+
+	return files;
+}
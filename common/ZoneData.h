@@ -7,11 +7,37 @@
 #include "zone-utilities/common/eqg_loader.h"
 #include "zone-utilities/common/s3d_loader.h"
 
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 typedef std::shared_ptr<EQEmu::EQG::Geometry> ModelPtr;
 typedef std::shared_ptr<EQEmu::S3D::Geometry> OldModelPtr;
 
 class ZoneDataLoader;
 
+// The .mod models of the archives listed in a zone's _assets file, by lower case
+// file name. Kept as a vector sorted by name.
+class AssetModels
+{
+public:
+	// Load the models of the archives. The archives are opened and their models
+	// decoded in parallel. When several archives have a model of the same name,
+	// the one from the last archive in the list is kept, as when loading them one
+	// after another, which is what happens if parallel is false.
+	bool Load(const std::string& eqPath, const std::vector<std::string>& filenames, bool parallel = true);
+
+	ModelPtr Find(const std::string& name) const;
+
+	const std::vector<std::pair<std::string, ModelPtr>>& GetModels() const { return m_models; }
+
+private:
+	bool LoadSerial(const std::string& eqPath, const std::vector<std::string>& filenames);
+
+	std::vector<std::pair<std::string, ModelPtr>> m_models;
+};
+
 struct ModelInfo
 {
 	glm::vec3 min = { 0, 0, 0 };
@@ -34,6 +60,10 @@ public:
 	std::string GetZoneName() const { return m_zoneName; }
 	std::string GetEQPath() const { return m_eqPath; }
 
+	// Returns the list of game files that zone geometry may be read from, including
+	// files that don't exist for this zone. Used to fingerprint zone inputs for caching.
+	static std::vector<std::string> GetSourceFiles(const std::string& eqPath, const std::string& zoneName);
+
 private:
 	void LoadZone();
 	
@@ -0,0 +1,223 @@
+//
+// ZoneManifest.cpp
+//
+
+#include "ZoneManifest.h"
+
+#include "common/NavMesh.h"
+#include "common/NavMeshData.h"
+#include "common/Utilities.h"
+#include "common/ZoneData.h"
+
+#include <DetourNavMesh.h>
+#include <fmt/format.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include <spdlog/spdlog.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// version of the manifest file itself
+static constexpr int MANIFEST_FILE_VERSION = 1;
+
+//============================================================================
+
+std::string ZoneBuildInputs::GetToolVersion()
+{
+	return fmt::format("{}.{}.{}", NAVMESH_BUILD_VERSION, DT_NAVMESH_VERSION, NAVMESH_TILE_COMPAT_VERSION);
+}
+
+void ZoneBuildInputs::HashSources(const std::string& eqPath, const std::string& outputPath,
+	const std::string& zoneShortName)
+{
+	std::vector<std::string> files = ZoneData::GetSourceFiles(eqPath, zoneShortName);
+	files.push_back(outputPath + "\\" + zoneShortName + "_doors.json");
+
+	sources.clear();
+
+	for (const std::string& filename : files)
+	{
+		ContentHash hash;
+		if (HashFileContents(filename, hash))
+		{
+			sources[fs::path(filename).filename().string()] = hash.Get();
+		}
+	}
+}
+
+void ZoneBuildInputs::HashSettings(NavMesh& navMesh, bool useMaxExtents)
+{
+	ContentHash hash(navMesh.GetBuildSettingsHash());
+
+	auto iter = useMaxExtents ? MaxZoneExtents.find(navMesh.GetZoneName()) : MaxZoneExtents.end();
+	hash.Update(iter != MaxZoneExtents.end());
+	if (iter != MaxZoneExtents.end())
+	{
+		hash.Update(iter->second.first);
+		hash.Update(iter->second.second);
+	}
+
+	settings = hash.Get();
+}
+
+std::vector<std::string> ZoneBuildInputs::Compare(const ZoneBuildInputs& built) const
+{
+	std::vector<std::string> changes;
+
+	for (const auto& [filename, hash] : sources)
+	{
+		auto iter = built.sources.find(filename);
+		if (iter == built.sources.end())
+			changes.push_back(fmt::format("{} added", filename));
+		else if (iter->second != hash)
+			changes.push_back(fmt::format("{} changed", filename));
+	}
+
+	for (const auto& [filename, hash] : built.sources)
+	{
+		if (sources.count(filename) == 0)
+			changes.push_back(fmt::format("{} removed", filename));
+	}
+
+	if (settings != built.settings)
+		changes.push_back("build settings changed");
+
+	if (toolVersion != built.toolVersion)
+		changes.push_back(fmt::format("built with version {}, now {}", built.toolVersion, toolVersion));
+
+	return changes;
+}
+
+//============================================================================
+
+ZoneManifest::ZoneManifest(const std::string& outputPath)
+	: m_filename(outputPath + "\\manifest.json")
+{
+}
+
+bool ZoneManifest::Load()
+{
+	m_zones.clear();
+
+	std::error_code ec;
+	if (!fs::exists(m_filename, ec))
+		return true;
+
+	std::ifstream ifs(m_filename);
+	std::stringstream ss;
+	ss << ifs.rdbuf();
+
+	rapidjson::Document document;
+	if (document.Parse<0>(ss.str().c_str()).HasParseError() || !document.IsObject())
+	{
+		SPDLOG_ERROR("Failed to parse {}", m_filename);
+		return false;
+	}
+
+	if (!document.HasMember("version") || !document["version"].IsInt()
+		|| document["version"].GetInt() != MANIFEST_FILE_VERSION)
+	{
+		SPDLOG_WARN("{} has an unknown version, starting a new manifest", m_filename);
+		return true;
+	}
+
+	if (!document.HasMember("zones") || !document["zones"].IsObject())
+		return true;
+
+	for (auto zoneIter = document["zones"].MemberBegin(); zoneIter != document["zones"].MemberEnd(); ++zoneIter)
+	{
+		const rapidjson::Value& value = zoneIter->value;
+		if (!value.IsObject())
+			continue;
+
+		ZoneBuildInputs inputs;
+
+		if (value.HasMember("tool") && value["tool"].IsString())
+			inputs.toolVersion = value["tool"].GetString();
+		if (value.HasMember("settings") && value["settings"].IsString())
+			inputs.settings = std::strtoull(value["settings"].GetString(), nullptr, 16);
+
+		if (value.HasMember("sources") && value["sources"].IsObject())
+		{
+			for (auto iter = value["sources"].MemberBegin(); iter != value["sources"].MemberEnd(); ++iter)
+			{
+				if (iter->value.IsString())
+					inputs.sources[iter->name.GetString()] = std::strtoull(iter->value.GetString(), nullptr, 16);
+			}
+		}
+
+		m_zones[zoneIter->name.GetString()] = std::move(inputs);
+	}
+
+	return true;
+}
+
+bool ZoneManifest::Save() const
+{
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.Key("version"); writer.Int(MANIFEST_FILE_VERSION);
+	writer.Key("zones");
+	writer.StartObject();
+
+	for (const auto& [zoneShortName, inputs] : m_zones)
+	{
+		writer.Key(zoneShortName.c_str());
+		writer.StartObject();
+		writer.Key("tool"); writer.String(inputs.toolVersion.c_str());
+		writer.Key("settings"); writer.String(FormatHash(inputs.settings).c_str());
+		writer.Key("sources");
+		writer.StartObject();
+		for (const auto& [filename, hash] : inputs.sources)
+		{
+			writer.Key(filename.c_str());
+			writer.String(FormatHash(hash).c_str());
+		}
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	writer.EndObject();
+	writer.EndObject();
+
+	// Written next to the manifest first, so that a failed write never loses it.
+	const std::string tempFilename = m_filename + ".tmp";
+	{
+		std::ofstream ofs(tempFilename, std::ios::trunc);
+		ofs.write(buffer.GetString(), buffer.GetSize());
+		if (!ofs)
+		{
+			SPDLOG_ERROR("Failed to write {}", tempFilename);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tempFilename, m_filename, ec);
+	if (ec)
+	{
+		SPDLOG_ERROR("Failed to replace {}: {}", m_filename, ec.message());
+		return false;
+	}
+
+	return true;
+}
+
+const ZoneBuildInputs* ZoneManifest::Find(const std::string& zoneShortName) const
+{
+	auto iter = m_zones.find(zoneShortName);
+	return iter != m_zones.end() ? &iter->second : nullptr;
+}
+
+void ZoneManifest::Record(const std::string& zoneShortName, const ZoneBuildInputs& inputs)
+{
+	m_zones[zoneShortName] = inputs;
+}
@@ -0,0 +1,67 @@
+//
+// ZoneManifest.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class NavMesh;
+
+// Version of the meshes the generator builds. Bump it whenever a change to the
+// generator builds different meshes from the same inputs, so that every zone is
+// planned for a rebuild.
+constexpr uint32_t NAVMESH_BUILD_VERSION = 1;
+
+// Everything a zone's navmesh is built from: the game files its geometry is
+// loaded from, its build settings and the version of the generator.
+struct ZoneBuildInputs
+{
+	// Content hash of each source file that exists, by file name.
+	std::map<std::string, uint64_t> sources;
+
+	// Hash of the settings, bounds, volumes, areas and connections of the navmesh,
+	// and of the max extents the geometry was clipped to.
+	uint64_t settings = 0;
+
+	std::string toolVersion = GetToolVersion();
+
+	// Hash the zone's archives in the client directory, and its doors file in the
+	// output directory.
+	void HashSources(const std::string& eqPath, const std::string& outputPath, const std::string& zoneShortName);
+
+	void HashSettings(NavMesh& navMesh, bool useMaxExtents);
+
+	// Describes each difference from the inputs of a previous build, empty if there
+	// are none.
+	std::vector<std::string> Compare(const ZoneBuildInputs& built) const;
+
+	static std::string GetToolVersion();
+};
+
+// Records the inputs of every zone's last build, in <output>\manifest.json. After
+// a client patch, zones whose inputs still match their entry don't need to be
+// rebuilt.
+class ZoneManifest
+{
+public:
+	explicit ZoneManifest(const std::string& outputPath);
+
+	const std::string& GetFilename() const { return m_filename; }
+
+	// A missing manifest loads as empty.
+	bool Load();
+	bool Save() const;
+
+	const ZoneBuildInputs* Find(const std::string& zoneShortName) const;
+	void Record(const std::string& zoneShortName, const ZoneBuildInputs& inputs);
+
+	const std::map<std::string, ZoneBuildInputs>& GetZones() const { return m_zones; }
+
+private:
+	std::string m_filename;
+	std::map<std::string, ZoneBuildInputs> m_zones;
+};
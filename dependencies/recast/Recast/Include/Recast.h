@@ -834,6 +834,28 @@ bool rcAddSpan(rcContext* ctx, rcHeightfield& hf, const int x, const int y,
 			   const unsigned short smin, const unsigned short smax,
 			   const unsigned char area, const int flagMergeThr);
 
+/// Triangle rasterization implementations. (See: #rcSetRasterizationImpl)
+///  @ingroup recast
+enum rcRasterizationImpl
+{
+	RC_RASTERIZATION_SCALAR = 0,	///< Portable implementation.
+	RC_RASTERIZATION_SSE41,			///< Vectorized with SSE4.1.
+	RC_RASTERIZATION_AVX2,			///< Vectorized with AVX2.
+	RC_RASTERIZATION_AUTO,			///< The best implementation supported by the CPU.
+};
+
+/// Selects the implementation used by #rcRasterizeTriangle and #rcRasterizeTriangles.
+/// All implementations produce identical spans. The default is #RC_RASTERIZATION_AUTO.
+///  @ingroup recast
+///  @param[in]		impl			The implementation to use.
+///  @returns The implementation that will be used. This is the best supported one
+///  that is not above @p impl, if @p impl is not supported by the CPU.
+rcRasterizationImpl rcSetRasterizationImpl(const rcRasterizationImpl impl);
+
+/// Gets the implementation used by #rcRasterizeTriangle and #rcRasterizeTriangles.
+///  @ingroup recast
+rcRasterizationImpl rcGetRasterizationImpl();
+
 /// Rasterizes a triangle into the specified heightfield.
 ///  @ingroup recast
 ///  @param[in,out]	ctx				The build context to use during the operation.
@@ -22,6 +22,21 @@
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RC_RASTER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define RC_TARGET_SSE41
+#define RC_TARGET_AVX2
+#else
+#define RC_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define RC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define RC_RASTER_X86 0
+#endif
+
 inline bool overlapBounds(const float* amin, const float* amax, const float* bmin, const float* bmax)
 {
 	bool overlap = true;
@@ -333,6 +348,407 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 	return true;
 }
 
+//----------------------------------------------------------------------------
+// Vectorized rasterization
+//
+// The vectorized paths add exactly the same spans as the scalar path. Every
+// value is computed with the same floating point operations, in the same
+// order, only several of them at once:
+//
+// - Triangle bounds are computed and culled against the heightfield 4 (SSE4.1)
+//   or 8 (AVX2) triangles at a time. Most triangles handed to a tile are outside
+//   of it, so this skips the bulk of them without touching the clipper.
+// - Clipped polygons store their vertices padded to 4 floats, so a vertex is
+//   interpolated, copied and min/maxed with single instructions.
+//
+// Clipping a triangle against successive cell slabs stays sequential: each slab
+// clips the remainder of the previous one, and clipping the original triangle
+// against a slab directly would round differently.
+
+#if RC_RASTER_X86
+
+// Vertex indices of the triangles of an indexed mesh.
+template<class T>
+struct rcIndexedTris
+{
+	explicit rcIndexedTris(const T* t) : tris(t) {}
+	int operator()(const int tri, const int vert) const { return (int)tris[tri*3+vert]; }
+	const T* tris;
+};
+
+// Vertex indices of a plain triangle list.
+struct rcTriList
+{
+	int operator()(const int tri, const int vert) const { return tri*3+vert; }
+};
+
+// Same as dividePoly, with vertices padded to 4 floats.
+RC_TARGET_SSE41
+static void dividePolySIMD(const float* in, int nin,
+						   float* out1, int* nout1,
+						   float* out2, int* nout2,
+						   float x, int axis)
+{
+	float d[12];
+	for (int i = 0; i < nin; ++i)
+		d[i] = x - in[i*4+axis];
+
+	int m = 0, n = 0;
+	for (int i = 0, j = nin-1; i < nin; j=i, ++i)
+	{
+		const __m128 vi = _mm_load_ps(in + i*4);
+		bool ina = d[j] >= 0;
+		bool inb = d[i] >= 0;
+		if (ina != inb)
+		{
+			const __m128 vj = _mm_load_ps(in + j*4);
+			const float s = d[j] / (d[j] - d[i]);
+			const __m128 v = _mm_add_ps(vj, _mm_mul_ps(_mm_sub_ps(vi, vj), _mm_set1_ps(s)));
+			_mm_store_ps(out1 + m*4, v);
+			_mm_store_ps(out2 + n*4, v);
+			m++;
+			n++;
+			if (d[i] > 0)
+			{
+				_mm_store_ps(out1 + m*4, vi);
+				m++;
+			}
+			else if (d[i] < 0)
+			{
+				_mm_store_ps(out2 + n*4, vi);
+				n++;
+			}
+		}
+		else
+		{
+			if (d[i] >= 0)
+			{
+				_mm_store_ps(out1 + m*4, vi);
+				m++;
+				if (d[i] != 0)
+					continue;
+			}
+			_mm_store_ps(out2 + n*4, vi);
+			n++;
+		}
+	}
+
+	*nout1 = m;
+	*nout2 = n;
+}
+
+// Same as rasterizeTri, using dividePolySIMD.
+RC_TARGET_SSE41
+static bool rasterizeTriSIMD(const float* v0, const float* v1, const float* v2,
+							 const unsigned char area, rcHeightfield& hf,
+							 const float* bmin, const float* bmax,
+							 const float cs, const float ics, const float ich,
+							 const int flagMergeThr)
+{
+	const int w = hf.width;
+	const int h = hf.height;
+	const float by = bmax[1] - bmin[1];
+
+	// Calculate the bounding box of the triangle.
+	const __m128 a = _mm_setr_ps(v0[0], v0[1], v0[2], 0);
+	const __m128 b = _mm_setr_ps(v1[0], v1[1], v1[2], 0);
+	const __m128 c = _mm_setr_ps(v2[0], v2[1], v2[2], 0);
+	const __m128 tminv = _mm_min_ps(_mm_min_ps(a, b), c);
+	const __m128 tmaxv = _mm_max_ps(_mm_max_ps(a, b), c);
+
+	// If the triangle does not touch the bbox of the heightfield, skip the triagle.
+	const __m128 outside = _mm_or_ps(
+		_mm_cmpgt_ps(tminv, _mm_setr_ps(bmax[0], bmax[1], bmax[2], 0)),
+		_mm_cmplt_ps(tmaxv, _mm_setr_ps(bmin[0], bmin[1], bmin[2], 0)));
+	if (_mm_movemask_ps(outside) & 0x7)
+		return true;
+
+	alignas(16) float tmin[4], tmax[4];
+	_mm_store_ps(tmin, tminv);
+	_mm_store_ps(tmax, tmaxv);
+
+	// Calculate the footprint of the triangle on the grid's y-axis
+	int y0 = (int)((tmin[2] - bmin[2])*ics);
+	int y1 = (int)((tmax[2] - bmin[2])*ics);
+	y0 = rcClamp(y0, 0, h-1);
+	y1 = rcClamp(y1, 0, h-1);
+
+	// Clip the triangle into all grid cells it touches.
+	alignas(16) float buf[7*4*4];
+	float *in = buf, *inrow = buf+7*4, *p1 = inrow+7*4, *p2 = p1+7*4;
+
+	_mm_store_ps(&in[0], a);
+	_mm_store_ps(&in[1*4], b);
+	_mm_store_ps(&in[2*4], c);
+	int nvrow, nvIn = 3;
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		// Clip polygon to row. Store the remaining polygon as well
+		const float cz = bmin[2] + y*cs;
+		dividePolySIMD(in, nvIn, inrow, &nvrow, p1, &nvIn, cz+cs, 2);
+		rcSwap(in, p1);
+		if (nvrow < 3) continue;
+
+		// find the horizontal bounds in the row
+		__m128 rowMin = _mm_load_ps(inrow), rowMax = rowMin;
+		for (int i=1; i<nvrow; ++i)
+		{
+			const __m128 v = _mm_load_ps(inrow + i*4);
+			rowMin = _mm_min_ps(v, rowMin);
+			rowMax = _mm_max_ps(v, rowMax);
+		}
+		const float minX = _mm_cvtss_f32(rowMin);
+		const float maxX = _mm_cvtss_f32(rowMax);
+		int x0 = (int)((minX - bmin[0])*ics);
+		int x1 = (int)((maxX - bmin[0])*ics);
+		x0 = rcClamp(x0, 0, w-1);
+		x1 = rcClamp(x1, 0, w-1);
+
+		int nv, nv2 = nvrow;
+
+		for (int x = x0; x <= x1; ++x)
+		{
+			// Clip polygon to column. store the remaining polygon as well
+			const float cx = bmin[0] + x*cs;
+			dividePolySIMD(inrow, nv2, p1, &nv, p2, &nv2, cx+cs, 0);
+			rcSwap(inrow, p2);
+			if (nv < 3) continue;
+
+			// Calculate min and max of the span.
+			__m128 spanMin = _mm_load_ps(p1), spanMax = spanMin;
+			for (int i = 1; i < nv; ++i)
+			{
+				const __m128 v = _mm_load_ps(p1 + i*4);
+				spanMin = _mm_min_ps(spanMin, v);
+				spanMax = _mm_max_ps(spanMax, v);
+			}
+			float smin = _mm_cvtss_f32(_mm_shuffle_ps(spanMin, spanMin, _MM_SHUFFLE(1, 1, 1, 1)));
+			float smax = _mm_cvtss_f32(_mm_shuffle_ps(spanMax, spanMax, _MM_SHUFFLE(1, 1, 1, 1)));
+			smin -= bmin[1];
+			smax -= bmin[1];
+			// Skip the span if it is outside the heightfield bbox
+			if (smax < 0.0f) continue;
+			if (smin > by) continue;
+			// Clamp the span to the heightfield bbox.
+			if (smin < 0.0f) smin = 0;
+			if (smax > by) smax = by;
+
+			// Snap the span to the heightfield height grid.
+			const __m128 q = _mm_setr_ps(smin * ich, smax * ich, 0, 0);
+			const int qmin = _mm_cvttss_si32(_mm_floor_ps(q));
+			const __m128 qceil = _mm_ceil_ps(q);
+			const int qmax = _mm_cvttss_si32(_mm_shuffle_ps(qceil, qceil, _MM_SHUFFLE(1, 1, 1, 1)));
+			unsigned short ismin = (unsigned short)rcClamp(qmin, 0, RC_SPAN_MAX_HEIGHT);
+			unsigned short ismax = (unsigned short)rcClamp(qmax, (int)ismin+1, RC_SPAN_MAX_HEIGHT);
+
+			if (!addSpan(hf, x, y, ismin, ismax, area, flagMergeThr))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+template<class TriIndices>
+RC_TARGET_SSE41
+static bool rasterizeTrianglesSSE41(const float* verts, const TriIndices& tris,
+									const unsigned char* areas, const int nt,
+									rcHeightfield& hf, const int flagMergeThr)
+{
+	const float ics = 1.0f/hf.cs;
+	const float ich = 1.0f/hf.ch;
+
+	const __m128 hbmin[3] = { _mm_set1_ps(hf.bmin[0]), _mm_set1_ps(hf.bmin[1]), _mm_set1_ps(hf.bmin[2]) };
+	const __m128 hbmax[3] = { _mm_set1_ps(hf.bmax[0]), _mm_set1_ps(hf.bmax[1]), _mm_set1_ps(hf.bmax[2]) };
+
+	int i = 0;
+	for (; i + 4 <= nt; i += 4)
+	{
+		// Gather the vertices of 4 triangles, one register per vertex component.
+		alignas(16) float tv[9][4];
+		for (int k = 0; k < 4; ++k)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				const float* v = &verts[tris(i+k, j)*3];
+				tv[j*3+0][k] = v[0];
+				tv[j*3+1][k] = v[1];
+				tv[j*3+2][k] = v[2];
+			}
+		}
+
+		__m128 outside = _mm_setzero_ps();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const __m128 a = _mm_load_ps(tv[axis]);
+			const __m128 b = _mm_load_ps(tv[3+axis]);
+			const __m128 c = _mm_load_ps(tv[6+axis]);
+			const __m128 tmin = _mm_min_ps(_mm_min_ps(a, b), c);
+			const __m128 tmax = _mm_max_ps(_mm_max_ps(a, b), c);
+			outside = _mm_or_ps(outside, _mm_or_ps(
+				_mm_cmpgt_ps(tmin, hbmax[axis]), _mm_cmplt_ps(tmax, hbmin[axis])));
+		}
+
+		const int mask = _mm_movemask_ps(outside);
+		if (mask == 0xf)
+			continue;
+
+		for (int k = 0; k < 4; ++k)
+		{
+			if (mask & (1 << k))
+				continue;
+			if (!rasterizeTriSIMD(&verts[tris(i+k, 0)*3], &verts[tris(i+k, 1)*3], &verts[tris(i+k, 2)*3],
+				areas[i+k], hf, hf.bmin, hf.bmax, hf.cs, ics, ich, flagMergeThr))
+			{
+				return false;
+			}
+		}
+	}
+
+	for (; i < nt; ++i)
+	{
+		if (!rasterizeTriSIMD(&verts[tris(i, 0)*3], &verts[tris(i, 1)*3], &verts[tris(i, 2)*3],
+			areas[i], hf, hf.bmin, hf.bmax, hf.cs, ics, ich, flagMergeThr))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template<class TriIndices>
+RC_TARGET_AVX2
+static bool rasterizeTrianglesAVX2(const float* verts, const TriIndices& tris,
+								   const unsigned char* areas, const int nt,
+								   rcHeightfield& hf, const int flagMergeThr)
+{
+	const float ics = 1.0f/hf.cs;
+	const float ich = 1.0f/hf.ch;
+
+	int i = 0;
+	for (; i + 8 <= nt; i += 8)
+	{
+		// Gather the vertices of 8 triangles, one register per vertex component.
+		alignas(32) float tv[9][8];
+		for (int k = 0; k < 8; ++k)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				const float* v = &verts[tris(i+k, j)*3];
+				tv[j*3+0][k] = v[0];
+				tv[j*3+1][k] = v[1];
+				tv[j*3+2][k] = v[2];
+			}
+		}
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const __m256 a = _mm256_load_ps(tv[axis]);
+			const __m256 b = _mm256_load_ps(tv[3+axis]);
+			const __m256 c = _mm256_load_ps(tv[6+axis]);
+			const __m256 tmin = _mm256_min_ps(_mm256_min_ps(a, b), c);
+			const __m256 tmax = _mm256_max_ps(_mm256_max_ps(a, b), c);
+			outside = _mm256_or_ps(outside, _mm256_or_ps(
+				_mm256_cmp_ps(tmin, _mm256_set1_ps(hf.bmax[axis]), _CMP_GT_OQ),
+				_mm256_cmp_ps(tmax, _mm256_set1_ps(hf.bmin[axis]), _CMP_LT_OQ)));
+		}
+
+		const int mask = _mm256_movemask_ps(outside);
+		if (mask == 0xff)
+			continue;
+
+		// The clipper uses 128-bit registers only, avoid the transition penalty.
+		_mm256_zeroupper();
+
+		for (int k = 0; k < 8; ++k)
+		{
+			if (mask & (1 << k))
+				continue;
+			if (!rasterizeTriSIMD(&verts[tris(i+k, 0)*3], &verts[tris(i+k, 1)*3], &verts[tris(i+k, 2)*3],
+				areas[i+k], hf, hf.bmin, hf.bmax, hf.cs, ics, ich, flagMergeThr))
+			{
+				return false;
+			}
+		}
+	}
+
+	for (; i < nt; ++i)
+	{
+		if (!rasterizeTriSIMD(&verts[tris(i, 0)*3], &verts[tris(i, 1)*3], &verts[tris(i, 2)*3],
+			areas[i], hf, hf.bmin, hf.bmax, hf.cs, ics, ich, flagMergeThr))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool cpuSupportsSSE41()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+#else
+	return __builtin_cpu_supports("sse4.1") != 0;
+#endif
+}
+
+static bool cpuSupportsAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return false;
+	// The OS must save the ymm registers.
+	if ((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // RC_RASTER_X86
+
+static rcRasterizationImpl bestRasterizationImpl(const rcRasterizationImpl requested)
+{
+#if RC_RASTER_X86
+	if (requested >= RC_RASTERIZATION_AVX2 && cpuSupportsAVX2())
+		return RC_RASTERIZATION_AVX2;
+	if (requested >= RC_RASTERIZATION_SSE41 && cpuSupportsSSE41())
+		return RC_RASTERIZATION_SSE41;
+#else
+	rcIgnoreUnused(requested);
+#endif
+	return RC_RASTERIZATION_SCALAR;
+}
+
+static rcRasterizationImpl s_rasterizationImpl = bestRasterizationImpl(RC_RASTERIZATION_AUTO);
+
+/// @par
+///
+/// The implementation is global and not thread safe to change, select it before
+/// starting any builds. All implementations produce the same spans.
+rcRasterizationImpl rcSetRasterizationImpl(const rcRasterizationImpl impl)
+{
+	s_rasterizationImpl = bestRasterizationImpl(impl);
+	return s_rasterizationImpl;
+}
+
+rcRasterizationImpl rcGetRasterizationImpl()
+{
+	return s_rasterizationImpl;
+}
+
 /// @par
 ///
 /// No spans will be added if the triangle does not overlap the heightfield grid.
@@ -348,7 +764,14 @@ bool rcRasterizeTriangle(rcContext* ctx, const float* v0, const float* v1, const
 
 	const float ics = 1.0f/solid.cs;
 	const float ich = 1.0f/solid.ch;
-	if (!rasterizeTri(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr))
+#if RC_RASTER_X86
+	const bool ok = s_rasterizationImpl != RC_RASTERIZATION_SCALAR
+		? rasterizeTriSIMD(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr)
+		: rasterizeTri(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr);
+#else
+	const bool ok = rasterizeTri(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr);
+#endif
+	if (!ok)
 	{
 		ctx->log(RC_LOG_ERROR, "rcRasterizeTriangle: Out of memory.");
 		return false;
@@ -369,7 +792,19 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 	rcAssert(ctx);
 
 	rcScopedTimer timer(ctx, RC_TIMER_RASTERIZE_TRIANGLES);
-	
+
+#if RC_RASTER_X86
+	if (s_rasterizationImpl != RC_RASTERIZATION_SCALAR)
+	{
+		const bool ok = s_rasterizationImpl == RC_RASTERIZATION_AVX2
+			? rasterizeTrianglesAVX2(verts, rcIndexedTris<int>(tris), areas, nt, solid, flagMergeThr)
+			: rasterizeTrianglesSSE41(verts, rcIndexedTris<int>(tris), areas, nt, solid, flagMergeThr);
+		if (!ok)
+			ctx->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
+		return ok;
+	}
+#endif
+
 	const float ics = 1.0f/solid.cs;
 	const float ich = 1.0f/solid.ch;
 	// Rasterize triangles.
@@ -401,7 +836,19 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 	rcAssert(ctx);
 
 	rcScopedTimer timer(ctx, RC_TIMER_RASTERIZE_TRIANGLES);
-	
+
+#if RC_RASTER_X86
+	if (s_rasterizationImpl != RC_RASTERIZATION_SCALAR)
+	{
+		const bool ok = s_rasterizationImpl == RC_RASTERIZATION_AVX2
+			? rasterizeTrianglesAVX2(verts, rcIndexedTris<unsigned short>(tris), areas, nt, solid, flagMergeThr)
+			: rasterizeTrianglesSSE41(verts, rcIndexedTris<unsigned short>(tris), areas, nt, solid, flagMergeThr);
+		if (!ok)
+			ctx->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
+		return ok;
+	}
+#endif
+
 	const float ics = 1.0f/solid.cs;
 	const float ich = 1.0f/solid.ch;
 	// Rasterize triangles.
@@ -432,7 +879,19 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const unsigned cha
 	rcAssert(ctx);
 	
 	rcScopedTimer timer(ctx, RC_TIMER_RASTERIZE_TRIANGLES);
-	
+
+#if RC_RASTER_X86
+	if (s_rasterizationImpl != RC_RASTERIZATION_SCALAR)
+	{
+		const bool ok = s_rasterizationImpl == RC_RASTERIZATION_AVX2
+			? rasterizeTrianglesAVX2(verts, rcTriList(), areas, nt, solid, flagMergeThr)
+			: rasterizeTrianglesSSE41(verts, rcTriList(), areas, nt, solid, flagMergeThr);
+		if (!ok)
+			ctx->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
+		return ok;
+	}
+#endif
+
 	const float ics = 1.0f/solid.cs;
 	const float ich = 1.0f/solid.ch;
 	// Rasterize triangles.
@@ -0,0 +1,291 @@
+#include "catch.hpp"
+
+#include "Recast.h"
+
+#include <vector>
+
+namespace
+{
+
+// Spans of the heightfield built from buildTestMesh(1234, 0.3f) by the scalar
+// rasterizer. If rasterization is changed on purpose, update these.
+const int GOLDEN_SPAN_COUNT = 6502;
+const unsigned long long GOLDEN_HASH = 0xc2e63c2f15afcfaaULL;
+
+// Small deterministic generator so the meshes are the same on every platform.
+struct TestRandom
+{
+	unsigned int state;
+
+	explicit TestRandom(unsigned int seed) : state(seed) {}
+
+	unsigned int next()
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	// [lo, hi)
+	float range(float lo, float hi)
+	{
+		return lo + (hi - lo) * ((float)next() / (float)(1u << 24));
+	}
+};
+
+struct TestMesh
+{
+	std::vector<float> verts;
+	std::vector<int> tris;
+	std::vector<unsigned char> areas;
+
+	int addVert(float x, float y, float z)
+	{
+		verts.push_back(x);
+		verts.push_back(y);
+		verts.push_back(z);
+		return (int)verts.size() / 3 - 1;
+	}
+
+	void addTri(int a, int b, int c, unsigned char area)
+	{
+		tris.push_back(a);
+		tris.push_back(b);
+		tris.push_back(c);
+		areas.push_back(area);
+	}
+
+	int vertCount() const { return (int)verts.size() / 3; }
+	int triCount() const { return (int)tris.size() / 3; }
+};
+
+// A bumpy grid whose vertices lie exactly on cell boundaries, with random
+// triangles of all sizes and orientations scattered over it. Part of the mesh is
+// outside the heightfield, like the geometry handed to a tile.
+TestMesh buildTestMesh(unsigned int seed, float cellSize)
+{
+	TestMesh mesh;
+	TestRandom rnd(seed);
+
+	const int gridSize = 24;
+	const float spacing = cellSize * 2;
+	const int first = mesh.vertCount();
+	for (int z = 0; z <= gridSize; ++z)
+	{
+		for (int x = 0; x <= gridSize; ++x)
+			mesh.addVert(-4 + x * spacing, rnd.range(-1.0f, 1.0f), -4 + z * spacing);
+	}
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			const int i = first + x + z * (gridSize + 1);
+			mesh.addTri(i, i + gridSize + 1, i + 1, RC_WALKABLE_AREA);
+			mesh.addTri(i + 1, i + gridSize + 1, i + gridSize + 2, (unsigned char)(rnd.next() % 4));
+		}
+	}
+
+	for (int i = 0; i < 600; ++i)
+	{
+		const float cx = rnd.range(-8.0f, 28.0f);
+		const float cy = rnd.range(-4.0f, 8.0f);
+		const float cz = rnd.range(-8.0f, 28.0f);
+		const float size = (i % 5 == 0) ? rnd.range(2.0f, 12.0f) : rnd.range(0.05f, 2.0f);
+
+		int v[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			float x = cx + rnd.range(-size, size);
+			float z = cz + rnd.range(-size, size);
+			// Put some vertices exactly on cell boundaries.
+			if (rnd.next() % 3 == 0)
+				x = (float)(int)(x / cellSize) * cellSize;
+			if (rnd.next() % 3 == 0)
+				z = (float)(int)(z / cellSize) * cellSize;
+			v[j] = mesh.addVert(x, cy + rnd.range(-size, size), z);
+		}
+		mesh.addTri(v[0], v[1], v[2], (unsigned char)(rnd.next() % 64));
+	}
+
+	return mesh;
+}
+
+// FNV-1a over every span of the heightfield, in cell order.
+unsigned long long hashHeightfield(const rcHeightfield& hf, int* spanCount)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const auto add = [&hash](unsigned int value)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			hash ^= (value >> (i * 8)) & 0xff;
+			hash *= 1099511628211ULL;
+		}
+	};
+
+	*spanCount = 0;
+	for (int i = 0; i < hf.width * hf.height; ++i)
+	{
+		for (const rcSpan* s = hf.spans[i]; s; s = s->next)
+		{
+			add((unsigned int)i);
+			add(s->smin);
+			add(s->smax);
+			add(s->area);
+			++*spanCount;
+		}
+	}
+
+	return hash;
+}
+
+struct RasterResult
+{
+	unsigned long long hash;
+	int spanCount;
+};
+
+enum TestOverload
+{
+	OVERLOAD_INT_INDICES,
+	OVERLOAD_SHORT_INDICES,
+	OVERLOAD_TRIANGLE_LIST,
+	OVERLOAD_SINGLE_TRIANGLE,
+};
+
+RasterResult rasterizeTestMesh(const TestMesh& mesh, TestOverload overload, rcRasterizationImpl impl)
+{
+	const float cellSize = 0.3f;
+	const float cellHeight = 0.2f;
+	const float bmin[3] = { 0, -2, 0 };
+	const float bmax[3] = { 19.2f, 6, 19.2f };
+
+	int width, height;
+	rcCalcGridSize(bmin, bmax, cellSize, &width, &height);
+
+	rcContext ctx;
+	rcHeightfield solid;
+	REQUIRE(rcCreateHeightfield(&ctx, solid, width, height, bmin, bmax, cellSize, cellHeight));
+
+	const rcRasterizationImpl prevImpl = rcGetRasterizationImpl();
+	rcSetRasterizationImpl(impl);
+
+	const int flagMergeThr = 1;
+	const int nt = mesh.triCount();
+	bool ok = true;
+	switch (overload)
+	{
+	case OVERLOAD_INT_INDICES:
+		ok = rcRasterizeTriangles(&ctx, &mesh.verts[0], mesh.vertCount(), &mesh.tris[0], &mesh.areas[0], nt, solid, flagMergeThr);
+		break;
+
+	case OVERLOAD_SHORT_INDICES:
+	{
+		std::vector<unsigned short> tris(mesh.tris.begin(), mesh.tris.end());
+		ok = rcRasterizeTriangles(&ctx, &mesh.verts[0], mesh.vertCount(), &tris[0], &mesh.areas[0], nt, solid, flagMergeThr);
+		break;
+	}
+
+	case OVERLOAD_TRIANGLE_LIST:
+	{
+		std::vector<float> list;
+		for (int i = 0; i < nt * 3; ++i)
+			list.insert(list.end(), &mesh.verts[mesh.tris[i] * 3], &mesh.verts[mesh.tris[i] * 3] + 3);
+		ok = rcRasterizeTriangles(&ctx, &list[0], &mesh.areas[0], nt, solid, flagMergeThr);
+		break;
+	}
+
+	case OVERLOAD_SINGLE_TRIANGLE:
+		for (int i = 0; i < nt && ok; ++i)
+		{
+			ok = rcRasterizeTriangle(&ctx, &mesh.verts[mesh.tris[i * 3 + 0] * 3], &mesh.verts[mesh.tris[i * 3 + 1] * 3],
+				&mesh.verts[mesh.tris[i * 3 + 2] * 3], mesh.areas[i], solid, flagMergeThr);
+		}
+		break;
+	}
+
+	rcSetRasterizationImpl(prevImpl);
+	REQUIRE(ok);
+
+	RasterResult result;
+	result.hash = hashHeightfield(solid, &result.spanCount);
+	return result;
+}
+
+}
+
+TEST_CASE("rcSetRasterizationImpl")
+{
+	const rcRasterizationImpl prevImpl = rcGetRasterizationImpl();
+
+	SECTION("Scalar is always available")
+	{
+		REQUIRE(rcSetRasterizationImpl(RC_RASTERIZATION_SCALAR) == RC_RASTERIZATION_SCALAR);
+		REQUIRE(rcGetRasterizationImpl() == RC_RASTERIZATION_SCALAR);
+	}
+
+	SECTION("Auto resolves to a concrete implementation")
+	{
+		const rcRasterizationImpl impl = rcSetRasterizationImpl(RC_RASTERIZATION_AUTO);
+		REQUIRE(impl != RC_RASTERIZATION_AUTO);
+		REQUIRE(rcGetRasterizationImpl() == impl);
+	}
+
+	SECTION("Unsupported implementations fall back to a lower one")
+	{
+		REQUIRE(rcSetRasterizationImpl(RC_RASTERIZATION_AVX2) <= RC_RASTERIZATION_AVX2);
+		REQUIRE(rcSetRasterizationImpl(RC_RASTERIZATION_SSE41) <= RC_RASTERIZATION_SSE41);
+	}
+
+	rcSetRasterizationImpl(prevImpl);
+}
+
+TEST_CASE("Golden heightfield")
+{
+	const TestMesh mesh = buildTestMesh(1234, 0.3f);
+
+	SECTION("Scalar rasterization matches the golden heightfield")
+	{
+		const RasterResult result = rasterizeTestMesh(mesh, OVERLOAD_INT_INDICES, RC_RASTERIZATION_SCALAR);
+		REQUIRE(result.spanCount == GOLDEN_SPAN_COUNT);
+		REQUIRE(result.hash == GOLDEN_HASH);
+	}
+
+	SECTION("Every implementation and overload matches the golden heightfield")
+	{
+		const rcRasterizationImpl impls[] = { RC_RASTERIZATION_SCALAR, RC_RASTERIZATION_SSE41, RC_RASTERIZATION_AVX2 };
+		const TestOverload overloads[] = { OVERLOAD_INT_INDICES, OVERLOAD_SHORT_INDICES, OVERLOAD_TRIANGLE_LIST, OVERLOAD_SINGLE_TRIANGLE };
+
+		for (rcRasterizationImpl impl : impls)
+		{
+			for (TestOverload overload : overloads)
+			{
+				const RasterResult result = rasterizeTestMesh(mesh, overload, impl);
+				CAPTURE(impl);
+				CAPTURE(overload);
+				REQUIRE(result.spanCount == GOLDEN_SPAN_COUNT);
+				REQUIRE(result.hash == GOLDEN_HASH);
+			}
+		}
+	}
+}
+
+TEST_CASE("Vectorized rasterization matches scalar")
+{
+	SECTION("Random meshes")
+	{
+		for (unsigned int seed = 1; seed <= 20; ++seed)
+		{
+			const TestMesh mesh = buildTestMesh(seed, 0.3f);
+			const RasterResult scalar = rasterizeTestMesh(mesh, OVERLOAD_INT_INDICES, RC_RASTERIZATION_SCALAR);
+			const RasterResult sse = rasterizeTestMesh(mesh, OVERLOAD_INT_INDICES, RC_RASTERIZATION_SSE41);
+			const RasterResult avx = rasterizeTestMesh(mesh, OVERLOAD_INT_INDICES, RC_RASTERIZATION_AVX2);
+
+			CAPTURE(seed);
+			REQUIRE(scalar.spanCount > 0);
+			REQUIRE(sse.spanCount == scalar.spanCount);
+			REQUIRE(sse.hash == scalar.hash);
+			REQUIRE(avx.spanCount == scalar.spanCount);
+			REQUIRE(avx.hash == scalar.hash);
+		}
+	}
+}
@@ -12,13 +12,18 @@ EQEmu::EQGLoader::~EQGLoader() {
 
 bool EQEmu::EQGLoader::Load(std::string file, std::vector<std::shared_ptr<EQG::Geometry>> &models, std::vector<std::shared_ptr<Placeable>> &placeables,
 	std::vector<std::shared_ptr<EQG::Region>> &regions, std::vector<std::shared_ptr<Light>> &lights) {
-	// find zon file
 	EQEmu::PFS::Archive archive;
 	if(!archive.Open(file + ".eqg")) {
 		eqLogMessage(LogTrace, "Failed to open %s.eqg as a standard eqg file because the file does not exist.", file.c_str());
 		return false;
 	}
 
+	return Load(archive, file, models, placeables, regions, lights);
+}
+
+bool EQEmu::EQGLoader::Load(EQEmu::PFS::Archive &archive, std::string file, std::vector<std::shared_ptr<EQG::Geometry>> &models, std::vector<std::shared_ptr<Placeable>> &placeables,
+	std::vector<std::shared_ptr<EQG::Region>> &regions, std::vector<std::shared_ptr<Light>> &lights) {
+	// find zon file
 	std::vector<char> zon;
 	bool zon_found = false;
 	std::vector<std::string> files;
@@ -21,6 +21,11 @@ bool EQEmu::EQG4Loader::Load(std::string file, std::shared_ptr<EQG::Terrain> &te
 		return false;
 	}
 
+	return Load(archive, file, terrain);
+}
+
+bool EQEmu::EQG4Loader::Load(EQEmu::PFS::Archive &archive, std::string file, std::shared_ptr<EQG::Terrain> &terrain)
+{
 	std::vector<char> zon;
 	bool zon_found = false;
 	std::vector<std::string> files;
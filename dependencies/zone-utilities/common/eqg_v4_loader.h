@@ -19,6 +19,7 @@ public:
 	EQG4Loader();
 	~EQG4Loader();
 	bool Load(std::string file, std::shared_ptr<EQG::Terrain> &terrain);
+	bool Load(EQEmu::PFS::Archive &archive, std::string file, std::shared_ptr<EQG::Terrain> &terrain);
 private:
 	bool ParseZoneDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain);
 	bool ParseWaterDat(EQEmu::PFS::Archive &archive, std::shared_ptr<EQG::Terrain> &terrain);
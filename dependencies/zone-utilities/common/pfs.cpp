@@ -245,7 +245,9 @@ bool EQEmu::PFS::Archive::Get(std::string filename, std::vector<char> &buf) {
 	if(iter != files.end()) {
 		buf.clear();
 
-		uint32_t uc_size = files_uncompressed_size[filename];
+		// lookup only, so that several threads can read from the same archive.
+		auto size_iter = files_uncompressed_size.find(filename);
+		uint32_t uc_size = size_iter != files_uncompressed_size.end() ? size_iter->second : 0;
 		if(!InflateByFileOffset(0, uc_size, iter->second, buf)) {
 			return false;
 		}
@@ -19,9 +19,6 @@ EQEmu::S3DLoader::~S3DLoader() {
 
 bool EQEmu::S3DLoader::ParseWLDFile(std::string file_name, std::string wld_name, std::vector<S3D::WLDFragment> &out) {
 	out.clear();
-	std::vector<char> buffer;
-	char *current_hash;
-	bool old = false;
 
 	EQEmu::PFS::Archive archive;
 	if (!archive.Open(file_name)) {
@@ -29,6 +26,15 @@ bool EQEmu::S3DLoader::ParseWLDFile(std::string file_name, std::string wld_name,
 		return false;
 	}
 
+	return ParseWLDFile(archive, wld_name, out);
+}
+
+bool EQEmu::S3DLoader::ParseWLDFile(PFS::Archive &archive, std::string wld_name, std::vector<S3D::WLDFragment> &out) {
+	out.clear();
+	std::vector<char> buffer;
+	char *current_hash;
+	bool old = false;
+
 	if (!archive.Get(wld_name, buffer)) {
 		eqLogMessage(LogDebug, "Unable to open wld file %s.", wld_name.c_str());
 		return false;
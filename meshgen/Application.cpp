@@ -5,9 +5,12 @@
 // Implementation of main GUI interface for EQNavigation
 
 #include "meshgen/Application.h"
+#include "meshgen/GeometryLoadTask.h"
 #include "meshgen/InputGeom.h"
+#include "meshgen/InstancedGeometry.h"
 #include "meshgen/MapGeometryLoader.h"
 #include "meshgen/NavMeshTool.h"
+#include "meshgen/TerrainHeightfield.h"
 #include "meshgen/ZonePicker.h"
 #include "meshgen/resource.h"
 #include "meshgen/imgui/imgui_impl_opengl2.h"
@@ -296,6 +299,7 @@ int Application::RunMainLoop()
 		m_raye = glm::unProject(glm::vec3{ m_m.x, m_m.y, 1.0f }, m_model, m_proj, m_view);
 
 		DispatchCallbacks();
+		UpdateGeometryLoad();
 
 		// Handle input events.
 		HandleEvents();
@@ -349,6 +353,7 @@ int Application::RunMainLoop()
 
 	Halt();
 
+	m_geomLoadTask.reset();
 	m_geom.reset();
 	return 0;
 }
@@ -592,6 +597,22 @@ void Application::RenderInterface()
 			ImColor(255, 255, 255, 128), m_activityMessage.c_str(), m_progress);
 	}
 
+	if (m_geomLoadTask)
+	{
+		ImGui::SetNextWindowPos(ImVec2(m_width / 2.0f, m_height / 2.0f + 40.0f), ImGuiCond_Always, ImVec2(0.5f, 0.0f));
+		if (ImGui::Begin("##GeometryLoad", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize
+			| ImGuiWindowFlags_NoSavedSettings))
+		{
+			ImGui::ProgressBar(m_progress, ImVec2(250.0f, 0.0f));
+
+			if (m_geomLoadTask->IsCancelled())
+				ImGui::TextUnformatted("Cancelling...");
+			else if (ImGui::Button("Cancel"))
+				m_geomLoadTask->Cancel();
+		}
+		ImGui::End();
+	}
+
 	m_showFailedToOpenDialog = false;
 
 	if (ImGui::BeginMainMenuBar())
@@ -795,6 +816,15 @@ void Application::RenderInterface()
 
 			ImGui::Text("Verts: %.1fk Tris: %.1fk", loader->getVertCount() / 1000.0f, loader->getTriCount() / 1000.0f);
 
+			if (const TerrainHeightfield* terrain = loader->GetTerrainHeightfield())
+				ImGui::Text("Terrain: %.1fk quads", terrain->GetSolidQuadCount() / 1000.0f);
+
+			if (const InstancedGeometry* instances = loader->GetInstancedGeometry())
+			{
+				ImGui::Text("Placeables: %d of %d models (%.1fk tris)", instances->GetInstanceCount(),
+					instances->GetModelCount(), instances->GetInstancedTriCount() / 1000.0f);
+			}
+
 			if (m_navMesh->IsNavMeshLoaded())
 			{
 				ImGui::Separator();
@@ -826,16 +856,27 @@ void Application::RenderInterface()
 		{
 			if (m_meshTool->isBuildingTiles())
 			{
-				int tw, th, tm;
-				m_meshTool->getTileStatistics(tw, th, tm);
-				int tt = tw * th;
-
-				float percent = (float)m_meshTool->getTilesBuilt() / (float)tt;
+				NavMeshTool::BuildProgress progress = m_meshTool->getBuildProgress();
 
+				// Progress is weighted by the estimated cost of each tile, so it tracks time
+				// rather than the number of tiles.
 				char szProgress[256];
-				sprintf_s(szProgress, "%d of %d (%.2f%%)", m_meshTool->getTilesBuilt(), tt, percent * 100);
+				sprintf_s(szProgress, "%d of %d (%.2f%%)", progress.tilesBuilt, progress.tilesTotal,
+					progress.fraction * 100);
+
+				ImGui::ProgressBar(progress.fraction, ImVec2(-1, 0), szProgress);
 
-				ImGui::ProgressBar(percent, ImVec2(-1, 0), szProgress);
+				const int elapsed = static_cast<int>(progress.elapsedSeconds);
+				if (progress.etaSeconds >= 0.0f)
+				{
+					const int eta = static_cast<int>(progress.etaSeconds + 0.5f);
+					ImGui::Text("Elapsed %d:%02d, about %d:%02d remaining", elapsed / 60, elapsed % 60,
+						eta / 60, eta % 60);
+				}
+				else
+				{
+					ImGui::Text("Elapsed %d:%02d, estimating time remaining...", elapsed / 60, elapsed % 60);
+				}
 
 				if (ImGui::Button(ICON_MD_CANCEL " Stop"))
 					m_meshTool->CancelBuildAllTiles();
@@ -1191,28 +1232,46 @@ void Application::Halt()
 
 void Application::LoadGeometry(const std::string& zoneShortName, bool loadMesh)
 {
-	std::unique_lock<std::mutex> lock(m_renderMutex);
+	// A load that is still running is for a zone that is no longer wanted.
+	m_geomLoadTask.reset();
 
-	Halt();
-
-	std::string eqPath = m_eqConfig.GetEverquestPath();
-	std::string outputPath = m_eqConfig.GetOutputPath();
-
-	auto ptr = std::make_unique<InputGeom>(zoneShortName, eqPath);
+	// The current zone stays up until the new one is ready.
+	m_geomLoadTask = std::make_unique<GeometryLoadTask>(m_eqConfig, zoneShortName, m_rcContext.get());
+	m_loadMeshOnGeometry = loadMesh;
+}
 
-	auto geomLoader = std::make_unique<MapGeometryLoader>(
-		zoneShortName, eqPath, outputPath);
+void Application::UpdateGeometryLoad()
+{
+	if (!m_geomLoadTask)
+		return;
 
-	if (m_eqConfig.GetUseMaxExtents())
+	if (!m_geomLoadTask->IsFinished())
 	{
-		auto iter = MaxZoneExtents.find(zoneShortName);
-		if (iter != MaxZoneExtents.end())
-		{
-			geomLoader->SetMaxExtents(iter->second);
-		}
+		const GeometryLoadProgress& progress = m_geomLoadTask->GetProgress();
+
+		m_activityMessage = fmt::format("Loading {}: {}...", m_geomLoadTask->GetZoneShortName(),
+			GetGeometryLoadStageName(progress.GetStage()));
+		m_progress = progress.GetFraction();
+		return;
 	}
 
-	if (!ptr->loadGeometry(std::move(geomLoader), m_rcContext.get()))
+	m_activityMessage.clear();
+	m_progress = 0.0f;
+
+	std::unique_ptr<GeometryLoadTask> task = std::move(m_geomLoadTask);
+	if (task->IsCancelled())
+		return;
+
+	SetGeometry(task->GetZoneShortName(), task->TakeGeometry(), m_loadMeshOnGeometry);
+}
+
+void Application::SetGeometry(const std::string& zoneShortName, std::unique_ptr<InputGeom> ptr, bool loadMesh)
+{
+	std::unique_lock<std::mutex> lock(m_renderMutex);
+
+	Halt();
+
+	if (!ptr)
 	{
 		m_showFailedToLoadZone = true;
 
@@ -29,6 +29,7 @@
 #include <chrono>
 
 class RecastContext;
+class GeometryLoadTask;
 class InputGeom;
 class NavMeshTool;
 class ZonePicker;
@@ -135,8 +136,14 @@ private:
 
 	void DispatchCallbacks();
 
-	// Load a zone's geometry given its shortname.
+	// Start loading a zone's geometry given its shortname. The geometry is loaded
+	// in the background and replaces the current zone once it is ready.
 	void LoadGeometry(const std::string& zoneShortName, bool loadMesh);
+
+	// Show the progress of the geometry load and switch to the new geometry
+	// when it is done.
+	void UpdateGeometryLoad();
+	void SetGeometry(const std::string& zoneShortName, std::unique_ptr<InputGeom> geom, bool loadMesh);
 	void Halt();
 
 	// Reset the camera to the starting point
@@ -184,6 +191,10 @@ private:
 	// The input geometry (??)
 	std::unique_ptr<InputGeom> m_geom;
 
+	// Geometry being loaded in the background, if any
+	std::unique_ptr<GeometryLoadTask> m_geomLoadTask;
+	bool m_loadMeshOnGeometry = false;
+
 	// rendering properties
 	bool m_resetCamera;
 	int m_width, m_height;
@@ -0,0 +1,485 @@
+//
+// BuildBenchmark.cpp
+//
+
+#include "meshgen/BuildBenchmark.h"
+#include "meshgen/Application.h"
+#include "meshgen/EQConfig.h"
+#include "meshgen/GeometryLoadTask.h"
+#include "meshgen/InputGeom.h"
+#include "meshgen/NavMeshTool.h"
+#include "meshgen/ShardedBuild.h"
+#include "common/NavMesh.h"
+#include "common/NavMeshData.h"
+
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <fmt/format.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include <windows.h>
+#include <psapi.h>
+
+namespace fs = std::filesystem;
+
+//============================================================================
+
+// Highest working set of the process while it is in scope. The peak counter of
+// the process only ever goes up, so it can't tell builds apart.
+class PeakMemorySampler
+{
+public:
+	PeakMemorySampler()
+	{
+		m_peak = GetWorkingSetSize();
+
+		m_thread = std::thread([this]()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (!m_stop)
+				{
+					m_peak = std::max(m_peak, GetWorkingSetSize());
+					m_stopped.wait_for(lock, std::chrono::milliseconds(50));
+				}
+			});
+	}
+
+	~PeakMemorySampler()
+	{
+		Stop();
+	}
+
+	// Stop sampling and return the peak, in bytes.
+	size_t Stop()
+	{
+		if (m_thread.joinable())
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+
+			m_stopped.notify_all();
+			m_thread.join();
+		}
+
+		return m_peak;
+	}
+
+private:
+	static size_t GetWorkingSetSize()
+	{
+		PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+
+		return counters.WorkingSetSize;
+	}
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_stopped;
+	bool m_stop = false;
+	size_t m_peak = 0;
+};
+
+//----------------------------------------------------------------------------
+
+struct PathQuery
+{
+	glm::vec3 start;
+	glm::vec3 end;
+};
+
+// End points for the path queries of a zone, on triangles of its geometry picked
+// with a fixed seed, so that every build of the zone is queried the same way.
+// Zones without a triangle mesh (terrain only) get points over their bounds.
+static std::vector<PathQuery> GeneratePathQueries(const InputGeom& geom, int count)
+{
+	const MapGeometryLoader* loader = geom.getMeshLoader();
+	const glm::vec3& bmin = geom.getMeshBoundsMin();
+	const glm::vec3& bmax = geom.getMeshBoundsMax();
+
+	std::mt19937 random(12345);
+
+	auto randomPoint = [&]() -> glm::vec3
+	{
+		if (loader->getTriCount() > 0)
+		{
+			const int tri = std::uniform_int_distribution<int>(0, loader->getTriCount() - 1)(random);
+			const int* indices = &loader->getTris()[tri * 3];
+
+			glm::vec3 center(0.0f);
+			for (int i = 0; i < 3; ++i)
+				center += glm::make_vec3(&loader->getVerts()[indices[i] * 3]);
+
+			return center / 3.0f;
+		}
+
+		std::uniform_real_distribution<float> x(bmin.x, bmax.x);
+		std::uniform_real_distribution<float> z(bmin.z, bmax.z);
+		return glm::vec3(x(random), (bmin.y + bmax.y) * 0.5f, z(random));
+	};
+
+	std::vector<PathQuery> queries(count);
+	for (PathQuery& query : queries)
+	{
+		query.start = randomPoint();
+		query.end = randomPoint();
+	}
+
+	return queries;
+}
+
+struct BenchmarkResult
+{
+	float tileSize = 0;
+	float cellSize = 0;
+	bool built = false;
+
+	double buildSeconds = 0;
+	size_t peakMemory = 0;
+	uintmax_t fileSize = 0;
+	int tileCount = 0;
+
+	// Paths found out of the queries, and the time the ones found took.
+	int pathsFound = 0;
+	double queryMedianUs = 0;
+	double queryP95Us = 0;
+
+	std::string filename;
+};
+
+static void RunPathQueries(NavMesh& navMesh, const std::vector<PathQuery>& queries, float extentsY,
+	BenchmarkResult& result)
+{
+	std::shared_ptr<dtNavMeshQuery> query = navMesh.GetNavMeshQuery();
+	if (!query)
+		return;
+
+	dtQueryFilter filter;
+	filter.setIncludeFlags(+PolyFlags::All);
+	filter.setExcludeFlags(+PolyFlags::Disabled);
+	navMesh.FillFilterAreaCosts(filter);
+
+	const glm::vec3 extents(2.0f, extentsY, 2.0f);
+	constexpr int MaxPolys = 256;
+	dtPolyRef path[MaxPolys];
+
+	std::vector<double> times;
+	times.reserve(queries.size());
+
+	for (const PathQuery& pathQuery : queries)
+	{
+		dtPolyRef startRef = 0, endRef = 0;
+		glm::vec3 start, end;
+		query->findNearestPoly(glm::value_ptr(pathQuery.start), glm::value_ptr(extents), &filter,
+			&startRef, glm::value_ptr(start));
+		query->findNearestPoly(glm::value_ptr(pathQuery.end), glm::value_ptr(extents), &filter,
+			&endRef, glm::value_ptr(end));
+
+		if (!startRef || !endRef)
+			continue;
+
+		int pathCount = 0;
+		const auto startTime = std::chrono::steady_clock::now();
+		const dtStatus status = query->findPath(startRef, endRef, glm::value_ptr(start), glm::value_ptr(end),
+			&filter, path, &pathCount, MaxPolys);
+		const auto endTime = std::chrono::steady_clock::now();
+
+		// Partial paths end somewhere else, they don't count as found.
+		if (dtStatusSucceed(status) && !dtStatusDetail(status, DT_PARTIAL_RESULT) && pathCount > 0)
+		{
+			++result.pathsFound;
+			times.push_back(std::chrono::duration<double, std::micro>(endTime - startTime).count());
+		}
+	}
+
+	if (times.empty())
+		return;
+
+	std::sort(times.begin(), times.end());
+	result.queryMedianUs = times[times.size() / 2];
+	result.queryP95Us = times[std::min(times.size() - 1, times.size() * 95 / 100)];
+}
+
+static int CountTiles(const dtNavMesh& navMesh)
+{
+	int count = 0;
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (tile && tile->header)
+			++count;
+	}
+
+	return count;
+}
+
+// Pick the settings with the lowest cost, counting build time, file size and
+// query time equally, each relative to the best result. Only builds that find
+// about as many paths as the best one qualify, and only at cell sizes up to the
+// zone's own, so a recommendation never gives up detail for speed.
+static const BenchmarkResult* RecommendSettings(const std::vector<BenchmarkResult>& results, float currentCellSize)
+{
+	int mostPaths = 0;
+	for (const BenchmarkResult& result : results)
+		mostPaths = std::max(mostPaths, result.pathsFound);
+
+	auto qualifies = [&](const BenchmarkResult& result)
+	{
+		return result.built
+			&& result.cellSize <= currentCellSize + 0.001f
+			&& result.pathsFound >= mostPaths * 0.98;
+	};
+
+	double bestBuild = DBL_MAX, bestSize = DBL_MAX, bestQuery = DBL_MAX;
+	for (const BenchmarkResult& result : results)
+	{
+		if (!qualifies(result))
+			continue;
+
+		bestBuild = std::min(bestBuild, std::max(result.buildSeconds, 0.001));
+		bestSize = std::min(bestSize, std::max(static_cast<double>(result.fileSize), 1.0));
+		bestQuery = std::min(bestQuery, std::max(result.queryP95Us, 0.001));
+	}
+
+	const BenchmarkResult* recommended = nullptr;
+	double lowestCost = DBL_MAX;
+
+	for (const BenchmarkResult& result : results)
+	{
+		if (!qualifies(result))
+			continue;
+
+		const double cost = std::max(result.buildSeconds, 0.001) / bestBuild
+			+ std::max(static_cast<double>(result.fileSize), 1.0) / bestSize
+			+ std::max(result.queryP95Us, 0.001) / bestQuery;
+
+		if (cost < lowestCost)
+		{
+			lowestCost = cost;
+			recommended = &result;
+		}
+	}
+
+	return recommended;
+}
+
+//----------------------------------------------------------------------------
+
+// Replace a zone's navmesh with another file, keeping the previous one as .bak. The
+// navmesh is only moved once the new file is in place next to it, and moved back
+// if it can't be replaced, so a failure never leaves the zone without one.
+static bool ReplaceNavMeshFile(const std::string& source, const std::string& navMeshFile)
+{
+	const std::string tempFile = navMeshFile + ".tmp";
+	const std::string backupFile = navMeshFile + ".bak";
+	std::error_code ec;
+
+	fs::copy_file(source, tempFile, fs::copy_options::overwrite_existing, ec);
+	if (ec)
+	{
+		SPDLOG_ERROR("Failed to copy {} to {}: {}", source, tempFile, ec.message());
+		fs::remove(tempFile, ec);
+		return false;
+	}
+
+	const bool hadNavMesh = fs::exists(navMeshFile, ec);
+	if (hadNavMesh)
+	{
+		fs::rename(navMeshFile, backupFile, ec);
+		if (ec)
+		{
+			SPDLOG_ERROR("Failed to back up {}: {}", navMeshFile, ec.message());
+			fs::remove(tempFile, ec);
+			return false;
+		}
+	}
+
+	fs::rename(tempFile, navMeshFile, ec);
+	if (ec)
+	{
+		SPDLOG_ERROR("Failed to replace {}: {}", navMeshFile, ec.message());
+
+		if (hadNavMesh)
+		{
+			fs::rename(backupFile, navMeshFile, ec);
+			if (ec)
+				SPDLOG_ERROR("Failed to restore {} from {}: {}", navMeshFile, backupFile, ec.message());
+		}
+
+		fs::remove(tempFile, ec);
+		return false;
+	}
+
+	return true;
+}
+
+static bool BenchmarkZone(const BuildBenchmarkOptions& options, const EQConfig& eqConfig, RecastContext& context,
+	const std::string& zoneShortName, const fs::path& benchmarkPath, std::string& summary)
+{
+	std::unique_ptr<InputGeom> geom = LoadZoneGeometry(eqConfig, zoneShortName, &context);
+	if (!geom)
+	{
+		SPDLOG_ERROR("Failed to load {}", zoneShortName);
+		return false;
+	}
+
+	auto navMesh = std::make_shared<NavMesh>(eqConfig.GetOutputPath(), zoneShortName);
+
+	NavMeshTool tool(navMesh);
+	tool.setContext(&context);
+	tool.setOutputPath(eqConfig.GetOutputPath().c_str());
+	tool.setUseCaches(false);
+	tool.handleGeometryChanged(geom.get());
+
+	// Build with the zone's own settings, volumes and connections if it has any.
+	const std::string navMeshFile = navMesh->GetFullFilePath();
+	std::error_code ec;
+	if (fs::exists(navMeshFile, ec) && navMesh->LoadNavMeshFile() != NavMesh::LoadResult::Success)
+	{
+		SPDLOG_ERROR("Failed to load the settings of {} from {}", zoneShortName, navMeshFile);
+		return false;
+	}
+
+	const NavMeshConfig baseConfig = tool.getConfig();
+
+	const std::vector<PathQuery> queries = GeneratePathQueries(*geom, options.pathQueries);
+	const float queryExtentsY = std::max(baseConfig.agentHeight * 2.0f, 10.0f);
+
+	std::vector<BenchmarkResult> results;
+
+	for (float tileSize : options.tileSizes)
+	{
+		for (float cellSize : options.cellSizes)
+		{
+			BenchmarkResult& result = results.emplace_back();
+			result.tileSize = tileSize;
+			result.cellSize = cellSize;
+			result.filename = (benchmarkPath / fmt::format("{}.{}-{}.navmesh", zoneShortName, tileSize, cellSize)).string();
+
+			NavMeshConfig config = baseConfig;
+			config.tileSize = tileSize;
+			config.cellSize = cellSize;
+			tool.setConfig(config);
+
+			SPDLOG_INFO("Building {} with tile size {} and cell size {}", zoneShortName, tileSize, cellSize);
+
+			PeakMemorySampler memorySampler;
+			const auto startTime = std::chrono::steady_clock::now();
+
+			result.built = tool.StreamAllTiles(result.filename, false);
+
+			result.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+			result.peakMemory = memorySampler.Stop();
+
+			if (!result.built)
+			{
+				SPDLOG_ERROR("Failed to build {} with tile size {} and cell size {}", zoneShortName, tileSize, cellSize);
+				continue;
+			}
+
+			result.fileSize = fs::file_size(result.filename, ec);
+
+			NavMesh built(eqConfig.GetOutputPath(), zoneShortName);
+			if (built.LoadNavMeshFile(result.filename) == NavMesh::LoadResult::Success && built.GetNavMesh())
+			{
+				result.tileCount = CountTiles(*built.GetNavMesh());
+				RunPathQueries(built, queries, queryExtentsY, result);
+			}
+		}
+	}
+
+	// Leave the zone with its own settings.
+	tool.setConfig(baseConfig);
+
+	const BenchmarkResult* recommended = RecommendSettings(results, baseConfig.cellSize);
+
+	fmt::memory_buffer out;
+	fmt::format_to(std::back_inserter(out),
+		"tile_size,cell_size,built,build_s,peak_mb,file_kb,tiles,paths_found,paths,query_median_us,query_p95_us,recommended\n");
+
+	for (const BenchmarkResult& result : results)
+	{
+		fmt::format_to(std::back_inserter(out), "{},{},{},{:.2f},{:.1f},{:.1f},{},{},{},{:.1f},{:.1f},{}\n",
+			result.tileSize, result.cellSize, result.built ? 1 : 0, result.buildSeconds,
+			result.peakMemory / (1024.0 * 1024.0), result.fileSize / 1024.0, result.tileCount,
+			result.pathsFound, queries.size(), result.queryMedianUs, result.queryP95Us,
+			&result == recommended ? 1 : 0);
+
+		SPDLOG_INFO("{} {:>5} {:>4}: {:8.2f} s {:8.1f} MB {:10.1f} KB {:6} tiles {:4}/{} paths {:8.1f} us p50 {:8.1f} us p95{}",
+			zoneShortName, result.tileSize, result.cellSize, result.buildSeconds,
+			result.peakMemory / (1024.0 * 1024.0), result.fileSize / 1024.0, result.tileCount,
+			result.pathsFound, queries.size(), result.queryMedianUs, result.queryP95Us,
+			&result == recommended ? " *" : "");
+	}
+
+	std::ofstream csv(benchmarkPath / (zoneShortName + ".csv"), std::ios::trunc);
+	csv.write(out.data(), out.size());
+
+	if (recommended)
+	{
+		summary += fmt::format("{:<20} tile size {:>5} cell size {:>4} (was {} and {})\n", zoneShortName,
+			recommended->tileSize, recommended->cellSize, baseConfig.tileSize, baseConfig.cellSize);
+	}
+	else
+	{
+		summary += fmt::format("{:<20} no recommendation\n", zoneShortName);
+	}
+
+	// The recommended build has the zone's volumes and connections and can replace
+	// its navmesh as is.
+	bool applied = true;
+	if (options.apply && recommended)
+	{
+		applied = ReplaceNavMeshFile(recommended->filename, navMeshFile);
+		if (applied)
+			SPDLOG_INFO("Replaced {} with the build at the recommended settings", navMeshFile);
+	}
+
+	for (const BenchmarkResult& result : results)
+		fs::remove(result.filename, ec);
+
+	return applied;
+}
+
+int RunBuildBenchmark(const BuildBenchmarkOptions& options)
+{
+	InitializeHeadlessLogging("benchmark");
+
+	EQConfig eqConfig;
+	RecastContext context;
+
+	const fs::path benchmarkPath = fs::path(eqConfig.GetOutputPath()) / "benchmarks";
+	std::error_code ec;
+	fs::create_directories(benchmarkPath, ec);
+
+	std::string summary;
+	int failedZones = 0;
+
+	for (const std::string& zone : options.zones)
+	{
+		if (!BenchmarkZone(options, eqConfig, context, zone, benchmarkPath, summary))
+			++failedZones;
+	}
+
+	std::ofstream summaryFile(benchmarkPath / "summary.txt", std::ios::trunc);
+	summaryFile << summary;
+
+	SPDLOG_INFO("Benchmark finished, {} of {} zones failed. Recommended settings:\n{}", failedZones,
+		options.zones.size(), summary);
+	spdlog::shutdown();
+	return failedZones;
+}
@@ -0,0 +1,39 @@
+//
+// BuildBenchmark.h
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Builds zones at a grid of tile and cell sizes to find the settings that suit
+// each zone best. Small dungeons and large outdoor zones trade build time, file
+// size and path query speed very differently, so one set of defaults does not
+// fit them all.
+//
+// Each zone is built with its own settings, volumes and connections when it has
+// a navmesh, only the tile and cell size are changed. Results go to
+// <output>/benchmarks/<zone>.csv, with the recommended settings of every zone in
+// <output>/benchmarks/summary.txt.
+struct BuildBenchmarkOptions
+{
+	std::vector<std::string> zones;
+
+	// Tile sizes in cells and cell sizes in world units, every combination is built.
+	// Only cell sizes up to the zone's own are recommended, so the defaults stop at
+	// the default cell size.
+	std::vector<float> tileSizes = { 64, 128, 256 };
+	std::vector<float> cellSizes = { 0.4f, 0.6f };
+
+	// Number of paths found on each build. The end points are the same for every
+	// build of a zone.
+	int pathQueries = 500;
+
+	// Replace the navmesh of each zone with its build at the recommended settings,
+	// keeping the previous one as .navmesh.bak.
+	bool apply = false;
+};
+
+// Returns the number of zones that could not be benchmarked.
+int RunBuildBenchmark(const BuildBenchmarkOptions& options);
@@ -0,0 +1,248 @@
+//
+// BuildTrace.cpp
+//
+
+#include "meshgen/BuildTrace.h"
+
+#include <fmt/format.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+namespace fs = std::filesystem;
+
+//============================================================================
+
+const char* GetBuildStageName(BuildStage stage)
+{
+	switch (stage)
+	{
+	case BuildStage::Rasterize: return "Rasterize";
+	case BuildStage::Filter: return "Filter";
+	case BuildStage::Compact: return "Compact";
+	case BuildStage::Erode: return "Erode";
+	case BuildStage::MarkAreas: return "MarkAreas";
+	case BuildStage::Regions: return "Regions";
+	case BuildStage::Contours: return "Contours";
+	case BuildStage::PolyMesh: return "PolyMesh";
+	case BuildStage::DetailMesh: return "DetailMesh";
+	case BuildStage::CreateNavData: return "CreateNavData";
+	default: break;
+	}
+
+	return "Unknown";
+}
+
+//----------------------------------------------------------------------------
+
+void BuildTrace::Reset()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_records.clear();
+	m_startTime = TileBuildRecord::clock::now();
+}
+
+void BuildTrace::Add(const TileBuildRecord& record)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_records.push_back(record);
+}
+
+std::vector<TileBuildRecord> BuildTrace::GetRecords() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_records;
+}
+
+size_t BuildTrace::GetRecordCount() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_records.size();
+}
+
+static bool WriteTraceFile(const std::string& filename, const char* data, size_t length)
+{
+	std::error_code ec;
+	fs::create_directories(fs::path(filename).parent_path(), ec);
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		SPDLOG_ERROR("Failed to open {} for writing", filename);
+		return false;
+	}
+
+	file.write(data, length);
+	if (!file.good())
+	{
+		SPDLOG_ERROR("Failed to write {}", filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool BuildTrace::ExportChromeTrace(const std::string& filename, const std::string& processName) const
+{
+	TileBuildRecord::clock::time_point startTime;
+	std::vector<TileBuildRecord> records;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		startTime = m_startTime;
+		records = m_records;
+	}
+
+	std::sort(records.begin(), records.end(),
+		[](const TileBuildRecord& a, const TileBuildRecord& b) { return a.start < b.start; });
+
+	// Trace event timestamps are in microseconds.
+	auto toMicroseconds = [startTime](TileBuildRecord::clock::time_point time)
+	{
+		return std::chrono::duration<double, std::micro>(time - startTime).count();
+	};
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.Key("displayTimeUnit");
+	writer.String("ms");
+	writer.Key("traceEvents");
+	writer.StartArray();
+
+	// Name the process and the worker rows.
+	writer.StartObject();
+	writer.Key("name"); writer.String("process_name");
+	writer.Key("ph"); writer.String("M");
+	writer.Key("pid"); writer.Int(1);
+	writer.Key("args");
+	writer.StartObject();
+	writer.Key("name"); writer.String(processName.c_str());
+	writer.EndObject();
+	writer.EndObject();
+
+	std::set<int> workers;
+	for (const TileBuildRecord& record : records)
+		workers.insert(record.worker);
+
+	for (int worker : workers)
+	{
+		const std::string name = fmt::format("Worker {}", worker);
+
+		writer.StartObject();
+		writer.Key("name"); writer.String("thread_name");
+		writer.Key("ph"); writer.String("M");
+		writer.Key("pid"); writer.Int(1);
+		writer.Key("tid"); writer.Int(worker);
+		writer.Key("args");
+		writer.StartObject();
+		writer.Key("name"); writer.String(name.c_str());
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	for (const TileBuildRecord& record : records)
+	{
+		const std::string name = fmt::format("Tile {},{}", record.x, record.y);
+
+		writer.StartObject();
+		writer.Key("name"); writer.String(name.c_str());
+		writer.Key("cat"); writer.String("tile");
+		writer.Key("ph"); writer.String("X");
+		writer.Key("pid"); writer.Int(1);
+		writer.Key("tid"); writer.Int(record.worker);
+		writer.Key("ts"); writer.Double(toMicroseconds(record.start));
+		writer.Key("dur"); writer.Double(std::chrono::duration<double, std::micro>(record.end - record.start).count());
+		writer.Key("args");
+		writer.StartObject();
+		writer.Key("x"); writer.Int(record.x);
+		writer.Key("y"); writer.Int(record.y);
+		writer.Key("triangles"); writer.Int(record.inputTriangles);
+		writer.Key("spans"); writer.Int(record.spanCount);
+		writer.Key("polys"); writer.Int(record.polyCount);
+		writer.Key("bytes"); writer.Int(record.dataSize);
+		writer.Key("tileCache"); writer.Bool(record.fromTileCache);
+		writer.Key("heightfieldCache"); writer.Bool(record.fromHeightfieldCache);
+		writer.EndObject();
+		writer.EndObject();
+
+		for (size_t stage = 0; stage < static_cast<size_t>(BuildStage::Count); ++stage)
+		{
+			if (!record.HasStage(static_cast<BuildStage>(stage)))
+				continue;
+
+			writer.StartObject();
+			writer.Key("name"); writer.String(GetBuildStageName(static_cast<BuildStage>(stage)));
+			writer.Key("cat"); writer.String("stage");
+			writer.Key("ph"); writer.String("X");
+			writer.Key("pid"); writer.Int(1);
+			writer.Key("tid"); writer.Int(record.worker);
+			writer.Key("ts"); writer.Double(toMicroseconds(record.stageStart[stage]));
+			writer.Key("dur"); writer.Double(std::chrono::duration<double, std::micro>(
+				record.stageEnd[stage] - record.stageStart[stage]).count());
+			writer.EndObject();
+		}
+	}
+
+	writer.EndArray();
+	writer.EndObject();
+
+	return WriteTraceFile(filename, buffer.GetString(), buffer.GetSize());
+}
+
+bool BuildTrace::ExportCsv(const std::string& filename) const
+{
+	TileBuildRecord::clock::time_point startTime;
+	std::vector<TileBuildRecord> records;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		startTime = m_startTime;
+		records = m_records;
+	}
+
+	std::sort(records.begin(), records.end(),
+		[](const TileBuildRecord& a, const TileBuildRecord& b) { return a.start < b.start; });
+
+	auto toMilliseconds = [](TileBuildRecord::clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	};
+
+	fmt::memory_buffer out;
+	fmt::format_to(std::back_inserter(out), "x,y,worker,start_ms,total_ms");
+	for (size_t stage = 0; stage < static_cast<size_t>(BuildStage::Count); ++stage)
+		fmt::format_to(std::back_inserter(out), ",{}_ms", GetBuildStageName(static_cast<BuildStage>(stage)));
+	fmt::format_to(std::back_inserter(out), ",triangles,spans,polys,bytes,tile_cache,heightfield_cache\n");
+
+	for (const TileBuildRecord& record : records)
+	{
+		fmt::format_to(std::back_inserter(out), "{},{},{},{:.3f},{:.3f}", record.x, record.y, record.worker,
+			toMilliseconds(record.start - startTime), toMilliseconds(record.end - record.start));
+
+		for (size_t stage = 0; stage < static_cast<size_t>(BuildStage::Count); ++stage)
+		{
+			const double duration = record.HasStage(static_cast<BuildStage>(stage))
+				? toMilliseconds(record.stageEnd[stage] - record.stageStart[stage]) : 0.0;
+			fmt::format_to(std::back_inserter(out), ",{:.3f}", duration);
+		}
+
+		fmt::format_to(std::back_inserter(out), ",{},{},{},{},{},{}\n", record.inputTriangles, record.spanCount,
+			record.polyCount, record.dataSize, record.fromTileCache ? 1 : 0, record.fromHeightfieldCache ? 1 : 0);
+	}
+
+	return WriteTraceFile(filename, out.data(), out.size());
+}
+
+bool BuildTrace::Export(const std::string& basePath, const std::string& processName) const
+{
+	const bool json = ExportChromeTrace(basePath + ".json", processName);
+	const bool csv = ExportCsv(basePath + ".csv");
+
+	return json && csv;
+}
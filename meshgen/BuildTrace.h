@@ -0,0 +1,135 @@
+//
+// BuildTrace.h
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Stages of the recast pipeline, in the order they run for a tile.
+enum class BuildStage : uint8_t
+{
+	Rasterize,           // heightfield creation, terrain and triangle rasterization
+	Filter,              // walkable span filters
+	Compact,             // compact heightfield
+	Erode,               // erode by agent radius
+	MarkAreas,           // convex volumes
+	Regions,             // distance field and region partitioning
+	Contours,
+	PolyMesh,
+	DetailMesh,
+	CreateNavData,       // detour tile data
+
+	Count
+};
+
+const char* GetBuildStageName(BuildStage stage);
+
+// What happened during the build of one tile. Stages that did not run, because
+// the tile came from a cache or had nothing walkable, keep default times. With
+// extra agent profiles, the stages and counts are those of the main profile while
+// start and end cover all profiles.
+struct TileBuildRecord
+{
+	using clock = std::chrono::steady_clock;
+
+	int x = 0;
+	int y = 0;
+
+	// Index of the build worker that built the tile.
+	int worker = 0;
+
+	clock::time_point start;
+	clock::time_point end;
+	clock::time_point stageStart[static_cast<size_t>(BuildStage::Count)] = {};
+	clock::time_point stageEnd[static_cast<size_t>(BuildStage::Count)] = {};
+
+	// Triangles rasterized, including placed models.
+	int inputTriangles = 0;
+
+	// Spans of the compact heightfield.
+	int spanCount = 0;
+
+	int polyCount = 0;
+
+	// Size of the detour tile data, 0 for empty tiles.
+	int dataSize = 0;
+
+	bool fromTileCache = false;
+	bool fromHeightfieldCache = false;
+
+	bool HasStage(BuildStage stage) const
+	{
+		return stageEnd[static_cast<size_t>(stage)] != clock::time_point{};
+	}
+};
+
+// Times a stage of a tile build for as long as it is in scope. Does nothing
+// without a record.
+class ScopedBuildStage
+{
+public:
+	ScopedBuildStage(TileBuildRecord* record, BuildStage stage)
+		: m_record(record)
+		, m_stage(static_cast<size_t>(stage))
+	{
+		if (m_record)
+			m_record->stageStart[m_stage] = TileBuildRecord::clock::now();
+	}
+
+	~ScopedBuildStage()
+	{
+		if (m_record)
+			m_record->stageEnd[m_stage] = TileBuildRecord::clock::now();
+	}
+
+	ScopedBuildStage(const ScopedBuildStage&) = delete;
+	ScopedBuildStage& operator=(const ScopedBuildStage&) = delete;
+
+private:
+	TileBuildRecord* m_record;
+	size_t m_stage;
+};
+
+// Collects the records of every tile of a build, for finding out which tiles
+// and stages dominate a build and how busy the workers were. Exports to the
+// Chrome trace event format (load it in chrome://tracing or Perfetto) and to CSV.
+//
+// Add is thread safe.
+
+class BuildTrace
+{
+public:
+	BuildTrace() = default;
+
+	BuildTrace(const BuildTrace&) = delete;
+	BuildTrace& operator=(const BuildTrace&) = delete;
+
+	// Drop all records and start timing from now.
+	void Reset();
+
+	void Add(const TileBuildRecord& record);
+
+	std::vector<TileBuildRecord> GetRecords() const;
+	size_t GetRecordCount() const;
+
+	// Trace events with one row per worker, a slice per tile and nested slices
+	// for its stages. processName labels the trace, so that traces of several
+	// processes can be told apart.
+	bool ExportChromeTrace(const std::string& filename, const std::string& processName) const;
+
+	// One row per tile, with the duration of each stage in milliseconds.
+	bool ExportCsv(const std::string& filename) const;
+
+	// Export both, to basePath + ".json" and basePath + ".csv".
+	bool Export(const std::string& basePath, const std::string& processName) const;
+
+private:
+	mutable std::mutex m_mutex;
+	TileBuildRecord::clock::time_point m_startTime = TileBuildRecord::clock::now();
+	std::vector<TileBuildRecord> m_records;
+};
@@ -0,0 +1,341 @@
+//
+// GeometryCache.cpp
+//
+
+#include "meshgen/GeometryCache.h"
+#include "meshgen/InstancedGeometry.h"
+#include "meshgen/MapGeometryLoader.h"
+#include "meshgen/TerrainHeightfield.h"
+#include "meshgen/TriMeshBVH.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+static const uint32_t GEOMETRY_CACHE_MAGIC = 'MGEO';
+
+struct GeometryCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+
+	int32_t vertCount;
+	int32_t triCount;
+	int32_t nodeCount;
+	int32_t bvhTriCount;
+	int32_t maxTrisPerLeaf;
+	int32_t dynamicObjects;
+	int32_t hasDynamicObjects;
+	int32_t nodeSize;
+
+	int32_t modelCount;
+	int32_t modelVertCount;
+	int32_t modelTriCount;
+	int32_t instanceCount;
+	int32_t modelSize;
+	int32_t instanceSize;
+
+	int32_t terrainQuadsX;
+	int32_t terrainQuadsZ;
+	float terrainOrigin[2];
+	float terrainUnitsPerVertex;
+	int32_t padding;
+
+	// offsets of each section from the start of the file
+	uint64_t vertsOffset;
+	uint64_t trisOffset;
+	uint64_t normalsOffset;
+	uint64_t nodesOffset;
+	uint64_t bvhTrisOffset;
+	uint64_t modelsOffset;
+	uint64_t modelVertsOffset;
+	uint64_t modelTrisOffset;
+	uint64_t instancesOffset;
+	uint64_t terrainHeightsOffset;
+	uint64_t terrainFlagsOffset;
+	uint64_t totalSize;
+};
+
+// sections are aligned so the mapped arrays can be used directly
+static const uint64_t SECTION_ALIGNMENT = 16;
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+// True if a section of count elements at offset lies within the file and is
+// aligned. Corrupt counts and offsets are rejected without overflowing.
+static bool IsValidSection(uint64_t offset, int64_t count, uint64_t elementSize, uint64_t fileSize)
+{
+	if (count < 0 || offset % SECTION_ALIGNMENT != 0 || offset > fileSize)
+		return false;
+
+	return static_cast<uint64_t>(count) <= (fileSize - offset) / elementSize;
+}
+
+static bool IsValidHeader(const GeometryCacheHeader& header, uint64_t fileSize)
+{
+	if (header.terrainQuadsX < 0 || header.terrainQuadsZ < 0)
+		return false;
+
+	const bool hasTerrain = header.terrainQuadsX > 0 && header.terrainQuadsZ > 0;
+	const int64_t terrainHeights = hasTerrain
+		? (int64_t{ header.terrainQuadsX } + 1) * (int64_t{ header.terrainQuadsZ } + 1) : 0;
+	const int64_t terrainQuads = int64_t{ header.terrainQuadsX } * header.terrainQuadsZ;
+
+	return IsValidSection(header.vertsOffset, int64_t{ header.vertCount } * 3, sizeof(float), fileSize)
+		&& IsValidSection(header.trisOffset, int64_t{ header.triCount } * 3, sizeof(int), fileSize)
+		&& IsValidSection(header.nodesOffset, header.nodeCount, sizeof(TriMeshBVHNode), fileSize)
+		&& IsValidSection(header.bvhTrisOffset, int64_t{ header.bvhTriCount } * 3, sizeof(int), fileSize)
+		&& IsValidSection(header.normalsOffset, int64_t{ header.bvhTriCount } * 3, sizeof(float), fileSize)
+		&& IsValidSection(header.modelsOffset, header.modelCount, sizeof(InstancedModel), fileSize)
+		&& IsValidSection(header.modelVertsOffset, int64_t{ header.modelVertCount } * 3, sizeof(float), fileSize)
+		&& IsValidSection(header.modelTrisOffset, int64_t{ header.modelTriCount } * 3, sizeof(int), fileSize)
+		&& IsValidSection(header.instancesOffset, header.instanceCount, sizeof(ModelInstance), fileSize)
+		&& IsValidSection(header.terrainHeightsOffset, terrainHeights, sizeof(float), fileSize)
+		&& IsValidSection(header.terrainFlagsOffset, terrainQuads, sizeof(uint8_t), fileSize);
+}
+
+// The models and instances index into other sections, check that they stay within
+// them. Triangles are not checked, that would read the whole file.
+static bool IsValidInstances(const GeometryCacheHeader& header, const uint8_t* data)
+{
+	const InstancedModel* models = reinterpret_cast<const InstancedModel*>(data + header.modelsOffset);
+	for (int i = 0; i < header.modelCount; ++i)
+	{
+		const InstancedModel& model = models[i];
+		if (uint64_t{ model.firstVert } + model.vertCount > static_cast<uint64_t>(header.modelVertCount)
+			|| uint64_t{ model.firstTri } + model.triCount > static_cast<uint64_t>(header.modelTriCount))
+		{
+			return false;
+		}
+	}
+
+	const ModelInstance* instances = reinterpret_cast<const ModelInstance*>(data + header.instancesOffset);
+	for (int i = 0; i < header.instanceCount; ++i)
+	{
+		if (instances[i].model >= static_cast<uint32_t>(header.modelCount))
+			return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+GeometryCache::GeometryCache()
+{
+}
+
+GeometryCache::~GeometryCache()
+{
+	Close();
+}
+
+bool GeometryCache::Open(const std::string& filename, uint64_t sourceHash)
+{
+	Close();
+
+	if (!m_file.Open(filename) || m_file.GetSize() < sizeof(GeometryCacheHeader))
+	{
+		Close();
+		return false;
+	}
+	m_data = m_file.GetData();
+
+	const GeometryCacheHeader* header = reinterpret_cast<const GeometryCacheHeader*>(m_data);
+	if (header->magic != GEOMETRY_CACHE_MAGIC
+		|| header->version != GEOMETRY_CACHE_VERSION
+		|| header->sourceHash != sourceHash
+		|| header->nodeSize != sizeof(TriMeshBVHNode)
+		|| header->modelSize != sizeof(InstancedModel)
+		|| header->instanceSize != sizeof(ModelInstance)
+		|| header->totalSize != m_file.GetSize()
+		|| !IsValidHeader(*header, header->totalSize)
+		|| !IsValidInstances(*header, m_data))
+	{
+		// A truncated or corrupt file is rebuilt by the caller.
+		Close();
+		return false;
+	}
+
+	m_vertCount = header->vertCount;
+	m_triCount = header->triCount;
+	m_nodeCount = header->nodeCount;
+	m_bvhTriCount = header->bvhTriCount;
+	m_maxTrisPerLeaf = header->maxTrisPerLeaf;
+	m_modelCount = header->modelCount;
+	m_modelVertCount = header->modelVertCount;
+	m_modelTriCount = header->modelTriCount;
+	m_instanceCount = header->instanceCount;
+	m_terrainQuadsX = header->terrainQuadsX;
+	m_terrainQuadsZ = header->terrainQuadsZ;
+	m_terrainOrigin[0] = header->terrainOrigin[0];
+	m_terrainOrigin[1] = header->terrainOrigin[1];
+	m_terrainUnitsPerVertex = header->terrainUnitsPerVertex;
+	m_dynamicObjects = header->dynamicObjects;
+	m_hasDynamicObjects = header->hasDynamicObjects != 0;
+
+	m_verts = reinterpret_cast<const float*>(m_data + header->vertsOffset);
+	m_tris = reinterpret_cast<const int*>(m_data + header->trisOffset);
+	m_normals = reinterpret_cast<const float*>(m_data + header->normalsOffset);
+	m_nodes = m_data + header->nodesOffset;
+	m_bvhTris = reinterpret_cast<const int*>(m_data + header->bvhTrisOffset);
+	m_models = m_data + header->modelsOffset;
+	m_modelVerts = reinterpret_cast<const float*>(m_data + header->modelVertsOffset);
+	m_modelTris = reinterpret_cast<const int*>(m_data + header->modelTrisOffset);
+	m_instances = m_data + header->instancesOffset;
+	m_terrainHeights = reinterpret_cast<const float*>(m_data + header->terrainHeightsOffset);
+	m_terrainFlags = m_data + header->terrainFlagsOffset;
+
+	return true;
+}
+
+void GeometryCache::Close()
+{
+	m_file.Close();
+	m_data = nullptr;
+
+	m_verts = nullptr;
+	m_tris = nullptr;
+	m_normals = nullptr;
+	m_nodes = nullptr;
+	m_bvhTris = nullptr;
+	m_models = nullptr;
+	m_modelVerts = nullptr;
+	m_modelTris = nullptr;
+	m_instances = nullptr;
+	m_modelCount = m_modelVertCount = m_modelTriCount = m_instanceCount = 0;
+	m_terrainHeights = nullptr;
+	m_terrainFlags = nullptr;
+	m_terrainQuadsX = m_terrainQuadsZ = 0;
+	m_vertCount = m_triCount = m_nodeCount = m_bvhTriCount = m_maxTrisPerLeaf = 0;
+	m_dynamicObjects = 0;
+	m_hasDynamicObjects = false;
+}
+
+void GeometryCache::AttachBVH(TriMeshBVH& bvh) const
+{
+	bvh.Attach(static_cast<const TriMeshBVHNode*>(m_nodes), m_nodeCount,
+		m_bvhTris, m_normals, m_bvhTriCount, m_maxTrisPerLeaf);
+}
+
+void GeometryCache::AttachInstances(InstancedGeometry& instances) const
+{
+	instances.Attach(static_cast<const InstancedModel*>(m_models), m_modelCount,
+		m_modelVerts, m_modelVertCount, m_modelTris, m_modelTriCount,
+		static_cast<const ModelInstance*>(m_instances), m_instanceCount);
+}
+
+void GeometryCache::AttachTerrain(TerrainHeightfield& terrain) const
+{
+	terrain.Attach(m_terrainOrigin, m_terrainUnitsPerVertex, m_terrainQuadsX, m_terrainQuadsZ,
+		m_terrainHeights, m_terrainFlags);
+}
+
+bool GeometryCache::Write(const std::string& filename, uint64_t sourceHash,
+	const MapGeometryLoader& loader, const TriMeshBVH& bvh)
+{
+	GeometryCacheHeader header = {};
+	header.magic = GEOMETRY_CACHE_MAGIC;
+	header.version = GEOMETRY_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertCount = loader.getVertCount();
+	header.triCount = loader.getTriCount();
+	header.nodeCount = bvh.GetNodeCount();
+	header.bvhTriCount = bvh.GetTriCount();
+	header.maxTrisPerLeaf = bvh.GetMaxTrisPerLeaf();
+	header.dynamicObjects = loader.GetDynamicObjectsCount();
+	header.hasDynamicObjects = loader.HasDynamicObjects() ? 1 : 0;
+	header.nodeSize = sizeof(TriMeshBVHNode);
+
+	static const InstancedGeometry emptyInstances;
+	const InstancedGeometry& instances = loader.GetInstancedGeometry()
+		? *loader.GetInstancedGeometry() : emptyInstances;
+	header.modelCount = instances.GetModelCount();
+	header.modelVertCount = instances.GetModelVertCount();
+	header.modelTriCount = instances.GetModelTriCount();
+	header.instanceCount = instances.GetInstanceCount();
+	header.modelSize = sizeof(InstancedModel);
+	header.instanceSize = sizeof(ModelInstance);
+
+	const TerrainHeightfield* terrain = loader.GetTerrainHeightfield();
+	uint64_t terrainHeightsSize = 0, terrainFlagsSize = 0;
+	if (terrain)
+	{
+		terrainHeightsSize = terrain->GetHeightCount() * sizeof(float);
+		terrainFlagsSize = terrain->GetQuadCount() * sizeof(uint8_t);
+
+		header.terrainQuadsX = terrain->GetQuadsX();
+		header.terrainQuadsZ = terrain->GetQuadsZ();
+		header.terrainOrigin[0] = terrain->GetOrigin()[0];
+		header.terrainOrigin[1] = terrain->GetOrigin()[1];
+		header.terrainUnitsPerVertex = terrain->GetUnitsPerVertex();
+	}
+
+	struct Section { const void* data; uint64_t size; uint64_t* offset; };
+	Section sections[] = {
+		{ loader.getVerts(),   header.vertCount * 3 * sizeof(float),           &header.vertsOffset },
+		{ loader.getTris(),    header.triCount * 3 * sizeof(int),              &header.trisOffset },
+		{ bvh.GetNodes(),      header.nodeCount * sizeof(TriMeshBVHNode),      &header.nodesOffset },
+		{ bvh.GetTris(),       header.bvhTriCount * 3 * sizeof(int),           &header.bvhTrisOffset },
+		{ bvh.GetNormals(),    header.bvhTriCount * 3 * sizeof(float),         &header.normalsOffset },
+		{ instances.GetModels(),     header.modelCount * sizeof(InstancedModel),   &header.modelsOffset },
+		{ instances.GetModelVerts(), header.modelVertCount * 3 * sizeof(float),    &header.modelVertsOffset },
+		{ instances.GetModelTris(),  header.modelTriCount * 3 * sizeof(int),       &header.modelTrisOffset },
+		{ instances.GetInstances(),  header.instanceCount * sizeof(ModelInstance), &header.instancesOffset },
+		{ terrain ? terrain->GetHeights() : nullptr,   terrainHeightsSize, &header.terrainHeightsOffset },
+		{ terrain ? terrain->GetQuadFlags() : nullptr, terrainFlagsSize,   &header.terrainFlagsOffset },
+	};
+
+	uint64_t offset = AlignOffset(sizeof(GeometryCacheHeader));
+	for (Section& section : sections)
+	{
+		*section.offset = offset;
+		offset = AlignOffset(offset + section.size);
+	}
+	header.totalSize = offset;
+
+	std::error_code ec;
+	fs::create_directories(fs::path(filename).parent_path(), ec);
+
+	std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		static const char padding[SECTION_ALIGNMENT] = { 0 };
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t written = sizeof(header);
+
+		for (const Section& section : sections)
+		{
+			out.write(padding, *section.offset - written);
+			if (section.size > 0)
+				out.write(static_cast<const char*>(section.data), section.size);
+			written = *section.offset + section.size;
+		}
+		out.write(padding, header.totalSize - written);
+
+		if (!out.good())
+		{
+			out.close();
+			fs::remove(tempFilename, ec);
+			return false;
+		}
+	}
+
+	fs::rename(tempFilename, filename, ec);
+	if (ec)
+	{
+		fs::remove(tempFilename, ec);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,99 @@
+//
+// GeometryCache.h
+//
+
+#pragma once
+
+#include "meshgen/MappedFile.h"
+
+#include <cstdint>
+#include <string>
+
+class InstancedGeometry;
+class MapGeometryLoader;
+class TerrainHeightfield;
+class TriMeshBVH;
+
+// Binary cache of the processed input geometry of a zone. The cache holds the
+// final vertices and triangles, the triangle BVH with its normals, the placeable
+// instances and the terrain grid of a zone, and is memory mapped when reopened
+// so that we don't need to parse the zone archives again.
+//
+// A cache file is only valid for the source hash it was written with. The source
+// hash covers the zone archives, the doors file and the max zone extents.
+
+// Increment when the layout of the file or the output of the loader changes.
+constexpr uint32_t GEOMETRY_CACHE_VERSION = 6;
+
+class GeometryCache
+{
+public:
+	GeometryCache();
+	~GeometryCache();
+
+	GeometryCache(const GeometryCache&) = delete;
+	GeometryCache& operator=(const GeometryCache&) = delete;
+
+	// Map the cache file. Fails if the file is missing, malformed, or was built
+	// from different inputs.
+	bool Open(const std::string& filename, uint64_t sourceHash);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+
+	// Write the geometry to a cache file. The file is written to a temporary
+	// file first and then moved into place.
+	static bool Write(const std::string& filename, uint64_t sourceHash,
+		const MapGeometryLoader& loader, const TriMeshBVH& bvh);
+
+	const float* GetVerts() const { return m_verts; }
+	const int* GetTris() const { return m_tris; }
+	int GetVertCount() const { return m_vertCount; }
+	int GetTriCount() const { return m_triCount; }
+
+	int GetDynamicObjectsCount() const { return m_dynamicObjects; }
+	bool HasDynamicObjects() const { return m_hasDynamicObjects; }
+
+	// Point the BVH at the mapped data. The BVH does not take ownership of it,
+	// so it must not outlive this cache.
+	void AttachBVH(TriMeshBVH& bvh) const;
+
+	// Point the instanced geometry at the mapped data, same as AttachBVH.
+	void AttachInstances(InstancedGeometry& instances) const;
+
+	// Point the terrain heightfield at the mapped data, same as AttachBVH.
+	bool HasTerrain() const { return m_terrainQuadsX > 0 && m_terrainQuadsZ > 0; }
+	void AttachTerrain(TerrainHeightfield& terrain) const;
+
+private:
+	MappedFile m_file;
+	const uint8_t* m_data = nullptr;
+
+	const float* m_verts = nullptr;
+	const int* m_tris = nullptr;
+	const float* m_normals = nullptr;
+	const void* m_nodes = nullptr;
+	const int* m_bvhTris = nullptr;
+	const void* m_models = nullptr;
+	const float* m_modelVerts = nullptr;
+	const int* m_modelTris = nullptr;
+	const void* m_instances = nullptr;
+	const float* m_terrainHeights = nullptr;
+	const uint8_t* m_terrainFlags = nullptr;
+
+	int m_vertCount = 0;
+	int m_triCount = 0;
+	int m_nodeCount = 0;
+	int m_bvhTriCount = 0;
+	int m_maxTrisPerLeaf = 0;
+	int m_modelCount = 0;
+	int m_modelVertCount = 0;
+	int m_modelTriCount = 0;
+	int m_instanceCount = 0;
+	int m_terrainQuadsX = 0;
+	int m_terrainQuadsZ = 0;
+	float m_terrainOrigin[2] = { 0, 0 };
+	float m_terrainUnitsPerVertex = 0;
+	int m_dynamicObjects = 0;
+	bool m_hasDynamicObjects = false;
+};
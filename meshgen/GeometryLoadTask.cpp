@@ -0,0 +1,100 @@
+//
+// GeometryLoadTask.cpp
+//
+
+#include "meshgen/GeometryLoadTask.h"
+#include "meshgen/EQConfig.h"
+#include "meshgen/InputGeom.h"
+#include "meshgen/MapGeometryLoader.h"
+#include "common/NavMeshData.h"
+
+#include <Recast.h>
+
+//============================================================================
+
+const char* GetGeometryLoadStageName(GeometryLoadStage stage)
+{
+	switch (stage)
+	{
+	case GeometryLoadStage::Starting: return "Starting";
+	case GeometryLoadStage::OpenArchives: return "Opening archives";
+	case GeometryLoadStage::ParseZone: return "Parsing zone";
+	case GeometryLoadStage::Placeables: return "Loading placeables";
+	case GeometryLoadStage::BuildBVH: return "Building triangle hierarchy";
+	case GeometryLoadStage::Finished: return "Finished";
+	default: break;
+	}
+
+	return "Unknown";
+}
+
+//----------------------------------------------------------------------------
+
+std::unique_ptr<InputGeom> LoadZoneGeometry(const std::string& zoneShortName, const std::string& eqPath,
+	const std::string& outputPath, bool useMaxExtents, rcContext* context, GeometryLoadProgress* progress)
+{
+	auto geom = std::make_unique<InputGeom>(zoneShortName, eqPath);
+	auto geomLoader = std::make_unique<MapGeometryLoader>(zoneShortName, eqPath, outputPath);
+
+	if (useMaxExtents)
+	{
+		auto iter = MaxZoneExtents.find(zoneShortName);
+		if (iter != MaxZoneExtents.end())
+		{
+			geomLoader->SetMaxExtents(iter->second);
+		}
+	}
+
+	geomLoader->SetProgress(progress);
+
+	if (!geom->loadGeometry(std::move(geomLoader), context))
+		return nullptr;
+
+	if (progress)
+		progress->SetStage(GeometryLoadStage::Finished);
+
+	return geom;
+}
+
+std::unique_ptr<InputGeom> LoadZoneGeometry(const EQConfig& eqConfig, const std::string& zoneShortName,
+	rcContext* context, GeometryLoadProgress* progress)
+{
+	return LoadZoneGeometry(zoneShortName, eqConfig.GetEverquestPath(), eqConfig.GetOutputPath(),
+		eqConfig.GetUseMaxExtents(), context, progress);
+}
+
+//============================================================================
+
+GeometryLoadTask::GeometryLoadTask(const EQConfig& eqConfig, const std::string& zoneShortName, rcContext* context)
+	: m_zoneShortName(zoneShortName)
+{
+	m_thread = std::thread(
+		[this, eqPath = eqConfig.GetEverquestPath(), outputPath = eqConfig.GetOutputPath(),
+			useMaxExtents = eqConfig.GetUseMaxExtents(), context]()
+		{
+			m_geom = LoadZoneGeometry(m_zoneShortName, eqPath, outputPath, useMaxExtents, context, &m_progress);
+			m_finished = true;
+		});
+}
+
+GeometryLoadTask::~GeometryLoadTask()
+{
+	Cancel();
+	Wait();
+}
+
+void GeometryLoadTask::Wait()
+{
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+std::unique_ptr<InputGeom> GeometryLoadTask::TakeGeometry()
+{
+	Wait();
+
+	if (m_progress.IsCancelled())
+		return nullptr;
+
+	return std::move(m_geom);
+}
@@ -0,0 +1,101 @@
+//
+// GeometryLoadTask.h
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+class EQConfig;
+class InputGeom;
+class rcContext;
+
+// Stages of loading the geometry of a zone, in the order they run.
+enum class GeometryLoadStage : uint8_t
+{
+	Starting,
+	OpenArchives,        // finding out the zone format and opening its archives
+	ParseZone,           // reading the zone, WLD fragments or eqg models
+	Placeables,          // compiling the zone mesh, placeables and doors
+	BuildBVH,            // triangle hierarchy and geometry cache
+	Finished,
+
+	Count
+};
+
+const char* GetGeometryLoadStageName(GeometryLoadStage stage);
+
+// Shared between a geometry load and whoever is watching it. The load reports
+// the stage it is in and checks for cancellation when it moves on to the next
+// one. Thread safe.
+class GeometryLoadProgress
+{
+public:
+	GeometryLoadStage GetStage() const { return m_stage; }
+	void SetStage(GeometryLoadStage stage) { m_stage = stage; }
+
+	// Rough fraction of the load that is done, from the stage it is in.
+	float GetFraction() const
+	{
+		return static_cast<float>(m_stage.load()) / static_cast<float>(GeometryLoadStage::Finished);
+	}
+
+	void Cancel() { m_cancelled = true; }
+	bool IsCancelled() const { return m_cancelled; }
+
+private:
+	std::atomic<GeometryLoadStage> m_stage = GeometryLoadStage::Starting;
+	std::atomic<bool> m_cancelled = false;
+};
+
+// Load the geometry of a zone, applying the max extents if the config asks for
+// them. Returns null if the zone failed to load or the load was cancelled.
+std::unique_ptr<InputGeom> LoadZoneGeometry(const EQConfig& eqConfig, const std::string& zoneShortName,
+	rcContext* context, GeometryLoadProgress* progress = nullptr);
+
+// Same, without a config. eqPath is the client directory, outputPath holds the
+// zone's doors file and the geometry cache.
+std::unique_ptr<InputGeom> LoadZoneGeometry(const std::string& zoneShortName, const std::string& eqPath,
+	const std::string& outputPath, bool useMaxExtents, rcContext* context, GeometryLoadProgress* progress = nullptr);
+
+// Loads the geometry of a zone on a thread of its own. Nothing here depends on
+// the UI, the owner polls IsFinished and takes the geometry once it is done.
+//
+// Destroying the task cancels the load and waits for it to stop.
+
+class GeometryLoadTask
+{
+public:
+	GeometryLoadTask(const EQConfig& eqConfig, const std::string& zoneShortName, rcContext* context);
+	~GeometryLoadTask();
+
+	GeometryLoadTask(const GeometryLoadTask&) = delete;
+	GeometryLoadTask& operator=(const GeometryLoadTask&) = delete;
+
+	const std::string& GetZoneShortName() const { return m_zoneShortName; }
+	const GeometryLoadProgress& GetProgress() const { return m_progress; }
+
+	// Stop the load at the next stage. The task still needs to finish.
+	void Cancel() { m_progress.Cancel(); }
+	bool IsCancelled() const { return m_progress.IsCancelled(); }
+
+	bool IsFinished() const { return m_finished; }
+
+	// Block until the load is finished.
+	void Wait();
+
+	// The loaded geometry, once the task is finished. Null if the load failed or
+	// was cancelled.
+	std::unique_ptr<InputGeom> TakeGeometry();
+
+private:
+	std::string m_zoneShortName;
+	GeometryLoadProgress m_progress;
+	std::unique_ptr<InputGeom> m_geom;
+	std::atomic<bool> m_finished = false;
+	std::thread m_thread;
+};
@@ -0,0 +1,166 @@
+//
+// HeightfieldCache.cpp
+//
+
+#include "meshgen/HeightfieldCache.h"
+
+#include <Recast.h>
+#include <RecastAlloc.h>
+
+#include <cstring>
+#include <type_traits>
+
+static rcCompactHeightfield* CopyCompactHeightfield(const rcCompactHeightfield& src)
+{
+	rcCompactHeightfield* dst = rcAllocCompactHeightfield();
+	if (!dst)
+		return nullptr;
+
+	// Copy the header fields, then give the copy its own arrays.
+	*dst = src;
+	dst->cells = nullptr;
+	dst->spans = nullptr;
+	dst->dist = nullptr;
+	dst->areas = nullptr;
+
+	const size_t cellCount = static_cast<size_t>(src.width) * src.height;
+	const size_t spanCount = static_cast<size_t>(src.spanCount);
+
+	bool ok = true;
+	auto copyArray = [&ok](auto*& out, const auto* in, size_t count)
+	{
+		if (!in || !ok)
+			return;
+
+		using T = std::remove_const_t<std::remove_pointer_t<decltype(in)>>;
+		out = static_cast<T*>(rcAlloc(sizeof(T) * count, RC_ALLOC_PERM));
+		if (!out)
+		{
+			ok = false;
+			return;
+		}
+		memcpy(out, in, sizeof(T) * count);
+	};
+
+	copyArray(dst->cells, src.cells, cellCount);
+	copyArray(dst->spans, src.spans, spanCount);
+	copyArray(dst->dist, src.dist, spanCount);
+	copyArray(dst->areas, src.areas, spanCount);
+
+	if (!ok)
+	{
+		rcFreeCompactHeightfield(dst);
+		return nullptr;
+	}
+
+	return dst;
+}
+
+//----------------------------------------------------------------------------
+
+size_t HeightfieldCache::GetHeightfieldSize(const rcCompactHeightfield& chf)
+{
+	size_t size = sizeof(rcCompactHeightfield);
+	size += sizeof(rcCompactCell) * static_cast<size_t>(chf.width) * chf.height;
+	size += (sizeof(rcCompactSpan) + sizeof(unsigned char)) * static_cast<size_t>(chf.spanCount);
+	if (chf.dist)
+		size += sizeof(unsigned short) * static_cast<size_t>(chf.spanCount);
+	return size;
+}
+
+bool HeightfieldCache::Load(uint64_t key, deleting_unique_ptr<rcCompactHeightfield>& chf)
+{
+	chf = deleting_unique_ptr<rcCompactHeightfield>(nullptr,
+		[](rcCompactHeightfield* hf) { rcFreeCompactHeightfield(hf); });
+
+	std::shared_ptr<const rcCompactHeightfield> stored;
+	{
+		std::unique_lock lock(m_mutex);
+
+		auto iter = m_entries.find(key);
+		if (iter == m_entries.end())
+		{
+			++m_misses;
+			return false;
+		}
+
+		++m_hits;
+		Entry& entry = iter->second;
+		m_lru.splice(m_lru.begin(), m_lru, entry.lruPos);
+		stored = entry.chf;
+	}
+
+	// Stored heightfields are never modified, and the reference keeps this one
+	// alive if it is evicted meanwhile, so the copy is made without the lock.
+	chf.reset(CopyCompactHeightfield(*stored));
+	return chf != nullptr;
+}
+
+void HeightfieldCache::Store(uint64_t key, const rcCompactHeightfield& chf)
+{
+	rcCompactHeightfield* copy = CopyCompactHeightfield(chf);
+	if (!copy)
+		return;
+
+	Entry entry;
+	entry.chf = std::shared_ptr<const rcCompactHeightfield>(copy,
+		[](const rcCompactHeightfield* hf) { rcFreeCompactHeightfield(const_cast<rcCompactHeightfield*>(hf)); });
+	entry.size = GetHeightfieldSize(*copy);
+
+	std::unique_lock lock(m_mutex);
+
+	// Too big to ever fit, or another thread stored the same tile first.
+	if (entry.size > m_budget || m_entries.count(key) != 0)
+		return;
+
+	m_lru.push_front(key);
+	entry.lruPos = m_lru.begin();
+	m_memoryUsed += entry.size;
+	m_entries.emplace(key, entry);
+
+	EvictToBudget();
+}
+
+void HeightfieldCache::Clear()
+{
+	std::unique_lock lock(m_mutex);
+
+	m_entries.clear();
+	m_lru.clear();
+	m_memoryUsed = 0;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+void HeightfieldCache::SetBudget(size_t budgetBytes)
+{
+	std::unique_lock lock(m_mutex);
+
+	m_budget = budgetBytes;
+	EvictToBudget();
+}
+
+HeightfieldCache::Stats HeightfieldCache::GetStats() const
+{
+	std::unique_lock lock(m_mutex);
+
+	Stats stats;
+	stats.budget = m_budget;
+	stats.memoryUsed = m_memoryUsed;
+	stats.entries = static_cast<int>(m_entries.size());
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	return stats;
+}
+
+void HeightfieldCache::EvictToBudget()
+{
+	while (m_memoryUsed > m_budget && !m_lru.empty())
+	{
+		auto iter = m_entries.find(m_lru.back());
+		m_lru.pop_back();
+
+		m_memoryUsed -= iter->second.size;
+		m_entries.erase(iter);
+	}
+}
@@ -0,0 +1,82 @@
+//
+// HeightfieldCache.h
+//
+
+#pragma once
+
+#include "common/Utilities.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+struct rcCompactHeightfield;
+
+// In memory cache of the filtered compact heightfield of each tile, so that
+// rebuilding with different region, contour or detail settings can skip
+// rasterization. Entries are keyed by a hash of the tile position and every
+// setting that affects rasterization, filtering and compaction (including the
+// border size, which follows the agent radius), and are evicted least recently
+// used first once the memory budget is exceeded.
+//
+// The key does not cover the input geometry, the cache must be cleared when the
+// geometry changes.
+//
+// All methods are thread safe.
+
+class HeightfieldCache
+{
+public:
+	HeightfieldCache() = default;
+
+	HeightfieldCache(const HeightfieldCache&) = delete;
+	HeightfieldCache& operator=(const HeightfieldCache&) = delete;
+
+	// Look up a heightfield. Returns true if the key was found, chf is then set
+	// to a copy that the caller is free to modify.
+	bool Load(uint64_t key, deleting_unique_ptr<rcCompactHeightfield>& chf);
+
+	// Store a copy of a heightfield.
+	void Store(uint64_t key, const rcCompactHeightfield& chf);
+
+	void Clear();
+
+	// Change the memory budget, evicting entries if needed.
+	void SetBudget(size_t budgetBytes);
+
+	struct Stats
+	{
+		size_t budget = 0;
+		size_t memoryUsed = 0;
+		int entries = 0;
+		int hits = 0;
+		int misses = 0;
+	};
+	Stats GetStats() const;
+
+	// Bytes used by the arrays of a compact heightfield.
+	static size_t GetHeightfieldSize(const rcCompactHeightfield& chf);
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<const rcCompactHeightfield> chf;
+		size_t size = 0;
+		std::list<uint64_t>::iterator lruPos;
+	};
+
+	void EvictToBudget();
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<uint64_t, Entry> m_entries;
+
+	// Most recently used at the front.
+	std::list<uint64_t> m_lru;
+
+	size_t m_budget = 512 * 1024 * 1024;
+	size_t m_memoryUsed = 0;
+	int m_hits = 0;
+	int m_misses = 0;
+};
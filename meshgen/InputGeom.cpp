@@ -3,12 +3,19 @@
 //
 
 #include "meshgen/InputGeom.h"
+#include "meshgen/GeometryCache.h"
+#include "meshgen/GeometryLoadTask.h"
+#include "meshgen/InstancedGeometry.h"
+#include "meshgen/TerrainHeightfield.h"
+#include "common/Utilities.h"
 
 #include <DebugDraw.h>
 #include <DetourNavMesh.h>
 #include <Recast.h>
 #include <RecastDebugDraw.h>
 
+#include <chrono>
+
 static bool intersectSegmentTriangle(const float* sp, const float* sq,
 	const float* a, const float* b, const float* c,
 	float &t)
@@ -63,39 +70,113 @@ InputGeom::~InputGeom()
 
 bool InputGeom::loadGeometry(std::unique_ptr<MapGeometryLoader> loader, rcContext* ctx)
 {
-	m_chunkyMesh.reset();
+	m_bvh.reset();
 	m_volumes.clear();
 
 	m_loader = std::move(loader);
+
+	// Try the geometry cache first. If the zone's inputs haven't changed since
+	// it was written, we can skip loading the zone entirely.
+	const std::string cacheFilename = m_loader->GetCacheFilename();
+	ContentHash cacheKey(m_loader->GetSourceHash());
+	cacheKey.Update(BVH_MAX_TRIS_PER_LEAF);
+	const uint64_t sourceHash = cacheKey.Get();
+
+	auto cache = std::make_shared<GeometryCache>();
+	if (cache->Open(cacheFilename, sourceHash) && cache->GetVerts() != nullptr)
+	{
+		m_loader->LoadFromCache(cache);
+
+		m_bvh = std::make_unique<TriMeshBVH>();
+		cache->AttachBVH(*m_bvh);
+
+		calcBounds();
+
+		ctx->log(RC_LOG_PROGRESS, "Loaded geometry for '%s' from cache (%d triangles)",
+			m_zoneShortName.c_str(), m_loader->getTriCount());
+		return true;
+	}
+
+	cache.reset();
+
 	if (!m_loader->load())
 	{
-		ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not load '%s'",
-			m_zoneShortName.c_str());
+		if (!m_loader->GetProgress() || !m_loader->GetProgress()->IsCancelled())
+		{
+			ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Could not load '%s'",
+				m_zoneShortName.c_str());
+		}
+		return false;
+	}
+
+	const TerrainHeightfield* terrain = m_loader->GetTerrainHeightfield();
+	const InstancedGeometry* instances = m_loader->GetInstancedGeometry();
+	if (m_loader->getVertCount() == 0
+		&& (!terrain || terrain->IsEmpty())
+		&& (!instances || instances->IsEmpty()))
+	{
 		return false;
 	}
 
-	if (m_loader->getVerts() == nullptr)
+	calcBounds();
+
+	if (!m_loader->BeginStage(GeometryLoadStage::BuildBVH))
 		return false;
 
-	rcCalcBounds(m_loader->getVerts(), m_loader->getVertCount(),
-		&m_meshBMin[0], &m_meshBMax[0]);
+	// Construct the triangle hierarchy
+	auto bvhStartTime = std::chrono::steady_clock::now();
 
-	// Construct the partitioned triangle mesh
-	m_chunkyMesh.reset(new rcChunkyTriMesh);
-	if (!rcCreateChunkyTriMesh(
+	m_bvh = std::make_unique<TriMeshBVH>();
+	if (!m_bvh->Build(
 		m_loader->getVerts(),        // verts
 		m_loader->getTris(),         // tris
 		m_loader->getTriCount(),     // ntris
-		256,                         // trisPerChunk
-		m_chunkyMesh.get()))         // [out] chunkyMesh
+		BVH_MAX_TRIS_PER_LEAF))      // maxTrisPerLeaf
 	{
-		ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Failed to build chunky mesh.");
+		ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Failed to build triangle BVH.");
 		return false;
 	}
 
+	std::chrono::duration<float, std::milli> bvhBuildTime = std::chrono::steady_clock::now() - bvhStartTime;
+	ctx->log(RC_LOG_PROGRESS, "Built triangle BVH for '%s' in %.2f ms (%d triangles, %d nodes)",
+		m_zoneShortName.c_str(), bvhBuildTime.count(),
+		m_bvh->GetTriCount(), m_bvh->GetNodeCount());
+
+	if (!GeometryCache::Write(cacheFilename, sourceHash, *m_loader, *m_bvh))
+	{
+		ctx->log(RC_LOG_WARNING, "Failed to write geometry cache: %s", cacheFilename.c_str());
+	}
+
 	return true;
 }
 
+void InputGeom::calcBounds()
+{
+	bool hasBounds = false;
+
+	if (m_loader->getVertCount() > 0)
+	{
+		rcCalcBounds(m_loader->getVerts(), m_loader->getVertCount(),
+			&m_meshBMin[0], &m_meshBMax[0]);
+		hasBounds = true;
+	}
+
+	const TerrainHeightfield* terrain = m_loader->GetTerrainHeightfield();
+	if (terrain && !terrain->IsEmpty())
+	{
+		m_meshBMin = hasBounds ? glm::min(m_meshBMin, terrain->GetBoundsMin()) : terrain->GetBoundsMin();
+		m_meshBMax = hasBounds ? glm::max(m_meshBMax, terrain->GetBoundsMax()) : terrain->GetBoundsMax();
+		hasBounds = true;
+	}
+
+	const InstancedGeometry* instances = m_loader->GetInstancedGeometry();
+	if (instances && !instances->IsEmpty())
+	{
+		m_meshBMin = hasBounds ? glm::min(m_meshBMin, instances->GetBoundsMin()) : instances->GetBoundsMin();
+		m_meshBMax = hasBounds ? glm::max(m_meshBMax, instances->GetBoundsMax()) : instances->GetBoundsMax();
+	}
+}
+
 #pragma region Utilities
 static bool isectSegAABB(const float* sp, const float* sq,
 	const float* amin, const float* amax, float& tmin, float& tmax)
@@ -140,26 +221,70 @@ bool InputGeom::raycastMesh(float* src, float* dst, float& tmin)
 	float btmin, btmax;
 	if (!isectSegAABB(src, dst, &m_meshBMin[0], &m_meshBMax[0], btmin, btmax))
 		return false;
-	float p[2], q[2];
-	p[0] = src[0] + (dst[0] - src[0])*btmin;
-	p[1] = src[2] + (dst[2] - src[2])*btmin;
-	q[0] = src[0] + (dst[0] - src[0])*btmax;
-	q[1] = src[2] + (dst[2] - src[2])*btmax;
-
-	int cid[512];
-	const int ncid = rcGetChunksOverlappingSegment(m_chunkyMesh.get(), p, q, cid, 512);
-	if (!ncid)
-		return false;
+	float p[3], q[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		p[i] = src[i] + (dst[i] - src[i])*btmin;
+		q[i] = src[i] + (dst[i] - src[i])*btmax;
+	}
 
 	tmin = 1.0f;
 	bool hit = false;
+
+	const TerrainHeightfield* terrain = m_loader->GetTerrainHeightfield();
+	if (terrain)
+	{
+		float t = 1;
+		if (terrain->Raycast(src, dst, t))
+		{
+			tmin = t;
+			hit = true;
+		}
+	}
+
+	const InstancedGeometry* instances = m_loader->GetInstancedGeometry();
+	if (instances)
+	{
+		thread_local std::vector<int> iid;
+		thread_local std::vector<float> iverts;
+
+		const int niid = instances->QuerySegment(p, q, iid);
+		for (int i = 0; i < niid; ++i)
+		{
+			instances->TransformInstance(iid[i], iverts);
+
+			const InstancedModel& model = instances->GetModel(instances->GetInstance(iid[i]).model);
+			const int* tris = instances->GetModelTris(model);
+
+			for (uint32_t j = 0; j < model.triCount * 3; j += 3)
+			{
+				float t = 1;
+				if (intersectSegmentTriangle(
+					src, dst,
+					&iverts[tris[j] * 3],
+					&iverts[tris[j + 1] * 3],
+					&iverts[tris[j + 2] * 3], t))
+				{
+					if (t < tmin)
+						tmin = t;
+					hit = true;
+				}
+			}
+		}
+	}
+
+	thread_local std::vector<int> cid;
+	const int ncid = m_bvh->QuerySegment(p, q, cid);
+	if (!ncid)
+		return hit;
+
 	const float* verts = m_loader->getVerts();
 
 	for (int i = 0; i < ncid; ++i)
 	{
-		const rcChunkyTriMeshNode& node = m_chunkyMesh->nodes[cid[i]];
-		const int* tris = &m_chunkyMesh->tris[node.i * 3];
-		const int ntris = node.n;
+		const TriMeshBVHNode& node = m_bvh->GetNode(cid[i]);
+		const int* tris = m_bvh->GetLeafTris(node);
+		const int ntris = node.count;
 
 		for (int j = 0; j < ntris * 3; j += 3)
 		{
@@ -4,13 +4,17 @@
 
 #pragma once
 
-#include "meshgen/ChunkyTriMesh.h"
 #include "meshgen/MapGeometryLoader.h"
+#include "meshgen/TriMeshBVH.h"
 
 #include "common/NavMeshData.h"
 
 static const int MAX_CONVEXVOL_PTS = 12;
 
+// Largest leaf of the triangle BVH. Queries return every overlapping leaf, so
+// this only affects performance.
+static const int BVH_MAX_TRIS_PER_LEAF = 64;
+
 class InputGeom
 {
 public:
@@ -24,16 +28,19 @@ public:
 	inline const glm::vec3& getMeshBoundsMax() const { return m_meshBMax; }
 
 	inline const MapGeometryLoader* getMeshLoader() const { return m_loader.get(); }
-	inline const rcChunkyTriMesh* getChunkyMesh() const { return m_chunkyMesh.get(); }
+	inline const TriMeshBVH* getBVH() const { return m_bvh.get(); }
 
 	// Utilities
 	bool raycastMesh(float* src, float* dst, float& tmin);
 
 private:
+	// Bounds of the triangle mesh and terrain
+	void calcBounds();
+
 	std::string m_eqPath;
 	std::string m_zoneShortName;
 
-	std::unique_ptr<rcChunkyTriMesh> m_chunkyMesh;
+	std::unique_ptr<TriMeshBVH> m_bvh;
 	std::unique_ptr<MapGeometryLoader> m_loader;
 
 	// bounds
@@ -0,0 +1,419 @@
+//
+// InstancedGeometry.cpp
+//
+
+#include "meshgen/InstancedGeometry.h"
+#include "meshgen/Parallel.h"
+#include "meshgen/TriNormals.h"
+#include "common/Utilities.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Size of a cell of the instance grid. Doubled until the grid is a reasonable size.
+static const float INSTANCE_GRID_CELL_SIZE = 64.0f;
+static const int INSTANCE_GRID_MAX_CELLS = 1 << 20;
+
+// Apply the 3x4 transform. The order of operations matches glm's mat4 * vec4 so
+// the result is the same as transforming the vertex with the original matrix.
+static inline void TransformPoint(const float* m, const float* v, float* out)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* row = &m[i * 4];
+		out[i] = (row[0] * v[0] + row[1] * v[1]) + (row[2] * v[2] + row[3]);
+	}
+}
+
+// Transform unit triangle normals, stored as x, y and z arrays of ntris each, by the
+// 3x4 transform. The cofactor matrix maps the cross product of two edges to the
+// cross product of the transformed edges, so this gives the normals of the
+// transformed triangles, mirrored ones included.
+static void TransformNormals(const float* m, const float* normals, int ntris,
+	float* nx, float* ny, float* nz)
+{
+	const float a = m[0], b = m[1], c = m[2];
+	const float d = m[4], e = m[5], f = m[6];
+	const float g = m[8], h = m[9], k = m[10];
+
+	const float cof[9] = {
+		e * k - f * h, f * g - d * k, d * h - e * g,
+		c * h - b * k, a * k - c * g, b * g - a * h,
+		b * f - c * e, c * d - a * f, a * e - b * d,
+	};
+
+	const float* mx = normals;
+	const float* my = normals + ntris;
+	const float* mz = normals + 2 * ntris;
+
+	for (int i = 0; i < ntris; ++i)
+	{
+		float n[3];
+		for (int j = 0; j < 3; ++j)
+			n[j] = cof[j * 3] * mx[i] + cof[j * 3 + 1] * my[i] + cof[j * 3 + 2] * mz[i];
+
+		const float len2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+		const float scale = len2 > 0 ? 1.0f / sqrtf(len2) : 0.0f;
+		nx[i] = n[0] * scale;
+		ny[i] = n[1] * scale;
+		nz[i] = n[2] * scale;
+	}
+}
+
+//----------------------------------------------------------------------------
+
+uint32_t InstancedGeometry::AddModel(const std::vector<glm::vec3>& verts, const std::vector<int>& tris)
+{
+	InstancedModel model;
+	model.firstVert = static_cast<uint32_t>(m_vertStorage.size() / 3);
+	model.vertCount = static_cast<uint32_t>(verts.size());
+	model.firstTri = static_cast<uint32_t>(m_triStorage.size() / 3);
+	model.triCount = static_cast<uint32_t>(tris.size() / 3);
+
+	ContentHash hash;
+	for (const glm::vec3& v : verts)
+	{
+		m_vertStorage.push_back(v.x);
+		m_vertStorage.push_back(v.y);
+		m_vertStorage.push_back(v.z);
+		hash.Update(v);
+	}
+
+	m_triStorage.insert(m_triStorage.end(), tris.begin(), tris.end());
+	if (!tris.empty())
+		hash.Update(tris.data(), tris.size() * sizeof(int));
+
+	model.hash = hash.Get();
+
+	const uint32_t index = static_cast<uint32_t>(m_modelStorage.size());
+	m_modelStorage.push_back(model);
+	return index;
+}
+
+void InstancedGeometry::AddInstance(uint32_t modelIndex, const glm::mat4x4& transform)
+{
+	if (m_modelStorage[modelIndex].triCount == 0)
+		return;
+
+	ModelInstance instance;
+	InitInstance(modelIndex, transform, instance);
+	m_instanceStorage.push_back(instance);
+}
+
+void InstancedGeometry::AddInstances(const std::vector<InstancePlacement>& placements)
+{
+	// Placements of empty models are skipped. Find where each of the others goes,
+	// so that the instances keep the order they would have been added in one by one.
+	std::vector<uint32_t> offsets(placements.size() + 1, 0);
+	for (size_t i = 0; i < placements.size(); ++i)
+		offsets[i + 1] = offsets[i] + (m_modelStorage[placements[i].model].triCount != 0 ? 1 : 0);
+
+	const size_t first = m_instanceStorage.size();
+	m_instanceStorage.resize(first + offsets.back());
+
+	ParallelFor(size_t(0), placements.size(), [&](size_t i)
+		{
+			if (offsets[i + 1] != offsets[i])
+				InitInstance(placements[i].model, placements[i].transform, m_instanceStorage[first + offsets[i]]);
+		});
+}
+
+void InstancedGeometry::InitInstance(uint32_t modelIndex, const glm::mat4x4& transform, ModelInstance& instance) const
+{
+	const InstancedModel& model = m_modelStorage[modelIndex];
+	instance.model = modelIndex;
+
+	// navmesh space is (y, z, x) of eq space.
+	static const int axis[3] = { 1, 2, 0 };
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+			instance.transform[i * 4 + j] = transform[j][axis[i]];
+	}
+
+	// Bounds of the vertices used by triangles.
+	std::fill(std::begin(instance.bmin), std::end(instance.bmin), FLT_MAX);
+	std::fill(std::begin(instance.bmax), std::end(instance.bmax), -FLT_MAX);
+
+	const float* verts = &m_vertStorage[model.firstVert * 3];
+	const int* tris = &m_triStorage[model.firstTri * 3];
+	for (uint32_t i = 0; i < model.triCount * 3; ++i)
+	{
+		float v[3];
+		TransformPoint(instance.transform, &verts[tris[i] * 3], v);
+		for (int j = 0; j < 3; ++j)
+		{
+			instance.bmin[j] = std::min(instance.bmin[j], v[j]);
+			instance.bmax[j] = std::max(instance.bmax[j], v[j]);
+		}
+	}
+}
+
+void InstancedGeometry::Finalize()
+{
+	UpdatePointers();
+	BuildIndex();
+	ClearDrawCache();
+}
+
+void InstancedGeometry::Attach(const InstancedModel* models, int modelCount, const float* verts, int vertCount,
+	const int* tris, int triCount, const ModelInstance* instances, int instanceCount)
+{
+	m_modelStorage.clear();
+	m_vertStorage.clear();
+	m_triStorage.clear();
+	m_instanceStorage.clear();
+
+	m_models = models;
+	m_modelCount = modelCount;
+	m_verts = verts;
+	m_vertCount = vertCount;
+	m_tris = tris;
+	m_triCount = triCount;
+	m_instances = instances;
+	m_instanceCount = instanceCount;
+
+	BuildIndex();
+	ClearDrawCache();
+}
+
+void InstancedGeometry::UpdatePointers()
+{
+	m_models = m_modelStorage.data();
+	m_modelCount = static_cast<int>(m_modelStorage.size());
+	m_verts = m_vertStorage.data();
+	m_vertCount = static_cast<int>(m_vertStorage.size() / 3);
+	m_tris = m_triStorage.data();
+	m_triCount = static_cast<int>(m_triStorage.size() / 3);
+	m_instances = m_instanceStorage.data();
+	m_instanceCount = static_cast<int>(m_instanceStorage.size());
+}
+
+void InstancedGeometry::BuildIndex()
+{
+	m_cellStart.clear();
+	m_cellInstances.clear();
+	m_gridWidth = m_gridHeight = 0;
+	m_instancedTriCount = 0;
+	m_bmin = glm::vec3(0.0f);
+	m_bmax = glm::vec3(0.0f);
+
+	if (m_instanceCount == 0)
+		return;
+
+	m_bmin = glm::vec3(FLT_MAX);
+	m_bmax = glm::vec3(-FLT_MAX);
+	for (int i = 0; i < m_instanceCount; ++i)
+	{
+		const ModelInstance& inst = m_instances[i];
+		m_bmin = glm::min(m_bmin, glm::vec3(inst.bmin[0], inst.bmin[1], inst.bmin[2]));
+		m_bmax = glm::max(m_bmax, glm::vec3(inst.bmax[0], inst.bmax[1], inst.bmax[2]));
+		m_instancedTriCount += m_models[inst.model].triCount;
+	}
+
+	m_gridOrigin[0] = m_bmin.x;
+	m_gridOrigin[1] = m_bmin.z;
+	m_gridCellSize = INSTANCE_GRID_CELL_SIZE;
+
+	do
+	{
+		m_gridWidth = static_cast<int>((m_bmax.x - m_bmin.x) / m_gridCellSize) + 1;
+		m_gridHeight = static_cast<int>((m_bmax.z - m_bmin.z) / m_gridCellSize) + 1;
+		if (static_cast<int64_t>(m_gridWidth) * m_gridHeight <= INSTANCE_GRID_MAX_CELLS)
+			break;
+		m_gridCellSize *= 2.0f;
+	} while (true);
+
+	auto forEachCell = [this](const ModelInstance& inst, auto&& func)
+	{
+		const float inv = 1.0f / m_gridCellSize;
+		const int x0 = std::clamp(static_cast<int>((inst.bmin[0] - m_gridOrigin[0]) * inv), 0, m_gridWidth - 1);
+		const int x1 = std::clamp(static_cast<int>((inst.bmax[0] - m_gridOrigin[0]) * inv), 0, m_gridWidth - 1);
+		const int z0 = std::clamp(static_cast<int>((inst.bmin[2] - m_gridOrigin[1]) * inv), 0, m_gridHeight - 1);
+		const int z1 = std::clamp(static_cast<int>((inst.bmax[2] - m_gridOrigin[1]) * inv), 0, m_gridHeight - 1);
+
+		for (int z = z0; z <= z1; ++z)
+		{
+			for (int x = x0; x <= x1; ++x)
+				func(x + z * m_gridWidth);
+		}
+	};
+
+	// Count, then fill.
+	m_cellStart.assign(static_cast<size_t>(m_gridWidth) * m_gridHeight + 1, 0);
+	for (int i = 0; i < m_instanceCount; ++i)
+		forEachCell(m_instances[i], [&](int cell) { ++m_cellStart[cell + 1]; });
+
+	for (size_t i = 1; i < m_cellStart.size(); ++i)
+		m_cellStart[i] += m_cellStart[i - 1];
+
+	m_cellInstances.resize(m_cellStart.back());
+	std::vector<uint32_t> cursor(m_cellStart.begin(), m_cellStart.end() - 1);
+	for (int i = 0; i < m_instanceCount; ++i)
+		forEachCell(m_instances[i], [&](int cell) { m_cellInstances[cursor[cell]++] = static_cast<uint32_t>(i); });
+}
+
+int InstancedGeometry::QueryBox(const float* bmin, const float* bmax, std::vector<int>& instances) const
+{
+	instances.clear();
+	if (m_instanceCount == 0)
+		return 0;
+
+	if (bmin[0] > m_bmax.x || bmax[0] < m_bmin.x || bmin[2] > m_bmax.z || bmax[2] < m_bmin.z)
+		return 0;
+
+	const float inv = 1.0f / m_gridCellSize;
+	auto cellX = [&](float x) { return std::clamp(static_cast<int>((x - m_gridOrigin[0]) * inv), 0, m_gridWidth - 1); };
+	auto cellZ = [&](float z) { return std::clamp(static_cast<int>((z - m_gridOrigin[1]) * inv), 0, m_gridHeight - 1); };
+
+	const int x0 = cellX(bmin[0]), x1 = cellX(bmax[0]);
+	const int z0 = cellZ(bmin[2]), z1 = cellZ(bmax[2]);
+
+	for (int z = z0; z <= z1; ++z)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			const int cell = x + z * m_gridWidth;
+			for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i)
+			{
+				const uint32_t index = m_cellInstances[i];
+				const ModelInstance& inst = m_instances[index];
+
+				// An instance can be in several cells, only report it from the first
+				// cell that it shares with the query.
+				if (x != std::max(x0, cellX(inst.bmin[0])) || z != std::max(z0, cellZ(inst.bmin[2])))
+					continue;
+
+				if (bmin[0] > inst.bmax[0] || bmax[0] < inst.bmin[0]
+					|| bmin[1] > inst.bmax[1] || bmax[1] < inst.bmin[1]
+					|| bmin[2] > inst.bmax[2] || bmax[2] < inst.bmin[2])
+				{
+					continue;
+				}
+
+				instances.push_back(static_cast<int>(index));
+			}
+		}
+	}
+
+	// Keep the order independent of the query so that results are deterministic.
+	std::sort(instances.begin(), instances.end());
+	return static_cast<int>(instances.size());
+}
+
+int InstancedGeometry::TransformInstance(int index, std::vector<float>& verts) const
+{
+	const ModelInstance& inst = m_instances[index];
+	const InstancedModel& model = m_models[inst.model];
+
+	verts.resize(static_cast<size_t>(model.vertCount) * 3);
+
+	const float* src = &m_verts[model.firstVert * 3];
+	for (uint32_t i = 0; i < model.vertCount; ++i)
+		TransformPoint(inst.transform, &src[i * 3], &verts[i * 3]);
+
+	return static_cast<int>(model.vertCount);
+}
+
+void InstancedGeometry::HashInstance(int index, ContentHash& hash) const
+{
+	const ModelInstance& inst = m_instances[index];
+
+	hash.Update(m_models[inst.model].hash);
+	hash.Update(inst.transform);
+}
+
+int InstancedGeometry::QuerySegment(const float* p, const float* q, std::vector<int>& instances) const
+{
+	static const float EPS = 1e-6f;
+
+	instances.clear();
+
+	const float d[3] = { q[0] - p[0], q[1] - p[1], q[2] - p[2] };
+
+	for (int i = 0; i < m_instanceCount; ++i)
+	{
+		const ModelInstance& inst = m_instances[i];
+
+		float tmin = 0.0f, tmax = 1.0f;
+		bool overlap = true;
+		for (int j = 0; j < 3 && overlap; ++j)
+		{
+			if (fabsf(d[j]) < EPS)
+			{
+				overlap = p[j] >= inst.bmin[j] && p[j] <= inst.bmax[j];
+			}
+			else
+			{
+				float t1 = (inst.bmin[j] - p[j]) / d[j];
+				float t2 = (inst.bmax[j] - p[j]) / d[j];
+				if (t1 > t2) std::swap(t1, t2);
+				tmin = std::max(tmin, t1);
+				tmax = std::min(tmax, t2);
+				overlap = tmin <= tmax;
+			}
+		}
+
+		if (overlap)
+			instances.push_back(i);
+	}
+
+	return static_cast<int>(instances.size());
+}
+
+void InstancedGeometry::ClearDrawCache()
+{
+	std::unique_lock<std::mutex> lock(m_drawCacheMutex);
+
+	m_drawCacheValid = false;
+	m_modelNormals = {};
+}
+
+void InstancedGeometry::BuildDrawCache() const
+{
+	m_modelNormals.resize(static_cast<size_t>(m_triCount) * 3);
+
+	ParallelFor(0, m_modelCount, [&](int i)
+		{
+			const InstancedModel& model = m_models[i];
+			const int ntris = static_cast<int>(model.triCount);
+
+			float* nx = &m_modelNormals[static_cast<size_t>(model.firstTri) * 3];
+			ComputeTriNormals(&m_verts[model.firstVert * 3], GetModelTris(model), ntris,
+				nx, nx + ntris, nx + 2 * ntris);
+		});
+
+	m_drawCacheValid = true;
+}
+
+void InstancedGeometry::DebugDraw(duDebugDraw* dd, float walkableSlopeAngle, float texScale) const
+{
+	if (!dd)
+		return;
+
+	std::unique_lock<std::mutex> lock(m_drawCacheMutex);
+	if (!m_drawCacheValid)
+		BuildDrawCache();
+
+	// Reused for each instance, never larger than the largest model.
+	std::vector<float> verts;
+	std::vector<float> normals;
+
+	for (int i = 0; i < m_instanceCount; ++i)
+	{
+		const ModelInstance& instance = m_instances[i];
+		const InstancedModel& model = m_models[instance.model];
+		const int ntris = static_cast<int>(model.triCount);
+
+		TransformInstance(i, verts);
+
+		normals.resize(static_cast<size_t>(ntris) * 3);
+		float* nx = normals.data();
+		TransformNormals(instance.transform, &m_modelNormals[static_cast<size_t>(model.firstTri) * 3], ntris,
+			nx, nx + ntris, nx + 2 * ntris);
+
+		DebugDrawTriMeshSlope(dd, verts.data(), GetModelTris(model), nx, nx + ntris, nx + 2 * ntris, ntris,
+			walkableSlopeAngle, texScale);
+	}
+}
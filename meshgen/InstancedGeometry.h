@@ -0,0 +1,164 @@
+//
+// InstancedGeometry.h
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class ContentHash;
+struct duDebugDraw;
+
+// A model that is placed one or more times in the zone. Vertices are in model
+// space and only visible triangles are kept.
+struct InstancedModel
+{
+	uint32_t firstVert;
+	uint32_t vertCount;
+	uint32_t firstTri;
+	uint32_t triCount;
+	uint64_t hash;
+};
+
+// A placement of a model.
+struct ModelInstance
+{
+	// Model space to navmesh space, as the three rows of a 3x4 matrix.
+	float transform[12];
+	uint32_t model;
+
+	// World bounds of the transformed model, navmesh space.
+	float bmin[3];
+	float bmax[3];
+};
+
+// A model and where to place it, see InstancedGeometry::AddInstances.
+struct InstancePlacement
+{
+	uint32_t model;
+	glm::mat4x4 transform;
+};
+
+// Placeable geometry of a zone, stored as each model once plus a transform for
+// every placement. Zones repeat the same trees, rocks and walls many times, so
+// this is much smaller than flattening every placement into the triangle mesh.
+// Triangles of an instance are transformed on demand, only for the instances
+// that overlap the area being built.
+//
+// Transformed vertices are identical to what flattening the placement into the
+// triangle mesh would produce.
+
+class InstancedGeometry
+{
+public:
+	InstancedGeometry() = default;
+
+	InstancedGeometry(const InstancedGeometry&) = delete;
+	InstancedGeometry& operator=(const InstancedGeometry&) = delete;
+
+	// Add a model. verts are in model space (eq coordinates) and tris index into
+	// verts, three per triangle. Returns the index of the model.
+	uint32_t AddModel(const std::vector<glm::vec3>& verts, const std::vector<int>& tris);
+
+	// Place a model. transform takes model space to eq world space.
+	void AddInstance(uint32_t model, const glm::mat4x4& transform);
+
+	// Place models in bulk. Same result as calling AddInstance for each placement
+	// in order, but the instances are transformed and bounded in parallel.
+	void AddInstances(const std::vector<InstancePlacement>& placements);
+
+	// Build the spatial index after all models and instances have been added.
+	void Finalize();
+
+	// Use prebuilt data, eg from a mapped cache file. The data is not copied and
+	// must outlive this object.
+	void Attach(const InstancedModel* models, int modelCount, const float* verts, int vertCount,
+		const int* tris, int triCount, const ModelInstance* instances, int instanceCount);
+
+	// Collect the instances whose bounds overlap the box, in ascending order.
+	// instances is cleared first. Returns the number found.
+	int QueryBox(const float* bmin, const float* bmax, std::vector<int>& instances) const;
+
+	// Transform the vertices of an instance to navmesh space. Returns the
+	// vertex count, use GetModelTris for the triangles.
+	int TransformInstance(int instance, std::vector<float>& verts) const;
+
+	// Hash the transform and model of an instance.
+	void HashInstance(int instance, ContentHash& hash) const;
+
+	// Collect the instances whose bounds are crossed by the segment p-q.
+	int QuerySegment(const float* p, const float* q, std::vector<int>& instances) const;
+
+	// Draws every instance, transforming each into a buffer that is reused for the
+	// next. The triangle normals of each model are kept from the first draw until
+	// the models change.
+	void DebugDraw(duDebugDraw* dd, float walkableSlopeAngle, float texScale) const;
+
+	bool IsEmpty() const { return m_instanceCount == 0; }
+
+	const glm::vec3& GetBoundsMin() const { return m_bmin; }
+	const glm::vec3& GetBoundsMax() const { return m_bmax; }
+
+	const InstancedModel& GetModel(uint32_t index) const { return m_models[index]; }
+	const InstancedModel* GetModels() const { return m_models; }
+	int GetModelCount() const { return m_modelCount; }
+
+	const ModelInstance& GetInstance(int index) const { return m_instances[index]; }
+	const ModelInstance* GetInstances() const { return m_instances; }
+	int GetInstanceCount() const { return m_instanceCount; }
+
+	const float* GetModelVerts() const { return m_verts; }
+	int GetModelVertCount() const { return m_vertCount; }
+	const int* GetModelTris() const { return m_tris; }
+	int GetModelTriCount() const { return m_triCount; }
+
+	// Triangles of a model, indexed from the model's first vertex.
+	const int* GetModelTris(const InstancedModel& model) const { return m_tris + model.firstTri * 3; }
+
+	// Number of triangles if every instance were flattened.
+	int64_t GetInstancedTriCount() const { return m_instancedTriCount; }
+
+private:
+	void InitInstance(uint32_t modelIndex, const glm::mat4x4& transform, ModelInstance& instance) const;
+
+	void UpdatePointers();
+	void BuildIndex();
+	void BuildDrawCache() const;
+	void ClearDrawCache();
+
+	std::vector<InstancedModel> m_modelStorage;
+	std::vector<float> m_vertStorage;
+	std::vector<int> m_triStorage;
+	std::vector<ModelInstance> m_instanceStorage;
+
+	const InstancedModel* m_models = nullptr;
+	const float* m_verts = nullptr;
+	const int* m_tris = nullptr;
+	const ModelInstance* m_instances = nullptr;
+	int m_modelCount = 0;
+	int m_vertCount = 0;
+	int m_triCount = 0;
+	int m_instanceCount = 0;
+	int64_t m_instancedTriCount = 0;
+
+	glm::vec3 m_bmin = glm::vec3(0.0f);
+	glm::vec3 m_bmax = glm::vec3(0.0f);
+
+	// Uniform grid over the xz plane. Each cell lists the instances that overlap it.
+	float m_gridOrigin[2] = { 0, 0 };
+	float m_gridCellSize = 0;
+	int m_gridWidth = 0;
+	int m_gridHeight = 0;
+	std::vector<uint32_t> m_cellStart;
+	std::vector<uint32_t> m_cellInstances;
+
+	// Model space triangle normals of every model, as x, y and z arrays per model
+	// starting at three times its first triangle. Built on the first draw.
+	mutable std::mutex m_drawCacheMutex;
+	mutable bool m_drawCacheValid = false;
+	mutable std::vector<float> m_modelNormals;
+};
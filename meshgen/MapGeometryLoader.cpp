@@ -3,9 +3,15 @@
 //
 
 #include "meshgen/MapGeometryLoader.h"
+#include "meshgen/GeometryCache.h"
+#include "meshgen/GeometryLoadTask.h"
+#include "meshgen/InstancedGeometry.h"
+#include "meshgen/Parallel.h"
+#include "meshgen/TerrainHeightfield.h"
 
 #include "common/ZoneData.h"
 #include "common/NavMeshData.h"
+#include "common/Utilities.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
@@ -14,7 +20,9 @@
 #include <zone-utilities/log/log_macros.h>
 #include <zone-utilities/common/compression.h>
 
+#include <chrono>
 #include <filesystem>
+#include <fstream>
 #include <sstream>
 
 namespace fs = std::filesystem;
@@ -75,9 +83,11 @@ MapGeometryLoader::MapGeometryLoader(const std::string& zoneShortName,
 
 MapGeometryLoader::~MapGeometryLoader()
 {
-	delete[] m_verts;
-	delete[] m_normals;
-	delete[] m_tris;
+	if (!m_cache)
+	{
+		delete[] m_verts;
+		delete[] m_tris;
+	}
 }
 
 void MapGeometryLoader::SetMaxExtents(const std::pair<glm::vec3, glm::vec3>& maxExtents)
@@ -88,6 +98,81 @@ void MapGeometryLoader::SetMaxExtents(const std::pair<glm::vec3, glm::vec3>& max
 	m_maxExtentsSet = true;
 }
 
+bool MapGeometryLoader::BeginStage(GeometryLoadStage stage)
+{
+	if (!m_progress)
+		return true;
+
+	if (m_progress->IsCancelled())
+	{
+		eqLogMessage(LogInfo, "Cancelled loading %s.", m_zoneName.c_str());
+		return false;
+	}
+
+	m_progress->SetStage(stage);
+	return true;
+}
+
+uint64_t MapGeometryLoader::GetSourceHash() const
+{
+	ContentHash hash;
+	hash.Update(GEOMETRY_CACHE_VERSION);
+	hash.Update(m_zoneName);
+
+	for (const std::string& filename : ZoneData::GetSourceFiles(m_eqPath, m_zoneName))
+	{
+		hash.Update(fs::path(filename).filename().string());
+		HashFileContents(filename, hash);
+	}
+
+	HashFileContents((fs::path(m_meshPath) / (m_zoneName + "_doors.json")).string(), hash);
+
+	hash.Update(m_maxExtentsSet);
+	if (m_maxExtentsSet)
+	{
+		hash.Update(m_maxExtents.first);
+		hash.Update(m_maxExtents.second);
+	}
+
+	return hash.Get();
+}
+
+std::string MapGeometryLoader::GetCacheFilename() const
+{
+	return (fs::path(m_meshPath) / "cache" / (m_zoneName + ".geocache")).string();
+}
+
+void MapGeometryLoader::LoadFromCache(const std::shared_ptr<GeometryCache>& cache)
+{
+	if (!m_cache)
+	{
+		delete[] m_verts;
+		delete[] m_tris;
+	}
+
+	m_cache = cache;
+
+	// the mapped view is read only, nothing modifies the arrays once loaded.
+	m_verts = const_cast<float*>(cache->GetVerts());
+	m_tris = const_cast<int*>(cache->GetTris());
+	m_vertCount = vcap = cache->GetVertCount();
+	m_triCount = tcap = cache->GetTriCount();
+
+	m_instancedGeometry = std::make_unique<InstancedGeometry>();
+	cache->AttachInstances(*m_instancedGeometry);
+
+	m_terrainHeightfield.reset();
+	if (cache->HasTerrain())
+	{
+		m_terrainHeightfield = std::make_unique<TerrainHeightfield>();
+		cache->AttachTerrain(*m_terrainHeightfield);
+	}
+
+	m_dynamicObjects = cache->GetDynamicObjectsCount();
+	m_hasDynamicObjects = cache->HasDynamicObjects();
+	m_doorsLoaded = m_hasDynamicObjects;
+}
+
 void MapGeometryLoader::addVertex(float x, float y, float z)
 {
 	if (m_vertCount + 1 > vcap)
@@ -124,6 +209,29 @@ void MapGeometryLoader::addTriangle(int a, int b, int c)
 	m_triCount++;
 }
 
+void MapGeometryLoader::reserveGeometry(int vertCount, int triCount)
+{
+	if (vertCount > vcap)
+	{
+		vcap = vertCount;
+		float* nv = new float[vcap * 3];
+		if (m_vertCount)
+			memcpy(nv, m_verts, m_vertCount * 3 * sizeof(float));
+		delete[] m_verts;
+		m_verts = nv;
+	}
+
+	if (triCount > tcap)
+	{
+		tcap = triCount;
+		int* nt = new int[tcap * 3];
+		if (m_triCount)
+			memcpy(nt, m_tris, m_triCount * 3 * sizeof(int));
+		delete[] m_tris;
+		m_tris = nt;
+	}
+}
+
 auto GetTranslation = [](auto obj) -> glm::vec3 {
 	return glm::vec3(obj->GetX(), obj->GetY(), obj->GetZ());
 };
@@ -140,106 +248,80 @@ auto GetRotationRad = [](auto obj) -> glm::vec3 {
 
 bool MapGeometryLoader::load()
 {
-	uint32_t counter = 0;
-
 	if (!Build())
 	{
 		return false;
 	}
 
-	// load terrain geometry
+	// Terrain is kept as a height grid and sampled directly into the heightfield
+	// of each tile, so it doesn't go through the triangle mesh.
+	m_terrainHeightfield.reset();
 	if (terrain)
 	{
-		const auto& tiles = terrain->GetTiles();
-		uint32_t quads_per_tile = terrain->GetQuadsPerTile();
-		float units_per_vertex = terrain->GetUnitsPerVertex();
-		uint32_t vert_count = ((quads_per_tile + 1) * (quads_per_tile + 1));
-		uint32_t quad_count = (quads_per_tile * quads_per_tile);
-
-		for (uint32_t i = 0; i < tiles.size(); ++i)
+		auto heightfield = std::make_unique<TerrainHeightfield>();
+		if (heightfield->Build(*terrain, [this](const glm::vec3& p) { return IsPointOutsideExtents(p); }))
 		{
-			auto& tile = tiles[i];
-			bool flat = tile->IsFlat();
-
-			float x = tile->GetX();
-			float y = tile->GetY();
-
-			if (flat)
-			{
-				float z = tile->GetFloats()[0];
+			eqLogMessage(LogTrace, "Terrain heightfield: %d x %d quads, %d solid",
+				heightfield->GetQuadsX(), heightfield->GetQuadsZ(), heightfield->GetSolidQuadCount());
 
-				// get x,y of corner point for this quad
-				float dt = quads_per_tile * units_per_vertex;
-
-				if (ArePointsOutsideExtents(glm::vec3{ y, x, z }))
-					continue;
-
-				addVertex(x, z, y);
-				addVertex(x + dt, z, y);
-				addVertex(x + dt, z, y + dt);
-				addVertex(x, z, y + dt);
-
-				addTriangle(counter + 0, counter + 2, counter + 1);
-				addTriangle(counter + 2, counter + 0, counter + 3);
-
-				counter += 4;
-			}
-			else
-			{
-				auto& floats = tile->GetFloats();
-				int row_number = -1;
-
-				for (uint32_t quad = 0; quad < quad_count; ++quad)
-				{
-					if (quad % quads_per_tile == 0)
-						++row_number;
+			m_terrainHeightfield = std::move(heightfield);
+		}
+	}
 
-					if (tile->GetFlags()[quad] & 0x01)
-						continue;
+	const auto flattenStart = std::chrono::steady_clock::now();
 
-					// get x,y of corner point for this quad
-					float _x = x + (row_number * units_per_vertex);
-					float _y = y + (quad % quads_per_tile) * units_per_vertex;
-					float dt = units_per_vertex;
+	// Copy the collidable triangles inside the max extents to the triangle mesh. The
+	// triangles that are kept are counted first, which gives each one its place in
+	// the output, and then written in parallel. The result is the same as adding
+	// them one at a time.
+	const size_t collideTriCount = collide_indices.size() / 3;
+	std::vector<int> triOffsets(collideTriCount + 1, 0);
 
-					float z1 = floats[quad + row_number];
-					float z2 = floats[quad + row_number + quads_per_tile + 1];
-					float z3 = floats[quad + row_number + quads_per_tile + 2];
-					float z4 = floats[quad + row_number + 1];
+	ParallelFor(size_t(0), collideTriCount, [&](size_t i)
+		{
+			const glm::vec3& vert1 = collide_verts[collide_indices[i * 3]];
+			const glm::vec3& vert2 = collide_verts[collide_indices[i * 3 + 2]];
+			const glm::vec3& vert3 = collide_verts[collide_indices[i * 3 + 1]];
 
-					if (ArePointsOutsideExtents(glm::vec3{ _y, _x, z1 }))
-						continue;
+			triOffsets[i + 1] = ArePointsOutsideExtents(vert1.yxz, vert2.yxz, vert3.yxz) ? 0 : 1;
+		});
 
-					addVertex(_x, z1, _y);
-					addVertex(_x + dt, z2, _y);
-					addVertex(_x + dt, z3, _y + dt);
-					addVertex(_x, z4, _y + dt);
+	for (size_t i = 0; i < collideTriCount; ++i)
+		triOffsets[i + 1] += triOffsets[i];
 
-					addTriangle(counter + 0, counter + 2, counter + 1);
-					addTriangle(counter + 2, counter + 0, counter + 3);
+	const int firstVert = m_vertCount;
+	const int firstTri = m_triCount;
+	const int keptTris = triOffsets.back();
+	reserveGeometry(firstVert + keptTris * 3, firstTri + keptTris);
 
-					counter += 4;
-				}
+	ParallelFor(size_t(0), collideTriCount, [&](size_t i)
+		{
+			if (triOffsets[i + 1] == triOffsets[i])
+				return;
+
+			const glm::vec3* verts[3] = {
+				&collide_verts[collide_indices[i * 3]],
+				&collide_verts[collide_indices[i * 3 + 2]],
+				&collide_verts[collide_indices[i * 3 + 1]],
+			};
+
+			const int vert = firstVert + triOffsets[i] * 3;
+			float* dst = &m_verts[vert * 3];
+			for (const glm::vec3* v : verts)
+			{
+				*dst++ = v->x * m_scale;
+				*dst++ = v->z * m_scale;
+				*dst++ = v->y * m_scale;
 			}
-		}
-	}
 
-	for (uint32_t index = 0; index < collide_indices.size(); index += 3)
-	{
-		const glm::vec3& vert1 = collide_verts[collide_indices[index]];
-		const glm::vec3& vert2 = collide_verts[collide_indices[index + 2]];
-		const glm::vec3& vert3 = collide_verts[collide_indices[index + 1]];
+			int* tri = &m_tris[(firstTri + triOffsets[i]) * 3];
+			tri[0] = vert;
+			tri[1] = vert + 2;
+			tri[2] = vert + 1;
+		});
 
-		if (ArePointsOutsideExtents(vert1.yxz, vert2.yxz, vert3.yxz))
-			continue;
-
-		addVertex(vert1.x, vert1.z, vert1.y);
-		addVertex(vert2.x, vert2.z, vert2.y);
-		addVertex(vert3.x, vert3.z, vert3.y);
-
-		addTriangle(counter, counter + 2, counter + 1);
-		counter += 3;
-	}
+	m_vertCount += keptTris * 3;
+	m_triCount += keptTris;
 
 	auto isVisible = [](int flags)
 	{
@@ -268,6 +350,7 @@ bool MapGeometryLoader::load()
 					visible, poly.flags });
 		}
 
+		entry->UpdateBounds();
 		m_models.emplace(std::move(name), std::move(entry));
 	}
 
@@ -294,17 +377,126 @@ bool MapGeometryLoader::load()
 					visible, poly.flags });
 		}
 
+		entry->UpdateBounds();
 		m_models.emplace(std::move(name), std::move(entry));
 	}
 
-	auto AddTriangle = [&](glm::vec3 v1, glm::vec3 v2, glm::vec3 v3)
+	// Placeables are stored as instances of their model instead of being
+	// flattened into the triangle mesh. Placements are collected in order and
+	// then transformed together, see InstancedGeometry::AddInstances.
+	m_instancedGeometry = std::make_unique<InstancedGeometry>();
+	std::unordered_map<std::string, uint32_t> instancedModels;
+	std::vector<InstancePlacement> placements;
+	placements.reserve(map_placeables.size());
+
+	int rejectedPlacements = 0;
+	int clippedPlacements = 0;
+
+	// Where the transformed bounds of a model are relative to the max extents.
+	enum class ExtentsOverlap { Inside, Outside, Partial };
+	auto ClassifyPlacement = [&](const ModelEntry& model, const glm::mat4x4& mtx)
 	{
-		addVertex(v1.y, v1.z, v1.x);
-		addVertex(v2.y, v2.z, v2.x);
-		addVertex(v3.y, v3.z, v3.x);
+		if (!m_maxExtentsSet || model.visibleTriCount == 0)
+			return ExtentsOverlap::Inside;
 
-		addTriangle(counter, counter + 1, counter + 2);
-		counter += 3;
+		glm::vec3 wmin(FLT_MAX), wmax(-FLT_MAX);
+		for (int i = 0; i < 8; ++i)
+		{
+			const glm::vec3 corner{
+				(i & 1) ? model.bmax.x : model.bmin.x,
+				(i & 2) ? model.bmax.y : model.bmin.y,
+				(i & 4) ? model.bmax.z : model.bmin.z };
+			const glm::vec3 p{ mtx * glm::vec4{ corner, 1. } };
+
+			wmin = glm::min(wmin, p);
+			wmax = glm::max(wmax, p);
+		}
+
+		// A bound of zero means that axis is not limited, as in IsPointOutsideExtents.
+		bool inside = true;
+		for (int i = 0; i < 3; ++i)
+		{
+			const float lo = m_maxExtents.first[i];
+			const float hi = m_maxExtents.second[i];
+
+			if ((lo != 0. && wmax[i] < lo) || (hi != 0. && wmin[i] > hi))
+				return ExtentsOverlap::Outside;
+			if ((lo != 0. && wmin[i] < lo) || (hi != 0. && wmax[i] > hi))
+				inside = false;
+		}
+
+		return inside ? ExtentsOverlap::Inside : ExtentsOverlap::Partial;
+	};
+
+	auto AddInstance = [&](const std::string& name, const ModelEntry& model, const glm::mat4x4& mtx)
+	{
+		const ExtentsOverlap overlap = ClassifyPlacement(model, mtx);
+		if (overlap == ExtentsOverlap::Outside)
+		{
+			const glm::vec3 pos{ mtx * glm::vec4{ 0., 0., 0., 1. } };
+			eqLogMessage(LogTrace, "Ignoring placement of '%s' at { %.2f %.2f %.2f } due to being outside of max extents",
+				name.c_str(), pos.x, pos.y, pos.z);
+
+			++rejectedPlacements;
+			return;
+		}
+
+		if (overlap == ExtentsOverlap::Partial)
+		{
+			// Straddles the edge of the extents. Keep the triangles that are inside,
+			// like the triangles of the zone mesh.
+			std::vector<int> tris;
+			for (const auto& poly : model.polys)
+			{
+				if (!poly.vis)
+					continue;
+
+				const glm::vec3 v1{ mtx * glm::vec4{ model.verts[poly.indices[0]], 1. } };
+				const glm::vec3 v2{ mtx * glm::vec4{ model.verts[poly.indices[1]], 1. } };
+				const glm::vec3 v3{ mtx * glm::vec4{ model.verts[poly.indices[2]], 1. } };
+				if (ArePointsOutsideExtents(v1, v2, v3))
+					continue;
+
+				tris.push_back(poly.indices[0]);
+				tris.push_back(poly.indices[1]);
+				tris.push_back(poly.indices[2]);
+			}
+
+			if (tris.empty())
+			{
+				++rejectedPlacements;
+				return;
+			}
+
+			if (static_cast<int>(tris.size()) < model.visibleTriCount * 3)
+			{
+				// The clipped triangles make a model of their own, used by this placement only.
+				placements.push_back(InstancePlacement{ m_instancedGeometry->AddModel(model.verts, tris), mtx });
+				++clippedPlacements;
+				return;
+			}
+		}
+
+		auto iter = instancedModels.find(name);
+		if (iter == instancedModels.end())
+		{
+			std::vector<int> tris;
+			tris.reserve(model.polys.size() * 3);
+
+			for (const auto& poly : model.polys)
+			{
+				if (!poly.vis)
+					continue;
+
+				tris.push_back(poly.indices[0]);
+				tris.push_back(poly.indices[1]);
+				tris.push_back(poly.indices[2]);
+			}
+
+			iter = instancedModels.emplace(name, m_instancedGeometry->AddModel(model.verts, tris)).first;
+		}
+
+		placements.push_back(InstancePlacement{ iter->second, mtx });
 	};
 
 	for (const auto& obj : map_placeables)
@@ -324,25 +516,7 @@ bool MapGeometryLoader::load()
 		if (obj->GetZ() < -30000 || obj->GetX() > 15000 || obj->GetY() > 15000 || obj->GetZ() > 15000)
 			continue;
 
-		if (IsPointOutsideExtents(glm::vec3{ mtx * glm::vec4{ 0., 0., 0., 1. } }))
-		{
-			eqLogMessage(LogWarn, "Ignoring placement of '%s' at { %.2f %.2f %.2f } due to being outside of max extents",
-				obj->GetFileName().c_str(), obj->GetX(), obj->GetY(), obj->GetZ());
-			continue;
-		}
-
-		const auto& model = modelIter->second;
-		for (const auto& poly : model->polys)
-		{
-			if (!poly.vis)
-				continue;
-
-			glm::vec3 v[3];
-			for (int i = 0; i < 3; i++)
-				v[i] = glm::vec3(mtx * glm::vec4(model->verts[poly.indices[i]], 1));
-
-			AddTriangle(v[0], v[1], v[2]);
-		}
+		AddInstance(name, *modelIter->second, mtx);
 	}
 
 	for (const auto& group : map_group_placeables)
@@ -368,29 +542,27 @@ bool MapGeometryLoader::load()
 			mtx = glm::scale(mtx, GetScale(obj));
 			mtx *= glm::mat4_cast(glm::quat(GetRotationRad(obj)));
 
-			glm::vec3 pos{ grp_mat * mtx * glm::vec4{ 0., 0., 0., 1. } };
-			if (IsPointOutsideExtents(pos))
-			{
-				eqLogMessage(LogWarn, "Ignoring placement of '%s' at { %.2f %.2f %.2f } due to being outside of max extents",
-					obj->GetFileName().c_str(), pos.x, pos.y, pos.z);
-				continue;
-			}
+			AddInstance(name, *modelIter->second, grp_mat * mtx);
+		}
+	}
 
-			const auto& model = modelIter->second;
-			for (const auto& poly : model->polys)
-			{
-				if (!poly.vis)
-					continue;
+	m_instancedGeometry->AddInstances(placements);
+	m_instancedGeometry->Finalize();
 
-				glm::vec3 v[3];
-				for (int i = 0; i < 3; i++)
-					v[i] = glm::vec3{ grp_mat * mtx * glm::vec4{ model->verts[poly.indices[i]], 1.0 } };
+	eqLogMessage(LogTrace, "Placeables: %d instances of %d models (%lld triangles)",
+		m_instancedGeometry->GetInstanceCount(), m_instancedGeometry->GetModelCount(),
+		m_instancedGeometry->GetInstancedTriCount());
 
-				AddTriangle(v[0], v[1], v[2]);
-			}
-		}
+	if (m_maxExtentsSet)
+	{
+		eqLogMessage(LogInfo, "Max extents: rejected %d placements outside, clipped %d placements on the edge",
+			rejectedPlacements, clippedPlacements);
 	}
 
+	eqLogMessage(LogTrace, "Compiled %d triangles and %d placements in %.2f ms",
+		keptTris, static_cast<int>(placements.size()),
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - flattenStart).count());
+
 	//const auto& non_collide_indices = map.GetNonCollideIndices();
 
 	//for (uint32_t index = 0; index < non_collide_indices.size(); index += 3, counter += 3)
@@ -412,33 +584,6 @@ bool MapGeometryLoader::load()
 
 	LoadDoors();
 
-	//message = "Calculating Surface Normals...";
-	m_normals = new float[m_triCount * 3];
-	for (int i = 0; i < m_triCount * 3; i += 3)
-	{
-		const float* v0 = &m_verts[m_tris[i] * 3];
-		const float* v1 = &m_verts[m_tris[i + 1] * 3];
-		const float* v2 = &m_verts[m_tris[i + 2] * 3];
-		float e0[3], e1[3];
-		for (int j = 0; j < 3; ++j)
-		{
-			e0[j] = v1[j] - v0[j];
-			e1[j] = v2[j] - v0[j];
-		}
-		float* n = &m_normals[i];
-		n[0] = e0[1] * e1[2] - e0[2] * e1[1];
-		n[1] = e0[2] * e1[0] - e0[0] * e1[2];
-		n[2] = e0[0] * e1[1] - e0[1] * e1[0];
-		float d = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
-		if (d > 0)
-		{
-			d = 1.0f / d;
-			n[0] *= d;
-			n[1] *= d;
-			n[2] *= d;
-		}
-	}
-
 	return true;
 }
 
@@ -463,7 +608,7 @@ void MapGeometryLoader::LoadDoors()
 	//
 	// Load the door data
 	//
-	std::string filename = m_meshPath + "\\" + m_zoneName + "_doors.json";
+	std::string filename = (fs::path(m_meshPath) / (m_zoneName + "_doors.json")).string();
 
 	std::error_code ec;
 	if (!fs::is_regular_file(filename, ec))
@@ -592,48 +737,162 @@ void MapGeometryLoader::LoadDoors()
 
 //============================================================================
 
+ZoneFileFormat MapGeometryLoader::DetectZoneFormat(const std::string& filePath, EQEmu::PFS::Archive& archive)
+{
+	if (archive.Open(filePath + ".eqg"))
+	{
+		// v4 zones have a zon file that starts with EQTZP. It is normally inside the
+		// archive, but may be next to it.
+		auto isTerrainZon = [](const std::vector<char>& zon)
+		{
+			return zon.size() >= 5 && memcmp(zon.data(), "EQTZP", 5) == 0;
+		};
+
+		std::vector<std::string> files;
+		archive.GetFilenames("zon", files);
+
+		std::vector<char> zon;
+		bool hasZon = !files.empty();
+		if (files.empty())
+		{
+			std::ifstream file(filePath + ".zon", std::ios::binary);
+			zon.resize(5);
+			if (file.read(zon.data(), zon.size()))
+			{
+				hasZon = true;
+				if (isTerrainZon(zon))
+					return ZoneFileFormat::EQGv4;
+			}
+		}
+
+		for (const std::string& filename : files)
+		{
+			if (archive.Get(filename, zon) && isTerrainZon(zon))
+				return ZoneFileFormat::EQGv4;
+		}
+
+		// Without a zon file the archive is not the zone, look for an s3d instead.
+		if (hasZon)
+			return ZoneFileFormat::EQG;
+
+		archive.Close();
+	}
+
+	std::error_code ec;
+	if (fs::exists(filePath + ".s3d", ec))
+		return ZoneFileFormat::S3D;
+
+	return ZoneFileFormat::Unknown;
+}
+
 bool MapGeometryLoader::Build()
 {
-	eqLogMessage(LogTrace, "Attempting to load %s.eqg as a standard eqg.", m_zoneName.c_str());
+	std::string filePath = (fs::path(m_eqPath) / m_zoneName).string();
 
-	std::string filePath = m_eqPath + "\\" + m_zoneName;
+	if (!BeginStage(GeometryLoadStage::OpenArchives))
+		return false;
+
+	// Look at the files once and go straight to the matching loader, instead of
+	// probing each format in turn.
+	EQEmu::PFS::Archive archive;
+	const ZoneFileFormat format = DetectZoneFormat(filePath, archive);
+
+	if (!BeginStage(GeometryLoadStage::ParseZone))
+		return false;
 
-	EQEmu::EQGLoader eqg;
-	std::vector<std::shared_ptr<EQEmu::EQG::Geometry>> eqg_models;
-	std::vector<std::shared_ptr<EQEmu::Placeable>> eqg_placables;
-	std::vector<std::shared_ptr<EQEmu::EQG::Region>> eqg_regions;
-	std::vector<std::shared_ptr<EQEmu::Light>> eqg_lights;
-	if (eqg.Load(filePath, eqg_models, eqg_placables, eqg_regions, eqg_lights))
+	switch (format)
 	{
+	case ZoneFileFormat::EQG: {
+		eqLogMessage(LogTrace, "Loading %s.eqg as a standard eqg.", m_zoneName.c_str());
+
+		EQEmu::EQGLoader eqg;
+		std::vector<std::shared_ptr<EQEmu::EQG::Geometry>> eqg_models;
+		std::vector<std::shared_ptr<EQEmu::Placeable>> eqg_placables;
+		std::vector<std::shared_ptr<EQEmu::EQG::Region>> eqg_regions;
+		std::vector<std::shared_ptr<EQEmu::Light>> eqg_lights;
+		if (!eqg.Load(archive, filePath, eqg_models, eqg_placables, eqg_regions, eqg_lights))
+		{
+			return false;
+		}
+
+		if (!BeginStage(GeometryLoadStage::Placeables))
+			return false;
+
 		return CompileEQG(eqg_models, eqg_placables, eqg_regions, eqg_lights);
 	}
 
-	eqLogMessage(LogTrace, "Attempting to load %s.eqg as a v4 eqg.", m_zoneName.c_str());
-	EQEmu::EQG4Loader eqg4;
-	if (eqg4.Load(filePath, terrain))
-	{
+	case ZoneFileFormat::EQGv4: {
+		eqLogMessage(LogTrace, "Loading %s.eqg as a v4 eqg.", m_zoneName.c_str());
+
+		EQEmu::EQG4Loader eqg4;
+		if (!eqg4.Load(archive, filePath, terrain))
+		{
+			return false;
+		}
+
+		if (!BeginStage(GeometryLoadStage::Placeables))
+			return false;
+
 		return CompileEQGv4();
 	}
 
-	eqLogMessage(LogTrace, "Attempting to load %s.s3d as a standard s3d.", m_zoneName.c_str());
-	EQEmu::S3DLoader s3d;
+	case ZoneFileFormat::S3D:
+		eqLogMessage(LogTrace, "Loading %s.s3d as a standard s3d.", m_zoneName.c_str());
+		return BuildS3D(filePath);
+
+	default:
+		eqLogMessage(LogError, "Could not find the zone files of %s.", m_zoneName.c_str());
+		return false;
+	}
+}
+
+bool MapGeometryLoader::BuildS3D(const std::string& filePath)
+{
 	std::vector<EQEmu::S3D::WLDFragment> zone_frags;
 	std::vector<EQEmu::S3D::WLDFragment> zone_object_frags;
 	std::vector<EQEmu::S3D::WLDFragment> object_frags;
-	if (!s3d.ParseWLDFile(filePath + ".s3d", m_zoneName + ".wld", zone_frags))
-	{
-		return false;
-	}
+	bool zoneLoaded = false;
+	bool zoneObjectsLoaded = false;
+	bool objectsLoaded = false;
+
+	// The zone and its object placements share an archive, which is opened once.
+	// The object models are in a separate archive. All three WLD files are parsed
+	// at the same time.
+	ParallelInvoke(
+		[&]()
+		{
+			EQEmu::PFS::Archive archive;
+			if (!archive.Open(filePath + ".s3d"))
+			{
+				eqLogMessage(LogError, "Unable to open file %s.s3d.", filePath.c_str());
+				return;
+			}
 
-	if (!s3d.ParseWLDFile(filePath + ".s3d", "objects.wld", zone_object_frags))
+			ParallelInvoke(
+				[&]()
+				{
+					EQEmu::S3DLoader s3d;
+					zoneLoaded = s3d.ParseWLDFile(archive, m_zoneName + ".wld", zone_frags);
+				},
+				[&]()
+				{
+					EQEmu::S3DLoader s3d;
+					zoneObjectsLoaded = s3d.ParseWLDFile(archive, "objects.wld", zone_object_frags);
+				});
+		},
+		[&]()
+		{
+			EQEmu::S3DLoader s3d;
+			objectsLoaded = s3d.ParseWLDFile(filePath + "_obj.s3d", m_zoneName + "_obj.wld", object_frags);
+		});
+
+	if (!zoneLoaded || !zoneObjectsLoaded || !objectsLoaded)
 	{
 		return false;
 	}
 
-	if (!s3d.ParseWLDFile(filePath + "_obj.s3d", m_zoneName + "_obj.wld", object_frags))
-	{
+	if (!BeginStage(GeometryLoadStage::Placeables))
 		return false;
-	}
 
 	return CompileS3D(zone_frags, zone_object_frags, object_frags);
 }
@@ -13,14 +13,31 @@
 
 #pragma warning(pop)
 
+#include <cfloat>
 #include <cstdint>
 #include <string>
 #include <map>
+#include <memory>
 #include <tuple>
 #include <unordered_map>
 
 #include <glm/glm.hpp>
 
+enum class GeometryLoadStage : uint8_t;
+
+class GeometryCache;
+class GeometryLoadProgress;
+class InstancedGeometry;
+class TerrainHeightfield;
+
+enum class ZoneFileFormat
+{
+	Unknown,
+	EQG,                 // <zone>.eqg with a standard zon file
+	EQGv4,               // <zone>.eqg with a terrain (EQTZP) zon file
+	S3D,                 // <zone>.s3d and <zone>_obj.s3d
+};
+
 struct KeyFuncs
 {
 	size_t operator()(const glm::vec3& k)const
@@ -43,21 +60,51 @@ public:
 
 	void SetMaxExtents(const std::pair<glm::vec3, glm::vec3>& maxExtents);
 
+	// Report the stages of the load to progress, and stop when it is cancelled.
+	void SetProgress(GeometryLoadProgress* progress) { m_progress = progress; }
+	GeometryLoadProgress* GetProgress() const { return m_progress; }
+
+	// Move on to the next stage of the load. Returns false if the load was cancelled.
+	bool BeginStage(GeometryLoadStage stage);
+
 	bool load();
 
+	// Hash of everything that the loaded geometry depends on: the zone archives,
+	// the doors file and the max extents.
+	uint64_t GetSourceHash() const;
+
+	std::string GetCacheFilename() const;
+
+	// Use geometry from a mapped cache file instead of loading it. The loader
+	// keeps the cache alive for as long as it exists.
+	void LoadFromCache(const std::shared_ptr<GeometryCache>& cache);
+
 	inline const std::string& getFileName() const { return m_zoneName; }
 
 	inline const float* getVerts() const { return m_verts; }
-	inline const float* getNormals() const { return m_normals; }
 	inline const int* getTris() const { return m_tris; }
 	inline int getVertCount() const { return m_vertCount; }
 	inline int getTriCount() const { return m_triCount; }
 
+	// Height grid of the terrain of v4 zones. This geometry is not part of the
+	// triangle mesh above. Null if the zone has no terrain.
+	inline const TerrainHeightfield* GetTerrainHeightfield() const { return m_terrainHeightfield.get(); }
+
+	// Placeable models and their placements. This geometry is not part of the
+	// triangle mesh above either.
+	inline const InstancedGeometry* GetInstancedGeometry() const { return m_instancedGeometry.get(); }
+
 	inline int GetDynamicObjectsCount() const { return m_dynamicObjects; }
 	inline bool HasDynamicObjects() const { return m_hasDynamicObjects; }
 
+	// Find out which format the files of a zone are in. filePath is the path of the
+	// zone files without extension. An eqg archive is left open in archive, to load
+	// it from without reading it again.
+	static ZoneFileFormat DetectZoneFormat(const std::string& filePath, EQEmu::PFS::Archive& archive);
+
 private:
 	bool Build();
+	bool BuildS3D(const std::string& filePath);
 	void LoadDoors();
 
 	void TraverseBone(std::shared_ptr<EQEmu::S3D::SkeletonTrack::Bone> bone, glm::vec3 parent_trans, glm::vec3 parent_rot, glm::vec3 parent_scale);
@@ -107,6 +154,28 @@ private:
 		};
 		std::vector<glm::vec3> verts;
 		std::vector<Poly> polys;
+
+		// Model space bounds of the visible triangles, for rejecting placements
+		// outside of the max extents without transforming the model.
+		glm::vec3 bmin = glm::vec3(FLT_MAX);
+		glm::vec3 bmax = glm::vec3(-FLT_MAX);
+		int visibleTriCount = 0;
+
+		void UpdateBounds()
+		{
+			for (const Poly& poly : polys)
+			{
+				if (!poly.vis)
+					continue;
+
+				for (int i = 0; i < 3; ++i)
+				{
+					bmin = glm::min(bmin, verts[poly.indices[i]]);
+					bmax = glm::max(bmax, verts[poly.indices[i]]);
+				}
+				++visibleTriCount;
+			}
+		}
 	};
 	std::map<std::string, std::shared_ptr<ModelEntry>> m_models;
 
@@ -145,17 +214,27 @@ private:
 	void addVertex(float x, float y, float z);
 	void addTriangle(int a, int b, int c);
 
+	// Grow the vertex and triangle arrays to hold at least this many.
+	void reserveGeometry(int vertCount, int triCount);
+
 	int vcap = 0, tcap = 0;
 	float m_scale = 1.0;
 	float* m_verts = 0;
 	int* m_tris = 0;
-	float* m_normals = 0;
 	int m_vertCount = 0;
 	int m_triCount = 0;
 
+	std::unique_ptr<TerrainHeightfield> m_terrainHeightfield;
+	std::unique_ptr<InstancedGeometry> m_instancedGeometry;
+
+	// if set, geometry arrays point into this cache and are not owned by us.
+	std::shared_ptr<GeometryCache> m_cache;
+
 	std::string m_zoneName;
 	std::string m_eqPath;
 	std::string m_meshPath;
 
 	bool m_doorsLoaded = false;
+
+	GeometryLoadProgress* m_progress = nullptr;
 };
@@ -0,0 +1,32 @@
+//
+// MappedFile.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// A whole file mapped read only into memory. Pages are read as they are touched,
+// and the mapping stays valid until the file is closed.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Fails if the file can't be opened or is empty.
+	bool Open(const std::string& filename);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const uint8_t* GetData() const { return m_data; }
+	uint64_t GetSize() const { return m_size; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	uint64_t m_size = 0;
+};
@@ -5,12 +5,14 @@
 #include "meshgen/NavMeshPruneTool.h"
 #include "meshgen/InputGeom.h"
 #include "meshgen/NavMeshTool.h"
+#include "common/NavMesh.h"
 #include "common/NavMeshData.h"
 
 #include <DetourNavMesh.h>
 #include <DetourCommon.h>
 #include <DetourAssert.h>
 #include <DetourDebugDraw.h>
+#include <DetourNavMeshQuery.h>
 
 #include <imgui.h>
 #include <glm/gtc/type_ptr.hpp>
@@ -170,6 +172,17 @@ static void disableUnvisitedPolys(dtNavMesh* nav, NavmeshFlags* flags)
 	}
 }
 
+static void floodNavmeshFrom(dtNavMesh* nav, dtNavMeshQuery* query, NavmeshFlags* flags, const glm::vec3& pos)
+{
+	const float ext[3] = { 2,4,2 };
+	dtQueryFilter filter;
+	dtPolyRef ref = 0;
+	query->findNearestPoly(glm::value_ptr(pos), ext, &filter, &ref, 0);
+
+	if (ref)
+		floodNavmesh(nav, flags, ref, 1);
+}
+
 //----------------------------------------------------------------------------
 
 NavMeshPruneTool::NavMeshPruneTool()
@@ -189,6 +202,7 @@ void NavMeshPruneTool::reset()
 {
 	m_hitPosSet = false;
 	m_flags.reset();
+	m_selectPoints.clear();
 }
 
 void NavMeshPruneTool::handleMenu()
@@ -200,12 +214,34 @@ void NavMeshPruneTool::handleMenu()
 	if (ImGui::Button("Clear Selection"))
 	{
 		m_flags->clearAllFlags();
+		m_selectPoints.clear();
 	}
 
 	if (ImGui::Button("Prune Unselected"))
 	{
 		disableUnvisitedPolys(nav.get(), m_flags.get());
+
+		// The meshes of the other agent profiles have polygons of their own, select
+		// them by flooding from the same points.
+		NavMesh* navMesh = m_meshTool->GetNavMesh().get();
+		for (int profile = 1; profile < navMesh->GetProfileCount(); ++profile)
+		{
+			auto profileNav = navMesh->GetNavMesh(profile);
+			auto query = navMesh->GetNavMeshQuery(profile);
+			if (!profileNav || !query)
+				continue;
+
+			NavmeshFlags flags;
+			flags.init(profileNav.get());
+
+			for (const glm::vec3& pos : m_selectPoints)
+				floodNavmeshFrom(profileNav.get(), query.get(), &flags, pos);
+
+			disableUnvisitedPolys(profileNav.get(), &flags);
+		}
+
 		m_flags.reset();
+		m_selectPoints.clear();
 	}
 }
 
@@ -228,12 +264,8 @@ void NavMeshPruneTool::handleClick(const glm::vec3& /*s*/, const glm::vec3& p, b
 		m_flags->init(nav.get());
 	}
 
-	const float ext[3] = { 2,4,2 };
-	dtQueryFilter filter;
-	dtPolyRef ref = 0;
-	query->findNearestPoly(glm::value_ptr(p), ext, &filter, &ref, 0);
-
-	floodNavmesh(nav.get(), m_flags.get(), ref, 1);
+	m_selectPoints.push_back(p);
+	floodNavmeshFrom(nav.get(), query.get(), m_flags.get(), p);
 }
 
 void NavMeshPruneTool::handleRender()
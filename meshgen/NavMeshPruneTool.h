@@ -8,6 +8,7 @@
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <vector>
 
 class NavmeshFlags;
 
@@ -31,6 +32,10 @@ public:
 private:
 	NavMeshTool* m_meshTool = nullptr;
 	std::unique_ptr<NavmeshFlags> m_flags;
+
+	// Points the selection was flooded from, to select the same areas in the meshes
+	// of the other agent profiles.
+	std::vector<glm::vec3> m_selectPoints;
 	glm::vec3 m_hitPos;
 	bool m_hitPosSet = false;
 };
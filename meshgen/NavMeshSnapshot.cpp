@@ -0,0 +1,158 @@
+//
+// NavMeshSnapshot.cpp
+//
+
+#include "meshgen/NavMeshSnapshot.h"
+
+#include <DetourAlloc.h>
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+
+//============================================================================
+
+TileSnapshotPublisher::~TileSnapshotPublisher()
+{
+	Stop();
+}
+
+void TileSnapshotPublisher::Start(const dtNavMeshParams& params, int profileCount, std::chrono::milliseconds interval)
+{
+	Stop();
+	Reset();
+
+	m_params = params;
+	m_profileCount = profileCount;
+	m_stop = false;
+
+	m_thread = std::thread([this, interval]()
+		{
+			int staleIntervals = 0;
+
+			std::unique_lock<std::mutex> lock(m_stopMutex);
+			while (!m_stop)
+			{
+				m_stopped.wait_for(lock, interval);
+
+				// Stop publishes what is left.
+				if (m_stop)
+					break;
+
+				lock.unlock();
+				if (Publish(++staleIntervals >= MaxStaleIntervals))
+					staleIntervals = 0;
+				lock.lock();
+			}
+		});
+}
+
+void TileSnapshotPublisher::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock(m_stopMutex);
+		m_stop = true;
+	}
+	m_stopped.notify_one();
+
+	m_thread.join();
+
+	// The tiles that came in since the last publish.
+	Publish(true);
+}
+
+void TileSnapshotPublisher::Reset()
+{
+	Stop();
+
+	{
+		std::unique_lock<std::mutex> lock(m_pendingMutex);
+		m_pendingTiles.clear();
+	}
+
+	m_tiles.clear();
+
+	std::shared_ptr<const NavMeshSnapshot> snapshot;
+	{
+		std::unique_lock<std::mutex> lock(m_snapshotMutex);
+		std::swap(snapshot, m_snapshot);
+	}
+}
+
+std::shared_ptr<const NavMeshSnapshot> TileSnapshotPublisher::GetSnapshot() const
+{
+	std::unique_lock<std::mutex> lock(m_snapshotMutex);
+	return m_snapshot;
+}
+
+void TileSnapshotPublisher::AddTile(int x, int y, int profile, uint8_t* data, int dataSize)
+{
+	auto blob = std::make_shared<TileBlob>();
+	blob->data = data;
+	blob->dataSize = dataSize;
+
+	std::unique_lock<std::mutex> lock(m_pendingMutex);
+	m_pendingTiles.emplace_back(TileKey{ profile, x, y }, std::move(blob));
+}
+
+bool TileSnapshotPublisher::Publish(bool force)
+{
+	std::vector<std::pair<TileKey, std::shared_ptr<const TileBlob>>> pendingTiles;
+	{
+		std::unique_lock<std::mutex> lock(m_pendingMutex);
+		if (m_pendingTiles.empty())
+			return false;
+
+		if (!force && m_pendingTiles.size() * MinGrowthDivisor < m_tiles.size())
+			return false;
+
+		std::swap(pendingTiles, m_pendingTiles);
+	}
+
+	for (auto& [key, blob] : pendingTiles)
+		m_tiles[key] = std::move(blob);
+
+	auto snapshot = std::make_shared<NavMeshSnapshot>();
+	snapshot->version = ++m_version;
+
+	for (int profile = 0; profile < m_profileCount; ++profile)
+	{
+		std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(),
+			[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+
+		if (dtStatusFailed(navMesh->init(&m_params)))
+		{
+			SPDLOG_ERROR("Could not init navmesh for snapshot {}", snapshot->version);
+			return false;
+		}
+
+		snapshot->navMeshes.push_back(std::move(navMesh));
+	}
+
+	// Tiles are ordered by profile first.
+	for (const auto& [key, blob] : m_tiles)
+	{
+		const int profile = std::get<0>(key);
+		if (profile >= m_profileCount)
+			continue;
+
+		uint8_t* data = static_cast<uint8_t*>(dtAlloc(blob->dataSize, DT_ALLOC_PERM));
+		memcpy(data, blob->data, blob->dataSize);
+
+		dtStatus status = snapshot->navMeshes[profile]->addTile(data, blob->dataSize, DT_TILE_FREE_DATA, 0, 0);
+		if (dtStatusFailed(status))
+			dtFree(data);
+	}
+
+	// The previous snapshot is freed outside of the lock, if this was the last
+	// reference to it.
+	std::shared_ptr<const NavMeshSnapshot> previous = std::move(snapshot);
+	{
+		std::unique_lock<std::mutex> lock(m_snapshotMutex);
+		std::swap(previous, m_snapshot);
+	}
+
+	return true;
+}
@@ -0,0 +1,104 @@
+//
+// NavMeshSnapshot.h
+//
+
+#pragma once
+
+#include <DetourNavMesh.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// Meshes of every agent profile, made from the tiles published up to a point of
+// a build. A snapshot is never modified once published: readers keep a snapshot
+// for as long as they use its meshes and it is freed when the last one lets go.
+struct NavMeshSnapshot
+{
+	uint32_t version = 0;
+
+	// Indexed by profile.
+	std::vector<std::shared_ptr<dtNavMesh>> navMeshes;
+};
+
+// Collects the tiles of a build from the build workers and periodically publishes
+// them as a new snapshot. Workers only ever hand over tile data, and readers only
+// ever see complete snapshots, so no mesh is modified while it can be read.
+//
+// Each snapshot gets its own copy of the tiles, since detour writes the links of a
+// tile into its data.
+
+class TileSnapshotPublisher
+{
+public:
+	TileSnapshotPublisher() = default;
+	~TileSnapshotPublisher();
+
+	TileSnapshotPublisher(const TileSnapshotPublisher&) = delete;
+	TileSnapshotPublisher& operator=(const TileSnapshotPublisher&) = delete;
+
+	// Start collecting tiles for meshes with these params, and publish a snapshot of
+	// the new tiles at most every interval. Drops the tiles and the snapshot of the
+	// previous build.
+	//
+	// Every snapshot copies all tiles so far, so one is only published once the new
+	// tiles grow the mesh by at least 1/MinGrowthDivisor, or when MaxStaleIntervals
+	// intervals passed since the last one. Copying stays proportional to the size of
+	// the mesh, instead of growing with the square of it on large zones.
+	void Start(const dtNavMeshParams& params, int profileCount, std::chrono::milliseconds interval);
+
+	// Stop publishing, after publishing the tiles that are left.
+	void Stop();
+
+	// Drop the tiles and the latest snapshot. Readers that hold the snapshot keep it.
+	void Reset();
+
+	// Add a built tile, taking ownership of data. Replaces the tile at the same
+	// location of the same profile. Thread safe.
+	void AddTile(int x, int y, int profile, uint8_t* data, int dataSize);
+
+	// The latest snapshot, or null if nothing was published since Start. Thread safe.
+	std::shared_ptr<const NavMeshSnapshot> GetSnapshot() const;
+
+private:
+	struct TileBlob
+	{
+		uint8_t* data = nullptr;
+		int dataSize = 0;
+
+		~TileBlob() { dtFree(data); }
+	};
+	using TileKey = std::tuple<int, int, int>;
+
+	static constexpr size_t MinGrowthDivisor = 8;
+	static constexpr int MaxStaleIntervals = 10;
+
+	// Build a snapshot out of the new tiles and all tiles before them, if there are
+	// enough of them or if forced. Returns true if one was published.
+	bool Publish(bool force);
+
+	// Tiles handed over since the last publish.
+	std::mutex m_pendingMutex;
+	std::vector<std::pair<TileKey, std::shared_ptr<const TileBlob>>> m_pendingTiles;
+
+	// All tiles so far, by profile and location. Publisher only.
+	std::map<TileKey, std::shared_ptr<const TileBlob>> m_tiles;
+	dtNavMeshParams m_params = {};
+	int m_profileCount = 0;
+	uint32_t m_version = 0;
+
+	// Only held to swap or copy the pointer, never while building a snapshot.
+	mutable std::mutex m_snapshotMutex;
+	std::shared_ptr<const NavMeshSnapshot> m_snapshot;
+
+	std::thread m_thread;
+	std::mutex m_stopMutex;
+	std::condition_variable m_stopped;
+	bool m_stop = false;
+};
@@ -39,9 +39,27 @@ void NavMeshTileTool::handleMenu()
 			m_meshTool->RemoveAllTiles();
 	}
 
+	bool streamToFile = m_meshTool->getStreamToFile();
+	if (ImGui::Checkbox("Stream to File", &streamToFile))
+		m_meshTool->setStreamToFile(streamToFile);
+	ImGui::SameLine();
+	mq::imgui::HelpMarker("Write tiles to the navmesh file as they are built instead of keeping\n"
+		"them all in memory. Uses less memory on large zones. The file is loaded\n"
+		"once the build completes.", 600.0f, mq::imgui::ConsoleFont);
+
 	float totalBuildTime = m_meshTool->getTotalBuildTimeMS();
 	if (totalBuildTime > 0)
 		ImGui::Text("Build Time: %.1fms", totalBuildTime);
+
+	if (m_meshTool->getBuildTrace().GetRecordCount() > 0)
+	{
+		if (ImGui::Button(ICON_MD_TIMELINE " Export Build Trace"))
+			m_meshTool->ExportBuildTrace();
+		ImGui::SameLine();
+		mq::imgui::HelpMarker("Write the time each tile and build stage took in the last build to\n"
+			"the traces folder, as a Chrome trace (open it in chrome://tracing or\n"
+			"ui.perfetto.dev) and as a CSV file.", 600.0f, mq::imgui::ConsoleFont);
+	}
 }
 
 void NavMeshTileTool::handleClick(const glm::vec3& s, const glm::vec3& p, bool shift)
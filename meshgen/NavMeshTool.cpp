@@ -3,13 +3,19 @@
 #include "meshgen/Application.h"
 #include "meshgen/ConvexVolumeTool.h"
 #include "meshgen/InputGeom.h"
+#include "meshgen/InstancedGeometry.h"
 #include "meshgen/NavMeshInfoTool.h"
 #include "meshgen/NavMeshPruneTool.h"
 #include "meshgen/NavMeshTesterTool.h"
 #include "meshgen/NavMeshTileTool.h"
 #include "meshgen/OffMeshConnectionTool.h"
+#include "meshgen/TerrainHeightfield.h"
+#include "meshgen/TileBuildContext.h"
+#include "meshgen/TileCache.h"
+#include "meshgen/TriNormals.h"
 #include "meshgen/WaypointsTool.h"
 #include "common/NavMeshData.h"
+#include "common/NavMeshFileWriter.h"
 #include "common/Utilities.h"
 #include "common/proto/NavMeshFile.pb.h"
 #include "imgui/ImGuiUtils.h"
@@ -21,13 +27,17 @@
 #include <DetourDebugDraw.h>
 #include <DetourNavMesh.h>
 #include <DetourNavMeshBuilder.h>
+#include <fmt/format.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <imgui.h>
 
+#include <algorithm>
+#include <ctime>
+#include <optional>
+
 #include <ppl.h>
-#include <agents.h>
 
 //----------------------------------------------------------------------------
 
@@ -37,6 +47,7 @@ NavMeshTool::NavMeshTool(const std::shared_ptr<NavMesh>& navMesh)
 	resetCommonSettings();
 
 	m_outputPath = new char[MAX_PATH];
+	m_rebuildTasks = std::make_unique<concurrency::task_group>();
 	setTool(new NavMeshTileTool);
 
 	m_logger = spdlog::default_logger()->clone("NavMeshTool");
@@ -49,6 +60,8 @@ NavMeshTool::NavMeshTool(const std::shared_ptr<NavMesh>& navMesh)
 
 NavMeshTool::~NavMeshTool()
 {
+	CancelBuildAllTiles();
+
 	delete[] m_outputPath;
 }
 
@@ -80,6 +93,14 @@ void NavMeshTool::NavMeshUpdated()
 	initToolStates();
 }
 
+void NavMeshTool::setConfig(const NavMeshConfig& config)
+{
+	m_config = config;
+	m_navMesh->GetNavMeshConfig() = m_config;
+
+	UpdateTileSizes();
+}
+
 void NavMeshTool::getTileStatistics(int& width, int& height, int& maxTiles) const
 {
 	width = m_tilesWidth;
@@ -169,6 +190,32 @@ void NavMeshTool::handleDebug()
 			m_drawMode = DrawMode::NAVMESH_NODES;
 		if (valid[DrawMode::NAVMESH_PORTALS] && ImGui::RadioButton("Navmesh Portals", m_drawMode == DrawMode::NAVMESH_PORTALS))
 			m_drawMode = DrawMode::NAVMESH_PORTALS;
+
+		const int profileCount = m_navMesh->GetProfileCount();
+		if (profileCount > 1)
+		{
+			const std::vector<AgentProfile>& extraProfiles = m_navMesh->GetNavMeshConfig().extraProfiles;
+			auto getProfileName = [&](int profile) -> std::string
+			{
+				if (profile == 0)
+					return "Main";
+				if (profile - 1 < (int)extraProfiles.size() && !extraProfiles[profile - 1].name.empty())
+					return extraProfiles[profile - 1].name;
+				return fmt::format("Profile {}", profile);
+			};
+
+			m_drawProfile = std::clamp(m_drawProfile, 0, profileCount - 1);
+			if (ImGui::BeginCombo("Show Profile", getProfileName(m_drawProfile).c_str()))
+			{
+				for (int profile = 0; profile < profileCount; ++profile)
+				{
+					if (ImGui::Selectable(getProfileName(profile).c_str(), profile == m_drawProfile))
+						m_drawProfile = profile;
+				}
+
+				ImGui::EndCombo();
+			}
+		}
 	}
 }
 
@@ -291,6 +338,37 @@ void NavMeshTool::handleTools()
 			ImGui::SliderFloat("Max Climb", &m_config.agentMaxClimb, 0.1f, 15.0f, "%.1f");
 			ImGui::SliderFloat("Max Slope", &m_config.agentMaxSlope, 0.0f, 90.0f, "%.1f");
 		}
+		if (ImGui::TreeNodeEx("Extra Profiles", ImGuiTreeNodeFlags_NoTreePushOnOpen)) {
+			ImGui::TextWrapped("Meshes for agents of other sizes, built along with the main mesh from the same rasterized geometry.");
+
+			int removeProfile = -1;
+			for (size_t i = 0; i < m_config.extraProfiles.size(); ++i)
+			{
+				AgentProfile& profile = m_config.extraProfiles[i];
+				ImGui::PushID(static_cast<int>(i));
+
+				char name[64] = { 0 };
+				strncpy_s(name, profile.name.c_str(), _TRUNCATE);
+				if (ImGui::InputText("Name", name, sizeof(name)))
+					profile.name = name;
+
+				ImGui::SliderFloat("Height", &profile.agentHeight, 0.1f, 15.0f, "%.1f");
+				ImGui::SliderFloat("Radius", &profile.agentRadius, 0.1f, 15.0f, "%.1f");
+				ImGui::SliderFloat("Max Climb", &profile.agentMaxClimb, 0.1f, 15.0f, "%.1f");
+
+				if (ImGui::Button("Remove"))
+					removeProfile = static_cast<int>(i);
+
+				ImGui::Separator();
+				ImGui::PopID();
+			}
+
+			if (removeProfile >= 0)
+				m_config.extraProfiles.erase(m_config.extraProfiles.begin() + removeProfile);
+
+			if (ImGui::Button("Add Profile"))
+				m_config.extraProfiles.emplace_back();
+		}
 
 		if (m_geom && ImGui::TreeNodeEx("Bounding Box", ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_NoTreePushOnOpen)) {
 			glm::vec3 min, max;
@@ -400,6 +478,49 @@ void NavMeshTool::handleTools()
 
 			ImGui::SliderFloat("Sample Distance", &m_config.detailSampleDist, 0.0f, 0.9f, "%.2f");
 			ImGui::SliderFloat("Max Sample Error", &m_config.detailSampleMaxError, 0.0f, 100.0f, "%.1f");
+
+			// Tile Cache
+			ImGui::Text("Tile Cache");
+			ImGui::SameLine();
+			static const char* TileCacheHelp =
+				"Reuse Cached Tiles:\n"
+				"  - Tiles are stored in the output directory, keyed by their inputs. If a tile's\n"
+				"    geometry, settings, areas and connections are unchanged, the cached tile is\n"
+				"    reused instead of being built again.\n";
+			mq::imgui::HelpMarker(TileCacheHelp, 600.0f, mq::imgui::ConsoleFont);
+
+			ImGui::Checkbox("Reuse Cached Tiles", &m_useTileCache);
+
+			// Heightfield Cache
+			ImGui::Text("Heightfield Cache");
+			ImGui::SameLine();
+			static const char* HeightfieldCacheHelp =
+				"Cache Heightfields:\n"
+				"  - Keeps the rasterized and filtered heightfield of each tile in memory. When\n"
+				"    only region, polygonization or detail mesh settings change, rebuilds start\n"
+				"    from the cached heightfield instead of rasterizing the geometry again.\n"
+				"    Changing the cell size, agent height, radius, climb or slope invalidates it.\n\n"
+				"Budget:\n"
+				"  - Memory used by the cache. The least recently used tiles are dropped when\n"
+				"    it is exceeded.\n";
+			mq::imgui::HelpMarker(HeightfieldCacheHelp, 600.0f, mq::imgui::ConsoleFont);
+
+			if (ImGui::Checkbox("Cache Heightfields", &m_useHeightfieldCache) && !m_useHeightfieldCache)
+			{
+				m_heightfieldCache.Clear();
+			}
+
+			if (m_useHeightfieldCache)
+			{
+				if (ImGui::SliderInt("Budget (MB)", &m_heightfieldCacheBudgetMB, 64, 8192))
+				{
+					m_heightfieldCache.SetBudget(static_cast<size_t>(m_heightfieldCacheBudgetMB) * 1024 * 1024);
+				}
+
+				HeightfieldCache::Stats stats = m_heightfieldCache.GetStats();
+				ImGui::Text("%d tiles, %.1f MB (%d hits, %d misses)", stats.entries,
+					stats.memoryUsed / (1024.0f * 1024.0f), stats.hits, stats.misses);
+			}
 		}
 	}
 }
@@ -416,15 +537,27 @@ void NavMeshTool::handleRender()
 	// Draw mesh
 	if (m_drawMode != DrawMode::NAVMESH_TRANS)
 	{
-		// Draw mesh
-		duDebugDrawTriMeshSlope(&dd,
+		// Draw mesh, in BVH order to use the precomputed normals.
+		const TriMeshBVH* bvh = m_geom->getBVH();
+		DebugDrawTriMeshSlope(&dd,
 			m_geom->getMeshLoader()->getVerts(),
-			m_geom->getMeshLoader()->getVertCount(),
-			m_geom->getMeshLoader()->getTris(),
-			m_geom->getMeshLoader()->getNormals(),
-			m_geom->getMeshLoader()->getTriCount(),
+			bvh->GetTris(),
+			bvh->GetNormalsX(),
+			bvh->GetNormalsY(),
+			bvh->GetNormalsZ(),
+			bvh->GetTriCount(),
 			m_config.agentMaxSlope,
 			texScale);
+
+		if (const TerrainHeightfield* terrain = m_geom->getMeshLoader()->GetTerrainHeightfield())
+		{
+			terrain->DebugDraw(&dd, m_config.agentMaxSlope, texScale);
+		}
+
+		if (const InstancedGeometry* instances = m_geom->getMeshLoader()->GetInstancedGeometry())
+		{
+			instances->DebugDraw(&dd, m_config.agentMaxSlope, texScale);
+		}
 		//m_geom->drawOffMeshConnections(&dd);
 	}
 
@@ -452,8 +585,9 @@ void NavMeshTool::handleRender()
 			|| m_drawMode == DrawMode::NAVMESH_PORTALS
 			|| m_drawMode == DrawMode::NAVMESH_INVIS))
 	{
-		auto navMesh = m_navMesh->GetNavMesh();
-		auto navQuery = m_navMesh->GetNavMeshQuery();
+		const int drawProfile = m_drawProfile < m_navMesh->GetProfileCount() ? m_drawProfile : 0;
+		auto navMesh = m_navMesh->GetNavMesh(drawProfile);
+		auto navQuery = m_navMesh->GetNavMeshQuery(drawProfile);
 
 		if (navMesh && navQuery)
 		{
@@ -562,8 +696,21 @@ void NavMeshTool::handleRenderOverlay(const glm::mat4& proj,
 
 void NavMeshTool::handleGeometryChanged(class InputGeom* geom)
 {
+	// Rebuilds and builds in progress read the old geometry. The snapshots of the
+	// build of all tiles are no longer wanted either.
+	CancelBuildAllTiles();
+	m_tilePublisher.Reset();
+	m_snapshotMesh.reset();
+
 	m_geom = geom;
 
+	// Cached heightfields and tile timings are for the old geometry.
+	m_heightfieldCache.Clear();
+	m_tileBuildTimes.clear();
+	m_tileBuildTimesWidth = 0;
+	m_tileBuildTimesHeight = 0;
+	m_tileBuildTimesKey = 0;
+
 	if (m_tool)
 	{
 		m_tool->reset();
@@ -581,30 +728,30 @@ bool NavMeshTool::handleBuild()
 		return false;
 	}
 
-	std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(),
-		[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
-
-	m_navMesh->SetNavMesh(navMesh, false);
+	// Every tile is about to be built anyway.
+	CancelTileRebuilds(false);
 
-	dtNavMeshParams params;
-	glm::vec3 boundsMin = m_navMesh->GetNavMeshBoundsMin();
-	rcVcopy(params.orig, glm::value_ptr(boundsMin));
-	params.tileWidth = m_config.tileSize * m_config.cellSize;
-	params.tileHeight = m_config.tileSize * m_config.cellSize;
-	params.maxTiles = m_tilesWidth * m_tilesHeight;
-	params.maxPolys = m_maxPolysPerTile * params.maxTiles;
+	std::vector<std::shared_ptr<dtNavMesh>> navMeshes = createNavMeshes();
+	if (navMeshes.empty())
+		return false;
 
-	dtStatus status;
+	if (m_streamToFile)
+	{
+		// The mesh stays empty while the tiles are written to the navmesh file, it is
+		// loaded from there once complete.
+		if (m_navMesh->GetFullFilePath().empty())
+		{
+			SPDLOG_LOGGER_ERROR(m_logger, "buildTiledNavigation: No navmesh file to stream tiles to.");
+			return false;
+		}
 
-	status = navMesh->init(&params);
-	if (dtStatusFailed(status))
+		StreamAllTiles(m_navMesh->GetFullFilePath());
+	}
+	else
 	{
-		SPDLOG_LOGGER_ERROR(m_logger, "buildTiledNavigation: Could not init navmesh.");
-		return false;
+		BuildAllTiles(navMeshes);
 	}
 
-	BuildAllTiles(navMesh);
-
 	if (m_tool)
 	{
 		m_tool->init(this);
@@ -615,6 +762,43 @@ bool NavMeshTool::handleBuild()
 	return true;
 }
 
+std::vector<std::shared_ptr<dtNavMesh>> NavMeshTool::createNavMeshes()
+{
+	dtNavMeshParams params;
+	getNavMeshParams(params);
+
+	std::vector<std::shared_ptr<dtNavMesh>> navMeshes;
+	for (size_t i = 0; i < 1 + m_config.extraProfiles.size(); ++i)
+	{
+		std::shared_ptr<dtNavMesh> navMesh(dtAllocNavMesh(),
+			[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+
+		dtStatus status = navMesh->init(&params);
+		if (dtStatusFailed(status))
+		{
+			SPDLOG_LOGGER_ERROR(m_logger, "buildTiledNavigation: Could not init navmesh.");
+			return {};
+		}
+
+		navMeshes.push_back(std::move(navMesh));
+	}
+
+	m_navMesh->SetNavMesh(navMeshes[0], false);
+	m_navMesh->SetProfileNavMeshes({ navMeshes.begin() + 1, navMeshes.end() });
+
+	return navMeshes;
+}
+
+void NavMeshTool::getNavMeshParams(dtNavMeshParams& params) const
+{
+	glm::vec3 boundsMin = m_navMesh->GetNavMeshBoundsMin();
+	rcVcopy(params.orig, glm::value_ptr(boundsMin));
+	params.tileWidth = m_config.tileSize * m_config.cellSize;
+	params.tileHeight = m_config.tileSize * m_config.cellSize;
+	params.maxTiles = m_tilesWidth * m_tilesHeight;
+	params.maxPolys = m_maxPolysPerTile * params.maxTiles;
+}
+
 void NavMeshTool::GetTilePos(const glm::vec3& pos, int& tx, int& ty)
 {
 	if (!m_geom) return;
@@ -630,30 +814,39 @@ void NavMeshTool::RemoveTile(const glm::vec3& pos)
 {
 	if (!m_geom) return;
 
-	auto navMesh = m_navMesh->GetNavMesh();
-	if (!navMesh) return;
-
 	const glm::vec3& bmin = m_navMesh->GetNavMeshBoundsMin();
 
 	const float ts = m_config.tileSize * m_config.cellSize;
 	const int tx = static_cast<int>((pos[0] - bmin[0]) / ts);
 	const int ty = static_cast<int>((pos[2] - bmin[2]) / ts);
 
-	dtTileRef tileRef = navMesh->getTileRefAt(tx, ty, 0);
-	navMesh->removeTile(tileRef, nullptr, nullptr);
+	// The tile is removed from the mesh of every profile, like it is built.
+	for (int profile = 0; profile < m_navMesh->GetProfileCount(); ++profile)
+	{
+		std::shared_ptr<dtNavMesh> navMesh = m_navMesh->GetNavMesh(profile);
+		if (!navMesh)
+			continue;
+
+		dtTileRef tileRef = navMesh->getTileRefAt(tx, ty, 0);
+		navMesh->removeTile(tileRef, nullptr, nullptr);
+	}
 }
 
 void NavMeshTool::RemoveAllTiles()
 {
-	std::shared_ptr<dtNavMesh> navMesh = m_navMesh->GetNavMesh();
-	if (!navMesh) return;
-
-	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	for (int profile = 0; profile < m_navMesh->GetProfileCount(); ++profile)
 	{
-		if (const dtMeshTile* tile; ((tile = const_cast<const dtNavMesh*>(navMesh.get())->getTile(i)))
-			&& tile->header != nullptr)
+		std::shared_ptr<dtNavMesh> navMesh = m_navMesh->GetNavMesh(profile);
+		if (!navMesh)
+			continue;
+
+		for (int i = 0; i < navMesh->getMaxTiles(); ++i)
 		{
-			navMesh->removeTile(navMesh->getTileRef(tile), nullptr, nullptr);
+			if (const dtMeshTile* tile; ((tile = const_cast<const dtNavMesh*>(navMesh.get())->getTile(i)))
+				&& tile->header != nullptr)
+			{
+				navMesh->removeTile(navMesh->getTileRef(tile), nullptr, nullptr);
+			}
 		}
 	}
 }
@@ -663,6 +856,8 @@ void NavMeshTool::CancelBuildAllTiles(bool wait)
 	if (m_buildingTiles)
 		m_cancelTiles = true;
 
+	CancelTileRebuilds(wait);
+
 	if (wait && m_buildThread.joinable())
 		m_buildThread.join();
 }
@@ -686,103 +881,269 @@ void NavMeshTool::BuildTile(const glm::vec3& pos)
 	if (!m_geom) return;
 
 	const glm::vec3& bmin = m_navMesh->GetNavMeshBoundsMin();
-	const glm::vec3& bmax = m_navMesh->GetNavMeshBoundsMax();
 
 	const float ts = m_config.tileSize * m_config.cellSize;
 	const int tx = static_cast<int>((pos[0] - bmin[0]) / ts);
 	const int ty = static_cast<int>((pos[2] - bmin[2]) / ts);
 
 	glm::vec3 tileBmin, tileBmax;
+	getTileBounds(tx, ty, glm::value_ptr(tileBmin), glm::value_ptr(tileBmax));
+
+	m_ctx->resetLog();
+
+	// Start over if the meshes do not match the profiles of the current settings.
+	if (!m_navMesh->GetNavMesh() || m_navMesh->GetProfileCount() != 1 + (int)m_config.extraProfiles.size())
+	{
+		if (createNavMeshes().empty())
+			return;
+	}
+
+	auto buildContext = CreateBuildContext();
+
+	std::vector<TileMeshData> tiles;
+	buildTileMeshes(tx, ty, glm::value_ptr(tileBmin), glm::value_ptr(tileBmax), *buildContext, tiles);
+
+	addTileMeshes(tx, ty, tiles);
+
+	SPDLOG_LOGGER_DEBUG(m_logger, "Build Tile ({}, {}):", tx, ty);
+}
+
+void NavMeshTool::getTileBounds(int tx, int ty, float* tileBmin, float* tileBmax) const
+{
+	const glm::vec3& bmin = m_navMesh->GetNavMeshBoundsMin();
+	const glm::vec3& bmax = m_navMesh->GetNavMeshBoundsMax();
+	const float ts = m_config.tileSize * m_config.cellSize;
+
 	tileBmin[0] = bmin[0] + tx * ts;
 	tileBmin[1] = bmin[1];
 	tileBmin[2] = bmin[2] + ty * ts;
 
-	tileBmax[0] = bmin[0] + (tx + 1)*ts;
+	tileBmax[0] = bmin[0] + (tx + 1) * ts;
 	tileBmax[1] = bmax[1];
-	tileBmax[2] = bmin[2] + (ty + 1)*ts;
+	tileBmax[2] = bmin[2] + (ty + 1) * ts;
+}
 
-	m_ctx->resetLog();
-	auto offMeshConnections = m_navMesh->CreateOffMeshConnectionBuffer();
+void NavMeshTool::addTileMeshes(int tx, int ty, std::vector<TileMeshData>& tiles)
+{
+	for (int profile = 0; profile < (int)tiles.size(); ++profile)
+	{
+		std::shared_ptr<dtNavMesh> navMesh = m_navMesh->GetNavMesh(profile);
+		if (!navMesh)
+		{
+			dtFree(tiles[profile].data);
+			continue;
+		}
 
+		// Remove any previous data (navmesh owns and deletes the data).
+		navMesh->removeTile(navMesh->getTileRefAt(tx, ty, 0), 0, 0);
+
+		// Add tile, or leave the location empty.
+		if (tiles[profile].data)
+		{
+			// Let the navmesh own the data.
+			dtStatus status = navMesh->addTile(tiles[profile].data, tiles[profile].dataSize, DT_TILE_FREE_DATA, 0, 0);
+			if (dtStatusFailed(status))
+				dtFree(tiles[profile].data);
+		}
+	}
+
+	tiles.clear();
+}
+
+void NavMeshTool::RebuildTiles(const std::vector<dtTileRef>& tiles)
+{
+	if (!m_geom) return;
 	std::shared_ptr<dtNavMesh> navMesh = m_navMesh->GetNavMesh();
-	if (!navMesh)
-	{
-		navMesh = std::shared_ptr<dtNavMesh>(dtAllocNavMesh(),
-			[](dtNavMesh* ptr) { dtFreeNavMesh(ptr); });
+	if (!navMesh) return;
 
-		m_navMesh->SetNavMesh(navMesh, false);
+	// Refs change when tiles are replaced, so tiles are queued by location.
+	const auto due = std::chrono::steady_clock::now() + RebuildDelay;
 
-		dtNavMeshParams params;
-		rcVcopy(params.orig, glm::value_ptr(bmin));
-		params.tileWidth = m_config.tileSize * m_config.cellSize;
-		params.tileHeight = m_config.tileSize * m_config.cellSize;
-		params.maxTiles = m_tilesWidth * m_tilesHeight;
-		params.maxPolys = m_maxPolysPerTile * params.maxTiles;
+	for (dtTileRef tileRef : tiles)
+	{
+		const dtMeshTile* tile = navMesh->getTileByRef(tileRef);
+		if (!tile || !tile->header)
+			continue;
 
-		dtStatus status;
+		const TileKey key{ tile->header->x, tile->header->y };
 
-		status = navMesh->init(&params);
-		if (dtStatusFailed(status))
+		// A rebuild in progress is already out of date.
+		auto iter = m_rebuildJobs.find(key);
+		if (iter != m_rebuildJobs.end())
 		{
-			SPDLOG_LOGGER_ERROR(m_logger, "buildTiledNavigation: Could not init navmesh.");
-			return;
+			iter->second->cancelled = true;
+			m_rebuildJobs.erase(iter);
 		}
+
+		m_pendingRebuilds[key] = due;
 	}
+}
 
-	int dataSize = 0;
-	unsigned char* data = buildTileMesh(tx, ty, glm::value_ptr(tileBmin),
-		glm::value_ptr(tileBmax), offMeshConnections, dataSize);
+void NavMeshTool::CancelTileRebuilds(bool wait)
+{
+	m_pendingRebuilds.clear();
+
+	for (const auto& [key, job] : m_rebuildJobs)
+		job->cancelled = true;
+	m_rebuildJobs.clear();
+
+	if (!wait)
+		return;
 
-	// Remove any previous data (navmesh owns and deletes the data).
-	dtTileRef tileRef = navMesh->getTileRefAt(tx, ty, 0);
-	navMesh->removeTile(tileRef, 0, 0);
+	m_rebuildTasks->wait();
 
-	// Add tile, or leave the location empty.
-	if (data)
+	std::vector<std::shared_ptr<TileRebuildJob>> finished;
 	{
-		// Let the navmesh own the data.
-		dtStatus status = navMesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
-		if (dtStatusFailed(status))
-			dtFree(data);
+		std::unique_lock<std::mutex> lock(m_finishedRebuildsMutex);
+		std::swap(finished, m_finishedRebuilds);
 	}
 
-	SPDLOG_LOGGER_DEBUG(m_logger, "Build Tile ({}, {}):", tx, ty);
+	for (const auto& job : finished)
+	{
+		for (TileMeshData& tile : job->tiles)
+			dtFree(tile.data);
+	}
 }
 
-void NavMeshTool::RebuildTile(
-	const std::shared_ptr<OffMeshConnectionBuffer> connBuffer,
-	dtTileRef tileRef)
+void NavMeshTool::updateTileSnapshot()
 {
-	if (!m_geom) return;
-	const auto& navMesh = m_navMesh->GetNavMesh();
-	if (!navMesh) return;
+	if (!m_snapshotMesh)
+		return;
 
-	const dtMeshTile* tile = navMesh->getTileByRef(tileRef);
-	if (!tile || !tile->header) return;
+	// Once the build is over, the latest snapshot is the last one.
+	const bool building = m_buildingTiles;
 
-	auto bmin = tile->header->bmin;
-	auto bmax = tile->header->bmax;
+	std::shared_ptr<const NavMeshSnapshot> snapshot = m_tilePublisher.GetSnapshot();
+	if (snapshot && snapshot->version != m_snapshotVersion)
+	{
+		m_snapshotVersion = snapshot->version;
+
+		// The mesh was replaced since the build started, by a load or another build.
+		if (m_navMesh->GetNavMesh() != m_snapshotMesh)
+		{
+			m_snapshotMesh.reset();
+			return;
+		}
 
-	int dataSize = 0;
-	unsigned char* data = buildTileMesh(tile->header->x, tile->header->y, bmin, bmax, connBuffer, dataSize);
+		// The previous meshes are freed once nothing holds them anymore.
+		m_navMesh->SetNavMesh(snapshot->navMeshes[0], false);
+		m_navMesh->SetProfileNavMeshes({ snapshot->navMeshes.begin() + 1, snapshot->navMeshes.end() });
+		m_snapshotMesh = snapshot->navMeshes[0];
 
-	navMesh->removeTile(tileRef, 0, 0);
+		// Tools keep the query of the mesh they were started with.
+		if (m_tool)
+		{
+			m_tool->init(this);
+		}
+	}
 
-	if (data)
+	if (!building)
 	{
-		dtStatus status = navMesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0);
-		if (dtStatusFailed(status))
-			dtFree(data);
+		// The build thread is done with the publisher once it stopped building, but
+		// may not have exited yet.
+		if (m_buildThread.joinable())
+			m_buildThread.join();
+
+		m_tilePublisher.Reset();
+		m_snapshotMesh.reset();
 	}
+}
+
+void NavMeshTool::updateTileRebuilds()
+{
+	std::vector<std::shared_ptr<TileRebuildJob>> finished;
+	{
+		std::unique_lock<std::mutex> lock(m_finishedRebuildsMutex);
+		std::swap(finished, m_finishedRebuilds);
+	}
+
+	for (const auto& job : finished)
+	{
+		const TileKey key{ job->tx, job->ty };
+
+		auto iter = m_rebuildJobs.find(key);
+		if (iter != m_rebuildJobs.end() && iter->second == job)
+			m_rebuildJobs.erase(iter);
 
+		if (job->cancelled || job->navMesh != m_navMesh->GetNavMesh())
+		{
+			for (TileMeshData& tile : job->tiles)
+				dtFree(tile.data);
+			continue;
+		}
+
+		addTileMeshes(job->tx, job->ty, job->tiles);
+
+		SPDLOG_LOGGER_DEBUG(m_logger, "Rebuilt tile ({}, {})", job->tx, job->ty);
+	}
+
+	// Leave the mesh alone while all tiles are being built.
+	if (m_pendingRebuilds.empty() || m_buildingTiles || !m_geom)
+		return;
+
+	std::shared_ptr<dtNavMesh> navMesh = m_navMesh->GetNavMesh();
+	if (!navMesh)
+	{
+		m_pendingRebuilds.clear();
+		return;
+	}
+
+	// All tiles that are due share a snapshot of the volumes and connections.
+	std::shared_ptr<TileBuildContext> buildContext;
+	const auto now = std::chrono::steady_clock::now();
+
+	for (auto iter = m_pendingRebuilds.begin(); iter != m_pendingRebuilds.end();)
+	{
+		if (iter->second > now)
+		{
+			++iter;
+			continue;
+		}
+
+		if (!buildContext)
+			buildContext = CreateBuildContext();
+
+		auto job = std::make_shared<TileRebuildJob>();
+		job->tx = iter->first.first;
+		job->ty = iter->first.second;
+		job->navMesh = navMesh;
+
+		m_rebuildJobs[iter->first] = job;
+		iter = m_pendingRebuilds.erase(iter);
+
+		m_rebuildTasks->run([this, job, buildContext]()
+			{
+				if (!job->cancelled)
+				{
+					float bmin[3], bmax[3];
+					getTileBounds(job->tx, job->ty, bmin, bmax);
+
+					buildTileMeshes(job->tx, job->ty, bmin, bmax, *buildContext, job->tiles);
+				}
+
+				std::unique_lock<std::mutex> lock(m_finishedRebuildsMutex);
+				m_finishedRebuilds.push_back(job);
+			});
+	}
 }
 
-void NavMeshTool::RebuildTiles(const std::vector<dtTileRef>& tiles)
+std::shared_ptr<TileBuildContext> NavMeshTool::CreateBuildContext() const
 {
-	auto connBuffer = m_navMesh->CreateOffMeshConnectionBuffer();
+	// Bucketed by the tiles of this build, not those of the saved config.
+	const float tileWorldSize = m_config.tileSize * m_config.cellSize;
 
-	for (dtTileRef tileRef : tiles)
-		RebuildTile(connBuffer, tileRef);
+	auto buildContext = std::make_shared<TileBuildContext>();
+	buildContext->offMeshConnections = m_navMesh->GetOffMeshConnectionBuffer(tileWorldSize, m_config.agentRadius);
+
+	// Volumes are indexed against the border expanded tile bounds, matching the
+	// border used by buildTileMeshes.
+	const glm::vec3& bmin = m_navMesh->GetNavMeshBoundsMin();
+	const int borderSize = getTileBorderSize();
+
+	buildContext->volumes.Build(m_navMesh->GetConvexVolumes(), bmin, tileWorldSize,
+		borderSize * m_config.cellSize, m_tilesWidth, m_tilesHeight);
+
+	return buildContext;
 }
 
 void NavMeshTool::SaveNavMesh()
@@ -794,75 +1155,148 @@ void NavMeshTool::SaveNavMesh()
 	m_navMesh->SaveNavMeshFile();
 }
 
-struct TileData
+void NavMeshTool::BuildAllTiles(const std::vector<std::shared_ptr<dtNavMesh>>& navMeshes, bool async)
 {
-	unsigned char* data = 0;
-	int length = 0;
-	int x = 0;
-	int y = 0;
-};
+	if (!m_geom) return;
+	if (m_buildingTiles) return;
+	if (navMeshes.size() != 1 + m_config.extraProfiles.size()) return;
 
-using TileDataPtr = std::shared_ptr<TileData>;
+	if (m_buildThread.joinable())
+		m_buildThread.join();
 
-class NavmeshUpdaterAgent : public concurrency::agent
-{
-public:
-	explicit NavmeshUpdaterAgent(concurrency::ISource<TileDataPtr>& dataSource,
-		const std::shared_ptr<dtNavMesh>& navMesh)
-		: m_source(dataSource)
-		, m_navMesh(navMesh)
+	// Everything the main thread reads is set up before the build starts, so that
+	// handleUpdate never sees a build in between.
+	m_buildingTiles = true;
+	m_cancelTiles = false;
+	m_snapshotMesh = navMeshes[0];
+	m_snapshotVersion = 0;
+
+	// Workers hand their tiles to the publisher, which puts them in new meshes that
+	// handleUpdate switches to. The meshes being drawn are never modified.
+	m_tilePublisher.Start(*navMeshes[0]->getParams(), (int)navMeshes.size(), SnapshotInterval);
+
+	// Taken here, the volumes and connections are only edited on this thread.
+	auto buildContext = CreateBuildContext();
+
+	auto build = [this, buildContext]()
 	{
+		buildAllTiles(*buildContext, [this](int x, int y, int profile, uint8_t* data, int dataSize)
+			{
+				m_tilePublisher.AddTile(x, y, profile, data, dataSize);
+			});
+
+		m_tilePublisher.Stop();
+
+		m_buildingTiles = false;
+	};
+
+	// if async, invoke on a new thread
+	if (async)
+	{
+		m_buildThread = std::thread(build);
+		return;
 	}
 
-protected:
-	virtual void run() override
+	build();
+
+	// Switch to the finished meshes right away.
+	updateTileSnapshot();
+}
+
+bool NavMeshTool::StreamAllTiles(const std::string& filename, bool async, int shard, int shardCount)
+{
+	if (!m_geom) return false;
+	if (m_buildingTiles) return false;
+	if (filename.empty()) return false;
+
+	if (m_buildThread.joinable())
+		m_buildThread.join();
+
+	// Marked before the build thread starts, so that nothing else can start a build
+	// in between and a cancel right after this returns isn't lost.
+	m_buildingTiles = true;
+	m_cancelTiles = false;
+
+	// Taken here, the volumes and connections are only edited on this thread.
+	auto buildContext = CreateBuildContext();
+
+	auto stream = [this, filename, shard, shardCount, buildContext]()
 	{
-		TileDataPtr data = receive(m_source);
-		while (data != nullptr)
+		dtNavMeshParams params;
+		getNavMeshParams(params);
+
+		// Tiles are written as they are built. At most MaxQueuedStreamTiles compressed
+		// tiles wait for the disk, workers block beyond that.
+		NavMeshFileWriter writer(MaxQueuedStreamTiles);
+		if (!writer.Open(filename))
 		{
-			// Remove any previous data (navmesh owns and deletes the data).
-			m_navMesh->removeTile(m_navMesh->getTileRefAt(data->x, data->y, 0), 0, 0);
+			SPDLOG_LOGGER_ERROR(m_logger, "Could not open {} for writing", filename);
+			return false;
+		}
 
-			// Let the navmesh own the data.
-			dtStatus status = m_navMesh->addTile(data->data, data->length, DT_TILE_FREE_DATA, 0, 0);
-			if (dtStatusFailed(status))
+		std::atomic<bool> writeFailed = false;
+
+		buildAllTiles(*buildContext, [this, &writer, &writeFailed](int, int, int profile, uint8_t* data, int dataSize)
 			{
-				dtFree(data->data);
-			}
+				// Tiles are saved without a reference, they get one when the file is loaded.
+				if (!writer.AddTile(0, data, dataSize, profile) && !writeFailed.exchange(true))
+				{
+					m_cancelTiles = true;
+				}
 
-			data = receive(m_source);
-		}
+				dtFree(data);
+			}, shard, shardCount);
 
-		done();
-	}
+		bool result = false;
 
-private:
-	concurrency::ISource<TileDataPtr>& m_source;
-	std::shared_ptr<dtNavMesh> m_navMesh;
-};
+		if (writeFailed)
+		{
+			SPDLOG_LOGGER_ERROR(m_logger, "Failed to write tiles to {}, build stopped", filename);
+			writer.Abort();
+		}
+		else if (m_cancelTiles)
+		{
+			writer.Abort();
+		}
+		else
+		{
+			m_navMesh->GetNavMeshConfig() = m_config;
 
-void NavMeshTool::BuildAllTiles(const std::shared_ptr<dtNavMesh>& navMesh, bool async)
-{
-	if (!m_geom) return;
-	if (m_buildingTiles) return;
-	if (!navMesh) return;
+			if (m_navMesh->FinishNavMeshFile(writer, params, 1 + (int)m_config.extraProfiles.size()))
+			{
+				SPDLOG_LOGGER_INFO(m_logger, "Wrote {} tiles to {}", writer.GetTileCount(), filename);
+				m_streamedMeshReady = true;
+				result = true;
+			}
+			else
+			{
+				SPDLOG_LOGGER_ERROR(m_logger, "Failed to save navmesh to {}", filename);
+			}
+		}
+
+		return result;
+	};
 
 	// if async, invoke on a new thread
 	if (async)
 	{
-		if (m_buildThread.joinable())
-			m_buildThread.join();
-
-		m_buildThread = std::thread([this, navMesh]()
+		m_buildThread = std::thread([this, stream]()
 			{
-				BuildAllTiles(navMesh, false);
+				stream();
+				m_buildingTiles = false;
 			});
-		return;
+		return true;
 	}
 
-	m_buildingTiles = true;
-	m_cancelTiles = false;
+	const bool result = stream();
+	m_buildingTiles = false;
+	return result;
+}
 
+void NavMeshTool::buildAllTiles(const TileBuildContext& buildContext,
+	const std::function<void(int x, int y, int profile, uint8_t* data, int dataSize)>& tileBuilt,
+	int shard, int shardCount)
+{
 	const glm::vec3& bmin = m_navMesh->GetNavMeshBoundsMin();
 	const glm::vec3& bmax = m_navMesh->GetNavMeshBoundsMax();
 	int gw = 0, gh = 0;
@@ -873,30 +1307,69 @@ void NavMeshTool::BuildAllTiles(const std::shared_ptr<dtNavMesh>& navMesh, bool
 	const float tcs = m_config.tileSize * m_config.cellSize;
 
 	m_tilesBuilt = 0;
-
-	auto offMeshConnections = m_navMesh->CreateOffMeshConnectionBuffer();
+	m_tilesScheduled = 0;
+	m_tilesFromCache = 0;
+	m_tilesRasterized = 0;
+	m_trisTouched = 0;
+
+	// Tiles vary wildly in cost, from empty water to dense cities. Dispatch the
+	// most expensive ones first so that the tail of the build is made of cheap
+	// tiles and all workers stay busy until the end.
+	const uint64_t settingsKey = computeBuildSettingsKey();
+	std::vector<float> costs;
+	const bool fromTimings = estimateTileCosts(tw, th, settingsKey, bmin, bmax, costs);
+
+	// A shard holds every shardCount-th tile, which spreads cheap and expensive
+	// areas evenly over the shards.
+	std::vector<int> order;
+	order.reserve(costs.size() / shardCount + 1);
+	for (int i = shard; i < (int)costs.size(); i += shardCount)
+		order.push_back(i);
+	std::stable_sort(order.begin(), order.end(),
+		[&costs](int a, int b) { return costs[a] > costs[b]; });
+
+	std::vector<float> tileBuildTimes(costs.size(), -1.0f);
+
+	double buildCostTotal = 0.0;
+	for (int index : order)
+		buildCostTotal += costs[index];
+	m_buildCostTotal = buildCostTotal;
+	m_buildCostDone = 0.0;
+	m_buildStartTime = std::chrono::steady_clock::now();
+	m_tilesScheduled = (int)order.size();
+
+	SPDLOG_LOGGER_DEBUG(m_logger, "Scheduling {} tiles by {}", order.size(),
+		fromTimings ? "previous build times" : "triangle counts");
 
 	//concurrency::CurrentScheduler::Create(concurrency::SchedulerPolicy(1, concurrency::MaxConcurrency, 3));
 
-	concurrency::unbounded_buffer<TileDataPtr> agentTiles;
-	NavmeshUpdaterAgent updater_agent(agentTiles, navMesh);
-
-	updater_agent.start();
-
 	// Start the build process.
 	m_ctx->startTimer(RC_TIMER_TEMP);
 
+	// One task per worker, each pulling the next most expensive tile. Tasks queued
+	// to a task_group do not run in the order they are queued, so the tiles are
+	// handed out from a shared index instead.
+	std::atomic<int> nextTile = 0;
+	const int workerCount = std::min((int)concurrency::GetProcessorCount(), (int)order.size());
+
+	m_buildTrace.Reset();
+
 	concurrency::task_group tasks;
-	for (int x = 0; x < tw; x++)
+	for (int worker = 0; worker < workerCount; ++worker)
 	{
-		for (int y = 0; y < th; y++)
-		{
-			tasks.run([this, x, y, &bmin, &bmax, tcs, &agentTiles, offMeshConnections]()
+		tasks.run([&, tcs, worker]()
+			{
+				for (int next = nextTile++; next < (int)order.size() && !m_cancelTiles; next = nextTile++)
 				{
-					if (m_cancelTiles)
-						return;
+					const int index = order[next];
+					const int x = index % tw;
+					const int y = index / tw;
 
-					++m_tilesBuilt;
+					TileBuildRecord record;
+					record.x = x;
+					record.y = y;
+					record.worker = worker;
+					record.start = TileBuildRecord::clock::now();
 
 					glm::vec3 tileBmin, tileBmax;
 					tileBmin[0] = bmin[0] + x * tcs;
@@ -907,42 +1380,219 @@ void NavMeshTool::BuildAllTiles(const std::shared_ptr<dtNavMesh>& navMesh, bool
 					tileBmax[1] = bmax[1];
 					tileBmax[2] = bmin[2] + (y + 1)*tcs;
 
-					int dataSize = 0;
-					uint8_t* data = buildTileMesh(x, y, glm::value_ptr(tileBmin),
-						glm::value_ptr(tileBmax), offMeshConnections, dataSize);
+					std::vector<TileMeshData> tiles;
+					buildTileMeshes(x, y, glm::value_ptr(tileBmin), glm::value_ptr(tileBmax),
+						buildContext, tiles, &record);
 
-					if (data)
+					for (int profile = 0; profile < (int)tiles.size(); ++profile)
 					{
-						TileDataPtr tileData = std::make_shared<TileData>();
-						tileData->data = data;
-						tileData->length = dataSize;
-						tileData->x = x;
-						tileData->y = y;
-
-						asend(agentTiles, tileData);
+						if (tiles[profile].data)
+						{
+							tileBuilt(x, y, profile, tiles[profile].data, tiles[profile].dataSize);
+						}
 					}
-				});
-		}
-	}
 
-	tasks.wait();
+					record.end = TileBuildRecord::clock::now();
+					record.dataSize = tiles[0].data ? tiles[0].dataSize : 0;
+					m_buildTrace.Add(record);
 
-	// send terminator
-	asend(agentTiles, TileDataPtr());
+					// A tile loaded from the tile cache says nothing about what building it costs.
+					if (!record.fromTileCache)
+						tileBuildTimes[index] = std::chrono::duration<float, std::milli>(record.end - record.start).count();
 
-	concurrency::agent::wait(&updater_agent);
+					m_buildCostDone += costs[index];
+					++m_tilesBuilt;
+				}
+			});
+	}
 
+	tasks.wait();
 
 	// Start the build process.
 	m_ctx->stopTimer(RC_TIMER_TEMP);
 
 	m_totalBuildTimeMs = m_ctx->getAccumulatedTime(RC_TIMER_TEMP) / 1000.0f;
 
-	m_buildingTiles = false;
+	// Keep the timings for scheduling the next build. Tiles skipped by a cancelled
+	// build or loaded from the tile cache keep their previous timing, as long as it
+	// was measured with the same settings.
+	if (m_tileBuildTimesWidth == tw && m_tileBuildTimesHeight == th && m_tileBuildTimesKey == settingsKey)
+	{
+		for (size_t i = 0; i < tileBuildTimes.size(); ++i)
+		{
+			if (tileBuildTimes[i] < 0.0f)
+				tileBuildTimes[i] = m_tileBuildTimes[i];
+		}
+	}
+	m_tileBuildTimes = std::move(tileBuildTimes);
+	m_tileBuildTimesWidth = tw;
+	m_tileBuildTimesHeight = th;
+	m_tileBuildTimesKey = settingsKey;
+
+	SPDLOG_LOGGER_INFO(m_logger, "Built {} tiles in {:.2f} ms ({} reused from tile cache)",
+		m_tilesBuilt.load(), m_totalBuildTimeMs.load(), m_tilesFromCache.load());
+
+	if (m_tilesRasterized > 0)
+	{
+		SPDLOG_LOGGER_INFO(m_logger, "Rasterized {} tiles, {:.1f} triangles per tile on average",
+			m_tilesRasterized.load(), static_cast<double>(m_trisTouched) / m_tilesRasterized);
+	}
+
+	if (m_useHeightfieldCache)
+	{
+		HeightfieldCache::Stats stats = m_heightfieldCache.GetStats();
+		SPDLOG_LOGGER_INFO(m_logger, "Heightfield cache: {} tiles, {:.1f} MB, {} hits, {} misses",
+			stats.entries, stats.memoryUsed / (1024.0 * 1024.0), stats.hits, stats.misses);
+	}
 }
 
-deleting_unique_ptr<rcCompactHeightfield> NavMeshTool::rasterizeGeometry(rcConfig& cfg) const
+uint64_t NavMeshTool::computeBuildSettingsKey() const
 {
+	// Volumes, areas and connections of the navmesh, and the settings being edited,
+	// which may not have been copied to the navmesh yet.
+	ContentHash hash(m_navMesh->GetBuildSettingsHash());
+
+	const glm::vec3& bmin = m_navMesh->GetNavMeshBoundsMin();
+	const glm::vec3& bmax = m_navMesh->GetNavMeshBoundsMax();
+	for (int i = 0; i < 3; ++i)
+	{
+		hash.Update(bmin[i]);
+		hash.Update(bmax[i]);
+	}
+
+	hash.Update(m_config.tileSize);
+	hash.Update(m_config.cellSize);
+	hash.Update(m_config.cellHeight);
+	hash.Update(m_config.agentHeight);
+	hash.Update(m_config.agentRadius);
+	hash.Update(m_config.agentMaxClimb);
+	hash.Update(m_config.agentMaxSlope);
+	hash.Update(m_config.regionMinSize);
+	hash.Update(m_config.regionMergeSize);
+	hash.Update(m_config.edgeMaxLen);
+	hash.Update(m_config.edgeMaxError);
+	hash.Update(m_config.vertsPerPoly);
+	hash.Update(m_config.detailSampleDist);
+	hash.Update(m_config.detailSampleMaxError);
+	hash.Update(m_config.partitionType);
+
+	hash.Update(m_config.extraProfiles.size());
+	for (const AgentProfile& profile : m_config.extraProfiles)
+	{
+		hash.Update(profile.agentHeight);
+		hash.Update(profile.agentRadius);
+		hash.Update(profile.agentMaxClimb);
+	}
+
+	return hash.Get();
+}
+
+bool NavMeshTool::estimateTileCosts(int tw, int th, uint64_t settingsKey, const glm::vec3& bmin,
+	const glm::vec3& bmax, std::vector<float>& costs) const
+{
+	const int tileCount = tw * th;
+	costs.assign(tileCount, 0.0f);
+
+	// Time measured by the previous build, if it built every tile of the same grid
+	// with the same settings.
+	if (m_tileBuildTimesWidth == tw && m_tileBuildTimesHeight == th && m_tileBuildTimesKey == settingsKey
+		&& std::all_of(m_tileBuildTimes.begin(), m_tileBuildTimes.end(), [](float t) { return t >= 0.0f; }))
+	{
+		costs = m_tileBuildTimes;
+		return true;
+	}
+
+	// Otherwise count the triangles that will be rasterized into each tile, plus a
+	// per cell term for the passes that every tile pays for. Terrain is sampled
+	// once per cell instead of being rasterized as triangles.
+	const TriMeshBVH* bvh = m_geom->getBVH();
+	const InstancedGeometry* instances = m_geom->getMeshLoader()->GetInstancedGeometry();
+	const TerrainHeightfield* terrain = m_geom->getMeshLoader()->GetTerrainHeightfield();
+
+	const float tcs = m_config.tileSize * m_config.cellSize;
+	const float border = getTileBorderSize() * m_config.cellSize;
+	const float cellCost = terrain ? 1.0f : 0.1f;
+	const float baseCost = m_config.tileSize * m_config.tileSize * cellCost;
+
+	concurrency::parallel_for(0, tileCount, [&](int index)
+		{
+			const int x = index % tw;
+			const int y = index / tw;
+
+			const float tileBmin[3] = { bmin[0] + x * tcs - border, bmin[1], bmin[2] + y * tcs - border };
+			const float tileBmax[3] = { bmin[0] + (x + 1) * tcs + border, bmax[1], bmin[2] + (y + 1) * tcs + border };
+
+			thread_local std::vector<int> leaves;
+			thread_local std::vector<int> iid;
+
+			int64_t tris = 0;
+			const int nleaves = bvh ? bvh->QueryBox(tileBmin, tileBmax, leaves) : 0;
+			for (int i = 0; i < nleaves; ++i)
+				tris += bvh->GetNode(leaves[i]).count;
+
+			const int niid = instances ? instances->QueryBox(tileBmin, tileBmax, iid) : 0;
+			for (int i = 0; i < niid; ++i)
+				tris += instances->GetModel(instances->GetInstance(iid[i]).model).triCount;
+
+			costs[index] = baseCost + static_cast<float>(tris);
+		});
+
+	return false;
+}
+
+NavMeshTool::BuildProgress NavMeshTool::getBuildProgress() const
+{
+	BuildProgress progress;
+	progress.tilesBuilt = m_tilesBuilt;
+	progress.tilesTotal = m_tilesScheduled;
+	if (progress.tilesTotal == 0)
+	{
+		progress.tilesTotal = m_tilesCount;
+		return progress;
+	}
+
+	progress.elapsedSeconds = std::chrono::duration<float>(
+		std::chrono::steady_clock::now() - m_buildStartTime.load()).count();
+
+	const double total = m_buildCostTotal;
+	const double done = m_buildCostDone;
+	if (total > 0.0)
+		progress.fraction = static_cast<float>(std::min(done / total, 1.0));
+
+	// Wait for a few tiles before extrapolating.
+	if (done > 0.0 && progress.tilesBuilt >= std::min(8, progress.tilesTotal))
+	{
+		progress.etaSeconds = static_cast<float>(progress.elapsedSeconds
+			* std::max(total - done, 0.0) / done);
+	}
+
+	return progress;
+}
+
+std::string NavMeshTool::ExportBuildTrace() const
+{
+	if (m_buildTrace.GetRecordCount() == 0)
+		return std::string();
+
+	char timestamp[32] = { 0 };
+	std::time_t now = std::time(nullptr);
+	std::tm localTime;
+	localtime_s(&localTime, &now);
+	std::strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", &localTime);
+
+	const std::string basePath = fmt::format("{}\\traces\\{}-{}", m_outputPath, m_navMesh->GetZoneName(), timestamp);
+	if (!m_buildTrace.Export(basePath, m_navMesh->GetZoneName()))
+		return std::string();
+
+	SPDLOG_LOGGER_INFO(m_logger, "Exported build trace of {} tiles to {}.json and {}.csv",
+		m_buildTrace.GetRecordCount(), basePath, basePath);
+	return basePath;
+}
+
+deleting_unique_ptr<rcHeightfield> NavMeshTool::rasterizeGeometry(const rcConfig& cfg, TileBuildRecord* record) const
+{
+	std::optional<ScopedBuildStage> stage(std::in_place, record, BuildStage::Rasterize);
+
 	// Allocate voxel heightfield where we rasterize our input data to.
 	deleting_unique_ptr<rcHeightfield> solid(rcAllocHeightfield(),
 		[](rcHeightfield* hf) { rcFreeHeightField(hf); });
@@ -955,51 +1605,103 @@ deleting_unique_ptr<rcCompactHeightfield> NavMeshTool::rasterizeGeometry(rcConfi
 
 	const float* verts = m_geom->getMeshLoader()->getVerts();
 	const int nverts = m_geom->getMeshLoader()->getVertCount();
-	const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
+	const TriMeshBVH* bvh = m_geom->getBVH();
 
 	// Allocate array that can hold triangle flags.
 	// If you have multiple meshes you need to process, allocate
 	// and array which can hold the max number of triangles you need to process.
 
-	std::unique_ptr<unsigned char[]> triareas(new unsigned char[chunkyMesh->maxTrisPerChunk]);
+	std::unique_ptr<unsigned char[]> triareas(new unsigned char[bvh->GetMaxTrisPerLeaf()]);
+
+	// Terrain is sampled straight from its height grid, only the remaining
+	// geometry needs to be rasterized as triangles.
+	int terrainColumns = 0;
+	if (const TerrainHeightfield* terrain = m_geom->getMeshLoader()->GetTerrainHeightfield())
+	{
+		terrainColumns = terrain->Rasterize(m_ctx, cfg.walkableSlopeAngle, *solid, cfg.walkableClimb);
+	}
 
-	float tbmin[2], tbmax[2];
-	tbmin[0] = cfg.bmin[0];
-	tbmin[1] = cfg.bmin[2];
-	tbmax[0] = cfg.bmax[0];
-	tbmax[1] = cfg.bmax[2];
-	int cid[512];// TODO: Make grow when returning too many items.
-	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
-	if (!ncid)
+	// Leaf and instance lists are reused by each thread between tiles.
+	thread_local std::vector<int> cid;
+	thread_local std::vector<int> iid;
+	const int ncid = bvh->QueryBox(cfg.bmin, cfg.bmax, cid);
+
+	const InstancedGeometry* instances = m_geom->getMeshLoader()->GetInstancedGeometry();
+	const int niid = instances ? instances->QueryBox(cfg.bmin, cfg.bmax, iid) : 0;
+
+	if (!ncid && !niid && !terrainColumns)
 		return nullptr;
 
+	int64_t trisTouched = 0;
+
+	// Placed models are transformed into a scratch buffer one instance at a time.
+	// Their normals depend on the transform, so they are computed here.
+	thread_local std::vector<float> iverts;
+	thread_local std::vector<float> inormals;
+	thread_local std::vector<unsigned char> iareas;
+	for (int i = 0; i < niid; ++i)
+	{
+		const int niverts = instances->TransformInstance(iid[i], iverts);
+
+		const InstancedModel& model = instances->GetModel(instances->GetInstance(iid[i]).model);
+		const int* itris = instances->GetModelTris(model);
+		const int nitris = static_cast<int>(model.triCount);
+		trisTouched += nitris;
+
+		inormals.resize(static_cast<size_t>(nitris) * 3);
+		ComputeTriNormals(iverts.data(), itris, nitris,
+			inormals.data(), inormals.data() + nitris, inormals.data() + 2 * nitris);
+
+		iareas.assign(nitris, 0);
+		MarkWalkableTriangles(cfg.walkableSlopeAngle, inormals.data() + nitris, nitris, iareas.data());
+
+		rcRasterizeTriangles(m_ctx, iverts.data(), niverts, itris, iareas.data(), nitris, *solid, cfg.walkableClimb);
+	}
+
 	for (int i = 0; i < ncid; ++i)
 	{
-		const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
-		const int* ctris = &chunkyMesh->tris[node.i * 3];
-		const int nctris = node.n;
+		const TriMeshBVHNode& node = bvh->GetNode(cid[i]);
+		const int* ctris = bvh->GetLeafTris(node);
+		const int nctris = node.count;
+		trisTouched += nctris;
 
+		// Normals were computed when the BVH was built.
 		memset(triareas.get(), 0, nctris * sizeof(unsigned char));
-		rcMarkWalkableTriangles(m_ctx, cfg.walkableSlopeAngle,
-			verts, nverts, ctris, nctris, triareas.get());
+		MarkWalkableTriangles(cfg.walkableSlopeAngle, bvh->GetLeafNormalsY(node), nctris, triareas.get());
 
 		rcRasterizeTriangles(m_ctx, verts, nverts, ctris, triareas.get(), nctris, *solid, cfg.walkableClimb);
 	}
 
+	m_trisTouched += trisTouched;
+	++m_tilesRasterized;
+
+	if (record)
+		record->inputTriangles = static_cast<int>(trisTouched);
+
+	return solid;
+}
+
+deleting_unique_ptr<rcCompactHeightfield> NavMeshTool::filterHeightfield(const rcConfig& cfg, rcHeightfield& solid,
+	TileBuildRecord* record) const
+{
+	std::optional<ScopedBuildStage> stage(std::in_place, record, BuildStage::Filter);
+
 	// Once all geometry is rasterized, we do initial pass of filtering to
 	// remove unwanted overhangs caused by the conservative rasterization
 	// as well as filter spans where the character cannot possibly stand.
-	rcFilterLowHangingWalkableObstacles(m_ctx, cfg.walkableClimb, *solid);
-	rcFilterLedgeSpans(m_ctx, cfg.walkableHeight, cfg.walkableClimb, *solid);
-	rcFilterWalkableLowHeightSpans(m_ctx, cfg.walkableHeight, *solid);
+	rcFilterLowHangingWalkableObstacles(m_ctx, cfg.walkableClimb, solid);
+	rcFilterLedgeSpans(m_ctx, cfg.walkableHeight, cfg.walkableClimb, solid);
+	rcFilterWalkableLowHeightSpans(m_ctx, cfg.walkableHeight, solid);
 
 	// Compact the heightfield so that it is faster to handle from now on.
 	// This will result more cache coherent data as well as the neighbours
 	// between walkable cells will be calculated.
+	stage.emplace(record, BuildStage::Compact);
+
 	deleting_unique_ptr<rcCompactHeightfield> chf(rcAllocCompactHeightfield(),
 		[](rcCompactHeightfield* hf) { rcFreeCompactHeightfield(hf); });
 
-	if (!rcBuildCompactHeightfield(m_ctx, cfg.walkableHeight, cfg.walkableClimb, *solid, *chf))
+	if (!rcBuildCompactHeightfield(m_ctx, cfg.walkableHeight, cfg.walkableClimb, solid, *chf))
 	{
 		SPDLOG_LOGGER_ERROR(m_logger, "buildNavigation: Could not build compact data.");
 		return nullptr;
@@ -1008,37 +1710,70 @@ deleting_unique_ptr<rcCompactHeightfield> NavMeshTool::rasterizeGeometry(rcConfi
 	return std::move(chf);
 }
 
-unsigned char* NavMeshTool::buildTileMesh(
-	const int tx,
-	const int ty,
-	const float* bmin,
-	const float* bmax,
-	const std::shared_ptr<OffMeshConnectionBuffer>& offMeshConnections,
-	int& dataSize) const
+uint64_t NavMeshTool::computeHeightfieldKey(int tx, int ty, const rcConfig& cfg, int rasterizeClimb) const
 {
-	if (!m_geom || !m_geom->getMeshLoader() || !m_geom->getChunkyMesh())
-	{
-		SPDLOG_LOGGER_ERROR(m_logger, "buildNavigation: Input mesh is not specified.");
-		return nullptr;
-	}
+	ContentHash hash;
+	hash.Update(tx);
+	hash.Update(ty);
+
+	// Heightfield extents. The border size follows the largest agent radius.
+	hash.Update(cfg.width);
+	hash.Update(cfg.height);
+	hash.Update(cfg.borderSize);
+	hash.Update(cfg.bmin);
+	hash.Update(cfg.bmax);
+	hash.Update(cfg.cs);
+	hash.Update(cfg.ch);
+
+	// Walkable marking and filtering.
+	hash.Update(cfg.walkableSlopeAngle);
+	hash.Update(rasterizeClimb);
+	hash.Update(cfg.walkableHeight);
+	hash.Update(cfg.walkableClimb);
+
+	return hash.Get();
+}
 
-	// Init build configuration from GUI
-	rcConfig cfg;
+std::vector<AgentProfile> NavMeshTool::getAgentProfiles() const
+{
+	std::vector<AgentProfile> profiles;
+	profiles.reserve(1 + m_config.extraProfiles.size());
+
+	AgentProfile& mainProfile = profiles.emplace_back();
+	mainProfile.agentHeight = m_config.agentHeight;
+	mainProfile.agentRadius = m_config.agentRadius;
+	mainProfile.agentMaxClimb = m_config.agentMaxClimb;
+
+	profiles.insert(profiles.end(), m_config.extraProfiles.begin(), m_config.extraProfiles.end());
+	return profiles;
+}
+
+int NavMeshTool::getTileBorderSize() const
+{
+	float agentRadius = m_config.agentRadius;
+	for (const AgentProfile& profile : m_config.extraProfiles)
+		agentRadius = std::max(agentRadius, profile.agentRadius);
 
+	return (int)ceilf(agentRadius / m_config.cellSize) + 3; // Reserve enough padding.
+}
+
+void NavMeshTool::initTileConfig(rcConfig& cfg, const AgentProfile& profile, const float* bmin, const float* bmax) const
+{
+	// Init build configuration from GUI
 	memset(&cfg, 0, sizeof(cfg));
 	cfg.cs = m_config.cellSize;
 	cfg.ch = m_config.cellHeight;
 	cfg.walkableSlopeAngle = m_config.agentMaxSlope;
-	cfg.walkableHeight = (int)ceilf(m_config.agentHeight / cfg.ch);
-	cfg.walkableClimb = (int)floorf(m_config.agentMaxClimb / cfg.ch);
-	cfg.walkableRadius = (int)ceilf(m_config.agentRadius / cfg.cs);
+	cfg.walkableHeight = (int)ceilf(profile.agentHeight / cfg.ch);
+	cfg.walkableClimb = (int)floorf(profile.agentMaxClimb / cfg.ch);
+	cfg.walkableRadius = (int)ceilf(profile.agentRadius / cfg.cs);
 	cfg.maxEdgeLen = (int)(m_config.edgeMaxLen / m_config.cellSize);
 	cfg.maxSimplificationError = m_config.edgeMaxError;
 	cfg.minRegionArea = (int)rcSqr(m_config.regionMinSize);		// Note: area = size*size
 	cfg.mergeRegionArea = (int)rcSqr(m_config.regionMergeSize);	// Note: area = size*size
 	cfg.maxVertsPerPoly = (int)m_config.vertsPerPoly;
 	cfg.tileSize = (int)m_config.tileSize;
-	cfg.borderSize = cfg.walkableRadius + 3; // Reserve enough padding.
+	cfg.borderSize = getTileBorderSize();
 	cfg.width = cfg.tileSize + cfg.borderSize * 2;
 	cfg.height = cfg.tileSize + cfg.borderSize * 2;
 	cfg.detailSampleDist = m_config.detailSampleDist < 0.9f ? 0 : m_config.cellSize * m_config.detailSampleDist;
@@ -1071,16 +1806,244 @@ unsigned char* NavMeshTool::buildTileMesh(
 	cfg.bmin[2] -= cfg.borderSize*cfg.cs;
 	cfg.bmax[0] += cfg.borderSize*cfg.cs;
 	cfg.bmax[2] += cfg.borderSize*cfg.cs;
+}
 
-	// Reset build times gathering.
-	m_ctx->resetTimers();
+void NavMeshTool::buildTileMeshes(
+	const int tx,
+	const int ty,
+	const float* bmin,
+	const float* bmax,
+	const TileBuildContext& buildContext,
+	std::vector<TileMeshData>& tiles,
+	TileBuildRecord* record) const
+{
+	const std::vector<AgentProfile> profiles = getAgentProfiles();
+	tiles.assign(profiles.size(), TileMeshData{});
 
-	// Start the build process.
-	m_ctx->startTimer(RC_TIMER_TOTAL);
+	if (!m_geom || !m_geom->getMeshLoader() || !m_geom->getBVH())
+	{
+		SPDLOG_LOGGER_ERROR(m_logger, "buildNavigation: Input mesh is not specified.");
+		return;
+	}
 
-	deleting_unique_ptr<rcCompactHeightfield> chf = rasterizeGeometry(cfg);
-	if (!chf)
-		return nullptr;
+	std::vector<rcConfig> configs(profiles.size());
+	for (size_t i = 0; i < profiles.size(); ++i)
+		initTileConfig(configs[i], profiles[i], bmin, bmax);
+
+	// The geometry is rasterized with the climb of the main profile. All profiles
+	// share the tile bounds, so the same heightfield serves each of them.
+	const rcConfig& rasterizeConfig = configs[0];
+
+	TileCache tileCache(GetTileCacheDirectory());
+	deleting_unique_ptr<rcHeightfield> solid;
+	std::vector<uint8_t> spanAreas;
+
+	for (size_t i = 0; i < profiles.size(); ++i)
+	{
+		rcConfig& cfg = configs[i];
+		TileBuildRecord* profileRecord = i == 0 ? record : nullptr;
+
+		// Look for a tile built from identical inputs.
+		uint64_t tileHash = 0;
+		if (m_useTileCache)
+		{
+			tileHash = computeTileHash(tx, ty, cfg, profiles[i], buildContext);
+
+			if (tileCache.Load(tileHash, tiles[i].data, tiles[i].dataSize))
+			{
+				++m_tilesFromCache;
+				if (profileRecord)
+					profileRecord->fromTileCache = true;
+				continue;
+			}
+		}
+
+		// Reset build times gathering.
+		m_ctx->resetTimers();
+
+		// Start the build process.
+		m_ctx->startTimer(RC_TIMER_TOTAL);
+
+		const uint64_t heightfieldKey = m_useHeightfieldCache
+			? computeHeightfieldKey(tx, ty, cfg, rasterizeConfig.walkableClimb) : 0;
+
+		deleting_unique_ptr<rcCompactHeightfield> chf;
+		if (m_useHeightfieldCache && m_heightfieldCache.Load(heightfieldKey, chf))
+		{
+			if (profileRecord)
+				profileRecord->fromHeightfieldCache = true;
+		}
+		else
+		{
+			if (!solid)
+			{
+				solid = rasterizeGeometry(rasterizeConfig, record);
+				if (!solid)
+					return;
+
+				// The filters of each profile only change span areas, so keep the
+				// rasterized ones to start the next profile from.
+				for (int c = 0; c < solid->width * solid->height; ++c)
+				{
+					for (const rcSpan* span = solid->spans[c]; span; span = span->next)
+						spanAreas.push_back(static_cast<uint8_t>(span->area));
+				}
+			}
+			else
+			{
+				size_t index = 0;
+				for (int c = 0; c < solid->width * solid->height; ++c)
+				{
+					for (rcSpan* span = solid->spans[c]; span; span = span->next)
+						span->area = spanAreas[index++];
+				}
+			}
+
+			chf = filterHeightfield(cfg, *solid, profileRecord);
+			if (!chf)
+				continue;
+
+			if (m_useHeightfieldCache)
+				m_heightfieldCache.Store(heightfieldKey, *chf);
+		}
+
+		bool cacheable = false;
+		tiles[i].data = buildTileMeshData(tx, ty, cfg, profiles[i], std::move(chf), buildContext,
+			tiles[i].dataSize, cacheable, profileRecord);
+
+		if (m_useTileCache && cacheable && !tileCache.Store(tileHash, tiles[i].data, tiles[i].dataSize))
+		{
+			SPDLOG_LOGGER_WARN(m_logger, "Failed to store tile ({}, {}) in the tile cache", tx, ty);
+		}
+	}
+}
+
+uint64_t NavMeshTool::computeTileHash(int tx, int ty, const rcConfig& cfg, const AgentProfile& profile,
+	const TileBuildContext& buildContext) const
+{
+	ContentHash hash;
+	hash.Update(TILE_CACHE_VERSION);
+	hash.Update(DT_NAVMESH_VERSION);
+	hash.Update(NAVMESH_TILE_COMPAT_VERSION);
+
+	// Tile position and the derived recast config. This covers the tile bounds as well.
+	hash.Update(tx);
+	hash.Update(ty);
+	hash.Update(cfg);
+
+	// Settings that are passed to detour directly, and the climb the geometry is
+	// rasterized with.
+	hash.Update(profile.agentHeight);
+	hash.Update(profile.agentRadius);
+	hash.Update(profile.agentMaxClimb);
+	hash.Update(m_config.agentMaxClimb);
+	hash.Update(m_config.partitionType);
+
+	// Triangles that overlap the border expanded tile, in the order they are rasterized.
+	const float* verts = m_geom->getMeshLoader()->getVerts();
+	const TriMeshBVH* bvh = m_geom->getBVH();
+
+	thread_local std::vector<int> cid;
+	const int ncid = bvh->QueryBox(cfg.bmin, cfg.bmax, cid);
+
+	uint32_t triCount = 0;
+	for (int i = 0; i < ncid; ++i)
+	{
+		const TriMeshBVHNode& node = bvh->GetNode(cid[i]);
+		const int* ctris = bvh->GetLeafTris(node);
+
+		for (int j = 0; j < node.count; ++j)
+		{
+			const float* v0 = &verts[ctris[j * 3 + 0] * 3];
+			const float* v1 = &verts[ctris[j * 3 + 1] * 3];
+			const float* v2 = &verts[ctris[j * 3 + 2] * 3];
+
+			if (std::max({ v0[0], v1[0], v2[0] }) < cfg.bmin[0] || std::min({ v0[0], v1[0], v2[0] }) > cfg.bmax[0]
+				|| std::max({ v0[2], v1[2], v2[2] }) < cfg.bmin[2] || std::min({ v0[2], v1[2], v2[2] }) > cfg.bmax[2])
+			{
+				continue;
+			}
+
+			hash.Update(v0, sizeof(float) * 3);
+			hash.Update(v1, sizeof(float) * 3);
+			hash.Update(v2, sizeof(float) * 3);
+			++triCount;
+		}
+	}
+	hash.Update(triCount);
+
+	if (const TerrainHeightfield* terrain = m_geom->getMeshLoader()->GetTerrainHeightfield())
+	{
+		terrain->Hash(cfg.bmin, cfg.bmax, hash);
+	}
+
+	// Placed models that overlap the tile, by model and transform.
+	if (const InstancedGeometry* instances = m_geom->getMeshLoader()->GetInstancedGeometry())
+	{
+		thread_local std::vector<int> iid;
+		const int niid = instances->QueryBox(cfg.bmin, cfg.bmax, iid);
+
+		hash.Update(niid);
+		for (int i = 0; i < niid; ++i)
+			instances->HashInstance(iid[i], hash);
+	}
+
+	// Convex volumes that overlap the tile, in the order they are applied.
+	for (uint32_t index : buildContext.volumes.GetVolumesForTile(tx, ty))
+	{
+		const ConvexVolume& vol = buildContext.volumes.GetVolume(index);
+
+		hash.Update(vol.verts.data(), vol.verts.size() * sizeof(glm::vec3));
+		hash.Update(vol.hmin);
+		hash.Update(vol.hmax);
+		hash.Update(vol.areaType);
+	}
+
+	// Off-mesh connections that may be stored in this tile.
+	const auto& connections = buildContext.offMeshConnections->GetConnectionsForTile(tx, ty);
+	for (size_t i = 0; i < connections.offMeshConCount; ++i)
+	{
+		hash.Update(connections.offMeshConVerts[i].first);
+		hash.Update(connections.offMeshConVerts[i].second);
+		hash.Update(connections.offMeshConRads[i]);
+		hash.Update(connections.offMeshConDirs[i]);
+		hash.Update(connections.offMeshConAreas[i]);
+		hash.Update(connections.offMeshConFlags[i]);
+		hash.Update(connections.offMeshConId[i]);
+	}
+	hash.Update(connections.offMeshConCount);
+
+	// Poly flags are derived from the area types.
+	for (int area = 0; area < 256; ++area)
+	{
+		hash.Update(m_navMesh->GetPolyArea(static_cast<uint8_t>(area)).flags);
+	}
+
+	return hash.Get();
+}
+
+std::string NavMeshTool::GetTileCacheDirectory() const
+{
+	return std::string(m_outputPath) + "\\cache\\tiles\\" + m_navMesh->GetZoneName();
+}
+
+unsigned char* NavMeshTool::buildTileMeshData(
+	const int tx,
+	const int ty,
+	rcConfig& cfg,
+	const AgentProfile& profile,
+	deleting_unique_ptr<rcCompactHeightfield> chf,
+	const TileBuildContext& buildContext,
+	int& dataSize,
+	bool& cacheable,
+	TileBuildRecord* record) const
+{
+	cacheable = false;
+
+	if (record)
+		record->spanCount = chf->spanCount;
+
+	std::optional<ScopedBuildStage> stage(std::in_place, record, BuildStage::Erode);
 
 	// Erode the walkable area by agent radius.
 	if (!rcErodeWalkableArea(m_ctx, cfg.walkableRadius, *chf))
@@ -1089,12 +2052,15 @@ unsigned char* NavMeshTool::buildTileMesh(
 		return nullptr;
 	}
 
-	// Mark areas.
-	const auto& volumes = m_navMesh->GetConvexVolumes();
-	for (const auto& vol : volumes)
+	stage.emplace(record, BuildStage::MarkAreas);
+
+	// Mark areas. Only volumes that overlap this tile need to be visited.
+	for (uint32_t index : buildContext.volumes.GetVolumesForTile(tx, ty))
 	{
-		rcMarkConvexPolyArea(m_ctx, glm::value_ptr(vol->verts[0]), static_cast<int>(vol->verts.size()),
-			vol->hmin, vol->hmax, static_cast<uint8_t>(vol->areaType), *chf);
+		const ConvexVolume& vol = buildContext.volumes.GetVolume(index);
+
+		rcMarkConvexPolyArea(m_ctx, glm::value_ptr(vol.verts[0]), static_cast<int>(vol.verts.size()),
+			vol.hmin, vol.hmax, static_cast<uint8_t>(vol.areaType), *chf);
 	}
 
 	// Mark doors.
@@ -1126,6 +2092,8 @@ unsigned char* NavMeshTool::buildTileMesh(
 	//     if you have large open areas with small obstacles (not a problem if you use tiles)
 	//   * good choice to use for tiled navmesh with medium and small sized tiles
 
+	stage.emplace(record, BuildStage::Regions);
+
 	if (m_config.partitionType == PartitionType::WATERSHED)
 	{
 		// Prepare for region partitioning, by calculating distance field along the walkable surface.
@@ -1162,6 +2130,8 @@ unsigned char* NavMeshTool::buildTileMesh(
 		}
 	}
 
+	stage.emplace(record, BuildStage::Contours);
+
 	// Create contours.
 	deleting_unique_ptr<rcContourSet> cset(rcAllocContourSet(), [](rcContourSet* cs) { rcFreeContourSet(cs); });
 	if (!rcBuildContours(m_ctx, *chf, cfg.maxSimplificationError, cfg.maxEdgeLen, *cset))
@@ -1172,9 +2142,13 @@ unsigned char* NavMeshTool::buildTileMesh(
 
 	if (cset->nconts == 0)
 	{
+		// nothing walkable in this tile.
+		cacheable = true;
 		return nullptr;
 	}
 
+	stage.emplace(record, BuildStage::PolyMesh);
+
 	// Build polygon navmesh from the contours.
 	deleting_unique_ptr<rcPolyMesh> pmesh(rcAllocPolyMesh(), [](rcPolyMesh* pm) { rcFreePolyMesh(pm); });
 	if (!rcBuildPolyMesh(m_ctx, *cset, cfg.maxVertsPerPoly, *pmesh))
@@ -1183,6 +2157,11 @@ unsigned char* NavMeshTool::buildTileMesh(
 		return nullptr;
 	}
 
+	if (record)
+		record->polyCount = pmesh->npolys;
+
+	stage.emplace(record, BuildStage::DetailMesh);
+
 	// Build detail mesh.
 	deleting_unique_ptr<rcPolyMeshDetail> dmesh(rcAllocPolyMeshDetail(), [](rcPolyMeshDetail* pm) { rcFreePolyMeshDetail(pm); });
 	if (!rcBuildPolyMeshDetail(m_ctx, *pmesh, *chf,
@@ -1196,6 +2175,8 @@ unsigned char* NavMeshTool::buildTileMesh(
 	chf.reset();
 	cset.reset();
 
+	stage.emplace(record, BuildStage::CreateNavData);
+
 	unsigned char* navData = 0;
 	int navDataSize = 0;
 	if (cfg.maxVertsPerPoly <= DT_VERTS_PER_POLYGON)
@@ -1232,10 +2213,10 @@ unsigned char* NavMeshTool::buildTileMesh(
 		params.detailTris = dmesh->tris;
 		params.detailTriCount = dmesh->ntris;
 
-		offMeshConnections->UpdateNavMeshCreateParams(params);
-		params.walkableHeight = m_config.agentHeight;
-		params.walkableRadius = m_config.agentRadius;
-		params.walkableClimb = m_config.agentMaxClimb;
+		buildContext.offMeshConnections->UpdateNavMeshCreateParams(params, tx, ty);
+		params.walkableHeight = profile.agentHeight;
+		params.walkableRadius = profile.agentRadius;
+		params.walkableClimb = profile.agentMaxClimb;
 		params.tileX = tx;
 		params.tileY = ty;
 		params.tileLayer = 0;
@@ -1254,6 +2235,7 @@ unsigned char* NavMeshTool::buildTileMesh(
 
 	m_ctx->stopTimer(RC_TIMER_TOTAL);
 
+	cacheable = navData != nullptr;
 	dataSize = navDataSize;
 	return navData;
 }
@@ -1304,6 +2286,18 @@ void NavMeshTool::handleClick(const glm::vec3& s, const glm::vec3& p, bool shift
 
 void NavMeshTool::handleUpdate(float dt)
 {
+	updateTileSnapshot();
+	updateTileRebuilds();
+
+	// Load the mesh written by a streaming build, on the main thread.
+	if (m_streamedMeshReady.exchange(false))
+	{
+		if (m_navMesh->LoadNavMeshFile() != NavMesh::LoadResult::Success)
+		{
+			SPDLOG_LOGGER_ERROR(m_logger, "Failed to load streamed navmesh from {}", m_navMesh->GetFullFilePath());
+		}
+	}
+
 	if (m_tool)
 	{
 		m_tool->handleUpdate(dt);
@@ -4,8 +4,11 @@
 
 #pragma once
 
-#include "meshgen/ChunkyTriMesh.h"
+#include "meshgen/BuildTrace.h"
 #include "meshgen/DebugDraw.h"
+#include "meshgen/HeightfieldCache.h"
+#include "meshgen/NavMeshSnapshot.h"
+#include "meshgen/TriMeshBVH.h"
 
 #include "mq/base/Enum.h"
 #include "common/NavMesh.h"
@@ -19,10 +22,13 @@
 #include "glm/glm.hpp"
 
 #include <atomic>
+#include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 class RecastContext;
 class InputGeom;
@@ -31,11 +37,16 @@ class dtNavMeshQuery;
 
 class NavMeshTool;
 class NavMeshLoader;
+struct TileBuildContext;
 
 namespace spdlog {
 	class logger;
 }
 
+namespace concurrency {
+	class task_group;
+}
+
 //----------------------------------------------------------------------------
 
 // Tool types.
@@ -116,19 +127,73 @@ public:
 	void RemoveTile(const glm::vec3& pos);
 	void RemoveAllTiles();
 
-	void BuildAllTiles(const std::shared_ptr<dtNavMesh>& navMesh, bool async = true);
+	// Build all tiles into the meshes of each agent profile, indexed by profile.
+	void BuildAllTiles(const std::vector<std::shared_ptr<dtNavMesh>>& navMeshes, bool async = true);
+
+	// Build all tiles straight into a navmesh file, without adding them to a mesh.
+	// Memory use stays bounded by the input geometry and a fixed number of tiles.
+	// With a shard count above one, only the tiles of the given shard are built
+	// (see ShardedBuild.h). Returns false if the file could not be written, when
+	// not async.
+	bool StreamAllTiles(const std::string& filename, bool async = true,
+		int shard = 0, int shardCount = 1);
 	void CancelBuildAllTiles(bool wait = true);
 	void UpdateTileSizes();
+
+	// Queue tiles of the main mesh to be rebuilt for every profile, after an edit of
+	// the volumes or connections that touch them. Tiles are rebuilt in the background
+	// once they haven't been edited for RebuildDelay, and replaced on the main thread
+	// by handleUpdate. Editing a tile again discards a rebuild that is in progress.
 	void RebuildTiles(const std::vector<dtTileRef>& tiles);
 
+	// Drop queued rebuilds and discard the ones in progress, optionally waiting for
+	// them to stop.
+	void CancelTileRebuilds(bool wait = true);
+
+	// True while tiles are queued or being rebuilt.
+	bool hasPendingRebuilds() const { return !m_pendingRebuilds.empty() || !m_rebuildJobs.empty(); }
+
 	void SaveNavMesh();
 
 	bool isBuildingTiles() const { return m_buildingTiles; }
 
+	bool getStreamToFile() const { return m_streamToFile; }
+	void setStreamToFile(bool streamToFile) { m_streamToFile = streamToFile; }
+
+	// Build every tile from scratch, for timing builds.
+	void setUseCaches(bool useCaches) { m_useTileCache = useCaches; m_useHeightfieldCache = useCaches; }
+
+	const NavMeshConfig& getConfig() const { return m_config; }
+
+	// Build with these settings from now on.
+	void setConfig(const NavMeshConfig& config);
+
 	void getTileStatistics(int& width, int& height, int& maxTiles) const;
 	int getTilesBuilt() const { return m_tilesBuilt; }
+
+	struct BuildProgress
+	{
+		int tilesBuilt = 0;
+		int tilesTotal = 0;
+
+		// Fraction of the estimated build cost that is done.
+		float fraction = 0.0f;
+
+		float elapsedSeconds = 0.0f;
+
+		// Estimated time remaining, negative until enough tiles are done to tell.
+		float etaSeconds = -1.0f;
+	};
+	BuildProgress getBuildProgress() const;
 	float getTotalBuildTimeMS() const { return m_totalBuildTimeMs; }
 
+	// Per tile records of the last build of all tiles.
+	const BuildTrace& getBuildTrace() const { return m_buildTrace; }
+
+	// Export the build trace to the traces folder of the output path. Returns the
+	// path the files were written to, without extension, or an empty string.
+	std::string ExportBuildTrace() const;
+
 	void setOutputPath(const char* output_path);
 
 	uint8_t getNavMeshDrawFlags() const { return m_navMeshDrawFlags; }
@@ -144,10 +209,34 @@ public:
 
 	unsigned int GetColorForPoly(const dtPoly* poly);
 
+	// The main agent followed by the extra profiles of the current settings.
+	std::vector<AgentProfile> getAgentProfiles() const;
+
 	duDebugDraw& getDebugDraw() { return m_dd; }
 
 private:
-	deleting_unique_ptr<rcCompactHeightfield> rasterizeGeometry(rcConfig& cfg) const;
+	struct TileMeshData
+	{
+		unsigned char* data = nullptr;
+		int dataSize = 0;
+	};
+
+	deleting_unique_ptr<rcHeightfield> rasterizeGeometry(const rcConfig& cfg, TileBuildRecord* record) const;
+
+	// Run the walkable span filters of an agent over a rasterized tile and compact it.
+	// Only the span areas of solid are modified.
+	deleting_unique_ptr<rcCompactHeightfield> filterHeightfield(const rcConfig& cfg, rcHeightfield& solid,
+		TileBuildRecord* record) const;
+
+	// Border of the tiles, in cells. Shared by all profiles, so that they can be
+	// built from the same rasterized heightfield, and wide enough for the largest.
+	int getTileBorderSize() const;
+
+	// Recast config for a tile of a profile.
+	void initTileConfig(rcConfig& cfg, const AgentProfile& profile, const float* bmin, const float* bmax) const;
+
+	// Create empty meshes for every profile and make them the current ones.
+	std::vector<std::shared_ptr<dtNavMesh>> createNavMeshes();
 
 	void resetCommonSettings();
 
@@ -156,17 +245,78 @@ private:
 	void renderToolStates();
 	void renderOverlayToolStates(const glm::mat4& proj, const glm::mat4& model, const glm::ivec4& view);
 
-	void RebuildTile(
-		const std::shared_ptr<OffMeshConnectionBuffer> connBuffer,
-		dtTileRef tileRef);
+	// Snapshot the data shared by all tiles of a build (volumes, connections).
+	std::shared_ptr<TileBuildContext> CreateBuildContext() const;
+
+	// World bounds of the tile at tx, ty, covering the full height of the mesh.
+	void getTileBounds(int tx, int ty, float* tileBmin, float* tileBmax) const;
 
-	unsigned char* buildTileMesh(
+	// Replace the tile at tx, ty of each profile with the built tiles, which the
+	// meshes take ownership of.
+	void addTileMeshes(int tx, int ty, std::vector<TileMeshData>& tiles);
+
+	// Start the queued rebuilds that are due, and put the finished ones in the mesh.
+	void updateTileRebuilds();
+
+	// Switch to the latest snapshot of the build of all tiles, if there is a new one.
+	void updateTileSnapshot();
+
+	// Build the tile at tx, ty for every agent profile. The geometry is rasterized
+	// once and filtered for each profile, and only for profiles that are missing from
+	// the caches. tiles receives the data of each profile, with null data for empty
+	// tiles. The record gets the stages of the main profile.
+	void buildTileMeshes(
 		const int tx,
 		const int ty,
 		const float* bmin,
 		const float* bmax,
-		const std::shared_ptr<OffMeshConnectionBuffer>& connBuffer,
-		int& dataSize) const;
+		const TileBuildContext& buildContext,
+		std::vector<TileMeshData>& tiles,
+		TileBuildRecord* record = nullptr) const;
+
+	// Runs the rest of the recast pipeline for a tile of a profile, from its compact
+	// heightfield. cacheable is set if the result (including an empty tile) is valid
+	// to store in the tile cache.
+	unsigned char* buildTileMeshData(
+		const int tx,
+		const int ty,
+		rcConfig& cfg,
+		const AgentProfile& profile,
+		deleting_unique_ptr<rcCompactHeightfield> chf,
+		const TileBuildContext& buildContext,
+		int& dataSize,
+		bool& cacheable,
+		TileBuildRecord* record) const;
+
+	// Hash of the settings that the filtered heightfield of a profile depends on, used
+	// as the heightfield cache key. rasterizeClimb is the climb of the main profile,
+	// which the geometry is rasterized with.
+	uint64_t computeHeightfieldKey(int tx, int ty, const rcConfig& cfg, int rasterizeClimb) const;
+
+	void getNavMeshParams(dtNavMeshParams& params) const;
+
+	// Build every tile of the mesh (or of one shard) with the volumes and connections of
+	// buildContext, passing the data of each tile of each profile to tileBuilt, which
+	// takes ownership of it. Called from a worker thread.
+	void buildAllTiles(const TileBuildContext& buildContext,
+		const std::function<void(int x, int y, int profile, uint8_t* data, int dataSize)>& tileBuilt,
+		int shard = 0, int shardCount = 1);
+
+	// Estimate the relative cost of building each tile of a tw x th grid, from the
+	// timings of the previous build if it covered the same grid with the same
+	// settings, or from the number of triangles overlapping each tile otherwise.
+	// Returns true if timings were used.
+	bool estimateTileCosts(int tw, int th, uint64_t settingsKey, const glm::vec3& bmin,
+		const glm::vec3& bmax, std::vector<float>& costs) const;
+
+	// Hash of the settings, bounds and volumes that tile build times depend on.
+	uint64_t computeBuildSettingsKey() const;
+
+	// Hash of all inputs to a tile build, used as the tile cache key.
+	uint64_t computeTileHash(int tx, int ty, const rcConfig& cfg, const AgentProfile& profile,
+		const TileBuildContext& buildContext) const;
+
+	std::string GetTileCacheDirectory() const;
 
 	void NavMeshUpdated();
 
@@ -190,7 +340,7 @@ private:
 	int m_maxPolysPerTile = 0;
 
 	char* m_outputPath = nullptr;
-	float m_totalBuildTimeMs = 0.f;
+	std::atomic<float> m_totalBuildTimeMs = 0.f;
 
 	int m_tilesWidth = 0;
 	int m_tilesHeight = 0;
@@ -200,9 +350,86 @@ private:
 	std::atomic<bool> m_cancelTiles = false;
 	std::thread m_buildThread;
 
+	// Tiles of the build of all tiles are published in snapshots, which the main
+	// thread switches to between frames.
+	static constexpr std::chrono::milliseconds SnapshotInterval{ 1000 };
+	TileSnapshotPublisher m_tilePublisher;
+	uint32_t m_snapshotVersion = 0;
+
+	// Main mesh of the build, or of its last snapshot. Snapshots are only switched to
+	// while it is still the current mesh.
+	std::shared_ptr<dtNavMesh> m_snapshotMesh;
+
+	// Background rebuilds of edited tiles.
+	static constexpr std::chrono::milliseconds RebuildDelay{ 250 };
+
+	struct TileRebuildJob
+	{
+		int tx = 0;
+		int ty = 0;
+
+		// Main mesh the tile was built for. The result is dropped if it was replaced.
+		std::shared_ptr<dtNavMesh> navMesh;
+
+		std::atomic<bool> cancelled = false;
+		std::vector<TileMeshData> tiles;
+	};
+	using TileKey = std::pair<int, int>;
+
+	// Tiles waiting for their edits to settle, with the time they are due. Main thread only.
+	std::map<TileKey, std::chrono::steady_clock::time_point> m_pendingRebuilds;
+
+	// Rebuilds in progress, by tile. Main thread only.
+	std::map<TileKey, std::shared_ptr<TileRebuildJob>> m_rebuildJobs;
+
+	// Rebuilds that are done, waiting for the main thread.
+	std::mutex m_finishedRebuildsMutex;
+	std::vector<std::shared_ptr<TileRebuildJob>> m_finishedRebuilds;
+
+	std::unique_ptr<concurrency::task_group> m_rebuildTasks;
+
+	// Write tiles to the navmesh file as they are built instead of keeping them in
+	// memory, and load the file once complete.
+	static const size_t MaxQueuedStreamTiles = 32;
+	bool m_streamToFile = false;
+	std::atomic<bool> m_streamedMeshReady = false;
+
+	// Estimated cost of the current build and the part of it that is done, used
+	// to report progress and remaining time. Written by the build thread and read by
+	// the main thread. m_tilesScheduled is set last, once the others are valid.
+	std::atomic<int> m_tilesScheduled = 0;
+	std::atomic<double> m_buildCostTotal = 0.0;
+	std::atomic<double> m_buildCostDone = 0.0;
+	std::atomic<std::chrono::steady_clock::time_point> m_buildStartTime;
+
+	// Time in ms each tile took in the last build, indexed x + y * width. Negative
+	// for tiles that were not built, or were loaded from the tile cache.
+	std::vector<float> m_tileBuildTimes;
+	int m_tileBuildTimesWidth = 0;
+	int m_tileBuildTimesHeight = 0;
+	uint64_t m_tileBuildTimesKey = 0;
+
+	// What each tile of the last build spent its time on.
+	BuildTrace m_buildTrace;
+
+	bool m_useTileCache = true;
+	mutable std::atomic<int> m_tilesFromCache = 0;
+
+	// Filtered heightfields of built tiles, kept in memory between builds.
+	bool m_useHeightfieldCache = false;
+	int m_heightfieldCacheBudgetMB = 512;
+	mutable HeightfieldCache m_heightfieldCache;
+
+	// Number of tiles rasterized and the triangles fetched from the BVH for them.
+	mutable std::atomic<int> m_tilesRasterized = 0;
+	mutable std::atomic<int64_t> m_trisTouched = 0;
+
 	uint8_t m_navMeshDrawFlags = 0;
 	NavMeshConfig m_config;
 
+	// Agent profile whose mesh is drawn.
+	int m_drawProfile = 0;
+
 	struct DrawMode { enum Enum {
 		NAVMESH,
 		NAVMESH_TRANS,
@@ -200,6 +200,8 @@ void OffMeshConnectionTool::handleMenu()
 
 				if (update)
 				{
+					navMesh->MarkConnectionModified(conn->id);
+
 					auto modifiedTiles = m_state->UpdateConnection(conn);
 					if (!modifiedTiles.empty())
 					{
@@ -0,0 +1,64 @@
+//
+// Parallel.h
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <ppl.h>
+#endif
+
+// The parallel loops of geometry loading. They run on PPL on Windows, like the
+// rest of the mesh generator, and on plain threads elsewhere so that the loader
+// and its tests don't depend on PPL.
+
+// Calls function(i) for every i in [first, last).
+template <typename Index, typename Function>
+void ParallelFor(Index first, Index last, const Function& function)
+{
+#if defined(_WIN32)
+	concurrency::parallel_for(first, last, function);
+#else
+	if (last <= first)
+		return;
+
+	const uint64_t count = static_cast<uint64_t>(last - first);
+	const uint64_t threadCount = std::min<uint64_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+
+	// Each thread takes one contiguous range, the calling thread the first one.
+	auto runRange = [&](uint64_t index)
+	{
+		const Index begin = first + static_cast<Index>(count * index / threadCount);
+		const Index end = first + static_cast<Index>(count * (index + 1) / threadCount);
+		for (Index i = begin; i < end; ++i)
+			function(i);
+	};
+
+	std::vector<std::thread> threads;
+	for (uint64_t index = 1; index < threadCount; ++index)
+		threads.emplace_back(runRange, index);
+
+	runRange(0);
+
+	for (std::thread& thread : threads)
+		thread.join();
+#endif
+}
+
+// Runs both functions at the same time and returns once both are done.
+template <typename Function1, typename Function2>
+void ParallelInvoke(const Function1& function1, const Function2& function2)
+{
+#if defined(_WIN32)
+	concurrency::parallel_invoke(function1, function2);
+#else
+	std::thread thread(function1);
+	function2();
+	thread.join();
+#endif
+}
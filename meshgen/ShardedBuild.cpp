@@ -0,0 +1,821 @@
+//
+// ShardedBuild.cpp
+//
+
+#include "meshgen/ShardedBuild.h"
+#include "meshgen/Application.h"
+#include "meshgen/EQConfig.h"
+#include "meshgen/GeometryLoadTask.h"
+#include "meshgen/InputGeom.h"
+#include "meshgen/NavMeshTool.h"
+#include "common/NavMesh.h"
+#include "common/NavMeshFileWriter.h"
+#include "common/ZoneManifest.h"
+
+#include <DetourNavMesh.h>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/basic_file_sink.h>
+#include <spdlog/sinks/msvc_sink.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+//============================================================================
+
+static const char* GetStateExtension(ShardState state)
+{
+	switch (state)
+	{
+	case ShardState::Todo: return ".todo";
+	case ShardState::Claimed: return ".claimed";
+	case ShardState::Done: return ".done";
+	case ShardState::Failed: return ".failed";
+	}
+
+	return "";
+}
+
+// State files hold "[worker id] attempts".
+static bool ReadStateFile(const fs::path& path, std::string& workerId, int& attempts)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+
+	std::string first, second;
+	file >> first >> second;
+
+	workerId.clear();
+	attempts = 0;
+
+	if (second.empty())
+	{
+		attempts = atoi(first.c_str());
+	}
+	else
+	{
+		workerId = first;
+		attempts = atoi(second.c_str());
+	}
+
+	return true;
+}
+
+static bool WriteStateFile(const fs::path& path, const std::string& workerId, int attempts)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	if (!workerId.empty())
+		file << workerId << " ";
+	file << attempts << "\n";
+
+	return file.good();
+}
+
+//----------------------------------------------------------------------------
+
+std::string ShardTask::GetName() const
+{
+	return fmt::format("{}.{}-of-{}", zoneShortName, shard, shardCount);
+}
+
+bool ShardTask::ParseName(const std::string& name, ShardTask& task)
+{
+	size_t pos = name.rfind('.');
+	if (pos == std::string::npos || pos == 0)
+		return false;
+
+	int shard = 0, shardCount = 0;
+	if (sscanf_s(name.c_str() + pos + 1, "%d-of-%d", &shard, &shardCount) != 2
+		|| shardCount < 1 || shard < 0 || shard >= shardCount)
+	{
+		return false;
+	}
+
+	task.zoneShortName = name.substr(0, pos);
+	task.shard = shard;
+	task.shardCount = shardCount;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+ShardWorkDirectory::ShardWorkDirectory(const std::string& path)
+	: m_path(path)
+{
+	std::error_code ec;
+	fs::create_directories(m_path, ec);
+}
+
+fs::path ShardWorkDirectory::GetStateFile(const ShardTask& task, ShardState state) const
+{
+	return m_path / (task.GetName() + GetStateExtension(state));
+}
+
+std::string ShardWorkDirectory::GetSettingsFile(const std::string& zoneShortName) const
+{
+	return (m_path / (zoneShortName + ".settings" + NAVMESH_FILE_EXTENSION)).string();
+}
+
+std::string ShardWorkDirectory::GetOutputFile(const ShardTask& task, const std::string& workerId) const
+{
+	return (m_path / (task.GetName() + "." + workerId + NAVMESH_FILE_EXTENSION)).string();
+}
+
+std::vector<ShardWorkDirectory::TaskInfo> ShardWorkDirectory::GetTasks() const
+{
+	std::vector<TaskInfo> tasks;
+
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(m_path, ec))
+	{
+		if (!entry.is_regular_file(ec))
+			continue;
+
+		const std::string extension = entry.path().extension().string();
+
+		TaskInfo info;
+		if (extension == ".todo")
+			info.state = ShardState::Todo;
+		else if (extension == ".claimed")
+			info.state = ShardState::Claimed;
+		else if (extension == ".done")
+			info.state = ShardState::Done;
+		else if (extension == ".failed")
+			info.state = ShardState::Failed;
+		else
+			continue;
+
+		if (!ShardTask::ParseName(entry.path().stem().string(), info.task))
+			continue;
+
+		// The file may have moved on since it was listed.
+		if (!ReadStateFile(entry.path(), info.workerId, info.task.attempts))
+			continue;
+
+		info.lastHeartbeat = entry.last_write_time(ec);
+		tasks.push_back(std::move(info));
+	}
+
+	return tasks;
+}
+
+bool ShardWorkDirectory::AddTask(const ShardTask& task)
+{
+	return WriteStateFile(GetStateFile(task, ShardState::Todo), std::string(), task.attempts);
+}
+
+bool ShardWorkDirectory::RequeueTask(const ShardTask& task)
+{
+	// Take the claim away first. If the worker completed the task in the meantime
+	// the claim is gone and the task stays done. Writing the claim file before
+	// moving it would recreate it next to the done file.
+	const fs::path requeued = m_path / (task.GetName() + ".requeued");
+
+	std::error_code ec;
+	fs::rename(GetStateFile(task, ShardState::Claimed), requeued, ec);
+	if (ec)
+		return false;
+
+	// No worker can claim the task until it is renamed to .todo, so the attempt
+	// count can't be lost to a worker claiming it right away.
+	WriteStateFile(requeued, std::string(), task.attempts + 1);
+
+	fs::rename(requeued, GetStateFile(task, ShardState::Todo), ec);
+	return !ec;
+}
+
+bool ShardWorkDirectory::FailTask(const ShardTask& task, ShardState state)
+{
+	std::error_code ec;
+	fs::rename(GetStateFile(task, state), GetStateFile(task, ShardState::Failed), ec);
+	return !ec;
+}
+
+void ShardWorkDirectory::RemoveZone(const std::string& zoneShortName)
+{
+	const std::string prefix = zoneShortName + ".";
+
+	std::vector<fs::path> files;
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(m_path, ec))
+	{
+		if (entry.path().filename().string().compare(0, prefix.length(), prefix) == 0)
+			files.push_back(entry.path());
+	}
+
+	for (const fs::path& file : files)
+		fs::remove(file, ec);
+}
+
+bool ShardWorkDirectory::ClaimTask(const std::string& workerId, ShardTask& task)
+{
+	std::vector<fs::path> queued;
+
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(m_path, ec))
+	{
+		if (entry.path().extension() == ".todo")
+			queued.push_back(entry.path());
+	}
+
+	std::sort(queued.begin(), queued.end());
+
+	for (const fs::path& todo : queued)
+	{
+		if (!ShardTask::ParseName(todo.stem().string(), task))
+			continue;
+
+		// Only one worker can move the file, the others fail and try the next one.
+		const fs::path claimed = GetStateFile(task, ShardState::Claimed);
+		fs::rename(todo, claimed, ec);
+		if (ec)
+			continue;
+
+		std::string previousWorker;
+		ReadStateFile(claimed, previousWorker, task.attempts);
+		WriteStateFile(claimed, workerId, task.attempts);
+		return true;
+	}
+
+	return false;
+}
+
+void ShardWorkDirectory::Heartbeat(const ShardTask& task)
+{
+	std::error_code ec;
+	fs::last_write_time(GetStateFile(task, ShardState::Claimed), fs::file_time_type::clock::now(), ec);
+}
+
+bool ShardWorkDirectory::CompleteTask(const ShardTask& task, const std::string& workerId)
+{
+	const fs::path claimed = GetStateFile(task, ShardState::Claimed);
+	const fs::path completing = m_path / (task.GetName() + "." + workerId + ".completing");
+
+	// Take the claim file out of reach of a requeue before checking who owns it.
+	std::error_code ec;
+	fs::rename(claimed, completing, ec);
+	if (ec)
+		return false;
+
+	std::string owner;
+	int attempts = 0;
+	if (!ReadStateFile(completing, owner, attempts) || owner != workerId)
+	{
+		// Requeued and claimed by another worker, which keeps its claim.
+		fs::rename(completing, claimed, ec);
+		return false;
+	}
+
+	fs::rename(completing, GetStateFile(task, ShardState::Done), ec);
+	return !ec;
+}
+
+void ShardWorkDirectory::RequestStop()
+{
+	std::ofstream file(m_path / "stop", std::ios::trunc);
+}
+
+bool ShardWorkDirectory::IsStopRequested() const
+{
+	std::error_code ec;
+	return fs::exists(m_path / "stop", ec);
+}
+
+void ShardWorkDirectory::ClearStop()
+{
+	std::error_code ec;
+	fs::remove(m_path / "stop", ec);
+}
+
+//============================================================================
+
+static std::string GetModuleDirectory()
+{
+	CHAR fullPath[MAX_PATH] = { 0 };
+	GetModuleFileNameA(nullptr, fullPath, MAX_PATH);
+	PathRemoveFileSpecA(fullPath);
+
+	return fullPath;
+}
+
+void InitializeHeadlessLogging(const std::string& name)
+{
+	const std::string logFile = fmt::format("{}/logs/MeshGenerator-{}.log", GetModuleDirectory(), name);
+
+	auto logger = spdlog::create<spdlog::sinks::basic_file_sink_mt>("MeshGen", logFile, true);
+#if defined(_DEBUG)
+	logger->sinks().push_back(std::make_shared<spdlog::sinks::msvc_sink_mt>());
+#endif
+	spdlog::set_default_logger(logger);
+	spdlog::set_pattern("%L %Y-%m-%d %T.%f [%n] %v");
+	spdlog::flush_every(std::chrono::seconds{ 5 });
+	spdlog::register_logger(logger->clone("Recast"));
+	spdlog::register_logger(logger->clone("EQEmu"));
+}
+
+//----------------------------------------------------------------------------
+
+ShardHeartbeat::ShardHeartbeat(ShardWorkDirectory& workDir, const ShardTask& task,
+	std::function<int()> progress, std::chrono::milliseconds interval)
+{
+	m_thread = std::thread([this, &workDir, task, progress = std::move(progress), interval]()
+		{
+			int lastProgress = progress();
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_stopped.wait_for(lock, interval, [this]() { return m_stop; }))
+			{
+				const int current = progress();
+				if (current != lastProgress)
+				{
+					lastProgress = current;
+					workDir.Heartbeat(task);
+				}
+			}
+		});
+}
+
+ShardHeartbeat::~ShardHeartbeat()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_stopped.notify_all();
+	m_thread.join();
+}
+
+static bool BuildShard(const EQConfig& eqConfig, RecastContext& context, InputGeom* geom,
+	ShardWorkDirectory& workDir, const ShardTask& task, const std::string& workerId)
+{
+	auto navMesh = std::make_shared<NavMesh>(eqConfig.GetOutputPath(), task.zoneShortName);
+
+	NavMeshTool tool(navMesh);
+	tool.setContext(&context);
+	tool.setOutputPath(eqConfig.GetOutputPath().c_str());
+	tool.handleGeometryChanged(geom);
+
+	// The claim is only kept while tiles are being built.
+	ShardHeartbeat heartbeat(workDir, task, [&tool]() { return tool.getTilesBuilt(); });
+
+	// Without settings, the zone is built with the defaults over the whole geometry.
+	const std::string settingsFile = workDir.GetSettingsFile(task.zoneShortName);
+	std::error_code ec;
+	if (fs::exists(settingsFile, ec))
+	{
+		if (navMesh->LoadNavMeshFile(settingsFile) != NavMesh::LoadResult::Success)
+		{
+			SPDLOG_ERROR("Failed to load build settings from {}", settingsFile);
+			return false;
+		}
+	}
+
+	tool.UpdateTileSizes();
+
+	const std::string outputFile = workDir.GetOutputFile(task, workerId);
+	if (!tool.StreamAllTiles(outputFile, false, task.shard, task.shardCount))
+		return false;
+
+	// Traces are kept after the zone is merged, to compare workers and zones.
+	const std::string traceName = task.GetName() + "." + workerId;
+	tool.getBuildTrace().Export((workDir.GetPath() / "traces" / traceName).string(), traceName);
+
+	if (!workDir.CompleteTask(task, workerId))
+	{
+		SPDLOG_WARN("Lost the claim on {} while building it", task.GetName());
+		fs::remove(outputFile, ec);
+		return false;
+	}
+
+	return true;
+}
+
+int RunShardWorker(const std::string& workDirectory, const std::string& workerId)
+{
+	InitializeHeadlessLogging("worker-" + workerId);
+
+	ShardWorkDirectory workDir(workDirectory);
+	EQConfig eqConfig;
+	RecastContext context;
+
+	std::string loadedZone;
+	std::unique_ptr<InputGeom> geom;
+	int built = 0;
+
+	SPDLOG_INFO("Worker {} started on {}", workerId, workDirectory);
+
+	while (true)
+	{
+		ShardTask task;
+		if (!workDir.ClaimTask(workerId, task))
+		{
+			if (workDir.IsStopRequested())
+				break;
+
+			// Shards can still be requeued when another worker dies.
+			std::this_thread::sleep_for(std::chrono::seconds(2));
+			continue;
+		}
+
+		SPDLOG_INFO("Building {} (attempt {})", task.GetName(), task.attempts + 1);
+
+		if (task.zoneShortName != loadedZone)
+		{
+			geom.reset();
+			loadedZone.clear();
+
+			// The claim is kept while the load moves from one stage to the next.
+			GeometryLoadProgress loadProgress;
+			ShardHeartbeat heartbeat(workDir, task,
+				[&loadProgress]() { return static_cast<int>(loadProgress.GetStage()); });
+
+			geom = LoadZoneGeometry(eqConfig, task.zoneShortName, &context, &loadProgress);
+			if (geom)
+				loadedZone = task.zoneShortName;
+		}
+
+		if (geom && BuildShard(eqConfig, context, geom.get(), workDir, task, workerId))
+		{
+			++built;
+		}
+		else
+		{
+			SPDLOG_ERROR("Failed to build {}", task.GetName());
+			workDir.RequeueTask(task);
+		}
+	}
+
+	SPDLOG_INFO("Worker {} built {} shards", workerId, built);
+	spdlog::shutdown();
+	return 0;
+}
+
+//============================================================================
+
+struct LocalWorker
+{
+	std::string id;
+	PROCESS_INFORMATION process = {};
+	bool running = false;
+};
+
+static bool LaunchWorker(LocalWorker& worker, const std::string& workDirectory)
+{
+	CHAR exePath[MAX_PATH] = { 0 };
+	GetModuleFileNameA(nullptr, exePath, MAX_PATH);
+
+	std::string commandLine = fmt::format("\"{}\" --shard-worker \"{}\" --worker-id {}",
+		exePath, workDirectory, worker.id);
+
+	STARTUPINFOA startupInfo = { sizeof(startupInfo) };
+	if (!CreateProcessA(exePath, commandLine.data(), nullptr, nullptr, FALSE,
+		CREATE_NO_WINDOW | BELOW_NORMAL_PRIORITY_CLASS, nullptr, nullptr, &startupInfo, &worker.process))
+	{
+		SPDLOG_ERROR("Failed to start worker {}: error {}", worker.id, GetLastError());
+		return false;
+	}
+
+	worker.running = true;
+	return true;
+}
+
+static void CloseWorker(LocalWorker& worker)
+{
+	CloseHandle(worker.process.hProcess);
+	CloseHandle(worker.process.hThread);
+	worker.process = {};
+	worker.running = false;
+}
+
+// Stop a local worker that no longer makes progress. It is restarted like any
+// other worker that exited.
+static void TerminateWorker(std::vector<LocalWorker>& workers, const std::string& workerId)
+{
+	for (LocalWorker& worker : workers)
+	{
+		if (worker.running && worker.id == workerId)
+		{
+			SPDLOG_WARN("Terminating worker {}", worker.id);
+			TerminateProcess(worker.process.hProcess, 1);
+			WaitForSingleObject(worker.process.hProcess, 10 * 1000);
+		}
+	}
+}
+
+int RunShardedBuild(const ShardedBuildOptions& options)
+{
+	InitializeHeadlessLogging("coordinator");
+
+	EQConfig eqConfig;
+
+	const std::string workDirectory = options.workDirectory.empty()
+		? (fs::path(eqConfig.GetOutputPath()) / "shards").string()
+		: options.workDirectory;
+	ShardWorkDirectory workDir(workDirectory);
+	workDir.ClearStop();
+
+	const int shardCount = std::max(options.shardsPerZone, 1);
+
+	// A zone listed twice would be queued twice but only finish once.
+	std::vector<std::string> zones;
+	for (const std::string& zone : options.zones)
+	{
+		if (std::find(zones.begin(), zones.end(), zone) == zones.end())
+			zones.push_back(zone);
+	}
+
+	// Zones are recorded in the manifest as they are built, with the sources they
+	// had when they were queued.
+	ZoneManifest manifest(eqConfig.GetOutputPath());
+	manifest.Load();
+
+	std::map<std::string, ZoneBuildInputs> zoneInputs;
+
+	for (const std::string& zone : zones)
+	{
+		workDir.RemoveZone(zone);
+
+		zoneInputs[zone].HashSources(eqConfig.GetEverquestPath(), eqConfig.GetOutputPath(), zone);
+
+		// Build with the settings, volumes and connections of the existing navmesh.
+		NavMesh navMesh(eqConfig.GetOutputPath(), zone);
+		if (navMesh.LoadNavMeshFile() == NavMesh::LoadResult::Success && navMesh.GetNavMesh())
+		{
+			NavMeshFileWriter writer;
+			if (!writer.Open(workDir.GetSettingsFile(zone))
+				|| !navMesh.FinishNavMeshFile(writer, *navMesh.GetNavMesh()->getParams()))
+			{
+				SPDLOG_ERROR("Failed to write build settings for {}", zone);
+			}
+		}
+
+		for (int shard = 0; shard < shardCount; ++shard)
+		{
+			ShardTask task;
+			task.zoneShortName = zone;
+			task.shard = shard;
+			task.shardCount = shardCount;
+			workDir.AddTask(task);
+		}
+	}
+
+	SPDLOG_INFO("Sharded build of {} zones, {} shards each, in {}", zones.size(), shardCount, workDirectory);
+
+	std::vector<LocalWorker> workers(std::max(options.localWorkers, 0));
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i].id = fmt::format("local{}-{}", i, GetCurrentProcessId());
+		LaunchWorker(workers[i], workDirectory);
+	}
+
+	// A worker that keeps dying is probably hitting the same bad tile over and over,
+	// the attempt limit on the shard takes care of that. This only stops an endless
+	// restart loop if workers can't run at all.
+	int restartsLeft = static_cast<int>(workers.size()) * options.maxAttempts * 4;
+
+	std::set<std::string> finishedZones;
+	int failedZones = 0;
+
+	// Shards done or failed so far, and when the last one was.
+	size_t settledShards = 0;
+	auto lastProgress = std::chrono::steady_clock::now();
+
+	// When each claim was first seen, by task, to time it out. Kept here rather
+	// than in the claim file so that the clocks of remote workers don't matter.
+	struct ClaimStart
+	{
+		std::string workerId;
+		int attempts = 0;
+		std::chrono::steady_clock::time_point time;
+	};
+	std::map<std::string, ClaimStart> claimStarts;
+
+	while (finishedZones.size() < zones.size())
+	{
+		std::vector<ShardWorkDirectory::TaskInfo> tasks = workDir.GetTasks();
+		const auto now = fs::file_time_type::clock::now();
+
+		bool workLeft = false;
+		bool building = false;
+		for (const auto& info : tasks)
+		{
+			if (info.state == ShardState::Todo || info.state == ShardState::Claimed)
+				workLeft = true;
+
+			// A worker that keeps its claim alive is still making progress.
+			if (info.state == ShardState::Claimed && now - info.lastHeartbeat <= options.heartbeatTimeout)
+				building = true;
+		}
+
+		// Shards held by workers that exited go back to the queue right away.
+		for (LocalWorker& worker : workers)
+		{
+			if (!worker.running || WaitForSingleObject(worker.process.hProcess, 0) != WAIT_OBJECT_0)
+				continue;
+
+			DWORD exitCode = 0;
+			GetExitCodeProcess(worker.process.hProcess, &exitCode);
+			SPDLOG_WARN("Worker {} exited with code {:#x}", worker.id, exitCode);
+			CloseWorker(worker);
+
+			for (const auto& info : tasks)
+			{
+				if (info.state == ShardState::Claimed && info.workerId == worker.id)
+					workDir.RequeueTask(info.task);
+			}
+
+			if (workLeft && restartsLeft > 0)
+			{
+				--restartsLeft;
+				LaunchWorker(worker, workDirectory);
+			}
+		}
+
+		std::map<std::string, ClaimStart> claimed;
+		for (const auto& info : tasks)
+		{
+			if (info.state != ShardState::Claimed)
+				continue;
+
+			const std::string name = info.task.GetName();
+			auto iter = claimStarts.find(name);
+			if (iter != claimStarts.end() && iter->second.workerId == info.workerId
+				&& iter->second.attempts == info.task.attempts)
+			{
+				claimed.emplace(name, iter->second);
+			}
+			else
+			{
+				claimed.emplace(name, ClaimStart{ info.workerId, info.task.attempts, std::chrono::steady_clock::now() });
+			}
+		}
+		claimStarts = std::move(claimed);
+
+		std::map<std::string, std::vector<const ShardWorkDirectory::TaskInfo*>> tasksByZone;
+		for (const auto& info : tasks)
+		{
+			const bool claimExpired = info.state == ShardState::Claimed
+				&& std::chrono::steady_clock::now() - claimStarts[info.task.GetName()].time > options.claimTimeout;
+
+			if (info.state == ShardState::Claimed && now - info.lastHeartbeat > options.heartbeatTimeout)
+			{
+				SPDLOG_WARN("No progress from worker {} on {}, requeueing it", info.workerId, info.task.GetName());
+				TerminateWorker(workers, info.workerId);
+				workDir.RequeueTask(info.task);
+			}
+			else if (claimExpired)
+			{
+				SPDLOG_WARN("Worker {} held {} for more than {} seconds, requeueing it", info.workerId,
+					info.task.GetName(), options.claimTimeout.count());
+				TerminateWorker(workers, info.workerId);
+				workDir.RequeueTask(info.task);
+			}
+			else if (info.state == ShardState::Todo && info.task.attempts >= options.maxAttempts)
+			{
+				SPDLOG_ERROR("Giving up on {} after {} attempts", info.task.GetName(), info.task.attempts);
+				workDir.FailTask(info.task, ShardState::Todo);
+			}
+
+			tasksByZone[info.task.zoneShortName].push_back(&info);
+		}
+
+		size_t settled = finishedZones.size() * static_cast<size_t>(shardCount);
+
+		for (const std::string& zone : zones)
+		{
+			if (finishedZones.count(zone))
+				continue;
+
+			// Counted by shard, so that a shard is never merged twice even if it
+			// shows up in more than one state.
+			std::map<int, std::string> outputs;
+			std::set<int> failedShards;
+			for (const auto* info : tasksByZone[zone])
+			{
+				if (info->task.shardCount != shardCount)
+					continue;
+
+				if (info->state == ShardState::Done)
+					outputs.emplace(info->task.shard, workDir.GetOutputFile(info->task, info->workerId));
+				else if (info->state == ShardState::Failed)
+					failedShards.insert(info->task.shard);
+			}
+
+			for (const auto& [shard, output] : outputs)
+				failedShards.erase(shard);
+
+			const int done = static_cast<int>(outputs.size());
+			const int failed = static_cast<int>(failedShards.size());
+			settled += done + failed;
+
+			if (done == shardCount)
+			{
+				std::vector<std::string> outputFiles;
+				for (const auto& [shard, output] : outputs)
+					outputFiles.push_back(output);
+
+				NavMesh navMesh(eqConfig.GetOutputPath(), zone);
+				if (NavMeshFileWriter::Merge(outputFiles, navMesh.GetFullFilePath()))
+				{
+					SPDLOG_INFO("Built {}", navMesh.GetFullFilePath());
+					workDir.RemoveZone(zone);
+
+					// Zones built without a navmesh get their settings from the build.
+					if (navMesh.LoadNavMeshFile() == NavMesh::LoadResult::Success)
+					{
+						ZoneBuildInputs& inputs = zoneInputs[zone];
+						inputs.HashSettings(navMesh, eqConfig.GetUseMaxExtents());
+						manifest.Record(zone, inputs);
+						manifest.Save();
+					}
+				}
+				else
+				{
+					SPDLOG_ERROR("Failed to merge the shards of {}", zone);
+					++failedZones;
+				}
+
+				finishedZones.insert(zone);
+			}
+			else if (failed > 0 && done + failed == shardCount)
+			{
+				// The shard files are left behind to investigate.
+				SPDLOG_ERROR("Failed to build {}: {} of {} shards failed", zone, failed, shardCount);
+				++failedZones;
+				finishedZones.insert(zone);
+			}
+		}
+
+		if (finishedZones.size() == zones.size())
+			break;
+
+		if (building || settled != settledShards)
+		{
+			settledShards = settled;
+			lastProgress = std::chrono::steady_clock::now();
+		}
+
+		// Without a local worker left, including when none were started, only
+		// remote workers can finish the build.
+		const bool localWorkers = restartsLeft > 0
+			|| std::any_of(workers.begin(), workers.end(), [](const LocalWorker& worker) { return worker.running; });
+		const std::chrono::seconds idleLimit = localWorkers ? options.progressTimeout : options.heartbeatTimeout;
+
+		if (std::chrono::steady_clock::now() - lastProgress > idleLimit)
+		{
+			SPDLOG_ERROR("No shard was built for {} seconds{}, giving up on the zones left",
+				idleLimit.count(), localWorkers ? "" : " and no local worker is left");
+
+			for (const std::string& zone : zones)
+			{
+				if (finishedZones.count(zone))
+					continue;
+
+				// Keep late workers from picking up shards of a zone that was given up.
+				for (const auto* info : tasksByZone[zone])
+				{
+					if (info->state == ShardState::Todo)
+						workDir.FailTask(info->task, ShardState::Todo);
+				}
+
+				SPDLOG_ERROR("Failed to build {}: not all shards were built", zone);
+				++failedZones;
+				finishedZones.insert(zone);
+			}
+
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	// Let the workers finish on their own, they exit once idle.
+	workDir.RequestStop();
+
+	for (LocalWorker& worker : workers)
+	{
+		if (!worker.running)
+			continue;
+
+		if (WaitForSingleObject(worker.process.hProcess, 30 * 1000) != WAIT_OBJECT_0)
+			TerminateProcess(worker.process.hProcess, 1);
+
+		CloseWorker(worker);
+	}
+
+	SPDLOG_INFO("Sharded build finished, {} of {} zones failed", failedZones, zones.size());
+	spdlog::shutdown();
+	return failedZones;
+}
@@ -0,0 +1,186 @@
+//
+// ShardedBuild.h
+//
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sharded builds split the tiles of one or more zones over several worker
+// processes, on this machine or on any machine that can see the work directory.
+// A worker that crashes, or stops making progress, only loses the shard it was
+// building, which is handed to another worker. A worker that is still making
+// progress but holds a claim for longer than the claim timeout loses it too, and
+// is terminated if it was started by the coordinator.
+//
+// Shard i of n holds every tile whose index (x + y * tile grid width) is i modulo
+// n. Each shard is written as a complete navmesh file holding only its tiles, and
+// the shards of a zone are merged into the final navmesh once they are all done.
+//
+// Work directory layout, where <task> is <zone>.<shard>-of-<count>:
+//
+//   <zone>.settings.navmesh   settings, volumes, areas and connections to build
+//                             with, as a navmesh without tiles. Optional.
+//   <task>.todo               shard waiting for a worker. Holds the attempt count.
+//   <task>.claimed            shard being built. Holds the worker id and attempt
+//                             count, its write time is refreshed as a heartbeat
+//                             whenever the build moves forward.
+//   <task>.done               shard built, same contents as when claimed.
+//   <task>.failed             shard that failed too many times.
+//   <task>.requeued           shard taken from its worker, on its way back to
+//                             .todo.
+//   <task>.<worker>.completing
+//                             shard being marked done by its worker.
+//   <task>.<worker>.navmesh   output of the shard, written by the worker that
+//                             completed it.
+//   stop                      tells workers to exit once idle.
+//   traces/                   build trace of each shard, see BuildTrace.h.
+//
+// Workers claim a shard by renaming its .todo file, which only one of them can
+// do. Completing and requeueing a shard both start by renaming its .claimed
+// file, so only one of them wins. Everything else is only written by the worker
+// holding the claim or by the coordinator.
+
+struct ShardTask
+{
+	std::string zoneShortName;
+	int shard = 0;
+	int shardCount = 1;
+	int attempts = 0;
+
+	// <zone>.<shard>-of-<count>
+	std::string GetName() const;
+	static bool ParseName(const std::string& name, ShardTask& task);
+};
+
+enum class ShardState
+{
+	Todo,
+	Claimed,
+	Done,
+	Failed,
+};
+
+class ShardWorkDirectory
+{
+public:
+	explicit ShardWorkDirectory(const std::string& path);
+
+	const std::filesystem::path& GetPath() const { return m_path; }
+
+	std::string GetSettingsFile(const std::string& zoneShortName) const;
+	std::string GetOutputFile(const ShardTask& task, const std::string& workerId) const;
+
+	struct TaskInfo
+	{
+		ShardTask task;
+		ShardState state = ShardState::Todo;
+		std::string workerId;
+		std::filesystem::file_time_type lastHeartbeat;
+	};
+
+	// All tasks in the directory.
+	std::vector<TaskInfo> GetTasks() const;
+
+	// Queue a new task.
+	bool AddTask(const ShardTask& task);
+
+	// Give a claimed task back to the queue, counting a failed attempt.
+	bool RequeueTask(const ShardTask& task);
+
+	// Give up on a queued or claimed task.
+	bool FailTask(const ShardTask& task, ShardState state);
+
+	// Remove every file of a zone, except its merged output which lives elsewhere.
+	void RemoveZone(const std::string& zoneShortName);
+
+	// Worker: claim the next queued task. Returns false if there is none.
+	bool ClaimTask(const std::string& workerId, ShardTask& task);
+	void Heartbeat(const ShardTask& task);
+
+	// Mark a claimed task as done. Fails if the claim was lost, after the worker
+	// was presumed dead.
+	bool CompleteTask(const ShardTask& task, const std::string& workerId);
+
+	void RequestStop();
+	bool IsStopRequested() const;
+	void ClearStop();
+
+private:
+	std::filesystem::path GetStateFile(const ShardTask& task, ShardState state) const;
+
+	std::filesystem::path m_path;
+};
+
+// Refreshes the claim on a task from a thread of its own, but only when the value
+// returned by progress has changed since the last refresh. A build that hangs
+// stops refreshing its claim even though this thread keeps running.
+class ShardHeartbeat
+{
+public:
+	ShardHeartbeat(ShardWorkDirectory& workDir, const ShardTask& task, std::function<int()> progress,
+		std::chrono::milliseconds interval = std::chrono::seconds(5));
+	~ShardHeartbeat();
+
+	ShardHeartbeat(const ShardHeartbeat&) = delete;
+	ShardHeartbeat& operator=(const ShardHeartbeat&) = delete;
+
+private:
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_stopped;
+	bool m_stop = false;
+};
+
+// Runs a sharded build of a list of zones from this process, launching local
+// worker processes and merging the shards of each zone into its navmesh file.
+// Each zone that is built is recorded in the manifest, see ZoneManifest.h.
+struct ShardedBuildOptions
+{
+	std::vector<std::string> zones;
+	std::string workDirectory;
+	int shardsPerZone = 4;
+	int localWorkers = 4;
+	int maxAttempts = 3;
+
+	// Claims without a heartbeat for this long are given to another worker.
+	std::chrono::seconds heartbeatTimeout{ 60 };
+
+	// The zones left are failed if no shard is being built or completed for this
+	// long. Once no local worker is left to run, remote workers get one heartbeat
+	// timeout to claim a shard instead.
+	std::chrono::seconds progressTimeout{ 10 * 60 };
+
+	// Claims held for this long are given to another worker even if they are still
+	// making progress, and local workers holding them are terminated.
+	std::chrono::seconds claimTimeout{ 2 * 60 * 60 };
+};
+
+// A worker that hangs without exiting can be checked by hand. Start a build of a
+// large zone:
+//
+//   MeshGenerator --build <zone> --workers 2
+//
+// Once a worker has claimed a shard, attach a debugger to it and freeze every
+// thread except the heartbeat. Its tile count stops moving, so its claim is no
+// longer refreshed, and after the heartbeat timeout the coordinator log reports
+// the shard as requeued, the worker is terminated and restarted, and another
+// worker builds the shard. Adding --claim-timeout 30 shows the claim timeout with
+// workers left running: each claim that lasts longer is requeued and its worker
+// restarted, until the shards fail after the attempt limit.
+
+// Returns the number of zones that failed.
+int RunShardedBuild(const ShardedBuildOptions& options);
+
+// Claims and builds shards from the work directory until no work is left.
+int RunShardWorker(const std::string& workDirectory, const std::string& workerId);
+
+// Headless runs log to their own file, there is no console window to log to.
+void InitializeHeadlessLogging(const std::string& name);
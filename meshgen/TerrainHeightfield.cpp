@@ -0,0 +1,667 @@
+//
+// TerrainHeightfield.cpp
+//
+
+#include "meshgen/TerrainHeightfield.h"
+#include "common/Utilities.h"
+
+#pragma warning(push)
+#pragma warning(disable : 4018)
+#include <zone-utilities/common/eqg_terrain.h>
+#pragma warning(pop)
+
+#include <DebugDraw.h>
+#include <Recast.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Column sample accumulated from all quads that overlap a heightfield cell.
+struct CellSample
+{
+	float smin;
+	float smax;
+	float walkableTop;
+	bool set;
+};
+
+// Heights of the four corners of a quad. The quad is split into triangle A
+// (corners 0, 1, 2) where u >= v and triangle B (corners 0, 2, 3) where u < v.
+//
+//   3 --- 2    z (v)
+//   | B / |    ^
+//   |  /  |    |
+//   | / A |    |
+//   0 --- 1    +---> x (u)
+struct QuadHeights
+{
+	float h[4];
+
+	float Sample(float u, float v) const
+	{
+		if (u >= v)
+			return h[0] + u * (h[1] - h[0]) + v * (h[2] - h[1]);
+		return h[0] + v * (h[3] - h[0]) + u * (h[2] - h[3]);
+	}
+
+	// Unit normals of the two triangles
+	void GetNormals(float unitsPerVertex, float* na, float* nb) const
+	{
+		const float inv = 1.0f / unitsPerVertex;
+		auto calc = [](float* n, float gx, float gz)
+		{
+			const float d = 1.0f / sqrtf(gx * gx + 1.0f + gz * gz);
+			n[0] = -gx * d;
+			n[1] = d;
+			n[2] = -gz * d;
+		};
+
+		calc(na, (h[1] - h[0]) * inv, (h[2] - h[1]) * inv);
+		calc(nb, (h[2] - h[3]) * inv, (h[3] - h[0]) * inv);
+	}
+};
+
+bool IntersectSegmentTriangle(const float* sp, const float* sq,
+	const float* a, const float* b, const float* c, float& t)
+{
+	float ab[3], ac[3], qp[3], ap[3], norm[3], e[3];
+	rcVsub(ab, b, a);
+	rcVsub(ac, c, a);
+	rcVsub(qp, sp, sq);
+
+	rcVcross(norm, ab, ac);
+
+	// Segment must point towards the front side of the triangle.
+	float d = rcVdot(qp, norm);
+	if (d <= 0.0f) return false;
+
+	rcVsub(ap, sp, a);
+	t = rcVdot(ap, norm);
+	if (t < 0.0f) return false;
+	if (t > d) return false;
+
+	rcVcross(e, qp, ap);
+	float v = rcVdot(ac, e);
+	if (v < 0.0f || v > d) return false;
+	float w = -rcVdot(ab, e);
+	if (w < 0.0f || v + w > d) return false;
+
+	t /= d;
+	return true;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+bool TerrainHeightfield::Build(EQEmu::EQG::Terrain& terrain,
+	const std::function<bool(const glm::vec3&)>& isExcluded)
+{
+	m_heightStorage.clear();
+	m_quadFlagStorage.clear();
+	m_heights = nullptr;
+	m_quadFlags = nullptr;
+	m_quadsX = m_quadsZ = 0;
+	m_solidQuadCount = 0;
+
+	const auto& tiles = terrain.GetTiles();
+	const int quadsPerTile = static_cast<int>(terrain.GetQuadsPerTile());
+	const float unitsPerVertex = terrain.GetUnitsPerVertex();
+	if (tiles.empty() || quadsPerTile <= 0 || unitsPerVertex <= 0.0f)
+		return false;
+
+	const float tileSize = quadsPerTile * unitsPerVertex;
+
+	// Tiles are laid out on a regular grid. Find its extents.
+	float minX = FLT_MAX, minZ = FLT_MAX, maxX = -FLT_MAX, maxZ = -FLT_MAX;
+	for (const auto& tile : tiles)
+	{
+		minX = std::min(minX, tile->GetX());
+		minZ = std::min(minZ, tile->GetY());
+		maxX = std::max(maxX, tile->GetX());
+		maxZ = std::max(maxZ, tile->GetY());
+	}
+
+	const int tilesX = static_cast<int>(std::lround((maxX - minX) / tileSize)) + 1;
+	const int tilesZ = static_cast<int>(std::lround((maxZ - minZ) / tileSize)) + 1;
+
+	m_origin[0] = minX;
+	m_origin[1] = minZ;
+	m_unitsPerVertex = unitsPerVertex;
+	m_quadsX = tilesX * quadsPerTile;
+	m_quadsZ = tilesZ * quadsPerTile;
+
+	m_heightStorage.assign(GetHeightCount(), 0.0f);
+	m_quadFlagStorage.assign(GetQuadCount(), 0);
+
+	const int vertsPerRow = quadsPerTile + 1;
+	const size_t tileVertCount = static_cast<size_t>(vertsPerRow) * vertsPerRow;
+	const size_t tileQuadCount = static_cast<size_t>(quadsPerTile) * quadsPerTile;
+
+	// Neighbouring tiles share their edge vertices, and don't always agree on
+	// their heights. Each tile owns the vertices from its near edges up to, but not
+	// including, its far edges. A far edge vertex is only taken from this tile if
+	// the tile that owns it is missing, and then from the first such tile in grid
+	// order, so the seams don't depend on the order of the tiles in the file.
+	struct TilePlacement
+	{
+		int baseX;
+		int baseZ;
+		EQEmu::EQG::TerrainTile* tile;
+	};
+
+	std::vector<TilePlacement> placements;
+	placements.reserve(tiles.size());
+
+	for (const auto& tile : tiles)
+	{
+		const auto& floats = tile->GetFloats();
+		if (tile->IsFlat() ? floats.empty()
+			: floats.size() < tileVertCount || tile->GetFlags().size() < tileQuadCount)
+		{
+			continue;
+		}
+
+		if (tile->IsFlat() && isExcluded(glm::vec3{ tile->GetY(), tile->GetX(), floats[0] }))
+			continue;
+
+		placements.push_back({
+			static_cast<int>(std::lround((tile->GetX() - minX) / tileSize)) * quadsPerTile,
+			static_cast<int>(std::lround((tile->GetY() - minZ) / tileSize)) * quadsPerTile,
+			tile.get() });
+	}
+
+	std::sort(placements.begin(), placements.end(),
+		[](const TilePlacement& a, const TilePlacement& b)
+		{
+			return std::tie(a.baseZ, a.baseX) < std::tie(b.baseZ, b.baseX);
+		});
+
+	std::vector<bool> heightSet(GetHeightCount(), false);
+
+	auto tileHeight = [&](EQEmu::EQG::TerrainTile* tile, int row, int col)
+	{
+		const auto& floats = tile->GetFloats();
+		return tile->IsFlat() ? floats[0] : floats[row * vertsPerRow + col];
+	};
+
+	// Owned vertices first, then the far edges that nobody owns.
+	for (const TilePlacement& placement : placements)
+	{
+		for (int row = 0; row < quadsPerTile; ++row)
+		{
+			for (int col = 0; col < quadsPerTile; ++col)
+			{
+				const size_t index = (placement.baseX + row) + (placement.baseZ + col) * (m_quadsX + 1);
+				m_heightStorage[index] = tileHeight(placement.tile, row, col);
+				heightSet[index] = true;
+			}
+		}
+	}
+
+	for (const TilePlacement& placement : placements)
+	{
+		for (int row = 0; row <= quadsPerTile; ++row)
+		{
+			for (int col = 0; col <= quadsPerTile; ++col)
+			{
+				if (row < quadsPerTile && col < quadsPerTile)
+					continue;
+
+				const size_t index = (placement.baseX + row) + (placement.baseZ + col) * (m_quadsX + 1);
+				if (heightSet[index])
+					continue;
+
+				m_heightStorage[index] = tileHeight(placement.tile, row, col);
+				heightSet[index] = true;
+			}
+		}
+	}
+
+	for (const TilePlacement& placement : placements)
+	{
+		EQEmu::EQG::TerrainTile* tile = placement.tile;
+		const float x = tile->GetX();
+		const float z = tile->GetY();
+		const auto& flags = tile->GetFlags();
+
+		for (int row = 0; row < quadsPerTile; ++row)
+		{
+			for (int col = 0; col < quadsPerTile; ++col)
+			{
+				if (!tile->IsFlat())
+				{
+					if (flags[row * quadsPerTile + col] & 0x01)
+						continue;
+
+					const glm::vec3 corner{ z + col * unitsPerVertex, x + row * unitsPerVertex,
+						tileHeight(tile, row, col) };
+					if (isExcluded(corner))
+						continue;
+				}
+
+				m_quadFlagStorage[(placement.baseX + row) + (placement.baseZ + col) * m_quadsX] = QUAD_SOLID;
+			}
+		}
+	}
+
+	m_heights = m_heightStorage.data();
+	m_quadFlags = m_quadFlagStorage.data();
+
+	CalcBounds();
+	return true;
+}
+
+void TerrainHeightfield::Attach(const float* origin, float unitsPerVertex, int quadsX, int quadsZ,
+	const float* heights, const uint8_t* quadFlags)
+{
+	m_heightStorage.clear();
+	m_quadFlagStorage.clear();
+
+	m_origin[0] = origin[0];
+	m_origin[1] = origin[1];
+	m_unitsPerVertex = unitsPerVertex;
+	m_quadsX = quadsX;
+	m_quadsZ = quadsZ;
+	m_heights = heights;
+	m_quadFlags = quadFlags;
+
+	CalcBounds();
+}
+
+void TerrainHeightfield::CalcBounds()
+{
+	m_solidQuadCount = 0;
+	m_bmin = glm::vec3(FLT_MAX);
+	m_bmax = glm::vec3(-FLT_MAX);
+
+	for (int z = 0; z < m_quadsZ; ++z)
+	{
+		for (int x = 0; x < m_quadsX; ++x)
+		{
+			if (!IsSolid(x, z))
+				continue;
+
+			++m_solidQuadCount;
+
+			const float h[4] = { GetHeight(x, z), GetHeight(x + 1, z), GetHeight(x + 1, z + 1), GetHeight(x, z + 1) };
+			m_bmin.x = std::min(m_bmin.x, m_origin[0] + x * m_unitsPerVertex);
+			m_bmin.y = std::min({ m_bmin.y, h[0], h[1], h[2], h[3] });
+			m_bmin.z = std::min(m_bmin.z, m_origin[1] + z * m_unitsPerVertex);
+			m_bmax.x = std::max(m_bmax.x, m_origin[0] + (x + 1) * m_unitsPerVertex);
+			m_bmax.y = std::max({ m_bmax.y, h[0], h[1], h[2], h[3] });
+			m_bmax.z = std::max(m_bmax.z, m_origin[1] + (z + 1) * m_unitsPerVertex);
+		}
+	}
+
+	if (m_solidQuadCount == 0)
+	{
+		m_bmin = glm::vec3(0.0f);
+		m_bmax = glm::vec3(0.0f);
+	}
+}
+
+bool TerrainHeightfield::GetQuadRange(float minx, float minz, float maxx, float maxz,
+	int& x0, int& z0, int& x1, int& z1) const
+{
+	if (m_quadsX == 0 || m_quadsZ == 0)
+		return false;
+
+	const float inv = 1.0f / m_unitsPerVertex;
+
+	x0 = std::max(0, static_cast<int>(floorf((minx - m_origin[0]) * inv)));
+	z0 = std::max(0, static_cast<int>(floorf((minz - m_origin[1]) * inv)));
+	x1 = std::min(m_quadsX - 1, static_cast<int>(floorf((maxx - m_origin[0]) * inv)));
+	z1 = std::min(m_quadsZ - 1, static_cast<int>(floorf((maxz - m_origin[1]) * inv)));
+
+	return x0 <= x1 && z0 <= z1;
+}
+
+int TerrainHeightfield::Rasterize(rcContext* ctx, float walkableSlopeAngle, rcHeightfield& hf,
+	int flagMergeThr) const
+{
+	int x0, z0, x1, z1;
+	if (!GetQuadRange(hf.bmin[0], hf.bmin[2], hf.bmax[0], hf.bmax[2], x0, z0, x1, z1))
+		return 0;
+
+	rcScopedTimer timer(ctx, RC_TIMER_RASTERIZE_TRIANGLES);
+
+	const float walkableThr = cosf(walkableSlopeAngle / 180.0f * RC_PI);
+	const float cs = hf.cs;
+	const float ics = 1.0f / hf.cs;
+	const float ich = 1.0f / hf.ch;
+	const float by = hf.bmax[1] - hf.bmin[1];
+	const float upv = m_unitsPerVertex;
+	const float iupv = 1.0f / upv;
+
+	// Reused by each thread between tiles.
+	thread_local std::vector<CellSample> cells;
+	cells.assign(static_cast<size_t>(hf.width) * hf.height, CellSample{ FLT_MAX, -FLT_MAX, -FLT_MAX, false });
+
+	for (int qz = z0; qz <= z1; ++qz)
+	{
+		for (int qx = x0; qx <= x1; ++qx)
+		{
+			if (!IsSolid(qx, qz))
+				continue;
+
+			const float wx = m_origin[0] + qx * upv;
+			const float wz = m_origin[1] + qz * upv;
+
+			QuadHeights quad{ { GetHeight(qx, qz), GetHeight(qx + 1, qz), GetHeight(qx + 1, qz + 1), GetHeight(qx, qz + 1) } };
+
+			float na[3], nb[3];
+			quad.GetNormals(upv, na, nb);
+			const bool walkableA = na[1] > walkableThr;
+			const bool walkableB = nb[1] > walkableThr;
+
+			// Cells covered by this quad.
+			const int cx0 = std::max(0, static_cast<int>(floorf((wx - hf.bmin[0]) * ics)));
+			const int cx1 = std::min(hf.width - 1, static_cast<int>(ceilf((wx + upv - hf.bmin[0]) * ics)) - 1);
+			const int cz0 = std::max(0, static_cast<int>(floorf((wz - hf.bmin[2]) * ics)));
+			const int cz1 = std::min(hf.height - 1, static_cast<int>(ceilf((wz + upv - hf.bmin[2]) * ics)) - 1);
+
+			for (int cz = cz0; cz <= cz1; ++cz)
+			{
+				const float cellz = hf.bmin[2] + cz * cs;
+				const float v0 = rcClamp((cellz - wz) * iupv, 0.0f, 1.0f);
+				const float v1 = rcClamp((cellz + cs - wz) * iupv, 0.0f, 1.0f);
+				if (v1 <= v0)
+					continue;
+
+				for (int cx = cx0; cx <= cx1; ++cx)
+				{
+					const float cellx = hf.bmin[0] + cx * cs;
+					const float u0 = rcClamp((cellx - wx) * iupv, 0.0f, 1.0f);
+					const float u1 = rcClamp((cellx + cs - wx) * iupv, 0.0f, 1.0f);
+					if (u1 <= u0)
+						continue;
+
+					// The surface is planar on each side of the diagonal, so the extremes over
+					// the covered rectangle are at its corners or where the diagonal crosses it.
+					// Track the top of each triangle separately to resolve the area below.
+					float smin = FLT_MAX, smax = -FLT_MAX;
+					float topA = -FLT_MAX, topB = -FLT_MAX;
+					auto addSample = [&](float u, float v)
+					{
+						const float h = quad.Sample(u, v);
+						smin = std::min(smin, h);
+						smax = std::max(smax, h);
+						if (u >= v) topA = std::max(topA, h);
+						if (u <= v) topB = std::max(topB, h);
+					};
+					addSample(u0, v0);
+					addSample(u1, v0);
+					addSample(u0, v1);
+					addSample(u1, v1);
+
+					const float d0 = std::max(u0, v0);
+					const float d1 = std::min(u1, v1);
+					if (d0 <= d1)
+					{
+						addSample(d0, d0);
+						addSample(d1, d1);
+					}
+
+					CellSample& cell = cells[cx + cz * hf.width];
+					cell.smin = std::min(cell.smin, smin);
+					cell.smax = std::max(cell.smax, smax);
+					if (walkableA && u1 > v0)
+						cell.walkableTop = std::max(cell.walkableTop, topA);
+					if (walkableB && v1 > u0)
+						cell.walkableTop = std::max(cell.walkableTop, topB);
+					cell.set = true;
+				}
+			}
+		}
+	}
+
+	int columns = 0;
+	for (int cz = 0; cz < hf.height; ++cz)
+	{
+		for (int cx = 0; cx < hf.width; ++cx)
+		{
+			const CellSample& cell = cells[cx + cz * hf.width];
+			if (!cell.set)
+				continue;
+
+			float smin = cell.smin - hf.bmin[1];
+			float smax = cell.smax - hf.bmin[1];
+
+			// Skip the span if it is outside the heightfield bbox
+			if (smax < 0.0f) continue;
+			if (smin > by) continue;
+
+			// Clamp the span to the heightfield bbox.
+			if (smin < 0.0f) smin = 0;
+			if (smax > by) smax = by;
+
+			// Snap the span to the heightfield height grid.
+			const unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
+			const unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin + 1, RC_SPAN_MAX_HEIGHT);
+
+			// Like span merging, the area comes from the top of the column. Walkable
+			// triangles within the merge threshold of the top keep it walkable.
+			unsigned char area = RC_NULL_AREA;
+			if (cell.walkableTop > -FLT_MAX)
+			{
+				const int walkableMax = (int)ceilf(rcMin(cell.walkableTop - hf.bmin[1], by) * ich);
+				if ((int)ismax - walkableMax <= flagMergeThr)
+					area = RC_WALKABLE_AREA;
+			}
+
+			if (!rcAddSpan(ctx, hf, cx, cz, ismin, ismax, area, flagMergeThr))
+				return columns;
+
+			++columns;
+		}
+	}
+
+	return columns;
+}
+
+void TerrainHeightfield::Hash(const float* bmin, const float* bmax, ContentHash& hash) const
+{
+	int x0, z0, x1, z1;
+	if (!GetQuadRange(bmin[0], bmin[2], bmax[0], bmax[2], x0, z0, x1, z1))
+	{
+		hash.Update(0);
+		return;
+	}
+
+	hash.Update(m_origin[0]);
+	hash.Update(m_origin[1]);
+	hash.Update(m_unitsPerVertex);
+	hash.Update(x0);
+	hash.Update(z0);
+	hash.Update(x1);
+	hash.Update(z1);
+
+	for (int z = z0; z <= z1; ++z)
+		hash.Update(&m_quadFlags[x0 + z * m_quadsX], x1 - x0 + 1);
+
+	for (int z = z0; z <= z1 + 1; ++z)
+		hash.Update(&m_heights[x0 + z * (m_quadsX + 1)], sizeof(float) * (x1 - x0 + 2));
+}
+
+bool TerrainHeightfield::Raycast(const float* src, const float* dst, float& tmin) const
+{
+	if (IsEmpty())
+		return false;
+
+	const float gridMin[2] = { m_origin[0], m_origin[1] };
+	const float gridMax[2] = { m_origin[0] + m_quadsX * m_unitsPerVertex, m_origin[1] + m_quadsZ * m_unitsPerVertex };
+	const float d[2] = { dst[0] - src[0], dst[2] - src[2] };
+	const float p[2] = { src[0], src[2] };
+
+	// Clip the segment to the grid on the xz plane.
+	float t0 = 0.0f, t1 = 1.0f;
+	for (int i = 0; i < 2; ++i)
+	{
+		if (fabsf(d[i]) < 1e-6f)
+		{
+			if (p[i] < gridMin[i] || p[i] > gridMax[i])
+				return false;
+		}
+		else
+		{
+			float ta = (gridMin[i] - p[i]) / d[i];
+			float tb = (gridMax[i] - p[i]) / d[i];
+			if (ta > tb) std::swap(ta, tb);
+			t0 = std::max(t0, ta);
+			t1 = std::min(t1, tb);
+			if (t0 > t1)
+				return false;
+		}
+	}
+
+	// Walk the quads crossed by the segment in order, the first hit is the nearest.
+	const float iupv = 1.0f / m_unitsPerVertex;
+	int cell[2], step[2];
+	float tnext[2], tdelta[2];
+
+	for (int i = 0; i < 2; ++i)
+	{
+		const int maxCell = (i == 0 ? m_quadsX : m_quadsZ) - 1;
+		const float start = p[i] + d[i] * t0;
+		cell[i] = rcClamp(static_cast<int>(floorf((start - gridMin[i]) * iupv)), 0, maxCell);
+
+		if (d[i] > 0.0f)
+		{
+			step[i] = 1;
+			tnext[i] = (gridMin[i] + (cell[i] + 1) * m_unitsPerVertex - p[i]) / d[i];
+			tdelta[i] = m_unitsPerVertex / d[i];
+		}
+		else if (d[i] < 0.0f)
+		{
+			step[i] = -1;
+			tnext[i] = (gridMin[i] + cell[i] * m_unitsPerVertex - p[i]) / d[i];
+			tdelta[i] = -m_unitsPerVertex / d[i];
+		}
+		else
+		{
+			step[i] = 0;
+			tnext[i] = FLT_MAX;
+			tdelta[i] = FLT_MAX;
+		}
+	}
+
+	while (true)
+	{
+		const int qx = cell[0], qz = cell[1];
+
+		if (IsSolid(qx, qz))
+		{
+			const float wx = m_origin[0] + qx * m_unitsPerVertex;
+			const float wz = m_origin[1] + qz * m_unitsPerVertex;
+			const float wx1 = wx + m_unitsPerVertex;
+			const float wz1 = wz + m_unitsPerVertex;
+
+			const float v0[3] = { wx, GetHeight(qx, qz), wz };
+			const float v1[3] = { wx1, GetHeight(qx + 1, qz), wz };
+			const float v2[3] = { wx1, GetHeight(qx + 1, qz + 1), wz1 };
+			const float v3[3] = { wx, GetHeight(qx, qz + 1), wz1 };
+
+			bool hit = false;
+			float t = 1.0f;
+			tmin = 1.0f;
+			if (IntersectSegmentTriangle(src, dst, v0, v2, v1, t))
+			{
+				tmin = std::min(tmin, t);
+				hit = true;
+			}
+			if (IntersectSegmentTriangle(src, dst, v2, v0, v3, t))
+			{
+				tmin = std::min(tmin, t);
+				hit = true;
+			}
+
+			if (hit)
+				return true;
+		}
+
+		const int axis = tnext[0] < tnext[1] ? 0 : 1;
+		if (tnext[axis] > t1)
+			break;
+
+		cell[axis] += step[axis];
+		tnext[axis] += tdelta[axis];
+
+		if (cell[axis] < 0 || cell[axis] >= (axis == 0 ? m_quadsX : m_quadsZ))
+			break;
+	}
+
+	return false;
+}
+
+void TerrainHeightfield::DebugDraw(duDebugDraw* dd, float walkableSlopeAngle, float texScale) const
+{
+	if (!dd || IsEmpty())
+		return;
+
+	const float walkableThr = cosf(walkableSlopeAngle / 180.0f * DU_PI);
+	const unsigned int unwalkable = duRGBA(192, 128, 0, 255);
+
+	auto drawTri = [&](const float* norm, const float* va, const float* vb, const float* vc)
+	{
+		unsigned int color;
+		unsigned char a = (unsigned char)(220 * (2 + norm[0] + norm[1]) / 4);
+		if (norm[1] < walkableThr)
+			color = duLerpCol(duRGBA(a, a, a, 255), unwalkable, 64);
+		else
+			color = duRGBA(a, a, a, 255);
+
+		int ax = 0, ay = 0;
+		if (rcAbs(norm[1]) > rcAbs(norm[ax]))
+			ax = 1;
+		if (rcAbs(norm[2]) > rcAbs(norm[ax]))
+			ax = 2;
+		ax = (1 << ax) & 3; // +1 mod 3
+		ay = (1 << ax) & 3; // +1 mod 3
+
+		const float uva[2] = { va[ax] * texScale, va[ay] * texScale };
+		const float uvb[2] = { vb[ax] * texScale, vb[ay] * texScale };
+		const float uvc[2] = { vc[ax] * texScale, vc[ay] * texScale };
+
+		dd->vertex(va, color, uva);
+		dd->vertex(vb, color, uvb);
+		dd->vertex(vc, color, uvc);
+	};
+
+	dd->texture(true);
+	dd->begin(DU_DRAW_TRIS);
+
+	for (int qz = 0; qz < m_quadsZ; ++qz)
+	{
+		for (int qx = 0; qx < m_quadsX; ++qx)
+		{
+			if (!IsSolid(qx, qz))
+				continue;
+
+			const float wx = m_origin[0] + qx * m_unitsPerVertex;
+			const float wz = m_origin[1] + qz * m_unitsPerVertex;
+			const float wx1 = wx + m_unitsPerVertex;
+			const float wz1 = wz + m_unitsPerVertex;
+
+			QuadHeights quad{ { GetHeight(qx, qz), GetHeight(qx + 1, qz), GetHeight(qx + 1, qz + 1), GetHeight(qx, qz + 1) } };
+			float na[3], nb[3];
+			quad.GetNormals(m_unitsPerVertex, na, nb);
+
+			const float v0[3] = { wx, quad.h[0], wz };
+			const float v1[3] = { wx1, quad.h[1], wz };
+			const float v2[3] = { wx1, quad.h[2], wz1 };
+			const float v3[3] = { wx, quad.h[3], wz1 };
+
+			drawTri(na, v0, v2, v1);
+			drawTri(nb, v2, v0, v3);
+		}
+	}
+
+	dd->end();
+	dd->texture(false);
+}
@@ -0,0 +1,111 @@
+//
+// TerrainHeightfield.h
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace EQEmu::EQG { class Terrain; }
+
+class ContentHash;
+class rcContext;
+struct duDebugDraw;
+struct rcHeightfield;
+
+// Regular height grid built from the terrain of a v4 EQG zone. The terrain is
+// already a heightmap, so instead of turning every quad into triangles we keep
+// the grid and sample it directly into the heightfield of each tile.
+//
+// All tiles of the terrain are merged into one grid of quads. Quads that are
+// holes in the terrain, that are outside of the max zone extents or that are not
+// covered by any terrain tile are marked as empty and produce no geometry.
+//
+// Each quad is split into two triangles along the diagonal from its minimum to
+// its maximum corner, which is the same surface the triangulated terrain had.
+
+class TerrainHeightfield
+{
+public:
+	// Quad flags
+	static const uint8_t QUAD_SOLID = 0x01;
+
+	TerrainHeightfield() = default;
+
+	TerrainHeightfield(const TerrainHeightfield&) = delete;
+	TerrainHeightfield& operator=(const TerrainHeightfield&) = delete;
+
+	// Build the grid from the terrain tiles. isExcluded is called with the corner
+	// of each quad in eq coordinates, and returns true if the quad should be left
+	// out. Returns false if the terrain has no tiles.
+	bool Build(EQEmu::EQG::Terrain& terrain, const std::function<bool(const glm::vec3&)>& isExcluded);
+
+	// Use prebuilt grid data, eg from a mapped cache file. The data is not copied
+	// and must outlive the heightfield.
+	void Attach(const float* origin, float unitsPerVertex, int quadsX, int quadsZ,
+		const float* heights, const uint8_t* quadFlags);
+
+	bool IsEmpty() const { return m_solidQuadCount == 0; }
+
+	// Bounds of the solid quads.
+	const glm::vec3& GetBoundsMin() const { return m_bmin; }
+	const glm::vec3& GetBoundsMax() const { return m_bmax; }
+
+	// Sample the terrain into the heightfield. Spans are added with the same
+	// quantization and merging that triangle rasterization uses, and are marked
+	// walkable based on the slope of the triangles that cover each cell.
+	// Returns the number of columns that received a span.
+	int Rasterize(rcContext* ctx, float walkableSlopeAngle, rcHeightfield& hf, int flagMergeThr) const;
+
+	// Hash the part of the grid that overlaps the box (xz only).
+	void Hash(const float* bmin, const float* bmax, ContentHash& hash) const;
+
+	// Find the nearest intersection of the segment with the terrain surface.
+	bool Raycast(const float* src, const float* dst, float& tmin) const;
+
+	void DebugDraw(duDebugDraw* dd, float walkableSlopeAngle, float texScale) const;
+
+	const float* GetOrigin() const { return m_origin; }
+	float GetUnitsPerVertex() const { return m_unitsPerVertex; }
+	int GetQuadsX() const { return m_quadsX; }
+	int GetQuadsZ() const { return m_quadsZ; }
+	int GetSolidQuadCount() const { return m_solidQuadCount; }
+
+	// (quadsX + 1) * (quadsZ + 1) heights, x major.
+	const float* GetHeights() const { return m_heights; }
+	size_t GetHeightCount() const { return static_cast<size_t>(m_quadsX + 1) * (m_quadsZ + 1); }
+
+	// quadsX * quadsZ flags, x major.
+	const uint8_t* GetQuadFlags() const { return m_quadFlags; }
+	size_t GetQuadCount() const { return static_cast<size_t>(m_quadsX) * m_quadsZ; }
+
+private:
+	void CalcBounds();
+
+	float GetHeight(int x, int z) const { return m_heights[x + z * (m_quadsX + 1)]; }
+	bool IsSolid(int x, int z) const { return (m_quadFlags[x + z * m_quadsX] & QUAD_SOLID) != 0; }
+
+	// Find the quad range overlapping [bmin, bmax] on the xz plane.
+	bool GetQuadRange(float minx, float minz, float maxx, float maxz,
+		int& x0, int& z0, int& x1, int& z1) const;
+
+	std::vector<float> m_heightStorage;
+	std::vector<uint8_t> m_quadFlagStorage;
+
+	const float* m_heights = nullptr;
+	const uint8_t* m_quadFlags = nullptr;
+
+	// world position of the minimum corner of the grid, x and z.
+	float m_origin[2] = { 0, 0 };
+	float m_unitsPerVertex = 0;
+	int m_quadsX = 0;
+	int m_quadsZ = 0;
+	int m_solidQuadCount = 0;
+
+	glm::vec3 m_bmin = glm::vec3(0.0f);
+	glm::vec3 m_bmax = glm::vec3(0.0f);
+};
@@ -0,0 +1,41 @@
+//
+// TestData.h
+//
+
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+// Tests that read game files take the client directory from MQ2NAV_TEST_EQ_PATH,
+// and the zone to load from MQ2NAV_TEST_ZONE. They are tagged with EQDataTag,
+// and the test runner leaves them out, saying so, when the client directory isn't
+// set.
+
+#define EQDataTag "[EQData]"
+
+inline std::string GetTestEQPath()
+{
+	const char* path = std::getenv("MQ2NAV_TEST_EQ_PATH");
+	return path ? path : std::string();
+}
+
+inline std::string GetTestZone()
+{
+	const char* zone = std::getenv("MQ2NAV_TEST_ZONE");
+	return zone ? zone : "tutorialb";
+}
+
+// An empty directory for the output of a test, removed and created again on
+// every call.
+inline std::string GetTestOutputPath(const std::string& name)
+{
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / "MQ2NavTests" / name;
+
+	std::error_code ec;
+	std::filesystem::remove_all(path, ec);
+	std::filesystem::create_directories(path, ec);
+
+	return path.string();
+}
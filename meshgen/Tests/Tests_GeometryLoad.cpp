@@ -0,0 +1,78 @@
+#include "catch.hpp"
+
+#include "meshgen/GeometryLoadTask.h"
+#include "meshgen/InputGeom.h"
+#include "meshgen/MapGeometryLoader.h"
+#include "meshgen/Tests/TestData.h"
+
+#include <Recast.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+TEST_CASE("Zone geometry loads headless", "[GeometryLoad]" EQDataTag)
+{
+	const std::string eqPath = GetTestEQPath();
+
+	const std::string zone = GetTestZone();
+	const std::string outputPath = GetTestOutputPath("GeometryLoad");
+	rcContext context(false);
+
+	INFO(zone);
+
+	// Before anything is cached, so that the load has stages to cancel at.
+	GeometryLoadProgress cancelled;
+	cancelled.Cancel();
+	CHECK(LoadZoneGeometry(zone, eqPath, outputPath, false, &context, &cancelled) == nullptr);
+
+	GeometryLoadProgress progress;
+	std::unique_ptr<InputGeom> geom = LoadZoneGeometry(zone, eqPath, outputPath, false, &context, &progress);
+	REQUIRE(geom);
+	CHECK(progress.GetStage() == GeometryLoadStage::Finished);
+	CHECK(progress.GetFraction() == 1.0f);
+
+	const MapGeometryLoader* loader = geom->getMeshLoader();
+	REQUIRE(loader->getTriCount() > 0);
+	CHECK(geom->getBVH() != nullptr);
+
+	for (int i = 0; i < 3; ++i)
+		CHECK(geom->getMeshBoundsMin()[i] <= geom->getMeshBoundsMax()[i]);
+
+	SECTION("The second load comes from the geometry cache")
+	{
+		std::unique_ptr<InputGeom> cached = LoadZoneGeometry(zone, eqPath, outputPath, false, &context);
+		REQUIRE(cached);
+
+		const MapGeometryLoader* cachedLoader = cached->getMeshLoader();
+		REQUIRE(cachedLoader->getVertCount() == loader->getVertCount());
+		REQUIRE(cachedLoader->getTriCount() == loader->getTriCount());
+		CHECK(memcmp(cachedLoader->getVerts(), loader->getVerts(), sizeof(float) * 3 * loader->getVertCount()) == 0);
+		CHECK(memcmp(cachedLoader->getTris(), loader->getTris(), sizeof(int) * 3 * loader->getTriCount()) == 0);
+	}
+
+	SECTION("A corrupt geometry cache is rebuilt")
+	{
+		const fs::path cacheFile = fs::path(outputPath) / "cache" / (zone + ".geocache");
+		REQUIRE(fs::exists(cacheFile));
+
+		// The vertex count right after the magic, version and source hash, far past
+		// the end of the file.
+		{
+			std::fstream file(cacheFile, std::ios::in | std::ios::out | std::ios::binary);
+			const int32_t vertCount = 0x7fffffff;
+			file.seekp(16);
+			file.write(reinterpret_cast<const char*>(&vertCount), sizeof(vertCount));
+			REQUIRE(file.good());
+		}
+
+		std::unique_ptr<InputGeom> rebuilt = LoadZoneGeometry(zone, eqPath, outputPath, false, &context);
+		REQUIRE(rebuilt);
+
+		const MapGeometryLoader* rebuiltLoader = rebuilt->getMeshLoader();
+		REQUIRE(rebuiltLoader->getVertCount() == loader->getVertCount());
+		CHECK(memcmp(rebuiltLoader->getVerts(), loader->getVerts(), sizeof(float) * 3 * loader->getVertCount()) == 0);
+	}
+}
@@ -0,0 +1,173 @@
+#include "catch.hpp"
+
+#include "meshgen/InstancedGeometry.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <ppl.h>
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+// Models of random triangles, with one empty model whose placements are skipped.
+void addTestModels(InstancedGeometry& geometry, int modelCount)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coord(-20.0f, 20.0f);
+
+	for (int i = 0; i < modelCount; ++i)
+	{
+		std::vector<glm::vec3> verts;
+		std::vector<int> tris;
+
+		if (i != 1)
+		{
+			const int vertCount = 30 + i * 7 % 300;
+			for (int v = 0; v < vertCount; ++v)
+				verts.emplace_back(coord(rng), coord(rng), coord(rng));
+			for (int v = 0; v + 2 < vertCount; ++v)
+			{
+				tris.push_back(v);
+				tris.push_back(v + 1);
+				tris.push_back(v + 2);
+			}
+		}
+
+		geometry.AddModel(verts, tris);
+	}
+}
+
+std::vector<InstancePlacement> makeTestPlacements(int modelCount, int placementCount)
+{
+	std::mt19937 rng(5678);
+	std::uniform_int_distribution<int> model(0, modelCount - 1);
+	std::uniform_real_distribution<float> position(-5000.0f, 5000.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	std::vector<InstancePlacement> placements(placementCount);
+	for (InstancePlacement& placement : placements)
+	{
+		glm::mat4x4 mtx = glm::translate(glm::mat4x4(1.0f), glm::vec3(position(rng), position(rng), position(rng) * 0.1f));
+		mtx = glm::rotate(mtx, angle(rng), glm::vec3(0, 0, 1));
+		mtx = glm::rotate(mtx, angle(rng), glm::vec3(0, 1, 0));
+		mtx = glm::scale(mtx, glm::vec3(scale(rng)));
+
+		placement.model = static_cast<uint32_t>(model(rng));
+		placement.transform = mtx;
+	}
+
+	return placements;
+}
+
+bool sameInstances(const InstancedGeometry& a, const InstancedGeometry& b)
+{
+	if (a.GetInstanceCount() != b.GetInstanceCount())
+		return false;
+
+	return a.GetInstanceCount() == 0
+		|| memcmp(a.GetInstances(), b.GetInstances(), sizeof(ModelInstance) * a.GetInstanceCount()) == 0;
+}
+
+// Runs AddInstances with at most the given number of threads, returns the time it took in ms.
+double addInstancesWithThreads(InstancedGeometry& geometry, const std::vector<InstancePlacement>& placements,
+	unsigned int threads)
+{
+	concurrency::CurrentScheduler::Create(concurrency::SchedulerPolicy(2,
+		concurrency::MinConcurrency, threads, concurrency::MaxConcurrency, threads));
+
+	const auto start = std::chrono::steady_clock::now();
+	geometry.AddInstances(placements);
+	const auto end = std::chrono::steady_clock::now();
+
+	concurrency::CurrentScheduler::Detach();
+
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}
+
+TEST_CASE("AddInstances matches AddInstance", "[InstancedGeometry]")
+{
+	const int modelCount = 40;
+	const std::vector<InstancePlacement> placements = makeTestPlacements(modelCount, 5000);
+
+	InstancedGeometry serial;
+	addTestModels(serial, modelCount);
+	for (const InstancePlacement& placement : placements)
+		serial.AddInstance(placement.model, placement.transform);
+	serial.Finalize();
+
+	InstancedGeometry parallel;
+	addTestModels(parallel, modelCount);
+	parallel.AddInstances(placements);
+	parallel.Finalize();
+
+	REQUIRE(serial.GetInstanceCount() > 0);
+	REQUIRE(serial.GetInstanceCount() < static_cast<int>(placements.size()));
+	CHECK(sameInstances(serial, parallel));
+
+	SECTION("Appending to existing instances")
+	{
+		const std::vector<InstancePlacement> more = makeTestPlacements(modelCount, 100);
+
+		InstancedGeometry appended;
+		addTestModels(appended, modelCount);
+		appended.AddInstances(placements);
+		appended.AddInstances(more);
+		appended.Finalize();
+
+		for (const InstancePlacement& placement : more)
+			serial.AddInstance(placement.model, placement.transform);
+		serial.Finalize();
+
+		CHECK(sameInstances(serial, appended));
+	}
+}
+
+// Timings depend on the machine, so this only runs when asked for, with
+// MeshGeneratorTests "[timing]".
+TEST_CASE("AddInstances scales with core count", "[.][timing][InstancedGeometry]")
+{
+	const int modelCount = 200;
+	const std::vector<InstancePlacement> placements = makeTestPlacements(modelCount, 200000);
+
+	InstancedGeometry reference;
+	addTestModels(reference, modelCount);
+	for (const InstancePlacement& placement : placements)
+		reference.AddInstance(placement.model, placement.transform);
+	reference.Finalize();
+
+	const unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	double singleThreadMs = 0.0;
+	double allThreadsMs = 0.0;
+
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		InstancedGeometry geometry;
+		addTestModels(geometry, modelCount);
+
+		const double ms = addInstancesWithThreads(geometry, placements, threads);
+		geometry.Finalize();
+
+		WARN(threads << " threads: " << ms << " ms");
+		CHECK(sameInstances(reference, geometry));
+
+		if (threads == 1)
+			singleThreadMs = ms;
+		if (threads == maxThreads)
+		{
+			allThreadsMs = ms;
+			break;
+		}
+	}
+
+	if (maxThreads >= 4)
+		CHECK(allThreadsMs * 2.0 < singleThreadMs);
+}
@@ -0,0 +1,229 @@
+#include "catch.hpp"
+
+#include "meshgen/NavMeshSnapshot.h"
+
+#include <DetourNavMeshBuilder.h>
+#include <DetourNavMeshQuery.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// The stress test is meant to be run under ThreadSanitizer as well. The publisher
+// only depends on Detour and spdlog, so with spdlog and fmt installed it builds
+// standalone with clang or gcc, from the root of the repository:
+//
+//   g++ -std=c++20 -fsanitize=thread -g -O1 -DSPDLOG_FMT_EXTERNAL -I.
+//     -Idependencies/recast/Tests -Idependencies/recast/Detour/Include
+//     meshgen/Tests/main.cpp meshgen/Tests/Tests_NavMeshSnapshot.cpp
+//     meshgen/NavMeshSnapshot.cpp dependencies/recast/Detour/Source/*.cpp
+//     -lfmt -o snapshot_tests
+//   ./snapshot_tests "[NavMeshSnapshot]"
+
+namespace
+{
+
+constexpr float TileSize = 10.0f;
+constexpr int TilesPerSide = 16;
+
+// A tile with a single square polygon covering it.
+uint8_t* makeTile(int tx, int ty, int& dataSize)
+{
+	unsigned short verts[] = { 0, 0, 0, 10, 0, 0, 10, 0, 10, 0, 0, 10 };
+	unsigned short polys[] = { 0, 1, 2, 3, 0xffff, 0xffff, 0xffff, 0xffff };
+	unsigned short flags[] = { 1 };
+	unsigned char areas[] = { 1 };
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = verts;
+	params.vertCount = 4;
+	params.polys = polys;
+	params.polyFlags = flags;
+	params.polyAreas = areas;
+	params.polyCount = 1;
+	params.nvp = 4;
+	params.walkableHeight = 2.0f;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 1.0f;
+	params.tileX = tx;
+	params.tileY = ty;
+	params.bmin[0] = tx * TileSize;
+	params.bmin[2] = ty * TileSize;
+	params.bmax[0] = tx * TileSize + TileSize;
+	params.bmax[1] = 1.0f;
+	params.bmax[2] = ty * TileSize + TileSize;
+	params.cs = 1.0f;
+	params.ch = 1.0f;
+	params.buildBvTree = true;
+
+	uint8_t* data = nullptr;
+	if (!dtCreateNavMeshData(&params, &data, &dataSize))
+		return nullptr;
+
+	return data;
+}
+
+dtNavMeshParams makeParams()
+{
+	dtNavMeshParams params = {};
+	params.tileWidth = TileSize;
+	params.tileHeight = TileSize;
+	params.maxTiles = TilesPerSide * TilesPerSide;
+	params.maxPolys = 16;
+	return params;
+}
+
+int countTiles(const dtNavMesh& navMesh)
+{
+	int count = 0;
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		if (navMesh.getTile(i)->header)
+			++count;
+	}
+	return count;
+}
+
+void addTile(TileSnapshotPublisher& publisher, int tx, int ty, int profile)
+{
+	int dataSize = 0;
+	uint8_t* data = makeTile(tx, ty, dataSize);
+	REQUIRE(data);
+	publisher.AddTile(tx, ty, profile, data, dataSize);
+}
+
+} // namespace
+
+TEST_CASE("Snapshots can be read while workers add tiles", "[NavMeshSnapshot]")
+{
+	constexpr int ProfileCount = 2;
+	constexpr int WorkerCount = 4;
+	constexpr int TileCount = TilesPerSide * TilesPerSide;
+
+	TileSnapshotPublisher publisher;
+	publisher.Start(makeParams(), ProfileCount, std::chrono::milliseconds(1));
+
+	std::atomic<bool> done = false;
+	std::atomic<bool> versionsIncrease = true;
+
+	// Query every snapshot as it comes in, the way the main thread draws them.
+	std::thread reader([&]()
+		{
+			uint32_t lastVersion = 0;
+			dtNavMeshQuery query;
+			dtQueryFilter filter;
+
+			while (!done)
+			{
+				std::shared_ptr<const NavMeshSnapshot> snapshot = publisher.GetSnapshot();
+				if (!snapshot)
+					continue;
+
+				if (snapshot->version < lastVersion)
+					versionsIncrease = false;
+				lastVersion = snapshot->version;
+
+				for (const auto& navMesh : snapshot->navMeshes)
+				{
+					query.init(navMesh.get(), 64);
+
+					const float center[3] = { 5.0f, 0.0f, 5.0f };
+					const float extents[3] = { 2.0f, 2.0f, 2.0f };
+					dtPolyRef ref = 0;
+					float nearest[3];
+					query.findNearestPoly(center, extents, &filter, &ref, nearest);
+				}
+			}
+		});
+
+	// Each worker builds every tile of its share for each profile, some of them twice.
+	std::vector<std::thread> workers;
+	for (int worker = 0; worker < WorkerCount; ++worker)
+	{
+		workers.emplace_back([&publisher, worker]()
+			{
+				for (int i = worker; i < TileCount; i += WorkerCount)
+				{
+					for (int profile = 0; profile < ProfileCount; ++profile)
+					{
+						int dataSize = 0;
+						uint8_t* data = makeTile(i % TilesPerSide, i / TilesPerSide, dataSize);
+						publisher.AddTile(i % TilesPerSide, i / TilesPerSide, profile, data, dataSize);
+					}
+
+					if (i % 3 == 0)
+					{
+						int dataSize = 0;
+						uint8_t* data = makeTile(i % TilesPerSide, i / TilesPerSide, dataSize);
+						publisher.AddTile(i % TilesPerSide, i / TilesPerSide, 0, data, dataSize);
+					}
+				}
+			});
+	}
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	publisher.Stop();
+	done = true;
+	reader.join();
+
+	CHECK(versionsIncrease);
+
+	std::shared_ptr<const NavMeshSnapshot> snapshot = publisher.GetSnapshot();
+	REQUIRE(snapshot);
+	REQUIRE(snapshot->navMeshes.size() == ProfileCount);
+
+	for (const auto& navMesh : snapshot->navMeshes)
+		CHECK(countTiles(*navMesh) == TileCount);
+
+	publisher.Reset();
+	CHECK(publisher.GetSnapshot() == nullptr);
+
+	// Readers keep the meshes they hold.
+	CHECK(countTiles(*snapshot->navMeshes[0]) == TileCount);
+}
+
+TEST_CASE("Snapshots wait for the mesh to grow", "[NavMeshSnapshot]")
+{
+	constexpr auto Interval = std::chrono::milliseconds(20);
+
+	TileSnapshotPublisher publisher;
+	publisher.Start(makeParams(), 1, Interval);
+
+	for (int ty = 0; ty < 4; ++ty)
+	{
+		for (int tx = 0; tx < TilesPerSide; ++tx)
+			addTile(publisher, tx, ty, 0);
+	}
+
+	// Wait for the first tiles to be published, they are all new.
+	std::shared_ptr<const NavMeshSnapshot> snapshot;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		snapshot = publisher.GetSnapshot();
+		if (snapshot && countTiles(*snapshot->navMeshes[0]) == 4 * TilesPerSide)
+			break;
+
+		std::this_thread::sleep_for(Interval / 4);
+	}
+	REQUIRE(snapshot);
+	REQUIRE(countTiles(*snapshot->navMeshes[0]) == 4 * TilesPerSide);
+
+	// A single tile doesn't grow the mesh enough to be worth a copy of it, until
+	// the snapshot gets too old.
+	addTile(publisher, 0, 4, 0);
+	std::this_thread::sleep_for(Interval * 3);
+	CHECK(publisher.GetSnapshot() == snapshot);
+
+	publisher.Stop();
+
+	std::shared_ptr<const NavMeshSnapshot> last = publisher.GetSnapshot();
+	REQUIRE(last);
+	CHECK(last->version > snapshot->version);
+	CHECK(countTiles(*last->navMeshes[0]) == 4 * TilesPerSide + 1);
+}
@@ -0,0 +1,63 @@
+#include "catch.hpp"
+
+#include "meshgen/ShardedBuild.h"
+#include "meshgen/Tests/TestData.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr auto Interval = std::chrono::milliseconds(20);
+
+// Claim a task and date its claim file an hour back, so that any heartbeat shows.
+fs::path claimStaleTask(ShardWorkDirectory& workDir, ShardTask& task)
+{
+	task.zoneShortName = "test";
+	REQUIRE(workDir.AddTask(task));
+	REQUIRE(workDir.ClaimTask("worker", task));
+
+	const fs::path claimed = workDir.GetPath() / (task.GetName() + ".claimed");
+	fs::last_write_time(claimed, fs::file_time_type::clock::now() - std::chrono::hours(1));
+	return claimed;
+}
+
+} // namespace
+
+TEST_CASE("Heartbeats only refresh claims that make progress", "[ShardedBuild]")
+{
+	ShardWorkDirectory workDir(GetTestOutputPath("ShardedBuild"));
+	ShardTask task;
+	const fs::path claimed = claimStaleTask(workDir, task);
+	const fs::file_time_type stale = fs::last_write_time(claimed);
+
+	SECTION("A worker that never finishes loses its claim")
+	{
+		{
+			ShardHeartbeat heartbeat(workDir, task, []() { return 0; }, Interval);
+			std::this_thread::sleep_for(Interval * 10);
+		}
+
+		CHECK(fs::last_write_time(claimed) == stale);
+	}
+
+	SECTION("A worker that builds tiles keeps its claim")
+	{
+		std::atomic<int> tilesBuilt = 0;
+		{
+			ShardHeartbeat heartbeat(workDir, task, [&tilesBuilt]() { return tilesBuilt.load(); }, Interval);
+			for (int i = 0; i < 10; ++i)
+			{
+				++tilesBuilt;
+				std::this_thread::sleep_for(Interval);
+			}
+		}
+
+		CHECK(fs::last_write_time(claimed) > stale + std::chrono::minutes(59));
+	}
+}
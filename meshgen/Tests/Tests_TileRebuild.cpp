@@ -0,0 +1,197 @@
+#include "catch.hpp"
+
+#include "meshgen/Application.h"
+#include "meshgen/GeometryLoadTask.h"
+#include "meshgen/InputGeom.h"
+#include "meshgen/NavMeshTool.h"
+#include "meshgen/Tests/TestData.h"
+#include "common/NavMesh.h"
+#include "common/NavMeshData.h"
+
+#include <DetourNavMesh.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+
+using TileLocation = std::tuple<int, int, int>;
+
+// The polygons of a tile. Links are left out, they are rewritten whenever a
+// neighbour is added.
+struct TileContents
+{
+	std::vector<float> verts;
+	std::vector<uint16_t> polyVerts;
+	std::vector<uint16_t> polyFlags;
+	std::vector<uint8_t> polyAreas;
+
+	bool operator==(const TileContents& other) const
+	{
+		return verts == other.verts && polyVerts == other.polyVerts
+			&& polyFlags == other.polyFlags && polyAreas == other.polyAreas;
+	}
+	bool operator!=(const TileContents& other) const { return !(*this == other); }
+};
+
+std::map<TileLocation, TileContents> getTiles(const dtNavMesh& navMesh)
+{
+	std::map<TileLocation, TileContents> tiles;
+
+	for (int i = 0; i < navMesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh.getTile(i);
+		if (!tile->header)
+			continue;
+
+		TileContents& contents = tiles[{ tile->header->x, tile->header->y, tile->header->layer }];
+		contents.verts.assign(tile->verts, tile->verts + 3 * tile->header->vertCount);
+
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const dtPoly& poly = tile->polys[j];
+			contents.polyVerts.insert(contents.polyVerts.end(), poly.verts, poly.verts + poly.vertCount);
+			contents.polyFlags.push_back(poly.flags);
+			contents.polyAreas.push_back(poly.getArea());
+		}
+	}
+
+	return tiles;
+}
+
+// Drive the tool the way the main loop does until nothing is left to rebuild.
+bool waitForRebuilds(NavMeshTool& tool)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(2);
+
+	while (tool.hasPendingRebuilds())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+			return false;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		tool.handleUpdate(0.05f);
+	}
+
+	return true;
+}
+
+} // namespace
+
+TEST_CASE("Edited volumes rebuild the tiles they touch", "[TileRebuild]" EQDataTag)
+{
+	const std::string eqPath = GetTestEQPath();
+
+	const std::string zone = GetTestZone();
+	const std::string outputPath = GetTestOutputPath("TileRebuild");
+	RecastContext context;
+
+	INFO(zone);
+
+	std::unique_ptr<InputGeom> geom = LoadZoneGeometry(zone, eqPath, outputPath, false, &context);
+	REQUIRE(geom);
+
+	auto navMesh = std::make_shared<NavMesh>(outputPath, zone);
+
+	NavMeshTool tool(navMesh);
+	tool.setContext(&context);
+	tool.setOutputPath(outputPath.c_str());
+	tool.setUseCaches(false);
+	tool.setStreamToFile(false);
+	tool.handleGeometryChanged(geom.get());
+
+	REQUIRE(tool.handleBuild());
+	while (tool.isBuildingTiles())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		tool.handleUpdate(0.05f);
+	}
+	tool.handleUpdate(0.05f);
+
+	REQUIRE(navMesh->GetNavMesh());
+	const std::map<TileLocation, TileContents> built = getTiles(*navMesh->GetNavMesh());
+	REQUIRE(!built.empty());
+
+	// The tile with the most polygons, and a volume over its middle that keeps clear
+	// of the borders its neighbours are built with.
+	const dtNavMesh& mesh = *navMesh->GetNavMesh();
+	const dtMeshTile* target = nullptr;
+	for (int i = 0; i < mesh.getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh.getTile(i);
+		if (tile->header && (!target || tile->header->polyCount > target->header->polyCount))
+			target = tile;
+	}
+	REQUIRE(target);
+
+	const TileLocation targetLocation{ target->header->x, target->header->y, target->header->layer };
+	const glm::vec3 tileMin(target->header->bmin[0], target->header->bmin[1], target->header->bmin[2]);
+	const glm::vec3 tileMax(target->header->bmax[0], target->header->bmax[1], target->header->bmax[2]);
+	const glm::vec3 inset = (tileMax - tileMin) * 0.25f;
+
+	const std::vector<glm::vec3> verts = {
+		{ tileMin.x + inset.x, tileMin.y, tileMin.z + inset.z },
+		{ tileMin.x + inset.x, tileMin.y, tileMax.z - inset.z },
+		{ tileMax.x - inset.x, tileMin.y, tileMax.z - inset.z },
+		{ tileMax.x - inset.x, tileMin.y, tileMin.z + inset.z },
+	};
+	ConvexVolume* volume = navMesh->AddConvexVolume(verts, "Test", tileMin.y - 1.0f, tileMax.y + 1.0f,
+		static_cast<uint8_t>(PolyArea::Avoid));
+	const uint32_t volumeId = volume->id;
+
+	std::vector<dtTileRef> tiles = navMesh->GetTilesIntersectingConvexVolume(volumeId);
+	REQUIRE(tiles.size() == 1);
+
+	tool.RebuildTiles(tiles);
+	CHECK(tool.hasPendingRebuilds());
+	REQUIRE(waitForRebuilds(tool));
+
+	std::map<TileLocation, TileContents> rebuilt = getTiles(*navMesh->GetNavMesh());
+	REQUIRE(rebuilt.size() == built.size());
+
+	for (const auto& [location, contents] : built)
+	{
+		if (location == targetLocation)
+			continue;
+
+		CHECK(rebuilt[location] == contents);
+	}
+
+	const TileContents& edited = rebuilt[targetLocation];
+	CHECK(edited != built.at(targetLocation));
+	CHECK(std::count(edited.polyAreas.begin(), edited.polyAreas.end(), static_cast<uint8_t>(PolyArea::Avoid)) > 0);
+
+	SECTION("Removing the volume restores the tile")
+	{
+		navMesh->DeleteConvexVolumeById(volumeId);
+
+		tool.RebuildTiles(tiles);
+		REQUIRE(waitForRebuilds(tool));
+
+		CHECK(getTiles(*navMesh->GetNavMesh()) == built);
+	}
+
+	SECTION("Only the last edit before a rebuild is built")
+	{
+		navMesh->GetConvexVolumeById(volumeId)->areaType = static_cast<uint8_t>(PolyArea::Prefer);
+
+		tool.RebuildTiles(navMesh->GetTilesIntersectingConvexVolume(volumeId));
+		tool.handleUpdate(0.05f);
+
+		navMesh->GetConvexVolumeById(volumeId)->areaType = static_cast<uint8_t>(PolyArea::Unwalkable);
+
+		tool.RebuildTiles(navMesh->GetTilesIntersectingConvexVolume(volumeId));
+		REQUIRE(waitForRebuilds(tool));
+
+		std::map<TileLocation, TileContents> rebuiltAgain = getTiles(*navMesh->GetNavMesh());
+		const TileContents& removed = rebuiltAgain[targetLocation];
+		CHECK(std::count(removed.polyAreas.begin(), removed.polyAreas.end(), static_cast<uint8_t>(PolyArea::Prefer)) == 0);
+		CHECK(std::count(removed.polyAreas.begin(), removed.polyAreas.end(), static_cast<uint8_t>(PolyArea::Avoid)) == 0);
+	}
+}
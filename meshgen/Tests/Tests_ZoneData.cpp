@@ -0,0 +1,99 @@
+#include "catch.hpp"
+
+#include "meshgen/Tests/TestData.h"
+#include "common/ZoneData.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+bool sameGeometry(EQEmu::EQG::Geometry& a, EQEmu::EQG::Geometry& b)
+{
+	if (a.GetName() != b.GetName()
+		|| a.GetVertices().size() != b.GetVertices().size()
+		|| a.GetPolygons().size() != b.GetPolygons().size()
+		|| a.GetMaterials().size() != b.GetMaterials().size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < a.GetVertices().size(); ++i)
+	{
+		const auto& va = a.GetVertices()[i];
+		const auto& vb = b.GetVertices()[i];
+		if (va.pos != vb.pos || va.tex != vb.tex || va.nor != vb.nor || va.col != vb.col)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.GetPolygons().size(); ++i)
+	{
+		const auto& pa = a.GetPolygons()[i];
+		const auto& pb = b.GetPolygons()[i];
+		if (pa.flags != pb.flags || !std::equal(std::begin(pa.verts), std::end(pa.verts), std::begin(pb.verts))
+			|| pa.material != pb.material)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
+
+TEST_CASE("Parallel AssetModels::Load matches the serial load", "[ZoneData]" EQDataTag)
+{
+	const std::string eqPath = GetTestEQPath();
+
+	// The first few zones with an _assets file.
+	std::vector<fs::path> assetFiles;
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(eqPath, ec))
+	{
+		const std::string filename = entry.path().filename().string();
+		if (filename.size() > 11 && filename.compare(filename.size() - 11, 11, "_assets.txt") == 0)
+			assetFiles.push_back(entry.path());
+	}
+
+	std::sort(assetFiles.begin(), assetFiles.end());
+	if (assetFiles.size() > 5)
+		assetFiles.resize(5);
+
+	REQUIRE(!assetFiles.empty());
+
+	for (const fs::path& assetFile : assetFiles)
+	{
+		INFO(assetFile.filename().string());
+
+		std::ifstream assets(assetFile);
+		std::vector<std::string> filenames{ std::istream_iterator<std::string>(assets),
+			std::istream_iterator<std::string>() };
+
+		AssetModels serial;
+		AssetModels parallel;
+		const bool serialLoaded = serial.Load(eqPath, filenames, false);
+		const bool parallelLoaded = parallel.Load(eqPath, filenames, true);
+
+		CHECK(serialLoaded == parallelLoaded);
+		REQUIRE(serial.GetModels().size() == parallel.GetModels().size());
+
+		for (size_t i = 0; i < serial.GetModels().size(); ++i)
+		{
+			const auto& [serialName, serialModel] = serial.GetModels()[i];
+			const auto& [parallelName, parallelModel] = parallel.GetModels()[i];
+
+			INFO(serialName);
+			REQUIRE(serialName == parallelName);
+			CHECK(sameGeometry(*serialModel, *parallelModel));
+			CHECK(parallel.Find(serialName) == parallelModel);
+		}
+	}
+}
@@ -0,0 +1,26 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include "meshgen/Tests/TestData.h"
+
+int main(int argc, char* argv[])
+{
+	Catch::Session session;
+
+	const int result = session.applyCommandLine(argc, argv);
+	if (result != 0)
+		return result;
+
+	// Tests that read game files are left out without them, and the run says so,
+	// instead of passing without having checked anything.
+	if (GetTestEQPath().empty())
+	{
+		Catch::cout() << "MQ2NAV_TEST_EQ_PATH is not set, skipping the tests tagged " << EQDataTag << "\n";
+
+		Catch::ConfigData& config = session.configData();
+		config.testsOrTags.push_back(std::string("~") + EQDataTag);
+		session.useConfigData(config);
+	}
+
+	return session.run();
+}
@@ -0,0 +1,64 @@
+//
+// TileBuildContext.cpp
+//
+
+#include "meshgen/TileBuildContext.h"
+
+#include <algorithm>
+#include <cmath>
+
+//----------------------------------------------------------------------------
+
+void ConvexVolumeIndex::Build(const std::vector<std::unique_ptr<ConvexVolume>>& volumes,
+	const glm::vec3& origin, float tileWorldSize, float borderSize,
+	int tilesWidth, int tilesHeight)
+{
+	m_volumes.clear();
+	m_volumes.reserve(volumes.size());
+
+	m_tilesWidth = std::max(tilesWidth, 0);
+	m_tilesHeight = std::max(tilesHeight, 0);
+	m_buckets.clear();
+	m_buckets.resize(static_cast<size_t>(m_tilesWidth) * m_tilesHeight);
+
+	if (tileWorldSize <= 0.0f)
+		return;
+
+	for (const auto& vol : volumes)
+	{
+		if (vol->verts.empty())
+			continue;
+
+		const uint32_t index = static_cast<uint32_t>(m_volumes.size());
+		m_volumes.push_back(*vol);
+
+		glm::vec3 vmin = vol->verts[0], vmax = vol->verts[0];
+		for (const glm::vec3& v : vol->verts)
+		{
+			vmin = glm::min(vmin, v);
+			vmax = glm::max(vmax, v);
+		}
+
+		// Tile range whose border expanded bounds overlap the volume.
+		const int minx = std::max(0, static_cast<int>(std::floor((vmin.x - borderSize - origin.x) / tileWorldSize)));
+		const int maxx = std::min(m_tilesWidth - 1, static_cast<int>(std::floor((vmax.x + borderSize - origin.x) / tileWorldSize)));
+		const int miny = std::max(0, static_cast<int>(std::floor((vmin.z - borderSize - origin.z) / tileWorldSize)));
+		const int maxy = std::min(m_tilesHeight - 1, static_cast<int>(std::floor((vmax.z + borderSize - origin.z) / tileWorldSize)));
+
+		for (int y = miny; y <= maxy; ++y)
+		{
+			for (int x = minx; x <= maxx; ++x)
+			{
+				m_buckets[x + y * m_tilesWidth].push_back(index);
+			}
+		}
+	}
+}
+
+const std::vector<uint32_t>& ConvexVolumeIndex::GetVolumesForTile(int tx, int ty) const
+{
+	if (tx < 0 || ty < 0 || tx >= m_tilesWidth || ty >= m_tilesHeight)
+		return m_empty;
+
+	return m_buckets[tx + ty * m_tilesWidth];
+}
@@ -0,0 +1,56 @@
+//
+// TileBuildContext.h
+//
+
+#pragma once
+
+#include "common/NavMeshData.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct OffMeshConnectionBuffer;
+
+//----------------------------------------------------------------------------
+
+// Spatial index of convex volumes, bucketed by the tile grid. Each tile bucket
+// holds the volumes that overlap the border expanded bounds of that tile, so a
+// tile build only needs to visit nearby volumes.
+//
+// The index holds a copy of the volumes so that it is not affected by edits
+// made while a build is in progress.
+class ConvexVolumeIndex
+{
+public:
+	ConvexVolumeIndex() = default;
+
+	void Build(const std::vector<std::unique_ptr<ConvexVolume>>& volumes,
+		const glm::vec3& origin, float tileWorldSize, float borderSize,
+		int tilesWidth, int tilesHeight);
+
+	// Indices of volumes overlapping the tile, in the same order as the volume list.
+	const std::vector<uint32_t>& GetVolumesForTile(int tx, int ty) const;
+
+	const ConvexVolume& GetVolume(uint32_t index) const { return m_volumes[index]; }
+	size_t GetVolumeCount() const { return m_volumes.size(); }
+
+private:
+	std::vector<ConvexVolume> m_volumes;
+	std::vector<std::vector<uint32_t>> m_buckets;
+	std::vector<uint32_t> m_empty;
+	int m_tilesWidth = 0;
+	int m_tilesHeight = 0;
+};
+
+//----------------------------------------------------------------------------
+
+// Data that is shared by all tiles in a build. This is created once at the start
+// of a build and is read only for the duration of the build.
+struct TileBuildContext
+{
+	std::shared_ptr<OffMeshConnectionBuffer> offMeshConnections;
+	ConvexVolumeIndex volumes;
+};
@@ -0,0 +1,93 @@
+//
+// TileCache.cpp
+//
+
+#include "meshgen/TileCache.h"
+#include "common/Utilities.h"
+
+#include <DetourAlloc.h>
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+TileCache::TileCache(const std::string& directory)
+	: m_directory(directory)
+{
+}
+
+std::string TileCache::GetFilename(uint64_t key) const
+{
+	return m_directory + "\\" + FormatHash(key) + ".tile";
+}
+
+bool TileCache::Load(uint64_t key, unsigned char*& data, int& dataSize) const
+{
+	data = nullptr;
+	dataSize = 0;
+
+	std::ifstream in(GetFilename(key), std::ios::binary | std::ios::ate);
+	if (!in.is_open())
+		return false;
+
+	std::streamoff size = in.tellg();
+	if (size < 0 || size > INT_MAX)
+		return false;
+
+	if (size == 0)
+		return true;
+
+	unsigned char* buffer = static_cast<unsigned char*>(dtAlloc(static_cast<int>(size), DT_ALLOC_PERM));
+	if (!buffer)
+		return false;
+
+	in.seekg(0);
+	if (!in.read(reinterpret_cast<char*>(buffer), size))
+	{
+		dtFree(buffer);
+		return false;
+	}
+
+	data = buffer;
+	dataSize = static_cast<int>(size);
+	return true;
+}
+
+bool TileCache::Store(uint64_t key, const unsigned char* data, int dataSize) const
+{
+	std::error_code ec;
+	fs::create_directories(m_directory, ec);
+
+	// Write to a temporary file first so that readers never see a partial tile. Include
+	// the thread id in the name in case two threads happen to build the same tile.
+	std::string filename = GetFilename(key);
+	std::string tempFilename = filename + "." + std::to_string(
+		std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+	{
+		std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		if (data && dataSize > 0)
+			out.write(reinterpret_cast<const char*>(data), dataSize);
+
+		if (!out.good())
+		{
+			out.close();
+			fs::remove(tempFilename, ec);
+			return false;
+		}
+	}
+
+	fs::rename(tempFilename, filename, ec);
+	if (ec)
+	{
+		fs::remove(tempFilename, ec);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,37 @@
+//
+// TileCache.h
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// On disk cache of built navmesh tiles. Tiles are content addressed: the key is
+// a hash of every input that went into building the tile, so a tile whose inputs
+// haven't changed can be reused as is, even across sessions.
+//
+// Empty tiles are cached as well, as an empty entry.
+
+// Increment when the tile build process changes in a way that isn't captured
+// by the inputs hashed into the key.
+constexpr uint32_t TILE_CACHE_VERSION = 3;
+
+class TileCache
+{
+public:
+	explicit TileCache(const std::string& directory);
+
+	// Look up a tile. Returns true if the key was found. On success, data is
+	// allocated with dtAlloc and is owned by the caller. data will be null
+	// if the cached tile was empty.
+	bool Load(uint64_t key, unsigned char*& data, int& dataSize) const;
+
+	// Store a tile. data may be null to record an empty tile.
+	bool Store(uint64_t key, const unsigned char* data, int dataSize) const;
+
+private:
+	std::string GetFilename(uint64_t key) const;
+
+	std::string m_directory;
+};
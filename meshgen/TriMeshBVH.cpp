@@ -0,0 +1,443 @@
+//
+// TriMeshBVH.cpp
+//
+
+#include "meshgen/TriMeshBVH.h"
+#include "meshgen/Parallel.h"
+#include "meshgen/TriNormals.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+// Number of bins used to evaluate split candidates along each axis.
+constexpr int SAH_BIN_COUNT = 16;
+
+// Relative cost of visiting a node vs. processing a triangle.
+constexpr float SAH_TRAVERSAL_COST = 1.0f;
+constexpr float SAH_TRIANGLE_COST = 1.0f;
+
+// Subtrees larger than this are built in parallel.
+constexpr int PARALLEL_BUILD_THRESHOLD = 4096;
+
+// Deep enough for any reasonable input. Leaves are forced past this depth, which
+// also bounds the traversal stack.
+constexpr int MAX_TREE_DEPTH = 64;
+
+struct Bounds
+{
+	float bmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float bmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	void Grow(const float* p)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			bmin[i] = std::min(bmin[i], p[i]);
+			bmax[i] = std::max(bmax[i], p[i]);
+		}
+	}
+
+	void Grow(const Bounds& b)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			bmin[i] = std::min(bmin[i], b.bmin[i]);
+			bmax[i] = std::max(bmax[i], b.bmax[i]);
+		}
+	}
+
+	float SurfaceArea() const
+	{
+		const float dx = bmax[0] - bmin[0];
+		const float dy = bmax[1] - bmin[1];
+		const float dz = bmax[2] - bmin[2];
+		if (dx < 0 || dy < 0 || dz < 0)
+			return 0.0f;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+};
+
+struct BuildNode
+{
+	Bounds bounds;
+	int start = 0;
+	int count = 0;
+	std::unique_ptr<BuildNode> children[2];
+
+	bool IsLeaf() const { return children[0] == nullptr; }
+};
+
+class BVHBuilder
+{
+public:
+	BVHBuilder(const float* verts, const int* tris, int ntris, int maxTrisPerLeaf)
+		: m_verts(verts)
+		, m_tris(tris)
+		, m_maxTrisPerLeaf(std::max(1, maxTrisPerLeaf))
+		, m_triBounds(ntris)
+		, m_centroids(ntris * 3)
+		, m_indices(ntris)
+	{
+		ParallelFor(0, ntris, [&](int i)
+			{
+				Bounds& b = m_triBounds[i];
+				for (int j = 0; j < 3; ++j)
+					b.Grow(&m_verts[m_tris[i * 3 + j] * 3]);
+
+				for (int j = 0; j < 3; ++j)
+					m_centroids[i * 3 + j] = (b.bmin[j] + b.bmax[j]) * 0.5f;
+
+				m_indices[i] = i;
+			});
+	}
+
+	std::unique_ptr<BuildNode> BuildRecursive(int start, int end, int depth)
+	{
+		auto node = std::make_unique<BuildNode>();
+		node->start = start;
+		node->count = end - start;
+
+		Bounds centroidBounds;
+		for (int i = start; i < end; ++i)
+		{
+			node->bounds.Grow(m_triBounds[m_indices[i]]);
+			centroidBounds.Grow(&m_centroids[m_indices[i] * 3]);
+		}
+
+		const int count = end - start;
+		if (count <= 2 || depth >= MAX_TREE_DEPTH)
+			return node;
+
+		int mid = FindSplit(node->bounds, centroidBounds, start, end);
+		if (mid < 0)
+			return node;
+
+		if (count > PARALLEL_BUILD_THRESHOLD)
+		{
+			ParallelInvoke(
+				[&] { node->children[0] = BuildRecursive(start, mid, depth + 1); },
+				[&] { node->children[1] = BuildRecursive(mid, end, depth + 1); });
+		}
+		else
+		{
+			node->children[0] = BuildRecursive(start, mid, depth + 1);
+			node->children[1] = BuildRecursive(mid, end, depth + 1);
+		}
+
+		return node;
+	}
+
+	const std::vector<int>& GetIndices() const { return m_indices; }
+
+private:
+	// Partition [start, end) and return the split point, or -1 to make a leaf.
+	int FindSplit(const Bounds& bounds, const Bounds& centroidBounds, int start, int end)
+	{
+		const int count = end - start;
+
+		struct Bin
+		{
+			Bounds bounds;
+			int count = 0;
+		};
+
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		int bestBin = 0;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float cmin = centroidBounds.bmin[axis];
+			const float extent = centroidBounds.bmax[axis] - cmin;
+			if (extent <= 0.0f)
+				continue;
+
+			Bin bins[SAH_BIN_COUNT];
+			const float scale = SAH_BIN_COUNT / extent;
+
+			for (int i = start; i < end; ++i)
+			{
+				const int tri = m_indices[i];
+				int b = static_cast<int>((m_centroids[tri * 3 + axis] - cmin) * scale);
+				b = std::clamp(b, 0, SAH_BIN_COUNT - 1);
+				bins[b].count++;
+				bins[b].bounds.Grow(m_triBounds[tri]);
+			}
+
+			// sweep from the right to get the cost of everything right of each plane
+			float rightArea[SAH_BIN_COUNT];
+			int rightCount[SAH_BIN_COUNT];
+			Bounds accum;
+			int accumCount = 0;
+			for (int b = SAH_BIN_COUNT - 1; b > 0; --b)
+			{
+				accum.Grow(bins[b].bounds);
+				accumCount += bins[b].count;
+				rightArea[b] = accum.SurfaceArea();
+				rightCount[b] = accumCount;
+			}
+
+			accum = Bounds{};
+			accumCount = 0;
+			for (int b = 0; b < SAH_BIN_COUNT - 1; ++b)
+			{
+				accum.Grow(bins[b].bounds);
+				accumCount += bins[b].count;
+
+				if (accumCount == 0 || rightCount[b + 1] == 0)
+					continue;
+
+				const float cost = accum.SurfaceArea() * accumCount + rightArea[b + 1] * rightCount[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		const float parentArea = bounds.SurfaceArea();
+		const float leafCost = SAH_TRIANGLE_COST * count;
+
+		if (bestAxis >= 0)
+		{
+			const float splitCost = parentArea > 0.0f
+				? SAH_TRAVERSAL_COST + SAH_TRIANGLE_COST * bestCost / parentArea
+				: leafCost;
+
+			if (splitCost >= leafCost && count <= m_maxTrisPerLeaf)
+				return -1;
+
+			const float cmin = centroidBounds.bmin[bestAxis];
+			const float scale = SAH_BIN_COUNT / (centroidBounds.bmax[bestAxis] - cmin);
+
+			auto iter = std::partition(m_indices.begin() + start, m_indices.begin() + end,
+				[&](int tri)
+				{
+					int b = static_cast<int>((m_centroids[tri * 3 + bestAxis] - cmin) * scale);
+					return std::clamp(b, 0, SAH_BIN_COUNT - 1) <= bestBin;
+				});
+
+			int mid = static_cast<int>(iter - m_indices.begin());
+			if (mid > start && mid < end)
+				return mid;
+		}
+
+		if (count <= m_maxTrisPerLeaf)
+			return -1;
+
+		// No useful split (eg all centroids coincide), but the leaf would be too large.
+		// Split in the middle along the longest axis.
+		int axis = 0;
+		for (int i = 1; i < 3; ++i)
+		{
+			if (bounds.bmax[i] - bounds.bmin[i] > bounds.bmax[axis] - bounds.bmin[axis])
+				axis = i;
+		}
+
+		const int mid = start + count / 2;
+		std::nth_element(m_indices.begin() + start, m_indices.begin() + mid, m_indices.begin() + end,
+			[&](int a, int b)
+			{
+				if (m_centroids[a * 3 + axis] != m_centroids[b * 3 + axis])
+					return m_centroids[a * 3 + axis] < m_centroids[b * 3 + axis];
+				return a < b;
+			});
+		return mid;
+	}
+
+	const float* m_verts;
+	const int* m_tris;
+	int m_maxTrisPerLeaf;
+
+	std::vector<Bounds> m_triBounds;
+	std::vector<float> m_centroids;
+	std::vector<int> m_indices;
+};
+
+void FlattenTree(const BuildNode* node, std::vector<TriMeshBVHNode>& nodes, int& maxTrisPerLeaf)
+{
+	const int index = static_cast<int>(nodes.size());
+	nodes.emplace_back();
+
+	TriMeshBVHNode& out = nodes[index];
+	std::copy(std::begin(node->bounds.bmin), std::end(node->bounds.bmin), out.bmin);
+	std::copy(std::begin(node->bounds.bmax), std::end(node->bounds.bmax), out.bmax);
+
+	if (node->IsLeaf())
+	{
+		out.offset = node->start;
+		out.count = node->count;
+		maxTrisPerLeaf = std::max(maxTrisPerLeaf, node->count);
+		return;
+	}
+
+	FlattenTree(node->children[0].get(), nodes, maxTrisPerLeaf);
+
+	// can't hold a reference across the recursive calls
+	nodes[index].offset = static_cast<int>(nodes.size());
+	nodes[index].count = 0;
+
+	FlattenTree(node->children[1].get(), nodes, maxTrisPerLeaf);
+}
+
+inline bool OverlapBox(const float* amin, const float* amax, const TriMeshBVHNode& node)
+{
+	return !(amin[0] > node.bmax[0] || amax[0] < node.bmin[0]
+		|| amin[1] > node.bmax[1] || amax[1] < node.bmin[1]
+		|| amin[2] > node.bmax[2] || amax[2] < node.bmin[2]);
+}
+
+inline bool OverlapSegment(const float* p, const float* d, const TriMeshBVHNode& node)
+{
+	static const float EPSILON = 1e-6f;
+
+	float tmin = 0.0f;
+	float tmax = 1.0f;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (fabsf(d[i]) < EPSILON)
+		{
+			// Segment is parallel to slab. No hit if origin not within slab
+			if (p[i] < node.bmin[i] || p[i] > node.bmax[i])
+				return false;
+		}
+		else
+		{
+			const float ood = 1.0f / d[i];
+			float t1 = (node.bmin[i] - p[i]) * ood;
+			float t2 = (node.bmax[i] - p[i]) * ood;
+			if (t1 > t2) std::swap(t1, t2);
+			if (t1 > tmin) tmin = t1;
+			if (t2 < tmax) tmax = t2;
+			if (tmin > tmax) return false;
+		}
+	}
+
+	return true;
+}
+
+template <typename OverlapFunc>
+int Traverse(const TriMeshBVHNode* nodes, int nodeCount, std::vector<int>& leaves, OverlapFunc&& overlap)
+{
+	leaves.clear();
+	if (nodeCount == 0)
+		return 0;
+
+	int stack[MAX_TREE_DEPTH + 2];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const int index = stack[--stackSize];
+		const TriMeshBVHNode& node = nodes[index];
+
+		if (!overlap(node))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			leaves.push_back(index);
+		}
+		else
+		{
+			// push second child first so that leaves come out in depth first order
+			stack[stackSize++] = node.offset;
+			stack[stackSize++] = index + 1;
+		}
+	}
+
+	return static_cast<int>(leaves.size());
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+bool TriMeshBVH::Build(const float* verts, const int* tris, int ntris, int maxTrisPerLeaf)
+{
+	m_nodeStorage.clear();
+	m_triStorage.clear();
+	m_normalStorage.clear();
+	m_maxTrisPerLeaf = 0;
+
+	if (ntris > 0)
+	{
+		BVHBuilder builder(verts, tris, ntris, maxTrisPerLeaf);
+		std::unique_ptr<BuildNode> root = builder.BuildRecursive(0, ntris, 0);
+
+		m_nodeStorage.reserve(2 * static_cast<size_t>(ntris) / std::max(1, maxTrisPerLeaf) + 1);
+		FlattenTree(root.get(), m_nodeStorage, m_maxTrisPerLeaf);
+
+		// Reorder triangles to match leaf order.
+		const std::vector<int>& indices = builder.GetIndices();
+		m_triStorage.resize(static_cast<size_t>(ntris) * 3);
+
+		ParallelFor(0, ntris, [&](int i)
+			{
+				const int src = indices[i];
+				m_triStorage[i * 3 + 0] = tris[src * 3 + 0];
+				m_triStorage[i * 3 + 1] = tris[src * 3 + 1];
+				m_triStorage[i * 3 + 2] = tris[src * 3 + 2];
+			});
+
+		// Normals in leaf order, so tile builds can mark walkable triangles of a
+		// leaf without recomputing them.
+		m_normalStorage.resize(static_cast<size_t>(ntris) * 3);
+		float* nx = m_normalStorage.data();
+		float* ny = nx + ntris;
+		float* nz = ny + ntris;
+
+		const int blockSize = 4096;
+		ParallelFor(0, (ntris + blockSize - 1) / blockSize, [&](int block)
+			{
+				const int first = block * blockSize;
+				const int count = std::min(blockSize, ntris - first);
+				ComputeTriNormals(verts, &m_triStorage[first * 3], count, nx + first, ny + first, nz + first);
+			});
+	}
+
+	m_nodes = m_nodeStorage.data();
+	m_nodeCount = static_cast<int>(m_nodeStorage.size());
+	m_tris = m_triStorage.data();
+	m_normals = m_normalStorage.data();
+	m_triCount = ntris;
+
+	return true;
+}
+
+void TriMeshBVH::Attach(const TriMeshBVHNode* nodes, int nodeCount, const int* tris, const float* normals,
+	int triCount, int maxTrisPerLeaf)
+{
+	m_nodeStorage.clear();
+	m_triStorage.clear();
+	m_normalStorage.clear();
+
+	m_nodes = nodes;
+	m_nodeCount = nodeCount;
+	m_tris = tris;
+	m_normals = normals;
+	m_triCount = triCount;
+	m_maxTrisPerLeaf = maxTrisPerLeaf;
+}
+
+int TriMeshBVH::QueryBox(const float* bmin, const float* bmax, std::vector<int>& leaves) const
+{
+	return Traverse(m_nodes, m_nodeCount, leaves,
+		[bmin, bmax](const TriMeshBVHNode& node) { return OverlapBox(bmin, bmax, node); });
+}
+
+int TriMeshBVH::QuerySegment(const float* p, const float* q, std::vector<int>& leaves) const
+{
+	const float d[3] = { q[0] - p[0], q[1] - p[1], q[2] - p[2] };
+
+	return Traverse(m_nodes, m_nodeCount, leaves,
+		[p, &d](const TriMeshBVHNode& node) { return OverlapSegment(p, d, node); });
+}
@@ -0,0 +1,96 @@
+//
+// TriMeshBVH.h
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over the triangles of the input mesh. The tree is
+// built top down with a binned surface area heuristic, in parallel, and stored
+// as a flat array of nodes in depth first order: the first child of an interior
+// node immediately follows it, and the node stores the index of its second child.
+//
+// Triangles are reordered so that every leaf references a contiguous range of
+// the triangle list. Their normals are computed once when the hierarchy is
+// built and kept in the same order, as structure of arrays (see TriNormals.h).
+
+struct TriMeshBVHNode
+{
+	float bmin[3];
+
+	// leaf: index of the first triangle of the leaf in the triangle list.
+	// interior: index of the second child.
+	int32_t offset;
+
+	float bmax[3];
+
+	// leaf: number of triangles in the leaf. interior: 0.
+	int32_t count;
+
+	bool IsLeaf() const { return count > 0; }
+};
+static_assert(sizeof(TriMeshBVHNode) == 32, "TriMeshBVHNode is expected to be 32 bytes");
+
+class TriMeshBVH
+{
+public:
+	TriMeshBVH() = default;
+	~TriMeshBVH() = default;
+
+	TriMeshBVH(const TriMeshBVH&) = delete;
+	TriMeshBVH& operator=(const TriMeshBVH&) = delete;
+
+	// Build the hierarchy. maxTrisPerLeaf is the largest leaf the builder will
+	// create, the heuristic will usually produce smaller leaves.
+	bool Build(const float* verts, const int* tris, int ntris, int maxTrisPerLeaf);
+
+	// Use prebuilt hierarchy data, eg from a mapped cache file. The data is not
+	// copied and must outlive the BVH. normals holds the x, y and z arrays of the
+	// triangle normals back to back.
+	void Attach(const TriMeshBVHNode* nodes, int nodeCount, const int* tris, const float* normals,
+		int triCount, int maxTrisPerLeaf);
+
+	// Collect the leaves whose bounds overlap the box. leaves is cleared first.
+	// Returns the number of leaves found.
+	int QueryBox(const float* bmin, const float* bmax, std::vector<int>& leaves) const;
+
+	// Collect the leaves whose bounds are crossed by the segment p-q.
+	int QuerySegment(const float* p, const float* q, std::vector<int>& leaves) const;
+
+	const TriMeshBVHNode& GetNode(int index) const { return m_nodes[index]; }
+	const TriMeshBVHNode* GetNodes() const { return m_nodes; }
+	int GetNodeCount() const { return m_nodeCount; }
+
+	// Reordered triangle list, 3 indices per triangle.
+	const int* GetTris() const { return m_tris; }
+	int GetTriCount() const { return m_triCount; }
+
+	const int* GetLeafTris(const TriMeshBVHNode& node) const { return m_tris + node.offset * 3; }
+
+	// Normals of the reordered triangles: triCount x components, followed by the
+	// y and z components.
+	const float* GetNormals() const { return m_normals; }
+	const float* GetNormalsX() const { return m_normals; }
+	const float* GetNormalsY() const { return m_normals + m_triCount; }
+	const float* GetNormalsZ() const { return m_normals + 2 * static_cast<size_t>(m_triCount); }
+
+	const float* GetLeafNormalsY(const TriMeshBVHNode& node) const { return GetNormalsY() + node.offset; }
+
+	// Size of the largest leaf
+	int GetMaxTrisPerLeaf() const { return m_maxTrisPerLeaf; }
+
+private:
+	std::vector<TriMeshBVHNode> m_nodeStorage;
+	std::vector<int> m_triStorage;
+	std::vector<float> m_normalStorage;
+
+	const TriMeshBVHNode* m_nodes = nullptr;
+	int m_nodeCount = 0;
+	const int* m_tris = nullptr;
+	const float* m_normals = nullptr;
+	int m_triCount = 0;
+	int m_maxTrisPerLeaf = 0;
+};
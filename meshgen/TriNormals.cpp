@@ -0,0 +1,161 @@
+//
+// TriNormals.cpp
+//
+
+#include "meshgen/TriNormals.h"
+
+#include <DebugDraw.h>
+#include <Recast.h>
+
+#include <cmath>
+#include <emmintrin.h>
+
+// Normal of a single triangle, same operations as calcTriNormal in Recast.
+static inline void CalcTriNormal(const float* v0, const float* v1, const float* v2, float* n)
+{
+	float e0[3], e1[3];
+	for (int j = 0; j < 3; ++j)
+	{
+		e0[j] = v1[j] - v0[j];
+		e1[j] = v2[j] - v0[j];
+	}
+
+	n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+	n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+	n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+
+	const float len2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+	if (len2 > 0)
+	{
+		const float d = 1.0f / sqrtf(len2);
+		n[0] *= d;
+		n[1] *= d;
+		n[2] *= d;
+	}
+}
+
+void ComputeTriNormals(const float* verts, const int* tris, int ntris,
+	float* nx, float* ny, float* nz)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	int i = 0;
+	for (; i + 4 <= ntris; i += 4)
+	{
+		// Vertex components of 4 triangles, one register each.
+		alignas(16) float c[9][4];
+		for (int k = 0; k < 4; ++k)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				const float* v = &verts[tris[(i + k) * 3 + j] * 3];
+				c[j * 3 + 0][k] = v[0];
+				c[j * 3 + 1][k] = v[1];
+				c[j * 3 + 2][k] = v[2];
+			}
+		}
+
+		const __m128 v0x = _mm_load_ps(c[0]), v0y = _mm_load_ps(c[1]), v0z = _mm_load_ps(c[2]);
+		const __m128 e0x = _mm_sub_ps(_mm_load_ps(c[3]), v0x);
+		const __m128 e0y = _mm_sub_ps(_mm_load_ps(c[4]), v0y);
+		const __m128 e0z = _mm_sub_ps(_mm_load_ps(c[5]), v0z);
+		const __m128 e1x = _mm_sub_ps(_mm_load_ps(c[6]), v0x);
+		const __m128 e1y = _mm_sub_ps(_mm_load_ps(c[7]), v0y);
+		const __m128 e1z = _mm_sub_ps(_mm_load_ps(c[8]), v0z);
+
+		const __m128 x = _mm_sub_ps(_mm_mul_ps(e0y, e1z), _mm_mul_ps(e0z, e1y));
+		const __m128 y = _mm_sub_ps(_mm_mul_ps(e0z, e1x), _mm_mul_ps(e0x, e1z));
+		const __m128 z = _mm_sub_ps(_mm_mul_ps(e0x, e1y), _mm_mul_ps(e0y, e1x));
+
+		const __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		const __m128 valid = _mm_cmpgt_ps(len2, zero);
+		const __m128 d = _mm_div_ps(one, _mm_sqrt_ps(len2));
+
+		// Degenerate triangles keep their zero normal.
+		_mm_storeu_ps(nx + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(x, d)), _mm_andnot_ps(valid, x)));
+		_mm_storeu_ps(ny + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(y, d)), _mm_andnot_ps(valid, y)));
+		_mm_storeu_ps(nz + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(z, d)), _mm_andnot_ps(valid, z)));
+	}
+
+	for (; i < ntris; ++i)
+	{
+		float n[3];
+		CalcTriNormal(&verts[tris[i * 3 + 0] * 3], &verts[tris[i * 3 + 1] * 3], &verts[tris[i * 3 + 2] * 3], n);
+		nx[i] = n[0];
+		ny[i] = n[1];
+		nz[i] = n[2];
+	}
+}
+
+void MarkWalkableTriangles(float walkableSlopeAngle, const float* ny, int ntris,
+	unsigned char* areas)
+{
+	const float walkableThr = cosf(walkableSlopeAngle / 180.0f * RC_PI);
+
+	const __m128 thr = _mm_set1_ps(walkableThr);
+	const __m128i walkable = _mm_set1_epi8(static_cast<char>(RC_WALKABLE_AREA));
+
+	int i = 0;
+	for (; i + 16 <= ntris; i += 16)
+	{
+		// Compare 16 normals and narrow the masks down to one byte per triangle.
+		const __m128i m0 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(ny + i + 0), thr));
+		const __m128i m1 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(ny + i + 4), thr));
+		const __m128i m2 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(ny + i + 8), thr));
+		const __m128i m3 = _mm_castps_si128(_mm_cmpgt_ps(_mm_loadu_ps(ny + i + 12), thr));
+		const __m128i mask = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+
+		__m128i* dst = reinterpret_cast<__m128i*>(areas + i);
+		const __m128i prev = _mm_loadu_si128(dst);
+		_mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(mask, walkable), _mm_andnot_si128(mask, prev)));
+	}
+
+	for (; i < ntris; ++i)
+	{
+		if (ny[i] > walkableThr)
+			areas[i] = RC_WALKABLE_AREA;
+	}
+}
+
+void DebugDrawTriMeshSlope(duDebugDraw* dd, const float* verts, const int* tris,
+	const float* nx, const float* ny, const float* nz, int ntris,
+	float walkableSlopeAngle, float texScale)
+{
+	if (!dd || !verts || !tris || !nx || !ny || !nz)
+		return;
+
+	const float walkableThr = cosf(walkableSlopeAngle / 180.0f * DU_PI);
+	const unsigned int unwalkable = duRGBA(192, 128, 0, 255);
+
+	dd->texture(true);
+	dd->begin(DU_DRAW_TRIS);
+
+	for (int i = 0; i < ntris; ++i)
+	{
+		const float norm[3] = { nx[i], ny[i], nz[i] };
+
+		unsigned char a = (unsigned char)(220 * (2 + norm[0] + norm[1]) / 4);
+		unsigned int color = duRGBA(a, a, a, 255);
+		if (norm[1] < walkableThr)
+			color = duLerpCol(color, unwalkable, 64);
+
+		int ax = 0;
+		if (fabsf(norm[1]) > fabsf(norm[ax]))
+			ax = 1;
+		if (fabsf(norm[2]) > fabsf(norm[ax]))
+			ax = 2;
+		ax = (1 << ax) & 3; // +1 mod 3
+		const int ay = (1 << ax) & 3; // +1 mod 3
+
+		for (int j = 0; j < 3; ++j)
+		{
+			const float* v = &verts[tris[i * 3 + j] * 3];
+			const float uv[2] = { v[ax] * texScale, v[ay] * texScale };
+			dd->vertex(v, color, uv);
+		}
+	}
+
+	dd->end();
+	dd->texture(false);
+}
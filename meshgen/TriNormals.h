@@ -0,0 +1,28 @@
+//
+// TriNormals.h
+//
+
+#pragma once
+
+struct duDebugDraw;
+
+// Per-triangle unit normals, stored as structure of arrays: the x, y and z
+// components of all triangles are kept in three separate arrays so they can be
+// processed several triangles at a time.
+//
+// The normals are bit for bit the ones rcMarkWalkableTriangles computes, so
+// marking triangles from them gives the same areas. Degenerate triangles get a
+// zero normal, and are never walkable.
+
+// Compute the normals of ntris triangles into nx, ny and nz.
+void ComputeTriNormals(const float* verts, const int* tris, int ntris,
+	float* nx, float* ny, float* nz);
+
+// Same as rcMarkWalkableTriangles, using precomputed normal y components.
+void MarkWalkableTriangles(float walkableSlopeAngle, const float* ny, int ntris,
+	unsigned char* areas);
+
+// Same as duDebugDrawTriMeshSlope, using precomputed normals.
+void DebugDrawTriMeshSlope(duDebugDraw* dd, const float* verts, const int* tris,
+	const float* nx, const float* ny, const float* nz, int ntris,
+	float walkableSlopeAngle, float texScale);
@@ -3,12 +3,147 @@
 //
 
 #include "meshgen/Application.h"
+#include "meshgen/BuildBenchmark.h"
+#include "meshgen/ShardedBuild.h"
 
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <sstream>
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+
+	std::stringstream ss(list);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		if (!item.empty())
+			items.push_back(item);
+	}
+
+	return items;
+}
+
+static std::vector<float> SplitFloatList(const std::string& list)
+{
+	std::vector<float> values;
+	for (const std::string& item : SplitList(list))
+		values.push_back(static_cast<float>(atof(item.c_str())));
+
+	return values;
+}
+
+// Returns why the benchmark can't run with these options, or an empty string.
+static std::string ValidateBenchmarkOptions(const BuildBenchmarkOptions& options)
+{
+	if (options.tileSizes.empty() || options.cellSizes.empty())
+		return "--tile-sizes and --cell-sizes need at least one size";
+
+	for (float tileSize : options.tileSizes)
+	{
+		if (!(tileSize > 0))
+			return fmt::format("Invalid tile size {}, tile sizes must be positive", tileSize);
+	}
+
+	for (float cellSize : options.cellSizes)
+	{
+		if (!(cellSize > 0))
+			return fmt::format("Invalid cell size {}, cell sizes must be positive", cellSize);
+	}
+
+	if (options.pathQueries < 0)
+		return fmt::format("Invalid query count {}, it can't be negative", options.pathQueries);
+
+	return {};
+}
+
+// MeshGenerator [zone]
+// MeshGenerator --build zone1,zone2 [--shards N] [--workers N] [--workdir dir] [--claim-timeout seconds]
+// MeshGenerator --shard-worker dir [--worker-id id]
+// MeshGenerator --benchmark zone1,zone2 [--tile-sizes a,b] [--cell-sizes a,b] [--queries N] [--apply]
+//
+// Benchmarks only recommend cell sizes up to the zone's current one, coarser cell
+// sizes are built and reported for comparison.
 int main(int argc, char* argv[])
 {
 	std::string startingZone;
-	if (argc > 1)
-		startingZone = argv[1];
+	std::string shardWorkDir;
+	std::string workerId;
+	std::string buildZones;
+	ShardedBuildOptions buildOptions;
+	std::string benchmarkZones;
+	BuildBenchmarkOptions benchmarkOptions;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--shard-worker" && hasValue)
+			shardWorkDir = argv[++i];
+		else if (arg == "--worker-id" && hasValue)
+			workerId = argv[++i];
+		else if (arg == "--build" && hasValue)
+			buildZones = argv[++i];
+		else if (arg == "--shards" && hasValue)
+			buildOptions.shardsPerZone = atoi(argv[++i]);
+		else if (arg == "--workers" && hasValue)
+			buildOptions.localWorkers = atoi(argv[++i]);
+		else if (arg == "--workdir" && hasValue)
+			buildOptions.workDirectory = argv[++i];
+		else if (arg == "--claim-timeout" && hasValue)
+			buildOptions.claimTimeout = std::chrono::seconds(atoi(argv[++i]));
+		else if (arg == "--benchmark" && hasValue)
+			benchmarkZones = argv[++i];
+		else if (arg == "--tile-sizes" && hasValue)
+			benchmarkOptions.tileSizes = SplitFloatList(argv[++i]);
+		else if (arg == "--cell-sizes" && hasValue)
+			benchmarkOptions.cellSizes = SplitFloatList(argv[++i]);
+		else if (arg == "--queries" && hasValue)
+			benchmarkOptions.pathQueries = atoi(argv[++i]);
+		else if (arg == "--apply")
+			benchmarkOptions.apply = true;
+		else
+			startingZone = arg;
+	}
+
+	if (!shardWorkDir.empty())
+	{
+		if (workerId.empty())
+		{
+			CHAR computerName[MAX_COMPUTERNAME_LENGTH + 1] = { 0 };
+			DWORD size = MAX_COMPUTERNAME_LENGTH + 1;
+			GetComputerNameA(computerName, &size);
+
+			workerId = fmt::format("{}-{}", computerName, GetCurrentProcessId());
+		}
+
+		return RunShardWorker(shardWorkDir, workerId);
+	}
+
+	if (!buildZones.empty())
+	{
+		buildOptions.zones = SplitList(buildZones);
+		return RunShardedBuild(buildOptions);
+	}
+
+	if (!benchmarkZones.empty())
+	{
+		benchmarkOptions.zones = SplitList(benchmarkZones);
+
+		const std::string error = ValidateBenchmarkOptions(benchmarkOptions);
+		if (!error.empty())
+		{
+			InitializeHeadlessLogging("benchmark");
+			SPDLOG_ERROR("{}", error);
+			spdlog::shutdown();
+			return 1;
+		}
+
+		return RunBuildBenchmark(benchmarkOptions);
+	}
 
 	Application window(startingZone);
 	return window.RunMainLoop();